@@ -0,0 +1,110 @@
+/*
+ *  ArchiveImageSource2.h
+ *  OpenCV
+ *
+ */
+
+#ifndef ARCHIVEIMAGESOURCE2_H
+#define ARCHIVEIMAGESOURCE2_H
+
+#include <opencv2/core/core.hpp>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+#include "ImageDataSet2.h"
+
+/**
+ *\ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> Reads the images of an ImageDataSet2 out
+ * of a tar archive, in one sequential pass, without unpacking it.
+ *
+ * Image datasets such as GENKI are distributed as tar archives holding tens
+ * of thousands of small files. Reading them straight from the archive costs
+ * one sequential read, rather than one open per file, which is much cheaper
+ * on network file systems.
+ *
+ * The archive may be uncompressed or gzip compressed (.tar, .tgz, .tar.gz).
+ * Gzip support needs zlib, and is compiled in when CMake finds it (USE_ZLIB).
+ * Ustar path prefixes, GNU long names, and pax path records are understood.
+ *
+ * Dataset entries are matched to archive members by name: an entry and a
+ * member match if one path is equal to the other, or ends with it after a
+ * '/'. So the entry "data/GENKI-R2009a/files/file0001.jpg" matches the member
+ * "GENKI-R2009a/files/file0001.jpg". Images are returned in archive order.
+ *
+ * Members are read from the archive a batch at a time, and each batch is
+ * decoded on all cores with cv::parallel_for_. Only the members that match
+ * the dataset are kept in memory.
+ */
+class ArchiveImageSource2 {
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * @param archiveFile Path of the tar archive.
+	 * @param dataset Only members that match an entry of this dataset are
+	 * decoded. If it is empty, every member that is an image is decoded.
+	 * @param batchSize Number of members to read before decoding them
+	 * together. 0 means four per thread.
+	 **/
+	ArchiveImageSource2(const std::string &archiveFile,
+						const ImageDataSet2 &dataset = ImageDataSet2(),
+						int batchSize = 0);
+
+	/**
+	 * \brief Destructor. Closes the archive.
+	 **/
+	~ArchiveImageSource2();
+
+	/**
+	 * \brief Check whether the archive was opened.
+	 **/
+	int isOpened() const;
+
+	/**
+	 * \brief Get the next image in the archive.
+	 *
+	 * @param memberName Name of the image's archive member (set by the
+	 * method).
+	 * @param image The 8-bit single channel image (set by the method).
+	 * @param entries Indices of the dataset entries that match the member
+	 * (set by the method). Empty if no dataset was given.
+	 *
+	 * @return 1 if an image was returned, 0 at the end of the archive.
+	 **/
+	int nextImage(std::string &memberName, cv::Mat &image, std::vector<int> &entries);
+
+	/**
+	 * \brief Get the indices of dataset entries that have not matched any
+	 * member read so far. After nextImage() returns 0, these are the entries
+	 * missing from the archive, or whose image couldn't be decoded.
+	 **/
+	std::vector<int> getUnmatchedEntries() const;
+
+private:
+	ArchiveImageSource2(const ArchiveImageSource2 &copy);
+	ArchiveImageSource2 & operator=(const ArchiveImageSource2 &rhs);
+
+	int readBytes(char *dest, size_t numBytes);
+	int skipBytes(size_t numBytes);
+	int nextMember(std::string &name, std::vector<uchar> &data);
+	int readBatch();
+	void findEntries(const std::string &memberName, std::vector<int> &entries) const;
+
+	void *gzFileHandle;
+	FILE *fileHandle;
+	int atEnd;
+	int batchSize;
+
+	ImageDataSet2 dataset;
+	std::multimap<std::string, int> entriesByBaseName;
+	std::vector<char> matched;
+
+	std::vector<std::string> batchNames;
+	std::vector<cv::Mat> batchImages;
+	std::vector<std::vector<int> > batchEntries;
+	size_t batchPosition;
+};
+
+#endif
@@ -109,9 +109,9 @@ public:
 	 * the system current time in  microseconds. 
 	 *
 	 * Specifically, this uses
-	 * gettimeofday, time, and localtime. These are expected to be located in
-	 * <sys/time.h> and <time.h>. If the compiler gives you trouble,
-	 * try "man gettimeofday", "man time", and "man localtime" to figure out 
+	 * gettimeofday, which is expected to be located in
+	 * <sys/time.h>. If the compiler gives you trouble,
+	 * try "man gettimeofday" to figure out 
 	 * what headers you should use on your system, and include them in
 	 * BlockTimer.cpp. 
 	 */
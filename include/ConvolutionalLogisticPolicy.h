@@ -11,7 +11,12 @@
 #define _CONVOLUTIONALLOGISTICPOLICY_H
 
 #include <opencv2/core/core_c.h>
+#include <opencv2/core/core.hpp>
 #include <iostream>
+#include <vector>
+#include "DiscreteSampler.h"
+
+class MultinomialObservationModel; 
 
 
 /**
@@ -28,6 +33,8 @@
  * \li GAUSSIAN: Convolution kernel is a gaussian filter.
  * \li IMPULSE: Convolution kernel is an impulse response.
  * \li MAX: Convolution kernel is an impulse response with infinite weight.
+ * \li INFOMAX: Not a convolution: fixate the point with the greatest expected
+ * information gain.
  *
  * In the CLP, the belief-image is convolved with some kernel, and then a next fixation
  * is chosen by computing a soft-max over the convolution, and then sampling from
@@ -61,6 +68,13 @@ public:
 	 **/
 	const static int MAX = 4; 
 	
+	/**
+	 * ConvolutionalLogisticPolicy::INFOMAX - Fixate the grid cell where the observation is expected
+	 * to reduce the entropy of the belief the most, according to the observation model given to
+	 * setObservationModel(). See MultinomialObservationModel::getExpectedInformationGain(). 
+	 **/
+	const static int INFOMAX = 5; 
+	
 	/**
 	 * \brief Constructor: Create a CLP with space allocated to hold parameters
 	 * for a grid of size gridSize. 
@@ -77,7 +91,7 @@ public:
 	 * \brief Deep Copy Constructor: Create a CLP that is identical to the one 
 	 * to copy.
 	 **/
-	ConvolutionalLogisticPolicy(ConvolutionalLogisticPolicy* clpToCopy);
+	ConvolutionalLogisticPolicy(const ConvolutionalLogisticPolicy* clpToCopy);
 	
 	/**
 	 * \brief Default Destructor. 
@@ -104,6 +118,52 @@ public:
 	 **/
 	virtual CvPoint getFixationPoint(IplImage* currentBelief); 
 	
+	/**
+	 * \brief Draw another fixation from the distribution computed by the last
+	 * call to getFixationPoint(), without recomputing it. With the BOX, 
+	 * GAUSSIAN and IMPULSE policies, the distribution is held in a 
+	 * DiscreteSampler, so each draw takes O(log n) steps for n grid cells. 
+	 *
+	 * @return A grid-cell, or (-1,-1) if there is no distribution to draw 
+	 * from. 
+	 **/
+	CvPoint resampleFixationPoint(); 
+	
+	/**
+	 * \brief Rank the grid cells by how likely the policy is to fixate them, 
+	 * without drawing a fixation. This doesn't consume random numbers, so it 
+	 * doesn't change the fixations that getFixationPoint() goes on to choose.
+	 * Used by MIPOMDP to decide where to run the detector speculatively. 
+	 *
+	 * @param currentBelief The current belief, as for getFixationPoint(). 
+	 * @param numPoints How many cells to return. 
+	 * @param points The most likely cells, most likely first (set by the 
+	 * method). 
+	 **/
+	void getLikelyFixationPoints(IplImage* currentBelief, int numPoints, std::vector<CvPoint> &points); 
+	
+	/**
+	 * \brief Choose a fixation as getFixationPoint(currentBelief) does, and 
+	 * rank the cells as getLikelyFixationPoints() does, from one computation 
+	 * of the policy map. With INFOMAX this halves the work per fixation. 
+	 *
+	 * @param currentBelief The current belief, as for getFixationPoint(). 
+	 * @param numLikely How many cells to rank. 
+	 * @param likely The most likely cells, most likely first (set by the 
+	 * method). 
+	 *
+	 * @return The same grid-cell getFixationPoint(currentBelief) would return. 
+	 **/
+	CvPoint getFixationPoint(IplImage* currentBelief, int numLikely, std::vector<CvPoint> &likely); 
+	
+	/**
+	 * \brief Change the unnormalized probability of fixating one grid cell in
+	 * the distribution computed by the last call to getFixationPoint(), e.g. 
+	 * set it to 0 to keep resampleFixationPoint() from returning a cell that 
+	 * has already been fixated. This takes O(log n) steps. 
+	 **/
+	void setFixationWeight(CvPoint gridPoint, double weight); 
+	
 	/**
 	 * \brief Compute the infomax reward associated with this belief state.
 	 * 
@@ -123,9 +183,17 @@ public:
 	 * \li ConvolutionalLogisticPolicy::GAUSSIAN
 	 * \li ConvolutionalLogisticPolicy::IMPULSE
 	 * \li ConvolutionalLogisticPolicy::MAX
+	 * \li ConvolutionalLogisticPolicy::INFOMAX
 	 **/
 	void setPolicy(int policyNumber); 
 	
+	/**
+	 * \brief Tell the CLP which observation model the belief is updated with. 
+	 * This is needed by the INFOMAX policy. The model isn't copied, and must 
+	 * outlive the CLP. Generally this is set by the MIPOMDP that owns both.
+	 **/
+	void setObservationModel(const MultinomialObservationModel* model); 
+	
 	/**
 	 * \brief Tell the CLP the shape of the convolution kernel to use.
 	 * 
@@ -154,6 +222,18 @@ public:
 	 */
 	friend std::istream& operator>> (std::istream& ifs, ConvolutionalLogisticPolicy* a);
 	
+	/**
+	 * \brief Write the policy parameters to a binary stream as a checksummed 
+	 * block. Used by MIPOMDP::saveToBinaryFile(). 
+	 */
+	void addToStreamBinary(std::ostream& out); 
+	
+	/**
+	 * \brief Read what addToStreamBinary() wrote. Returns 0, leaving the 
+	 * policy unchanged, if the stream ended early or the checksum didn't match.
+	 */
+	int readFromStreamBinary(std::istream& in); 
+	
 	float randomFloat(); 
 protected:	
 	void readFromStream(std::istream& in); 
@@ -165,7 +245,14 @@ protected:
 	int polnum; 
 	
 	IplImage* actProb;       //has size of grid
+	DiscreteSampler sampler; //softmax of actProb, for sampling fixations
+	CvPoint sampleFromActivations(); 
+	cv::Mat computeFixationScores(IplImage* currentBelief); //policy map before the softmax gain
+	CvPoint chooseFromScores(cv::Mat score); 
+	static void rankFixationScores(cv::Mat score, int numPoints, std::vector<CvPoint> &points); 
 	
+	const MultinomialObservationModel* obsmodel; 
+	cv::Mat infoGain;        //has size of grid
 };
 
 
@@ -0,0 +1,149 @@
+#ifndef __DEADLINETIMER_H
+#define __DEADLINETIMER_H
+
+#include "BlockTimer.h"
+#include <iostream>
+#include <vector>
+
+/**
+ *\ingroup AuxGroup
+ *\brief <tt>Auxilliary Tool:</tt> A BlockTimer for work that has a time budget per frame, and is done in
+ * steps that can stop at any time (e.g. the fixations of MIPOMDP::searchFrameUntilDeadline()).
+ *
+ * Each frame is timed with one stopwatch, and each step with another. The costs of recent steps are kept, and
+ * the next step is predicted to cost as much as the most expensive of them, so that stopping whenever
+ * canAffordNextStep() says no keeps the frame within its budget unless a step is slower than any in recent
+ * history. The first step of a frame often costs more than the rest (e.g. the IPP searches the whole first
+ * scale of a new frame), so first steps and later steps are predicted from separate histories.
+ *
+ * The timer also counts how many frames there were, in how many of them the budget was binding (work stopped
+ * because the next step wouldn't fit), and in how many the budget was exceeded anyway.
+ *
+ * Typical usage:
+ *
+ * <code>
+ * timer.startFrame(.030); <br>
+ * while (!done && timer.canAffordNextStep()) { <br>
+ * &nbsp; timer.startStep(); doStep(); timer.stopStep(); <br>
+ * } <br>
+ * timer.endFrame(!done); <br>
+ * </code>
+ */
+class DeadlineTimer : public BlockTimer {
+public:
+	/**
+	 *\brief Constructor.
+	 *
+	 *@param historyLength The number of recent steps of each kind (first steps, and later steps) used to
+	 *predict the cost of the next step.
+	 */
+	DeadlineTimer(int historyLength=20);
+
+	/**
+	 *\brief Start timing a new frame.
+	 *
+	 *@param budget The time allowed for the frame, in seconds.
+	 */
+	void startFrame(double budget);
+
+	/**
+	 *\brief Finish timing a frame, and add it to the statistics.
+	 *
+	 *@param budgetWasBinding 1 if work on the frame stopped because the next step wouldn't fit in the
+	 *budget, 0 if it stopped for some other reason.
+	 */
+	void endFrame(int budgetWasBinding);
+
+	/**
+	 *\brief Start timing a step of the current frame.
+	 */
+	void startStep();
+
+	/**
+	 *\brief Stop timing a step, and add its cost to the history. A step that is started and never stopped
+	 *isn't counted.
+	 */
+	void stopStep();
+
+	/**
+	 *\brief Get the time since startFrame(), in seconds.
+	 */
+	double getElapsedTime();
+
+	/**
+	 *\brief Get the time left in the current frame's budget, in seconds (negative if it was exceeded).
+	 */
+	double getRemainingTime();
+
+	/**
+	 *\brief Get the predicted cost of the next step of the current frame, in seconds: the largest cost among
+	 *the recent steps of the same kind, or 0 if there haven't been any.
+	 */
+	double predictNextStepCost() const;
+
+	/**
+	 *\brief Check whether the next step is predicted to finish within the current frame's budget.
+	 */
+	int canAffordNextStep();
+
+	/**
+	 *\brief Get the number of steps completed in the current (or last) frame.
+	 */
+	int getNumStepsThisFrame() const;
+
+	/**
+	 *\brief Get the number of frames finished since the statistics were reset.
+	 */
+	int getNumFrames() const;
+
+	/**
+	 *\brief Get the number of frames in which the budget was binding.
+	 */
+	int getNumBindingFrames() const;
+
+	/**
+	 *\brief Get the number of frames that took longer than their budget.
+	 */
+	int getNumOverrunFrames() const;
+
+	/**
+	 *\brief Get the mean number of steps per frame.
+	 */
+	double getMeanStepsPerFrame() const;
+
+	/**
+	 *\brief Get the mean time per frame, in seconds.
+	 */
+	double getMeanFrameTime() const;
+
+	/**
+	 *\brief Reset the frame statistics. The step history is kept.
+	 */
+	void resetStatistics();
+
+	/**
+	 *\brief Print the frame statistics.
+	 */
+	void printStatistics(std::ostream &out) const;
+
+private:
+	enum {FRAME_BLOCK = 0, STEP_BLOCK = 1};
+
+	int historyLength;
+	std::vector<double> firstStepCosts;  //ring buffers of recent step costs, in seconds
+	std::vector<double> laterStepCosts;
+	int nextFirstStep;
+	int nextLaterStep;
+
+	double budget;
+	int stepsThisFrame;
+	int stepRunning;
+
+	int numFrames;
+	int numBindingFrames;
+	int numOverrunFrames;
+	int totalSteps;
+	double totalFrameTime;
+};
+
+#endif
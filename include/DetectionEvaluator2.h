@@ -160,15 +160,24 @@ public:
 	 * image across a range of thresholds. The object detector output must be 
 	 * supplied in the form of a vector of SearchResults.
 	 * 
+	 * The thresholds are the values of the boxes, and the performance at all
+	 * of them is found in one sweep over the boxes in descending order of 
+	 * value, in O(B log B + B*T) time for B boxes and T targets.
+	 * 
 	 * @param imNum Index of image in the dataset.
 	 * @param boxes Output of an object detector, such as a 
 	 * GentleBoostCascadedClassifier, evaluated on the image whose path is
 	 * getFileNames()[imNum].
+	 * @param withRectangles Also fill in the hits, misses and false_alarms 
+	 * rectangle lists of every threshold. This takes time and memory 
+	 * quadratic in the number of boxes, so by default only the counts are
+	 * computed. 
 	 *
 	 * @return Performance on a single image for a range of thresholds, in terms
-	 * of hits, misses, and false_alarms. 
+	 * of hits, misses, and false_alarms, in ascending order of threshold. 
 	 */
-	std::vector<EvaluationMetrics> evaluateImagePerformance(int imNum, const std::vector<SearchResult>& boxes) const; 
+	std::vector<EvaluationMetrics> evaluateImagePerformance(int imNum, const std::vector<SearchResult>& boxes, 
+															int withRectangles = 0) const; 
 	
 	/**
 	 * \brief Evaluate the number of hits, misses, and false alarms on all
@@ -176,11 +185,18 @@ public:
 	 * must be supplied in the form of a vector of SearchResults vectors, one
 	 * per image.
 	 * 
+	 * The thresholds are the values of all boxes of all images. All boxes are
+	 * sorted once, and the summed counts are updated incrementally as the 
+	 * threshold drops past each box, so this takes O(B log B + B*T) time for
+	 * B boxes in total and at most T targets per image. An image with no boxes
+	 * counts all of its targets as misses at every threshold. 
+	 * 
 	 * @param imBoxes Output of an object detector, such as a 
 	 * GentleBoostCascadedClassifier, evaluated on every image in the dataset.
 	 *
 	 * @return Performance on all images for a range of thresholds, in terms
-	 * of hits, misses, and false_alarms. 
+	 * of hits, misses, and false_alarms averaged over images, in ascending 
+	 * order of threshold. The rectangle lists are left empty. 
 	 */
 	std::vector<EvaluationMetrics> evaluatePerformance(const std::vector<std::vector<SearchResult> >& imBoxes) const; 
 	
@@ -206,6 +222,17 @@ public:
 	 **/
 	int empty() const; 
 	
+	/**
+	 * \brief Write all file names and target locations to a binary stream.
+	 */
+	void addToStreamBinary(std::ostream &out) const; 
+	
+	/**
+	 * \brief Replace the contents of this evaluator with one written by 
+	 * addToStreamBinary. 
+	 */
+	void readFromStreamBinary(std::istream &in); 
+	
 	
 	friend cv::FileStorage& operator << (cv::FileStorage &fs, const DetectionEvaluator2 &data); 
 	friend void operator >> ( const cv::FileNode &fs, DetectionEvaluator2 &data) ; 
@@ -217,6 +244,7 @@ protected:
 	std::vector<std::vector<cv::Rect> > targets; 
 	EvaluationMetrics getPerformanceAtThreshold(const std::vector<EvaluationMetrics>& ms, 
 												double threshold) const; 
+	int matchDetection(int imNum, const cv::Rect &box, std::vector<char> &found) const; 
 	void init(const ImageDataSet2 &labeledImages) ; 
 };
 
@@ -0,0 +1,81 @@
+/*
+ *  DiscreteSampler.h
+ *  OpenCV
+ *
+ */
+
+#ifndef DISCRETESAMPLER_H
+#define DISCRETESAMPLER_H
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+/**
+ *\ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> Draws indices from a discrete distribution
+ * given by nonnegative weights, which need not sum to 1.
+ *
+ * The weights are kept in a Fenwick (binary indexed) tree of partial sums.
+ * Building the tree from a whole map of weights takes one pass, a draw takes
+ * O(log n) steps, and changing one weight takes O(log n) steps, so when only a
+ * few weights change between draws they can be updated in place rather than
+ * rebuilding the tree.
+ *
+ * Used by ConvolutionalLogisticPolicy to sample fixations from the softmax of
+ * the convolved belief.
+ */
+class DiscreteSampler {
+public:
+	/**
+	 * \brief Default Constructor: an empty distribution.
+	 **/
+	DiscreteSampler();
+
+	/**
+	 * \brief Replace all of the weights.
+	 *
+	 * @param weights A single channel CV_32F or CV_64F matrix of nonnegative
+	 * weights. Index i of the distribution is element i of the matrix in
+	 * row-major order.
+	 **/
+	void setWeights(const cv::Mat &weights);
+
+	/**
+	 * \brief Change one weight.
+	 *
+	 * @param index Index of the weight, between 0 and size()-1.
+	 * @param weight The new nonnegative weight.
+	 **/
+	void setWeight(int index, double weight);
+
+	/**
+	 * \brief Get one weight.
+	 **/
+	double getWeight(int index) const;
+
+	/**
+	 * \brief Get the sum of all of the weights.
+	 **/
+	double getTotal() const;
+
+	/**
+	 * \brief Get the number of weights.
+	 **/
+	int size() const;
+
+	/**
+	 * \brief Draw an index, with probability proportional to its weight.
+	 *
+	 * @param u A number drawn uniformly from [0, 1).
+	 * @return The smallest index whose cumulative weight exceeds u*getTotal(),
+	 * or -1 if all weights are 0.
+	 **/
+	int sample(double u) const;
+
+private:
+	std::vector<double> weights;
+	std::vector<double> tree; //1-based partial sums
+	int topStep;              //largest power of 2 no larger than size()
+};
+
+#endif
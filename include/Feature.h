@@ -258,7 +258,6 @@ protected:
 	CvSize patchSize; 
 	int prefersIntegral; 
 	char* featureName; 
-	CvRNG rng; 
 	
 	Feature(cv::Size expectedPatchSize=cvSize(0,0)); 
 	
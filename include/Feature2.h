@@ -173,6 +173,21 @@ public:
 	 **/
 	void writeToFile(cv::FileStorage &storage, const std::string &varname) const; 
 	
+	/**
+	 * \brief Unarchive from a binary stream, when saved using 
+	 * addToStreamBinary.
+	 * 
+	 * @return An object that is a subclass of Feature, or NULL if the stream
+	 * did not contain a known feature type.
+	 **/
+	static Feature2* readFromStreamBinary(std::istream &in); 
+	
+	/**
+	 * \brief Archive to a binary stream: feature name, patch size, and 
+	 * parameters.
+	 **/
+	void addToStreamBinary(std::ostream &out) const; 
+	
 	
 	/**
 	 * \brief Get a feature with same type / dimension as this one, but random
@@ -214,6 +229,18 @@ public:
 	 **/
 	cv::Size getPatchSize() const; 
 	
+	/**
+	 * \brief Get the name of this feature's type, as used by 
+	 * getFeatureOfType.
+	 **/
+	std::string getFeatureName() const; 
+	
+	/**
+	 * \brief Get the parameter vector that defines this feature, as used by
+	 * setFeatureParameters.
+	 **/
+	const cv::Mat getFeatureParameters() const; 
+	
 	/**
 	 * \brief Write to a file.
 	 **/
@@ -139,6 +139,21 @@ public:
 	
 	DEPRECATED(void train(int numTableElements,const std::vector<ImagePatch*> &patches, const CvMat* labels, const CvMat* dataWeights)); 
 	
+	/**
+	 * \brief Compute this regressor's feature on each patch, i.e. the first
+	 * half of train(). 
+	 **/
+	void evaluateFeature(const std::vector<ImagePatch*> &patches, cv::Mat &vals); 
+	
+	/**
+	 * \brief Train the regression model from precomputed feature values, i.e.
+	 * the second half of train(). Splitting the two allows timing them 
+	 * separately.
+	 *
+	 * @param vals Output of evaluateFeature() on the training patches. 
+	 **/
+	void trainOnFeatureValues(int numTableElements, const cv::Mat &vals, const cv::Mat &labels, const cv::Mat &dataWeights); 
+	
 	/**
 	 * \brief Try to predict whether new ImagePatch data are the object we're
 	 * trying to detect.
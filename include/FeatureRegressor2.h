@@ -118,6 +118,37 @@ public:
 	 */
 	void train(int numTableElements, const  std::vector<ImagePatch2> &patches, const cv::Mat &labels, const cv::Mat &dataWeights);
 	
+	/**
+	 * \brief Compute the additive statistics that train() turns into a lookup 
+	 * table, for one part of a training set. Statistics computed on disjoint 
+	 * parts of a dataset with the same minVal and maxVal can be summed and
+	 * passed to setLUTFromStatistics(), giving the same table that train() 
+	 * would have given on the whole dataset. 
+	 *
+	 * @param numTableElements Number of lookup table bins. 
+	 *
+	 * @param vals Feature outputs for each patch, as from 
+	 * Feature2::evaluateImagePatches. 
+	 *
+	 * @param minVal Smallest feature output over the whole training set. 
+	 *
+	 * @param maxVal Largest feature output over the whole training set. 
+	 *
+	 * @param numerator Weighted label sum for each bin (set by the algorithm).
+	 *
+	 * @param denominator Weight sum for each bin (set by the algorithm).
+	 **/
+	static void getLUTStatistics(int numTableElements, const cv::Mat &vals, const cv::Mat &labels, 
+								 const cv::Mat &dataWeights, double minVal, double maxVal, 
+								 cv::Mat &numerator, cv::Mat &denominator); 
+	
+	/**
+	 * \brief Set the lookup table from statistics summed over a training set
+	 * with getLUTStatistics(). 
+	 **/
+	void setLUTFromStatistics(double minVal, double maxVal, 
+							  const cv::Mat &numerator, const cv::Mat &denominator); 
+	
 	/**
 	 * \brief Try to predict whether new ImagePatch data are the object we're
 	 * trying to detect.
@@ -190,6 +221,25 @@ public:
 	 **/
 	cv::Size getFeaturePatchSize() const; 
 		
+	/**
+	 * \brief Use feature as this regressor's feature, taking ownership of it
+	 * instead of copying it. Clears the lookup table. 
+	 **/
+	void adoptFeature(Feature2* feature); 
+	
+	/**
+	 * \brief Get the lookup table and the range of feature values it covers.
+	 * lut is a header for the regressor's own table, not a copy.
+	 **/
+	void getLUT(double &minVal, double &maxVal, cv::Mat &lut) const; 
+	
+	/**
+	 * \brief Set the lookup table and the range of feature values it covers.
+	 * lut must be a CV_64F column, and is used without copying it, so it can
+	 * be part of a larger block shared by many regressors. 
+	 **/
+	void setLUT(double minVal, double maxVal, const cv::Mat &lut); 
+		
 	/**
 	 * \brief Write to a file.
 	 **/
@@ -204,6 +254,17 @@ public:
 	friend void operator >> (const cv::FileNode &fs, FeatureRegressor2 &reg); 
 	friend std::istream& operator>> (std::istream& ifs, FeatureRegressor2 &reg); 
 	
+	/**
+	 * \brief Write to a binary stream: LUT range, LUT, and feature.
+	 **/
+	void addToStreamBinary(std::ostream &out) const; 
+	
+	/**
+	 * \brief Read from a binary stream written with addToStreamBinary.
+	 * Returns 0 on failure. 
+	 **/
+	int readFromStreamBinary(std::istream &in); 
+	
 	//friend class ImagePatch; 
 private:
 	Feature2* patchFeature; 
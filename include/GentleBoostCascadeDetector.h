@@ -0,0 +1,123 @@
+/*
+ *  GentleBoostCascadeDetector.h
+ *  OpenCV
+ *
+ */
+
+#ifndef GENTLEBOOSTCASCADEDETECTOR_H
+#define GENTLEBOOSTCASCADEDETECTOR_H
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/core_c.h>
+#include <string>
+#include <vector>
+#include "ObjectDetector.h"
+#include "GentleBoostCascadedClassifier.h"
+#include "PatchList.h"
+
+/**
+ *\ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> An object detector that uses a
+ * GentleBoostCascadedClassifier trained with NMPT (e.g. by
+ * TrainCascadedDetector), so that it can be used by the ImagePatchPyramid
+ * and MIPOMDP in place of an OpenCV Haar cascade.
+ *
+ * When the ImagePatchPyramid searches a frame, it asks the detector to
+ * search each level of the foveated representation with
+ * detectObjectsInRegion(). Rather than searching each scaled down region
+ * from scratch, this detector builds the classifier's image pyramid (and its
+ * integral images) for the frame once, and searches the part of the pyramid
+ * that covers the region. Only scales whose objects would be at least as
+ * large as the classifier's base patch size in the scaled down region are
+ * searched, which is what the detector would see in the foveated image. The
+ * pyramid is kept until the frame changes, so fixating the same frame many
+ * times costs one pyramid.
+ *
+ * When saved in a stream (as part of an MIPOMDP), only the classifier's file
+ * name and the detection threshold are saved.
+ */
+class GentleBoostCascadeDetector : public ObjectDetector {
+public:
+	/**
+	 * \brief Placeholder Constructor.
+	 *
+	 * Used to create a placeholder for an object detector, which can then be read
+	 * from a file stream using the \>\> operator.
+	 */
+	GentleBoostCascadeDetector();
+
+	/**
+	 * \brief Constructor.
+	 *
+	 * @param filename A GentleBoostCascadedClassifier saved with the \<\<
+	 * operator.
+	 * @param threshold Only patches whose classifier output is greater than
+	 * threshold are detections.
+	 */
+	GentleBoostCascadeDetector(const char* filename, double threshold = 0);
+
+	/**
+	 * \brief Deep Copy Constructor. The classifier is shared with the copy,
+	 * but the search state is not.
+	 **/
+	GentleBoostCascadeDetector(GentleBoostCascadeDetector* detectorToCopy);
+
+	/**
+	 * \brief Default Destructor.
+	 */
+	~GentleBoostCascadeDetector();
+
+	/**
+	 * \brief Search the whole image for objects.
+	 *
+	 * @param image The image to be searched for some target object.
+	 * @return The bounding boxes of the objects found.
+	 */
+	std::vector<cv::Rect> detectObjects(IplImage* image);
+
+	/**
+	 * \brief Search a region of a frame, reusing the frame's image pyramid
+	 * if newFrame is 0. See ObjectDetector::detectObjectsInRegion().
+	 */
+	std::vector<cv::Rect> detectObjectsInRegion(IplImage* frame, CvRect region,
+												IplImage* scaledRegion, int newFrame);
+
+	/**
+	 * \brief Only patches whose classifier output is greater than threshold
+	 * are detections. Default is 0.
+	 **/
+	void setThreshold(double threshold);
+
+	/**
+	 * \brief Change the file the classifier is read from, and read it.
+	 */
+	void setDetectorSource(std::string newFileName) ;
+
+	/**
+	 * \brief Make a deep copy of the detector.
+	 **/
+	ObjectDetector* clone();
+
+	/**
+	 * \brief The word that marks a GentleBoostCascadeDetector in a stream.
+	 **/
+	static const char* streamTag;
+
+protected:
+	void readFromStream(std::istream& in);
+	void addToStream(std::ostream& out);
+private:
+	GentleBoostCascadeDetector(const GentleBoostCascadeDetector &copy);
+	GentleBoostCascadeDetector & operator=(const GentleBoostCascadeDetector &rhs);
+
+	std::string filename;
+	double threshold;
+	cv::Ptr<GentleBoostCascadedClassifier> classifier;
+	cv::Ptr<PatchList> frameList;
+	cv::Ptr<PatchList> imageList;
+
+	const void* lastFrameData;
+	cv::Size lastFrameSize;
+};
+
+#endif
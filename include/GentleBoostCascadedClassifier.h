@@ -106,6 +106,68 @@ public:
 	
 	DEPRECATED(void searchImage(IplImage* gray_image,  std::vector<SearchResult>& keptPatches,  int NMSRadius=0,  double thresh = -INFINITY));
 	
+	/**
+	 * \brief Search through an image using a PatchList owned by the caller, 
+	 * rather than the classifier's own. 
+	 *
+	 * The classifier's features are only read during a search, so several 
+	 * threads may call this method on the same classifier at once, each with 
+	 * its own PatchList from createSearchPatchList(). Don't change the 
+	 * classifier (train it, or call setSearchParams()) while this is running.
+	 * GentleBoostCascadedSearchContext wraps this up. 
+	 *
+	 * @param gray_image Image or Frame to search. Must be single-channel, with
+	 * depth IPL_DEPTH_8U. 
+	 * @param list PatchList holding the image pyramid for this search. It is
+	 * overwritten, and can be reused for the next image. 
+	 * @param keptPatches Results of the search are recorded in this vector. 
+	 * @param NMSRadius Suppress object detection results if there is a 
+	 * another SearchResult with higher value nearby (within radius NMSRadius
+	 * pixels). 
+	 * @param thresh Suppress object detection results with a value lower than
+	 * thresh. 
+	 */
+	void searchImage(const cv::Mat &gray_image, 
+					 PatchList* list, 
+					 std::vector<SearchResult>& keptPatches, 
+					 int NMSRadius=0, 
+					 double thresh = -INFINITY);
+	
+	/**
+	 * \brief Create a new PatchList with the current search parameters (see 
+	 * setSearchParams()), for use with searchImage(). The caller must delete 
+	 * it. 
+	 */
+	PatchList* createSearchPatchList() const; 
+	
+	/**
+	 * \brief Search part of an image that is already held by a PatchList 
+	 * (see PatchList::setImage()). Many regions of the same image can be 
+	 * searched this way, and the image pyramid and its integral images are 
+	 * only computed once. 
+	 *
+	 * As with searchImage(const cv::Mat&, PatchList*, ...), several threads 
+	 * may do this at once, each with its own PatchList. 
+	 *
+	 * @param list PatchList holding the image to search, from 
+	 * createSearchPatchList(). 
+	 * @param region Only patches that lie entirely in this region are 
+	 * searched. 
+	 * @param keptPatches Results of the search are recorded in this vector,
+	 * in image coordinates.
+	 * @param minSize Don't search for objects smaller than minSize. 
+	 * @param maxSize Don't search for objects larger than maxSize. If maxSize
+	 * is (0,0), the size of region is used. 
+	 * @param thresh Suppress object detection results with a value lower than
+	 * thresh. 
+	 */
+	void searchRegionOfPatchList(PatchList* list, 
+								 cv::Rect region, 
+								 std::vector<SearchResult>& keptPatches, 
+								 cv::Size minSize = cv::Size(0,0), 
+								 cv::Size maxSize = cv::Size(0,0), 
+								 double thresh = -INFINITY); 
+	
 	/**
 	 * \brief Set the current image to search, without actually searching. This
 	 * allows you to search each scale (size) separately and manually, using
@@ -297,6 +359,20 @@ public:
 	 */
 	void setHardNegativeTrainingExamplesFromBGImages(); 
 	
+	/**
+	 * \brief Set how many background images setHardNegativeTrainingExamplesFromBGImages()
+	 * decodes and searches concurrently. 
+	 *
+	 * Each image in a batch is read and searched on its own thread, using its
+	 * own PatchList. The patches are then collected in the same order as a 
+	 * one-image-at-a-time search would take them, so the resulting training 
+	 * set does not depend on the batch size. 
+	 *
+	 * @param numImages Images per batch. 1 searches one image at a time, and 0 
+	 * (the default) uses cv::getNumThreads(). 
+	 */
+	void setBGMiningBatchSize(int numImages=0); 
+	
 	
 	/**
 	 * \brief Replace the rejected negative example patches in the current 
@@ -313,6 +389,66 @@ public:
 	 */
 	bool exhaustedAllNegPatches(); 
 	
+	/**
+	 * \brief Get timing and throughput statistics for the most recent call
+	 * to trainOneRound(): how many candidates were scored, how long feature 
+	 * response evaluation, lookup table fitting, chi-square scoring and hard
+	 * negative mining took, how often mining's image reads hit the shared 
+	 * ImageCache2, and how much memory the training patches use. 
+	 * Write the result to a stream to get one line of JSON. 
+	 */
+	const TrainingRoundStats& getLastRoundStats() const; 
+	
+	/**
+	 * \brief Save the complete training state to a binary snapshot, so that
+	 * training can be resumed later with loadTrainingSnapshot().
+	 *
+	 * The snapshot holds the model (features, reject thresholds and 
+	 * training parameters), the pixels of every training patch including 
+	 * the mined background patches, the per-patch feature outputs, sums, 
+	 * posteriors, predictions, weights and survived flags, the background
+	 * image list and mining position, the path of the PatchDataset given to
+	 * setTrainingSet(std::string), and the state of cv::theRNG(), which 
+	 * candidate features are drawn from. The testing set is not saved. 
+	 *
+	 * The snapshot is written to a temporary file that is renamed over 
+	 * filename when complete, so an interrupted save never destroys the 
+	 * previous snapshot.
+	 *
+	 * @param filename Path of the snapshot file.
+	 *
+	 * @param trainingTarget The total number of features the training run
+	 * is working towards, stored so that a resumed run stops where the 
+	 * interrupted one would have. 0 if there is no target. 
+	 *
+	 * @return 1 on success, 0 if the file couldn't be written.
+	 **/
+	int saveTrainingSnapshot(const std::string &filename, int trainingTarget=0); 
+	
+	/**
+	 * \brief Restore training state saved with saveTrainingSnapshot(), in 
+	 * place of setTrainingSet(). 
+	 *
+	 * The saved patches are used as they are, and are owned by the 
+	 * classifier from then on. The PatchDataset is only re-read from its 
+	 * saved path if mining needs its positive images. Unlike 
+	 * setTrainingSet(), the classifier is not re-run over the training 
+	 * patches, so calling trainOneRound() afterwards continues exactly as the
+	 * saved classifier would have. Search parameters (setSearchParams()) and
+	 * the mining batch size are not part of the snapshot; set them as for a 
+	 * new classifier. 
+	 *
+	 * @param filename Path of the snapshot file.
+	 *
+	 * @param trainingTarget If not NULL, set to the trainingTarget the 
+	 * snapshot was saved with.
+	 *
+	 * @return 1 on success, 0 if the file is missing, is not a valid 
+	 * snapshot, in which case the 
+	 * classifier is left unchanged.
+	 **/
+	int loadTrainingSnapshot(const std::string &filename, int* trainingTarget=NULL); 
+	
 	
 	/**
 	 * \brief Add a feature to the classifier by applying multiple rounds of 
@@ -472,6 +608,8 @@ private:
 	ImageDataSet* posImageDataset; 
 	ImageDataSet* negImageDataset; 
 	PatchDataset* posPatchDataset; 
+	std::string posPatchDatasetFileName; //Set by setTrainingSet(std::string), for training snapshots
+	std::vector<ImagePatch*> snapshotPatches; //Restored by loadTrainingSnapshot(), owned here
 	
 	bool sharingPatchList; 
 	
@@ -490,6 +628,19 @@ private:
 	bool runningOutOfNegPatches;
 	bool ranOutOfNegPatches; 
 	bool disableNMSAcrossScales; 
+	int bgMiningBatchSize; 
+	
+	TrainingRoundStats roundStats; 
+	void resetRoundStats(); 
+	
+	int searchUseFast; 
+	cv::Size searchMinSize; 
+	cv::Size searchMaxSize; 
+	double searchScaleInc; 
+	double searchStepWidth; 
+	int searchScaleStepWidth; 
+	
+	friend class BGImageMiningBody; 
 	
 	
 	Feature* getGoodFeatureViaTournament(std::string featureType,
@@ -525,6 +676,24 @@ private:
 								   int scaleRadius=0);
 	
 	
+	void applyFeaturesToPatchList(PatchList* list); 
+	
+	void searchPatchListAtScale(PatchList* list, 
+								std::vector<SearchResult>& keptPatches, 
+								int scale, 
+								int NMSRadius, 
+								double threshold,
+								const std::vector<cv::Rect> &blacklistPatches,
+								int spatialRadius=0, 
+								int scaleRadius=0); 
+	
+	void searchAllScalesOfPatchList(PatchList* list, 
+									std::vector<SearchResult>& keptPatches, 
+									int NMSRadius, 
+									double threshold,
+									const std::vector<cv::Rect> &blacklistPatches,
+									bool suppressAcrossScales); 
+	
 	void pickRejectThreshold(const CvMat* values,
 							 const CvMat* labels,
 							 const CvMat* survived,
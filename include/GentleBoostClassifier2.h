@@ -22,6 +22,7 @@
 #include "ImageDataSet2.h"
 #include "PatchDataset2.h"
 
+class GentleBoostShardCoordinator2; 
 
 /**
  * \ingroup MPGroup
@@ -317,6 +318,135 @@ public:
 	 **/ 
 	void setTrainingFeatureType(const std::string &featureType); 
 	
+	/**
+	 * \brief Speed up the feature tournament by screening candidates on a
+	 * subsample of the training set.
+	 *
+	 * After a few rounds of boosting, most of the weight sits on a small
+	 * number of hard examples. When screening is on, each round draws
+	 * subsampleSize examples in proportion to their boosting weight, and
+	 * every tournament candidate is scored on that subsample only. The
+	 * best rescoreFraction of the starting pool is then re-scored on the full
+	 * training set, and the best of those is selected.
+	 *
+	 * @param subsampleSize Number of weighted draws used to build the
+	 * screening subsample. 0 (the default) disables screening.
+	 *
+	 * @param rescoreFraction Fraction of the starting candidate pool that is
+	 * re-scored on the full training set. At least one candidate is always
+	 * re-scored.
+	 **/
+	void setCandidateScreening(int subsampleSize, double rescoreFraction = .1);
+
+	/**
+	 * \brief Report how often screening changed the chosen feature, i.e. how
+	 * often the best candidate on the subsample was not the best candidate on
+	 * the full training set.
+	 *
+	 * @param roundsScreened Number of tournaments run with screening on.
+	 *
+	 * @param choicesChanged Number of those tournaments in which re-scoring
+	 * on the full set picked a different feature than the subsample did.
+	 **/
+	void getCandidateScreeningStats(int &roundsScreened, int &choicesChanged) const;
+
+	/**
+	 * \brief Save the complete training state to a binary snapshot, so that
+	 * training can be resumed later with loadTrainingSnapshot().
+	 *
+	 * The snapshot holds the features and reject thresholds, the training 
+	 * patches (including their integral images) and labels, the per-patch 
+	 * feature outputs, sums, posteriors, predictions, weights and survived 
+	 * flags, the background image datasets and mining position, and the 
+	 * state of cv::theRNG(). The testing set is not saved. 
+	 *
+	 * The snapshot is written to a temporary file that is renamed over 
+	 * filename when complete, so an interrupted save never destroys the 
+	 * previous snapshot.
+	 *
+	 * @param filename Path of the snapshot file.
+	 *
+	 * @param trainingTarget The total number of features the training run
+	 * is working towards, stored so that a resumed run stops where the 
+	 * interrupted one would have. 0 if there is no target. 
+	 *
+	 * @return 1 on success, 0 if the file couldn't be written.
+	 **/
+	int saveTrainingSnapshot(const std::string &filename, int trainingTarget=0) const;
+
+	/**
+	 * \brief Restore training state saved with saveTrainingSnapshot(). 
+	 *
+	 * Unlike setTrainingSet(), this does not re-run the classifier over the
+	 * training patches, so it takes time proportional only to the size of 
+	 * the file. Calling trainOneRound() afterwards continues exactly as the 
+	 * saved classifier would have. 
+	 *
+	 * @param filename Path of the snapshot file.
+	 *
+	 * @param trainingTarget If not NULL, set to the trainingTarget the 
+	 * snapshot was saved with (0 for snapshots saved without one).
+	 *
+	 * @return 1 on success, 0 if the file is missing or not a valid snapshot,
+	 * in which case the classifier is left unchanged.
+	 **/
+	int loadTrainingSnapshot(const std::string &filename, int* trainingTarget=NULL);
+
+	/**
+	 * \brief Save the trained model (features, lookup tables and reject 
+	 * thresholds) in a compact, versioned binary format.
+	 *
+	 * Unlike the FileStorage format, the file holds each kind of value in one 
+	 * flat array (feature types, patch sizes, parameters, lookup table ranges
+	 * and entries, thresholds), so it can be loaded with a fixed number of 
+	 * reads regardless of the number of features. The file uses the byte 
+	 * order of the machine that wrote it. 
+	 *
+	 * @param filename Path of the model file. 
+	 *
+	 * @param lutDepth CV_64F to store lookup tables exactly, or CV_32F to 
+	 * store them in half the space. Tables are always used as CV_64F. 
+	 *
+	 * @return 1 on success, 0 if the file couldn't be written.
+	 **/
+	int saveBinaryModel(const std::string &filename, int lutDepth=CV_64F) const;
+
+	/**
+	 * \brief Load a model saved with saveBinaryModel(). 
+	 *
+	 * All lookup tables are placed in one shared block of memory, and each 
+	 * regressor's table is a view into it. 
+	 *
+	 * @return 1 on success, 0 if the file is missing or not a valid model,
+	 * in which case the classifier is left unchanged.
+	 **/
+	int loadBinaryModel(const std::string &filename);
+
+	/**
+	 * \brief Check whether a file was written by saveBinaryModel(). 
+	 **/
+	static int isBinaryModelFile(const std::string &filename);
+
+	/**
+	 * \brief Train on a training set that is split across several worker 
+	 * processes, instead of on local training patches. 
+	 *
+	 * Each worker holds one shard of the patches and reports per-candidate
+	 * sufficient statistics (feature ranges, lookup table sums, chi-square 
+	 * terms, weight sums); this classifier reduces them to run the feature 
+	 * tournament and add features exactly as trainOneRound() would on the 
+	 * whole set, up to floating point summation order. Any features already 
+	 * in the classifier are replayed on the workers first. 
+	 *
+	 * While shards are set, the local training set is unused, and candidate
+	 * screening (setCandidateScreening) is disabled. 
+	 *
+	 * @param shards Connected workers (see GentleBoostShardCoordinator2), or 
+	 * NULL to go back to local training. The coordinator must outlive its use
+	 * by this classifier. 
+	 **/
+	void setTrainingShards(GentleBoostShardCoordinator2 *shards); 
+
 	
 	void setSearchParams(cv::Size minSize = cv::Size(0,0), cv::Size maxSize=cv::Size(0,0), 
 						 double scaleInc=1.2, double stepWidth=1, int scaleStepWidth=1); 
@@ -343,6 +473,39 @@ public:
 					 std::vector<SearchResult>& keptPatches, 
 					 int NMSRadius=0, 
 					 double thresh = -INFINITY) ;
+	
+	/**
+	 * \brief Search through an image using a PatchList2 owned by the caller,
+	 * rather than the classifier's own. 
+	 *
+	 * This method doesn't change the classifier, so several threads may call
+	 * it at once on one classifier, each with its own PatchList2 from 
+	 * createSearchPatchList(). GentleBoostSearchContext2 wraps this up. 
+	 *
+	 * @param gray_image Image or Frame to search. Must be single-channel, with
+	 * depth IPL_DEPTH_8U. 
+	 * @param list PatchList2 holding the image pyramid for this search. It is
+	 * overwritten, and can be reused for the next image. 
+	 * @param keptPatches Results of the search are recorded in this vector. 
+	 * @param NMSRadius Suppress object detection results if there is a 
+	 * another SearchResult with higher value nearby (within radius NMSRadius
+	 * pixels). 
+	 * @param thresh Suppress object detection results with a value lower than
+	 * thresh. 
+	 */
+	void searchImage(const cv::Mat &gray_image, 
+					 PatchList2* list, 
+					 std::vector<SearchResult>& keptPatches, 
+					 int NMSRadius=0, 
+					 double thresh = -INFINITY) const;
+	
+	/**
+	 * \brief Create a new PatchList2 with the current search parameters (see
+	 * setSearchParams()), for use with searchImage(). The caller must delete 
+	 * it. 
+	 */
+	PatchList2* createSearchPatchList() const; 
+	
 	/**
 	 * \brief Set the current image to search, without actually searching. This
 	 * allows you to search each scale (size) separately and manually, using
@@ -430,6 +593,8 @@ protected:
 									const cv::Mat &survived=cv::Mat()) const; 
 	virtual void updateWeights(const cv::Mat &output, const cv::Mat &labels, cv::Mat &weights,
 							   const cv::Mat &survived=cv::Mat()) const; 
+	void reweight(const cv::Mat &output, const cv::Mat &labels, cv::Mat &weights,
+				  const cv::Mat &survived, double maxWeight) const; 
 	virtual void calcPosterior(const cv::Mat &featureSum, cv::Mat &posterior) const; 
 	virtual void makePredictions(const cv::Mat &featureSum, cv::Mat &predictions,
 								 const cv::Mat &survived=cv::Mat()) const;
@@ -450,6 +615,22 @@ protected:
 										double threshold,
 										cv::Mat &survived) const; 
 	
+	/**
+	 * \brief Weight-proportional subsample of the training set, used to
+	 * screen tournament candidates cheaply. Each distinct example is kept
+	 * once, with a weight equal to the number of times it was drawn.
+	 **/
+	struct TrainingSubsample {
+		std::vector<ImagePatch2> patches;
+		cv::Mat labels, weights, featureSum, survived;
+		int numPos, numNeg;
+	};
+
+	bool getTrainingSubsample(int numDraws, TrainingSubsample &subsample) const;
+
+	void getScreeningPerformance(const Feature2* candidate, PerformanceMetrics& perf,
+								 const TrainingSubsample &subsample) const;
+
 	Feature2* getGoodFeatureViaTournament(const std::string &featureType,
 										 int startPoolSize, 
 										 int similarFeatures,
@@ -457,7 +638,12 @@ protected:
 	
 	void compareFeaturesAndDeleteWorse(Feature2*& oldFeat1NewBetterFeat, 
 									   Feature2*& oldFeat2NewDeletedFeat,
-									   PerformanceMetrics& oldPerf1NewBetterPerf) const; 
+									   PerformanceMetrics& oldPerf1NewBetterPerf,
+									   const TrainingSubsample* subsample = NULL) const;
+	
+	void getShardedPerformanceMeasures(const Feature2* candidate, PerformanceMetrics& perf) const; 
+	
+	void trainRegressorOnShards(FeatureRegressor2 &reg) const; 
 	
 	virtual void printDebugState() const; 
 	
@@ -486,6 +672,21 @@ protected:
 								   int scaleRadius=0);
 	
 	
+	void searchPatchListAtScale(PatchList2* list, 
+								std::vector<SearchResult>& keptPatches, 
+								int scale, 
+								int NMSRadius, 
+								double threshold,
+								const std::vector<cv::Rect> &blacklistPatches,
+								int spatialRadius=0, 
+								int scaleRadius=0) const; 
+	
+	void searchAllScalesOfPatchList(PatchList2* list, 
+									std::vector<SearchResult>& keptPatches, 
+									int NMSRadius, 
+									double threshold,
+									const std::vector<cv::Rect> &blacklistPatches) const; 
+	
 	void suppressLocalNonMaximaAcrossScales(std::vector<SearchResult>& keptPatches, 
 											int NMSRadius, 
 											std::vector<cv::Point>& centers, 
@@ -529,6 +730,7 @@ protected:
 	ImageDataSet2 posImagesDataset; 
 	ImageDataSet2 negImagesDataset; 
 	PatchDataset2 patchDataset; 
+	PatchDataset2 testingDataset; 
 	
 	PatchList2 pl; 
 	FastPatchList2 fpl; 
@@ -548,6 +750,14 @@ protected:
 	int currentBGFileNum; 
 	unsigned int maxPatchesPerImage; 
 	
+	int screeningSubsampleSize;
+	double screeningRescoreFraction;
+	mutable int screeningRounds;
+	mutable int screeningChanges;
+
+	GentleBoostShardCoordinator2* shards; 
+	friend class GentleBoostShardWorker2; 
+
 	
 	
 };
@@ -0,0 +1,99 @@
+/*
+ *  GentleBoostSearchContext2.h
+ *  OpenCV
+ *
+ */
+
+#ifndef GENTLEBOOSTSEARCHCONTEXT2_H
+#define GENTLEBOOSTSEARCHCONTEXT2_H
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+#include "StructTypes.h"
+#include "GentleBoostClassifier2.h"
+
+/**
+ *\ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> The state of one search with a shared
+ * GentleBoostClassifier2.
+ *
+ * A GentleBoostClassifier2 keeps the image it is searching in its own patch
+ * list, so two threads can't search with it at once. A search context instead
+ * owns the patch list and search buffers, and holds a reference counted
+ * pointer to the classifier, which it only reads. Each thread can make its
+ * own context for the same classifier: the features and lookup tables are
+ * never copied, and each context only costs the memory of one image pyramid.
+ *
+ * The classifier must not be changed (trained, read, or given new search
+ * parameters) while contexts are searching with it. The search parameters are
+ * taken from the classifier when the context is created, or when setModel()
+ * is called.
+ */
+class GentleBoostSearchContext2 {
+public:
+	/**
+	 * \brief Default Constructor. Call setModel() before searching.
+	 **/
+	GentleBoostSearchContext2();
+
+	/**
+	 * \brief Constructor.
+	 *
+	 * @param model The classifier to search with. The context keeps a
+	 * reference to it.
+	 **/
+	GentleBoostSearchContext2(const cv::Ptr<GentleBoostClassifier2> &model);
+
+	/**
+	 * \brief Destructor.
+	 **/
+	~GentleBoostSearchContext2();
+
+	/**
+	 * \brief Search with a different classifier, or pick up changed search
+	 * parameters of the current one.
+	 **/
+	void setModel(const cv::Ptr<GentleBoostClassifier2> &model);
+
+	/**
+	 * \brief Get the classifier this context searches with.
+	 **/
+	cv::Ptr<GentleBoostClassifier2> getModel() const;
+
+	/**
+	 * \brief Search through an image for objects. See
+	 * GentleBoostClassifier2::searchImage().
+	 *
+	 * @param gray_image Image or Frame to search. Must be single-channel, with
+	 * depth IPL_DEPTH_8U.
+	 * @param keptPatches Results of the search are recorded in this vector.
+	 * @param NMSRadius Suppress object detection results if there is a
+	 * another SearchResult with higher value nearby (within radius NMSRadius
+	 * pixels).
+	 * @param thresh Suppress object detection results with a value lower than
+	 * thresh.
+	 */
+	void searchImage(const cv::Mat &gray_image,
+					 std::vector<SearchResult>& keptPatches,
+					 int NMSRadius=0,
+					 double thresh = -INFINITY);
+
+	/**
+	 * \brief Query the number of scales searched in the last image.
+	 **/
+	int getNumScales() const;
+
+	/**
+	 * \brief Query the size of object searched for at a given scale.
+	 **/
+	cv::Size getSizeOfScale(int scale) const;
+
+private:
+	GentleBoostSearchContext2(const GentleBoostSearchContext2 &copy);
+	GentleBoostSearchContext2 & operator=(const GentleBoostSearchContext2 &rhs);
+
+	cv::Ptr<GentleBoostClassifier2> model;
+	cv::Ptr<PatchList2> patchList;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ *  GentleBoostShards2.h
+ *  OpenCV
+ *
+ */
+
+#ifndef GENTLEBOOSTSHARDS2_H
+#define GENTLEBOOSTSHARDS2_H
+
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <vector>
+#include "GentleBoostClassifier2.h"
+#include "FeatureRegressor2.h"
+#include "PatchDataset2.h"
+
+/**
+ * \ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> Coordinates GentleBoostClassifier2 training
+ * on a training set that is split across several worker processes.
+ *
+ * Each worker (GentleBoostShardWorker2) holds one shard of the training
+ * patches, with that shard's boosting state. The coordinator broadcasts each
+ * request to all workers, which compute on their shards concurrently, and
+ * then sums their replies. Everything a worker reports is additive across
+ * shards (feature min/max, lookup table numerator/denominator sums,
+ * chi-square terms, reject counts, weight maxima and sums), so the reduced
+ * result is the same as single-process training, up to floating point
+ * summation order.
+ *
+ * Workers are either forked on the local host and connected by socket pairs
+ * (spawnLocalWorkers), or started separately on any host with the
+ * GentleBoostShardWorker tool and reached over TCP (connectToWorkers).
+ * Every connection starts with a handshake that checks both sides speak 
+ * the same protocol version, and messages larger than a fixed limit are 
+ * refused.
+ *
+ * Requires a POSIX system.
+ *
+ * Usage:
+ * \code
+ * GentleBoostShardCoordinator2 shards;
+ * shards.spawnLocalWorkers(dataset, 4);
+ * booster.setTrainingShards(&shards);
+ * booster.trainOneRound();
+ * \endcode
+ */
+class GentleBoostShardCoordinator2 {
+public:
+	/**
+	 * \brief Summed evaluation of the boosting state on all shards.
+	 **/
+	struct Evaluation {
+		double chisq;
+		int prevPosRejects;
+		int prevNegRejects;
+		double seconds;
+	};
+
+	/**
+	 * \brief Constructor.
+	 **/
+	GentleBoostShardCoordinator2();
+
+	/**
+	 * \brief Destructor. Tells workers to exit, closes connections, and
+	 * waits for any forked local workers.
+	 **/
+	~GentleBoostShardCoordinator2();
+
+	/**
+	 * \brief Fork numWorkers worker processes on this host. Worker k keeps the
+	 * patches of dataset whose index is k modulo numWorkers.
+	 *
+	 * Call this before any multi-threaded work (e.g. before training), since
+	 * only the forking thread survives in the children.
+	 *
+	 * @return 1 on success, 0 on failure.
+	 **/
+	int spawnLocalWorkers(const PatchDataset2 &dataset, int numWorkers);
+
+	/**
+	 * \brief Connect to workers started with the GentleBoostShardWorker tool.
+	 *
+	 * @param addresses One "host:port" entry per worker.
+	 *
+	 * @return 1 on success, 0 on failure.
+	 **/
+	int connectToWorkers(const std::vector<std::string> &addresses);
+
+	/**
+	 * \brief Number of connected workers.
+	 **/
+	int getNumShards() const;
+
+	/**
+	 * \brief Total number of positive training patches over all shards.
+	 **/
+	int getNumPos() const;
+
+	/**
+	 * \brief Total number of negative training patches over all shards.
+	 **/
+	int getNumNeg() const;
+
+	/**
+	 * \brief Training patch size reported by the workers.
+	 **/
+	cv::Size getPatchSize() const;
+
+	/**
+	 * \brief Clear the boosting state on all workers: no features, and
+	 * uniform weights over all patches of all shards.
+	 **/
+	void reset();
+
+	/**
+	 * \brief Smallest and largest output of a feature over all shards.
+	 **/
+	void getFeatureRange(const Feature2* feature, double &minVal, double &maxVal);
+
+	/**
+	 * \brief Summed FeatureRegressor2::getLUTStatistics over all shards,
+	 * using the current boosting weights.
+	 **/
+	void getLUTStatistics(const Feature2* feature, int numTableElements,
+						  double minVal, double maxVal,
+						  cv::Mat &numerator, cv::Mat &denominator);
+
+	/**
+	 * \brief Evaluate the current boosting state.
+	 **/
+	void evaluateCurrent(Evaluation &eval);
+
+	/**
+	 * \brief Evaluate the boosting state with feature number index removed.
+	 **/
+	void evaluateWithout(int index, Evaluation &eval);
+
+	/**
+	 * \brief Evaluate the boosting state with a trained regressor added.
+	 **/
+	void evaluateWith(const FeatureRegressor2 &reg, Evaluation &eval);
+
+	/**
+	 * \brief Add a trained regressor and its reject threshold on all shards,
+	 * updating their feature sums, survival and weights. Weights are
+	 * rescaled and normalized over all shards together.
+	 **/
+	void addFeature(const FeatureRegressor2 &reg, double threshold);
+
+private:
+	GentleBoostShardCoordinator2(const GentleBoostShardCoordinator2 &copy);
+	GentleBoostShardCoordinator2 & operator=(const GentleBoostShardCoordinator2 &rhs);
+
+	int queryShardInfo();
+	void broadcast(const std::string &request);
+	void gather(std::vector<std::string> &replies);
+	void shutdown();
+
+	std::vector<int> sockets;
+	std::vector<int> localPids;
+	int numPos, numNeg;
+	cv::Size patchSize;
+};
+
+/**
+ * \ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> Serves one shard of a training set to a
+ * GentleBoostShardCoordinator2.
+ *
+ * The worker owns a GentleBoostClassifier2 holding its shard of the training
+ * patches, and answers the coordinator's requests using that classifier's
+ * training state.
+ */
+class GentleBoostShardWorker2 {
+public:
+	/**
+	 * \brief Create a worker for the patches of dataset whose index is
+	 * shardIndex modulo numShards.
+	 **/
+	GentleBoostShardWorker2(const PatchDataset2 &dataset, int shardIndex, int numShards);
+
+	/**
+	 * \brief Answer requests on a connected socket until the coordinator
+	 * disconnects or tells the worker to quit.
+	 *
+	 * The first message must be the coordinator's handshake, which carries 
+	 * the protocol version; anything else ends the connection. 
+	 *
+	 * @return 1 if the coordinator asked the worker to quit, 0 if the
+	 * connection was lost or the handshake failed.
+	 **/
+	int serve(int socket);
+
+	/**
+	 * \brief Listen on a TCP port and block until a coordinator connects.
+	 *
+	 * There is no authentication: anyone who can reach the port can train 
+	 * on the shard, so only listen on a trusted network.
+	 *
+	 * @param port TCP port to listen on.
+	 *
+	 * @param interfaceAddress Address of the interface to listen on. The 
+	 * default only accepts coordinators on this host; use the address of a 
+	 * cluster-facing interface, or "0.0.0.0" for all interfaces, to serve 
+	 * other hosts.
+	 *
+	 * @return The connected socket, or -1 on failure.
+	 **/
+	static int waitForCoordinator(int port, const std::string &interfaceAddress = "127.0.0.1");
+
+private:
+	void handleRequest(int request, std::istream &in, std::ostream &out);
+
+	GentleBoostClassifier2 shard;
+	cv::Mat pendingOutput;
+};
+
+#endif
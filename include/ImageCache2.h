@@ -0,0 +1,109 @@
+/*
+ *  ImageCache2.h
+ *  OpenCV
+ *
+ */
+
+#ifndef IMAGECACHE2_H
+#define IMAGECACHE2_H
+
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <list>
+#include <map>
+
+/**
+ *\ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> A cache of decoded grayscale images, keyed
+ * by file name, with a byte budget and least-recently-used eviction.
+ *
+ * Training repeatedly reads the same images from disk: hard negative mining
+ * cycles through the same background set every round, and dataset
+ * construction reads each positive image once for its positive patches and
+ * again for negative patches. Reading through a cache keeps the most recently
+ * used images decoded in memory, along with their integral images if they
+ * were asked for.
+ *
+ * All methods are thread safe. Images are decoded outside of the cache's
+ * lock, so threads reading different images don't wait on each other.
+ *
+ * Returned matrices share data with the cache, and must be treated as
+ * read-only. Clone them before modifying them.
+ */
+class ImageCache2 {
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * @param byteBudget Largest total size of cached images and integral
+	 * images, in bytes. 0 disables caching.
+	 **/
+	ImageCache2(size_t byteBudget = 256<<20);
+
+	/**
+	 * \brief Get the grayscale image in a file, reading it from disk only if
+	 * it isn't cached.
+	 *
+	 * @param filename Path of the image file.
+	 * @param image The 8-bit single channel image (set by the method).
+	 * @param integralImage If not NULL, set to the CV_32S integral image of
+	 * image, which is computed once and cached with the image.
+	 *
+	 * @return 1 on success, 0 if the file couldn't be read.
+	 **/
+	int getImage(const std::string &filename, cv::Mat &image, cv::Mat *integralImage = NULL);
+
+	/**
+	 * \brief Set the largest total size of cached data in bytes, evicting
+	 * least recently used images if needed. 0 disables caching.
+	 **/
+	void setByteBudget(size_t byteBudget);
+
+	/**
+	 * \brief Get the largest total size of cached data in bytes.
+	 **/
+	size_t getByteBudget() const;
+
+	/**
+	 * \brief Get the total size of cached data in bytes.
+	 **/
+	size_t getBytesUsed() const;
+
+	/**
+	 * \brief Get the number of getImage calls that were answered from the
+	 * cache, and that had to read from disk.
+	 **/
+	void getStats(long long &hits, long long &misses) const;
+
+	/**
+	 * \brief Remove all images from the cache.
+	 **/
+	void clear();
+
+	/**
+	 * \brief The cache used by ImageDataSet2::getImage and by hard negative
+	 * mining.
+	 **/
+	static ImageCache2& getSharedCache();
+
+private:
+	ImageCache2(const ImageCache2 &copy);
+	ImageCache2 & operator=(const ImageCache2 &rhs);
+
+	struct Entry {
+		cv::Mat image;
+		cv::Mat integralImage;
+		size_t bytes;
+		std::list<std::string>::iterator lruPosition;
+	};
+
+	void evictToBudget();
+
+	std::map<std::string, Entry> entries;
+	std::list<std::string> lru;
+	size_t budget, used;
+	long long hits, misses;
+	mutable cv::Mutex lock;
+};
+
+#endif
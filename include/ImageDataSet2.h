@@ -13,6 +13,7 @@
 #include <opencv2/core/core.hpp>
 #include <string>
 #include <vector>
+#include <iostream>
 
 
 /**
@@ -124,6 +125,21 @@ public:
 	 **/
 	std::string getFileName(int fileNumber) const; 
 	
+	/**
+	 * \brief Get the grayscale image of a record, through the shared 
+	 * ImageCache2, so that images used repeatedly are only read from disk 
+	 * once while they fit in the cache's byte budget. 
+	 *
+	 * @param fileNumber Index of the record to access. Must be between 0 and getNumEntries()-1, inclusive.
+	 * @param image The 8-bit single channel image (set by the method). It
+	 * shares data with the cache, so it must not be modified.
+	 * @param integralImage If not NULL, set to the CV_32S integral image of
+	 * the image, which is also cached.
+	 *
+	 * @return 1 on success, 0 if the image couldn't be read.
+	 **/
+	int getImage(int fileNumber, cv::Mat &image, cv::Mat *integralImage = NULL) const; 
+	
 	/**
 	 * \brief Access the name of the labels located at a certain index. 
 	 * 
@@ -157,6 +173,17 @@ public:
 	 **/ 
 	int empty() const ; 
 	
+	/**
+	 * \brief Write all file names and labels to a binary stream.
+	 */
+	void addToStreamBinary(std::ostream &out) const; 
+	
+	/**
+	 * \brief Replace the contents of this dataset with one written by 
+	 * addToStreamBinary. 
+	 */
+	void readFromStreamBinary(std::istream &in); 
+	
 	/**
 	 * \brief Write to a file.
 	 */
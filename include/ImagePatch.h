@@ -216,6 +216,12 @@ public:
 	 **/
 	cv::Size getIntegralSize() const; 
 	
+	/**
+	 * \brief Get the number of bytes held by the patch's image and integral
+	 * image. 
+	 **/
+	size_t getMemoryUsage() const; 
+	
 	void testImagePatch() ; 
 private:
 	
@@ -89,6 +89,60 @@ public:
 	 */
 	void setImage(const cv::Mat &image, cv::Rect ROI, int setData=1, int setIntegral=1, int setSqInt=0, int setTInt=0);
 	
+	/**
+	 * \brief Use existing data as the representations of this ImagePatch,
+	 * without copying it. Any of the matrices may be empty. This is used to
+	 * view patches that live in a memory-mapped file, so the caller must 
+	 * keep the data valid for as long as the patch (or a copy of it) is used.
+	 *
+	 * @param image 8-bit single channel image data. 
+	 * @param integral 32-bit integer integral image, one row and column larger
+	 * than the image. 
+	 * @param sqIntegral 64-bit float square integral image. 
+	 * @param tIntegral 32-bit integer tilted integral image.
+	 * 
+	 * @return 1 if all matrices had the expected types and sizes, 0 otherwise,
+	 * in which case the patch is unchanged.
+	 */
+	int setRepresentations(const cv::Mat &image, const cv::Mat &integral, 
+						   const cv::Mat &sqIntegral=cv::Mat(), const cv::Mat &tIntegral=cv::Mat()); 
+	
+	/**
+	 * \brief Make this ImagePatch a view of a region of a larger image's 
+	 * representations, without copying or recomputing anything. 
+	 * 
+	 * This lets patches be pulled out of an image whose integral has already
+	 * been computed, e.g. by PatchList2 during search, in constant time. The
+	 * integral views are not rebased to start from zero: each value is offset
+	 * by the sums above and to the left of the region. Box sums are 
+	 * differences of four corners, so the offsets cancel, and BoxFeature2 and 
+	 * unintegration give the same results as for a freshly integrated patch.
+	 * 
+	 * The views share data with the source matrices, and are only valid 
+	 * until those are rewritten (e.g. by the next setImage() of the patch or
+	 * PatchList2 they came from). Call detach() to keep the patch for longer.
+	 *
+	 * @param image 8-bit single channel image, or an empty matrix. 
+	 * @param integral 32-bit integer integral of the image, or an empty matrix.
+	 * @param ROI Region of the image to view.
+	 * @param sqIntegral 64-bit float square integral of the image. 
+	 * @param tIntegral 32-bit integer tilted integral of the image.
+	 * 
+	 * @return 1 if the representations were consistent and contain ROI, 0 
+	 * otherwise, in which case the patch is unchanged.
+	 */
+	int setRepresentationsView(const cv::Mat &image, const cv::Mat &integral, cv::Rect ROI,
+							   const cv::Mat &sqIntegral=cv::Mat(), const cv::Mat &tIntegral=cv::Mat()); 
+	
+	/**
+	 * \brief Give this ImagePatch its own compact copy of any representations
+	 * that are views (see setRepresentationsView()) or shared with another 
+	 * matrix. Integral views are rebased so that the copies start from zero,
+	 * exactly as if the patch had been integrated on its own. Patches that 
+	 * already own their data are left alone. 
+	 */
+	void detach(); 
+	
 	/**
 	 * \brief Get the size of the ImagePatch. 
 	 */
@@ -140,6 +194,18 @@ public:
 	void createRepIfNeeded(int setData=1, int setIntegral=1, int setSqInt=0, int setTInt=0); 
 	
 	
+	/**
+	 * \brief Write all representations (image, integral, ...) that this patch 
+	 * currently holds to a binary stream. Unlike the FileStorage format, 
+	 * integral images are stored as well, so nothing is recomputed on reading.
+	 **/
+	void addToStreamBinary(std::ostream &out) const; 
+	
+	/**
+	 * \brief Read a patch written with addToStreamBinary.
+	 **/
+	void readFromStreamBinary(std::istream &in); 
+	
 	friend cv::FileStorage& operator << (cv::FileStorage &fs, const ImagePatch2 &patch); 
 	friend void operator >> ( const cv::FileNode &fs, ImagePatch2 &patch) ; 
 	
@@ -15,9 +15,11 @@
 #include <opencv2/core/core.hpp>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "ObjectDetector.h"
 #include "OpenCVHaarDetector.h"	
+#include "GentleBoostCascadeDetector.h"
 
 /**
  *\ingroup AuxGroup
@@ -76,11 +78,12 @@ public:
 	 * same image, or same frame of video, is fixated multiple times. 
 	 *
 	 * @param detector A pointer to an object detector. This object detector will be applied to 
-	 * each patch in the IPP, forming the basis for the MIPOMDP observation model. 
+	 * each patch in the IPP, forming the basis for the MIPOMDP observation model. The IPP takes
+	 * ownership of the detector. 
 	 **/
 	 
 	ImagePatchPyramid(CvSize inputImageSize, CvSize subImageSize, CvSize gridSize, 
-					  int numSubImages, CvMat* subImageGridPoints, OpenCVHaarDetector* detector); 
+					  int numSubImages, CvMat* subImageGridPoints, ObjectDetector* detector); 
 	
 	/**
 	 * \brief Placeholder Constructor. 
@@ -98,8 +101,14 @@ public:
 	/**
 	 * \brief Deep Copy Constructor: Create an IPP that is identical to 
 	 * the one copied.
+	 *
+	 * @param ippToCopy The IPP to copy. 
+	 * @param copyDetector If 0, the copy gets no detector (it is NULL), and
+	 * one must be given to it before searching. This saves cloning the 
+	 * detector (which reloads an OpenCVHaarDetector's XML file) for copies 
+	 * that share detectors, as in MIPOMDPStreamBatch. 
 	 **/
-	ImagePatchPyramid(ImagePatchPyramid* ippToCopy);
+	ImagePatchPyramid(const ImagePatchPyramid* ippToCopy, int copyDetector=1);
 	
 	/**
 	 * \brief Default Destructor. 
@@ -333,6 +342,31 @@ public:
 	 **/
 	void useSameFrameOptimizations(int flag); 	
 	
+	/**
+	 * \brief Set whether detections are cached across fixations of the same frame. 
+	 *
+	 * With the cache, each scale of the pyramid is treated as a down-sampled copy of the whole
+	 * frame, divided into tiles the size of that scale's patch. The object detector is run on a
+	 * tile (plus a margin of half a tile, so objects straddling its edge are found) the first
+	 * time a fixation's patch overlaps it, and the detections centered in each grid cell are 
+	 * remembered. Counting the objects seen by a fixation is then a lookup of the cached counts in 
+	 * the patch's region, and the detector runs at most once per tile per scale for each frame. 
+	 *
+	 * The counts differ slightly from those without the cache, because the detector sees a
+	 * little beyond the edges of each patch. Observation models should be trained with the same 
+	 * setting that is used for search. As with same-frame optimizations, setNewImage() must be 
+	 * called each time the image changes. 
+	 * 
+	 * @param flag If 1, use the detection cache. If 0 (the default), run the detector on the
+	 * patches of every fixation. 
+	 **/
+	void useDetectionCache(int flag); 
+	
+	/**
+	 * \brief Check whether detections are cached across fixations of the same frame. 
+	 **/
+	int getDetectionCache(); 
+	
 	
 	/**
 	 * \brief A pointer to the oject detector used in searching. By exposing this variable, it 
@@ -340,9 +374,18 @@ public:
 	 * properties.
 	 *
 	 * For example, with an OpenCVHaarDetector, the search granularity and minimum-patch-size
-	 * parameters can be changed.
+	 * parameters can be changed. Use setObjectDetector() to replace it. 
+	 **/
+	ObjectDetector* detector; 	
+	
+	/**
+	 * \brief Replace the object detector. The old detector is deleted, and the IPP takes 
+	 * ownership of the new one. 
+	 *
+	 * Only OpenCVHaarDetector and GentleBoostCascadeDetector can be saved and loaded with 
+	 * the IPP. Observation models should be trained with the detector used for search. 
 	 **/
-	OpenCVHaarDetector* detector; 	
+	void setObjectDetector(ObjectDetector* newDetector); 
 	
 	/**
 	 * \brief Change the file used by the object detector for doing detecting.
@@ -393,9 +436,24 @@ public:
 	 * \brief Read from a file.
 	 **/
 	friend std::istream& operator>> (std::istream& ifs, ImagePatchPyramid* a);
+	
+	/**
+	 * \brief Write the geometry and detector to a binary stream, in checksummed
+	 * blocks. Used by MIPOMDP::saveToBinaryFile(). 
+	 **/
+	void addToStreamBinary(std::ostream& out); 
+	
+	/**
+	 * \brief Read what addToStreamBinary() wrote. 
+	 *
+	 * @return 1 on success, 0 if the stream ended early, a checksum didn't 
+	 * match, or the geometry is invalid, in which case the IPP is unchanged.
+	 **/
+	int readFromStreamBinary(std::istream& in); 
 protected: 	
 	void readFromStream(std::istream& in); 
 	void addToStream(std::ostream& out); 
+	void readDetectorFromStream(std::istream& in); 
 	void reInitialize(); 
 	
 	int newImage; 
@@ -421,6 +479,16 @@ protected:
 	
 	CvRect getFullImageROIForPointAtScale(CvPoint searchPoint, int scale); 
 
+	int cacheDetections; 
+	int detectorHasFrame; //Whether the detector has seen the current frame since setNewImage() 
+	std::vector<cv::Mat> scaledFrames;  //The whole frame at the resolution of each scale 
+	std::vector<cv::Mat> tileSearched;  //Which tiles of each scale the detector has been run on 
+	std::vector<cv::Mat> cachedCounts;  //Detections centered in each grid cell at each scale, in searched tiles 
+	
+	void clearDetectionCache(); 
+	void searchTile(IplImage* grayFrame, int scale, int tileX, int tileY); 
+	void countCachedObjects(IplImage* grayFrame, CvPoint searchPoint, int scale); 
+
 };
 
 std::ostream& operator<< (std::ostream& ofs, ImagePatchPyramid* a);
@@ -11,8 +11,10 @@
 #define _MIPOMDP_H
 
 #include <opencv2/core/core_c.h>
+#include <opencv2/core/core.hpp>
 #include <iostream>
 #include <string>
+#include <vector>
 #include "OpenCVHaarDetector.h"
 #include "ObjectDetector.h"
 #include "ImagePatchPyramid.h"
@@ -20,6 +22,7 @@
 #include "OpenLoopPolicies.h"
 #include "ConvolutionalLogisticPolicy.h"
 #include "ImageDataSet.h"
+#include "DeadlineTimer.h"
 
 /**
  * \ingroup MPGroup
@@ -39,13 +42,30 @@ public:
 	
 	/**
 	 *\brief Load a saved MIPOMDP from a file. The file should have been saved 
-	 * via the saveToFile() method. 
+	 * via the saveToFile() method, or the saveToBinaryFile() method, in which 
+	 * case this calls loadFromBinaryFile(). 
 	 * 
 	 * @param filename The name of a file that was saved via the saveToFile() 
 	 * method. 
 	 **/
 	static MIPOMDP* loadFromFile(const char* filename); 
 	
+	/**
+	 *\brief Load a MIPOMDP saved with saveToBinaryFile(). 
+	 * 
+	 * @param filename The name of the file. 
+	 *
+	 * @return The MIPOMDP, or NULL if the file is missing, was written by a 
+	 * different version or on a machine with a different byte order, or fails
+	 * a checksum. 
+	 **/
+	static MIPOMDP* loadFromBinaryFile(const char* filename); 
+	
+	/**
+	 *\brief Check whether a file was written by saveToBinaryFile(). 
+	 **/
+	static int isBinaryModelFile(const char* filename); 
+	
 	/**
 	 * \brief Main Constructor: Manually create an MIPOMDP. 
 	 *
@@ -55,13 +75,10 @@ public:
 	 * will be, the size (height/width) in grid-cells of each image patch, and 
 	 * what object detector to apply. 
 	 *
-	 * In order to be able to properly save and load object detectors, the 
-	 * class of the object detector must be specified in the MIPOMDP. To use an 
-	 * object detector other than OpenCVHaarDetector, replace 
-	 * "OpenCVHaarDetector" in MIPOMDP.h and MIPOMDP.cpp, and recompile the 
-	 * NMPT library. (setHaarCascadeScaleFactor() and setHaarCascadeMinSize()
-	 * will also need to be removed, or implemented in your own object detector
-	 * for successful compilation). 
+	 * This constructor uses an OpenCVHaarDetector. To search with a cascade 
+	 * trained by NMPT instead, call setObjectDetector() with a 
+	 * GentleBoostCascadeDetector before training the observation model. Both 
+	 * kinds of detector are saved and loaded with the MIPOMDP. 
 	 *
 	 * @param inputImageSize The size of the images that will be given to the 
 	 * IPP to turn into MIPOMDP observations. This allocates memory for 
@@ -93,11 +110,8 @@ public:
 	 * multiple times. 
 	 *
 	 * @param haarDetectorXMLFile A file that was saved as the result of using 
-	 * OpenCV's haar-detector training facilities. In order to be able to 
-	 * properly save and load object detectors, the class of the object detector
-	 * must be specified in the MIPOMDP. To use an object detector other than 
-	 * OpenCVHaarDetector, simply replace "OpenCVHaarDetector" in MIPOMDP.h and 
-	 * MIPOMDP.cpp, and recompile the NMPT library. 
+	 * OpenCV's haar-detector training facilities. See setObjectDetector() for
+	 * using other detectors. 
 	 **/
 	MIPOMDP(CvSize inputImageSize, CvSize subImageSize, CvSize gridSize, 
 			int numSubImages, CvMat* subImageGridPoints, 
@@ -130,6 +144,25 @@ public:
 	 * @param filename The name of the saved file. 
 	 **/
 	void saveToFile(const char* filename);	
+	
+	/**
+	 *\brief Save MIPOMDP Data: Save the same data as saveToFile() in a 
+	 * compact, versioned binary format that is much faster to load. 
+	 * 
+	 * The observation model tables are stored exactly as they are laid out in 
+	 * memory, and are read straight back into place. Every block of the file 
+	 * (the IPP geometry and detector, each table, and the policy parameters)
+	 * is followed by a CRC-32 checksum, which is checked when it is loaded. The
+	 * file uses the byte order of the machine that wrote it. 
+	 * 
+	 * Existing text models can be converted with the ConvertMIPOMDPModel 
+	 * tool. 
+	 *
+	 * @param filename The name of the saved file. 
+	 *
+	 * @return 1 on success, 0 if the file couldn't be written. 
+	 **/
+	int saveToBinaryFile(const char* filename); 
 		
 	/*Modify*/
 	
@@ -174,7 +207,37 @@ public:
 	 * @return The size of the visual grid world, where each location is a 
 	 * potential object location (state) and potential eye-movement (action). 
 	 **/
-	CvSize getGridSize(); 
+	CvSize getGridSize() const; 
+	
+	/**
+	 *\brief Read-only access to the observation model, so that other 
+	 * searches (e.g. MIPOMDPStreamBatch) can use it without copying it. 
+	 **/
+	const MultinomialObservationModel* getObservationModel() const; 
+	
+	/**
+	 *\brief Read-only access to the policy. Choosing a fixation uses the 
+	 * policy's scratch buffers, so other searches should search with a copy
+	 * of it. 
+	 **/
+	const ConvolutionalLogisticPolicy* getPolicy() const; 
+	
+	/**
+	 *\brief Read-only access to the IPP, whose geometry and detector other 
+	 * searches copy. 
+	 **/
+	const ImagePatchPyramid* getImagePatchPyramid() const; 
+	
+	/**
+	 *\brief Normalize beliefs held in the log domain: each row of logBeliefs
+	 * is one distribution, which is shifted in place to sum to 1 once 
+	 * exponentiated (log-sum-exp, so nothing underflows). 
+	 *
+	 * @param logBeliefs CV_64F log probabilities, one distribution per row. 
+	 * @param beliefs The normalized probabilities in CV_32F, with the size 
+	 * of logBeliefs (set by the method). 
+	 **/
+	static void normalizeLogBeliefs(cv::Mat &logBeliefs, cv::Mat &beliefs); 
 	
 	/*Current state*/
 	
@@ -320,6 +383,73 @@ public:
 	CvPoint searchFrameUntilConfident(IplImage* grayFrame, 
 									  double confidenceThresh); 
 	
+	/**
+	 *\brief Search function: Set how many fixations searchFrameUntilConfident()
+	 * runs the object detector at ahead of the policy. 
+	 * 
+	 * Whenever the detector has to run at the fixation the policy chose, it 
+	 * also runs, on other threads, at the grid points the policy was most 
+	 * likely to choose (see ConvolutionalLogisticPolicy::getLikelyFixationPoints()), 
+	 * each with its own copy of the IPP. If the policy later chooses one of 
+	 * those points in the same frame, its detector output is used without 
+	 * waiting for the detector. Outputs that are never used are discarded at 
+	 * the end of the frame. 
+	 * 
+	 * The policy still chooses every fixation in order from the current 
+	 * belief, and the detector output at a point of a frame doesn't depend on 
+	 * which points were searched before it, so the fixations and the final 
+	 * belief are the same as with no speculation. Only the time to reach 
+	 * confidence changes. When a speculative output is used, the IPP's 
+	 * foveated preview is not redrawn for that fixation. 
+	 * 
+	 * The detector must support ObjectDetector::clone(). 
+	 *
+	 * @param numFixations Number of points to search ahead. 0 (the default)
+	 * searches one fixation at a time. 
+	 **/
+	void setSpeculativeFixations(int numFixations); 
+	
+	/**
+	 *\brief Search function: Search an image (or frame of video) as in 
+	 * searchFrameUntilConfident(), but stop before a time budget runs out. 
+	 * 
+	 * Each fixation (choosing it, and running the IPP and belief update) is 
+	 * timed, and before each fixation the search stops if the time so far plus
+	 * the predicted cost of the fixation would exceed the budget. The cost is 
+	 * predicted from recent fixations, across frames (see DeadlineTimer). The
+	 * search also stops when the target location reaches confidenceThresh, or
+	 * on the first repeat fixation, so with an ample budget it makes the same
+	 * fixations as searchFrameUntilConfident(). 
+	 * 
+	 * If no fixation fits in the budget, the frame isn't searched, and the 
+	 * most likely location under the current belief is returned. 
+	 * 
+	 * Speculative fixations (setSpeculativeFixations()) aren't used. 
+	 * 
+	 * @param grayFrame The image to search. Must be of type IPL_DEPTH_8U, 1
+	 * channel. 
+	 * 
+	 * @param timeBudget The time allowed for the search, in seconds. 
+	 * 
+	 * @param confidenceThresh Probability that max-location really contains
+	 * the object before stopping. 
+	 *
+	 * @param confidence If not NULL, set to the probability of the returned 
+	 * location (as getProb()). 
+	 *
+	 * @return The most likely location of the search target. 
+	 **/
+	CvPoint searchFrameUntilDeadline(IplImage* grayFrame, double timeBudget, 
+									 double confidenceThresh=1.0, double* confidence=NULL); 
+	
+	/**
+	 *\brief Search function: Get the timer used by searchFrameUntilDeadline(),
+	 * which keeps the history used to predict the cost of a fixation, and 
+	 * statistics on how often the budget was binding (see 
+	 * DeadlineTimer::printStatistics()). 
+	 **/
+	DeadlineTimer* getDeadlineTimer(); 
+	
 	/**
 	 *\brief Search function: Search an image (or frame of video) at a sequence
 	 * of fixation points chosen randomly, and update belief
@@ -546,6 +676,19 @@ public:
 	 **/
 	void useSameFrameOptimizations(int flag); 	
 	
+	/**
+	 *\brief Interface with IPP: Set whether object detector outputs are 
+	 * cached across fixations of the same frame, so that the detector runs at 
+	 * most once per region of each scale, however many times the frame is 
+	 * fixated. See ImagePatchPyramid::useDetectionCache(). 
+	 * 
+	 * The cached counts differ slightly from uncached ones, so the observation
+	 * model should be trained with the same setting that is used for search. 
+	 *
+	 * @param flag If 1, use the detection cache. If 0 (the default), don't. 
+	 **/
+	void useDetectionCache(int flag); 
+	
 	/**
 	 *\brief Interface with IPP: Save a variety of visual representations of the
 	 * process of fixating with an IPP to image files. 
@@ -609,6 +752,24 @@ public:
 	 */
 	void setHaarCascadeMinSize(int size); 
 	
+	/**
+	 *\brief Interface with Object Detector: Replace the object detector 
+	 * applied to each level of the IPP. The MIPOMDP takes ownership of the 
+	 * detector. 
+	 *
+	 * For example, to search with a cascade trained by TrainCascadedDetector:
+	 *
+	 * <code>
+	 * pomdp->setObjectDetector(new GentleBoostCascadeDetector("face.cascade")); 
+	 * </code>
+	 *
+	 * The observation model depends on the detector, so it should be trained 
+	 * (or retrained) after the detector is set. 
+	 *
+	 * @param detector The new object detector. 
+	 **/
+	void setObjectDetector(ObjectDetector* detector); 
+	
 	
 	/*Observation Model Interface*/
 	
@@ -643,6 +804,22 @@ public:
 	 **/
 	void addDataToObservationModel(ImageDataSet* trainingSet); 
 	
+	/**
+	 *\brief Interface with Observation Model: Set how many threads 
+	 * trainObservationModel() and addDataToObservationModel() use. 
+	 * 
+	 * The training set is split into one contiguous shard per thread. Each 
+	 * thread fixates its shard's images with its own copy of the IPP, and 
+	 * counts the detector outputs in its own copy of the observation model. 
+	 * The copies are then merged as in combineModels(). Training involves no
+	 * random choices, and the counts are whole numbers, so the model is the 
+	 * same for any number of threads. 
+	 *
+	 * @param numThreads Number of threads. 0 (the default) uses 
+	 * cv::getNumThreads(). 
+	 **/
+	void setNumTrainingThreads(int numThreads); 
+	
 	/**
 	 *\brief Interface with Observation Model:  Reset the experience-counts used
 	 * to estimate the multinomial parameters.  Sets all counts to 1.
@@ -682,6 +859,9 @@ public:
 	 * \li ConvolutionalLogisticPolicy::GAUSSIAN
 	 * \li ConvolutionalLogisticPolicy::IMPULSE
 	 * \li ConvolutionalLogisticPolicy::MAX
+	 * \li ConvolutionalLogisticPolicy::INFOMAX - Fixate where the observation
+	 * model expects to learn the most. This usually reaches a confidence 
+	 * threshold in fewer fixations than the heuristic kernels. 
 	 **/
 	void setPolicy(int policyNumber); 
 	
@@ -739,12 +919,39 @@ protected:
 	IplImage* actProb;       //has size of grid
 	IplImage* fixationCount; //has size of grid
 		
+	//The belief is updated in the log domain, and currentBelief is only recomputed from it when
+	//probabilities are needed. The flags say which of the two is up to date. 
+	cv::Mat logBelief;       //has size of grid
+	int logBeliefIsCurrent; 
+	int beliefIsCurrent; 
+	int deferBeliefNormalization; 
+	
+	void setLogBeliefFromBelief(); 
+	void setBeliefFromLogBelief(); 
+	void updateBeliefIfNeeded(); 
+		
 	virtual void runForwardBeliefDynamics(); 
 	virtual void setObservationProbability(CvPoint searchPoint); 
 	
 	float randomFloat(); 	
 	
 	virtual void updateProbTableCounts(IplImage* grayFrame, CvRect objectLocation) ; 
+	void updateProbTableCounts(ImagePatchPyramid* trainIpp, MultinomialObservationModel* trainModel, 
+							   IplImage* grayFrame, CvRect objectLocation); 
+	void addImageToObservationModel(ImagePatchPyramid* trainIpp, MultinomialObservationModel* trainModel, 
+									ImageDataSet* trainingSet, int index); 
+	friend class MIPOMDPTrainingBody; 
+	int numTrainingThreads; 
+	cv::Mutex trainingOutputLock; 
+	
+	CvPoint updateBeliefFromCounts(CvPoint searchPoint, IplImage* counts); 
+	CvPoint searchFrameUntilConfidentSpeculatively(IplImage* grayFrame, double confidenceThresh); 
+	int prepareSpeculativeIpps(); 
+	void clearSpeculativeIpps(); 
+	int numSpeculativeFixations; 
+	std::vector<ImagePatchPyramid*> speculativeIpps; //one per point searched ahead, kept across frames
+	
+	DeadlineTimer deadlineTimer; 
 	void normalizeProbTables() ; 
 	
 };
@@ -0,0 +1,192 @@
+/*
+ *  MIPOMDPEvaluator.h
+ *  OpenCV
+ *
+ */
+
+#ifndef MIPOMDPEVALUATOR_H
+#define MIPOMDPEVALUATOR_H
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/core_c.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+class ImageDataSet;
+
+/**
+ * \brief Speed and accuracy of MIPOMDP search on one image, as measured by
+ * MIPOMDPEvaluator.
+ **/
+struct MIPOMDPEvaluationResult {
+	/**
+	 * \brief Index of the fold (holdout set) the image belongs to.
+	 **/
+	int fold;
+
+	/**
+	 * \brief Index of the image within its fold.
+	 **/
+	int image;
+
+	/**
+	 * \brief Index of the worker thread that evaluated the image.
+	 **/
+	int worker;
+
+	/**
+	 * \brief 1 if the image was read and searched, 0 otherwise.
+	 **/
+	int ok;
+
+	/**
+	 * \brief Size of the image in pixels.
+	 **/
+	int width, height;
+
+	/**
+	 * \brief Seconds taken by searchFrameUntilConfident.
+	 **/
+	double searchTime;
+
+	/**
+	 * \brief Seconds taken by searchHighResImage (plain Viola-Jones search).
+	 **/
+	double hiresTime;
+
+	/**
+	 * \brief Grid distance from the most likely target location to the true
+	 * target location, for MIPOMDP and for Viola-Jones search.
+	 **/
+	double searchGridError, hiresGridError;
+
+	/**
+	 * \brief Probability of the target location, and negative entropy of the
+	 * belief, after the MIPOMDP search.
+	 **/
+	double searchProb, searchReward;
+};
+
+/**
+ *\ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> Measures the speed and accuracy of MIPOMDP
+ * search against plain Viola-Jones search, following the procedure of
+ * Butko and Movellan, CVPR 2009, on all cores.
+ *
+ * The evaluation is made of folds. Each fold has an MIPOMDP file, trained with
+ * the fold's images held out, and a set of labeled test images. For every
+ * image, the evaluator times searchFrameUntilConfident() and
+ * searchHighResImage(), and measures how far each search's answer is from the
+ * labeled target location in grid cells.
+ *
+ * Images are shared out to worker threads. Each worker loads its own MIPOMDP
+ * for the fold it is working on, and times its searches with its own
+ * BlockTimer, so workers never share search state. Timings measured while all
+ * cores are busy include the cost of contention for memory bandwidth and
+ * caches. For the cleanest latency numbers, use setPinThreads() to run
+ * exactly one worker per core, each pinned to its own core (Linux only), or
+ * use a single worker.
+ *
+ * \see CVPRTestSpeed
+ */
+class MIPOMDPEvaluator {
+public:
+	/**
+	 * \brief Constructor.
+	 **/
+	MIPOMDPEvaluator();
+
+	/**
+	 * \brief Destructor.
+	 **/
+	~MIPOMDPEvaluator();
+
+	/**
+	 * \brief Add a fold to the evaluation.
+	 *
+	 * @param pomdpFile MIPOMDP file trained without this fold's images.
+	 * @param testSet The fold's images. The first two labels of each image
+	 * are the x and y coordinates of the target. The names and labels are
+	 * copied, so the set can be deleted after this call.
+	 **/
+	void addFold(const std::string &pomdpFile, ImageDataSet* testSet);
+
+	/**
+	 * \brief Stop searchFrameUntilConfident() when the most likely target
+	 * location has this probability. Default is 0.125.
+	 **/
+	void setStopConfidence(double confidence);
+
+	/**
+	 * \brief Number of worker threads. 0 (the default) uses cv::getNumThreads().
+	 **/
+	void setNumWorkers(int numWorkers);
+
+	/**
+	 * \brief Run one worker per core, and pin each worker to its own core
+	 * while it runs, so that timings aren't distorted by threads migrating or
+	 * sharing cores. This overrides setNumWorkers(). Pinning is only
+	 * supported on Linux; elsewhere this just runs one worker per core.
+	 *
+	 * Workers are cv::parallel_for_ tasks, and each pins whichever thread 
+	 * runs it. Results are correct on any backend, but every core is only 
+	 * busy if the backend gives each task its own thread, as it does when 
+	 * cv::getNumThreads() threads are available; the worker number of each
+	 * result (MIPOMDPEvaluationResult::worker) shows how jobs were shared.
+	 **/
+	void setPinThreads(int flag);
+
+	/**
+	 * \brief Write one line per image as it is evaluated, with the same
+	 * comma separated statistics that CVPRTestSpeed prints. Pass NULL (the
+	 * default) to stay quiet.
+	 **/
+	void setProgressStream(std::ostream *out);
+
+	/**
+	 * \brief Evaluate every image of every fold.
+	 *
+	 * @return Number of images that were evaluated successfully.
+	 **/
+	int run();
+
+	/**
+	 * \brief Get the results of the last run(), in fold and image order.
+	 **/
+	const std::vector<MIPOMDPEvaluationResult>& getResults() const;
+
+	/**
+	 * \brief Print mean search time, search rate and grid error for MIPOMDP
+	 * and Viola-Jones search, as CVPRTestSpeed does, followed by the
+	 * distribution of per-image search times.
+	 **/
+	void printSummary(std::ostream &out) const;
+
+private:
+	MIPOMDPEvaluator(const MIPOMDPEvaluator &copy);
+	MIPOMDPEvaluator & operator=(const MIPOMDPEvaluator &rhs);
+
+	struct Fold {
+		std::string pomdpFile;
+		std::vector<std::string> fileNames;
+		std::vector<CvPoint> targets;
+	};
+
+	int nextJob();
+	void evaluateJobs(int worker);
+	void pinToCore(int core);
+	friend class MIPOMDPEvaluationBody;
+
+	std::vector<Fold> folds;
+	std::vector<std::pair<int, int> > jobs;
+	std::vector<MIPOMDPEvaluationResult> results;
+	int nextJobIndex;
+	double stopConfidence;
+	int numWorkers;
+	int pinThreads;
+	std::ostream *progress;
+	cv::Mutex lock;
+};
+
+#endif
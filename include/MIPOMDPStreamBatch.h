@@ -0,0 +1,191 @@
+/*
+ *  MIPOMDPStreamBatch.h
+ *  OpenCV
+ *
+ */
+
+#ifndef MIPOMDPSTREAMBATCH_H
+#define MIPOMDPSTREAMBATCH_H
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/core_c.h>
+#include <vector>
+
+class MIPOMDP;
+class ImagePatchPyramid;
+class ConvolutionalLogisticPolicy;
+class ObjectDetector;
+
+/**
+ *\ingroup AuxGroup
+ * \brief <tt>Auxilliary Tool:</tt> Searches many video streams at once with
+ * one MIPOMDP, advancing every stream by one fixation per step.
+ *
+ * An MIPOMDP holds both the model (the observation model tables, the policy
+ * parameters and the grid geometry) and the state of one search (the belief,
+ * the fixation counts and the ImagePatchPyramid's buffers). Serving many
+ * streams with one MIPOMDP per stream copies the model for every stream. A
+ * stream batch instead reads the model through the MIPOMDP's read-only 
+ * accessors (getObservationModel(), getPolicy(), getImagePatchPyramid()), and
+ * keeps only the per-stream state itself:
+ * \li The beliefs of all streams are the rows of one matrix (in the log domain,
+ * and as probabilities for the policy), so normalizing them after a step is
+ * one MIPOMDP::normalizeLogBeliefs() over contiguous memory rather than one
+ * small pass per stream.
+ * \li Fixation counts are rows of one matrix in the same way.
+ * \li Each stream has its own copy of the IPP's geometry and buffers, since
+ * that is where the foveated images and detector outputs of a frame live, but
+ * not of its detector. Detectors are cloned once per worker thread, and 
+ * stream s is always searched with the detector of worker s % workers. A 
+ * GentleBoostCascadeDetector re-reads its frame when its worker moves on to 
+ * another stream. 
+ *
+ * Each step(), one copy of the policy chooses a fixation for every stream 
+ * that is still searching. The workers then run the detectors and add the 
+ * evidence to each stream's log belief in parallel (cv::parallel_for_), and
+ * all of the beliefs are normalized together. A stream stops searching
+ * when it is confident, or when the policy chooses a point it has already
+ * fixated in this frame, as in MIPOMDP::searchFrameUntilConfident().
+ *
+ * Typical usage for one frame of every stream:
+ *
+ * <code>
+ * batch.setFrame(s, frame[s]); //for each stream s <br>
+ * while (batch.step(.125)) {} <br>
+ * CvPoint face = batch.getMostLikelyTargetLocation(s); <br>
+ * </code>
+ *
+ * As in searchFrameUntilConfident(), the target is not assumed to move while
+ * a frame is searched, and the belief carries over from one frame of a stream
+ * to the next.
+ *
+ * The MIPOMDP must outlive the batch, and must not be changed (trained, or
+ * given a new policy or detector) while the batch is in use.
+ *
+ * Streams must not share one IplImage: searching a frame sets and resets its
+ * ROI, so each stream's frame must be its own image while it is searched.
+ */
+class MIPOMDPStreamBatch {
+public:
+	/**
+	 * \brief Constructor.
+	 *
+	 * @param model The MIPOMDP whose observation model, policy and IPP
+	 * settings are used for every stream.
+	 * @param numStreams The number of streams to search.
+	 **/
+	MIPOMDPStreamBatch(const MIPOMDP* model, int numStreams);
+
+	/**
+	 * \brief Destructor.
+	 **/
+	~MIPOMDPStreamBatch();
+
+	/**
+	 * \brief Get the number of streams.
+	 **/
+	int getNumStreams() const;
+
+	/**
+	 * \brief Give a stream its next frame, and start searching it. If the frame
+	 * is a different size from the stream's last frame, the stream's belief is
+	 * reset to the prior.
+	 *
+	 * @param stream Index of the stream.
+	 * @param grayFrame The frame, of type IPL_DEPTH_8U with a single channel.
+	 * It must stay valid until the stream stops searching it, and must not be
+	 * the frame of another stream that is searching. 
+	 **/
+	void setFrame(int stream, IplImage* grayFrame);
+
+	/**
+	 * \brief Stop searching a stream's current frame.
+	 **/
+	void stopSearching(int stream);
+
+	/**
+	 * \brief Reset a stream's belief to a uniform distribution over the grid.
+	 **/
+	void resetPrior(int stream);
+
+	/**
+	 * \brief Make one fixation in every stream that is still searching, and
+	 * update their beliefs.
+	 *
+	 * @param confidenceThresh A stream stops searching once the probability of
+	 * its most likely target location reaches confidenceThresh.
+	 * @return The number of streams still searching.
+	 **/
+	int step(double confidenceThresh);
+
+	/**
+	 * \brief Search one frame of each stream until every stream is confident.
+	 *
+	 * @param grayFrames One frame per stream.
+	 * @param confidenceThresh See step().
+	 * @param locations The most likely target location in each frame, in
+	 * pixels (set by the method).
+	 **/
+	void searchFramesUntilConfident(const std::vector<IplImage*> &grayFrames,
+									double confidenceThresh,
+									std::vector<CvPoint> &locations);
+
+	/**
+	 * \brief Check whether a stream is still searching its current frame.
+	 **/
+	int isSearching(int stream) const;
+
+	/**
+	 * \brief Get the number of fixations made in a stream's current frame.
+	 **/
+	int getNumFixations(int stream) const;
+
+	/**
+	 * \brief Get the grid point a stream fixated last.
+	 **/
+	CvPoint getLastFixation(int stream) const;
+
+	/**
+	 * \brief Get the pixel at the center of the most likely target location of
+	 * a stream.
+	 **/
+	CvPoint getMostLikelyTargetLocation(int stream) const;
+
+	/**
+	 * \brief Get the probability of the most likely target location of a
+	 * stream.
+	 **/
+	double getProb(int stream) const;
+
+	/**
+	 * \brief Get a stream's belief about the target location: a CV_32F matrix
+	 * the size of the grid. This shares memory with the batch, and changes
+	 * with each step().
+	 **/
+	cv::Mat getBelief(int stream) const;
+
+private:
+	MIPOMDPStreamBatch(const MIPOMDPStreamBatch &copy);
+	MIPOMDPStreamBatch & operator=(const MIPOMDPStreamBatch &rhs);
+
+	void searchStreams(int worker);
+	friend class MIPOMDPStreamSearchBody;
+
+	const MIPOMDP* model;
+	CvSize gridSize;
+
+	ConvolutionalLogisticPolicy* policy;       //chooses every stream's fixations
+	std::vector<ObjectDetector*> detectors;   //one per worker
+	std::vector<ImagePatchPyramid*> ipps;     //one per stream, without a detector
+	std::vector<IplImage*> frames;
+	std::vector<int> searching;
+	std::vector<int> numFixations;
+	std::vector<CvPoint> fixations;
+	std::vector<int> steppedStreams;
+
+	cv::Mat logBeliefs;      //one row per stream, the grid in row-major order
+	cv::Mat beliefs;         //as logBeliefs, normalized probabilities in CV_32F
+	cv::Mat fixationCounts;  //one row per stream
+};
+
+#endif
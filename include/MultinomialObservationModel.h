@@ -11,7 +11,9 @@
 #define _MULTINOMIALOBSERVATIONMODEL_H
 
 #include <opencv2/core/core_c.h>
+#include <opencv2/core/core.hpp>
 #include <iostream>
+#include <vector>
 
 /**
  *\ingroup AuxGroup
@@ -72,6 +74,51 @@ public:
 	 **/
 	IplImage* observationProbability; //has size of grid
 	
+	/**
+	 * \brief Add the log of the likelihood ratios computed by 
+	 * setObservationProbability to a log-domain belief map. This is the same
+	 * Bayesian update as multiplying the belief by observationProbability, 
+	 * up to normalization, but it reads precomputed log-ratio tables with 
+	 * whole-row vector adds instead of looking up each grid cell's ratio.
+	 * @param searchPoint The point that was the center of fixation when the object detector was 
+	 * applied to the image.
+	 * @param faceCount An 8-bit "image" of counts with the size of the grid. 
+	 * @param logBelief A 64-bit floating point map with the size of the grid,
+	 * to which the log likelihood ratios are added. 
+	 **/
+	virtual void addLogLikelihoodRatio(CvPoint searchPoint, IplImage* faceCount, cv::Mat &logBelief) const; 
+	
+	/**
+	 * \brief Compute, for every possible fixation, the expected reduction in
+	 * the entropy of the belief (the information gain) from the observation 
+	 * made there. 
+	 *
+	 * The information gain is the mutual information between the target 
+	 * location and the observation. A cell's count depends on its distance 
+	 * from the fixation, and on whether the target is there. When computing 
+	 * the normalizer of the posterior, the evidence from other cells is 
+	 * replaced by its expected value. With this, the information gain is a sum
+	 * over cells of b*g(b,d), where b is the cell's belief and d its offset
+	 * from the fixation: 
+	 *
+	 * g(b,d) = sum_c p(c|face,d) log( r(c,d) / (b r(c,d) + 1 - b) ), 
+	 * r(c,d) = p(c|face,d) / p(c|noface,d). 
+	 *
+	 * g is tabulated for every offset at a range of beliefs whenever the 
+	 * probability tables change, so the gain at every fixation is a sum over
+	 * tabulated levels of the belief (split between the nearest levels) 
+	 * correlated with that level's table, with no logarithms. Each level is 
+	 * one filter2D() call, so the whole map costs O(levels*n log n) for a grid
+	 * of n cells rather than O(n^2). 
+	 *
+	 * @param belief The current belief: a 32-bit floating point map with the
+	 * size of the grid. 
+	 * @param gain The information gain (in nats) of fixating each grid cell
+	 * (set by the method). A 64-bit floating point map with the size of the 
+	 * grid.
+	 **/
+	virtual void getExpectedInformationGain(IplImage* belief, cv::Mat &gain) const; 
+	
 	/**
 	 *\brief Reset the experience-counts used to estimate the multinomial parameters.  Sets all counts
 	 * to 1.
@@ -137,10 +184,39 @@ public:
 	 **/
 	friend std::istream& operator>> (std::istream& ifs, MultinomialObservationModel* a);
 
+	/**
+	 * \brief Write the probabilities and counts to a binary stream, each table
+	 * as one checksummed block of doubles in its in-memory layout. Used by 
+	 * MIPOMDP::saveToBinaryFile(). 
+	 **/
+	void addToStreamBinary(std::ostream& out); 
+	
+	/**
+	 * \brief Read what addToStreamBinary() wrote, straight into the tables. 
+	 *
+	 * @return 1 on success, 0 if the stream ended early, a checksum didn't 
+	 * match, or the tables are a different size from this model's. The 
+	 * tables are only valid after a successful read. 
+	 **/
+	int readFromStreamBinary(std::istream& in); 
+
 protected:
 	void fillProbTablesHeuristic() ; 
 	int maxfaces; 
 	
+	void updateLogRatioTables(); 
+	
+	//Log likelihood ratio of each count at every offset from the fixation, centered so that the
+	//ratios for a fixation are the grid-sized window at (gridwidth-1-x, gridheight-1-y). Table 0 holds
+	//the ratios for a count of 0; table c > 0 holds the difference from table 0. 
+	std::vector<cv::Mat> logRatioTables; 
+	//g(b,d) (see getExpectedInformationGain()) for each tabulated belief level b, centered like
+	//logRatioTables. The levels are spaced evenly in log(b) from infoGainMinBelief to 1. 
+	std::vector<cv::Mat> infoGainTables; 
+	static const int numInfoGainLevels = 33; 
+	static const double infoGainMinBelief; 
+	void updateInfoGainTables(); 
+	
 	
 	void readFromStream(std::istream& in); 
 	void addToStream(std::ostream& out); 
@@ -155,6 +155,52 @@ namespace NMPTUtils {
 	 **/
 	void readMatBinary(const cv::FileNode &storage, cv::Mat &mat);
 	
+	/**
+	 * \brief Write a matrix to a binary stream: rows, cols and type as ints, 
+	 * followed by the raw element data, row by row. Much faster to read back
+	 * than writeMatBinary, at the cost of not being human readable. 
+	 **/
+	void writeMatToStreamBinary(std::ostream &out, const cv::Mat &mat); 
+	
+	/**
+	 * \brief Read a matrix written with writeMatToStreamBinary. Returns 0 if 
+	 * the stream ended early or the header was invalid (an unknown type, or 
+	 * more data than the stream holds), in which case nothing is allocated. 
+	 **/
+	int readMatFromStreamBinary(std::istream &in, cv::Mat &mat); 
+	
+	/**
+	 * \brief Write a string to a binary stream as its length followed by its 
+	 * characters. 
+	 **/
+	void writeStringToStreamBinary(std::ostream &out, const std::string &str); 
+	
+	/**
+	 * \brief Read a string written with writeStringToStreamBinary.
+	 **/
+	int readStringFromStreamBinary(std::istream &in, std::string &str); 
+	
+	/**
+	 * \brief Compute the CRC-32 (as used by zip and png) of a block of memory.
+	 * 
+	 * @param crc The checksum of the preceding data, to checksum data that is
+	 * split across several blocks. 
+	 **/
+	unsigned int crc32(const void* data, size_t bytes, unsigned int crc=0); 
+	
+	/**
+	 * \brief Write a block of memory to a binary stream, followed by its 
+	 * crc32(). 
+	 **/
+	void writeChecksummedBlockToStreamBinary(std::ostream &out, const void* data, size_t bytes); 
+	
+	/**
+	 * \brief Read a block written with writeChecksummedBlockToStreamBinary() 
+	 * straight into memory that already has the right size. Returns 0 if the 
+	 * stream ended early or the checksum doesn't match. 
+	 **/
+	int readChecksummedBlockFromStreamBinary(std::istream &in, void* data, size_t bytes); 
+	
 	
 	 //
 	 // \brief Write the value of a matrix to a FileStorage in a Base64 format that is much
@@ -262,6 +308,27 @@ namespace NMPTUtils {
 	cv::Mat RBF(const cv::Mat &input, const cv::Mat &labels, const cv::Mat &weights, 
 				const cv::Mat &xqueries, double tau=.05, double eps=.001); 
 	
+	/**
+	 * \brief Compute the unnormalized sums behind RBF(): for each query, the 
+	 * kernel-and-weight weighted sum of labels, and the sum of the kernel 
+	 * weights. These are additive over disjoint sets of data points, so 
+	 * partial sums from several parts of a dataset can be added and passed
+	 * to RBFFromSums() to get the RBF of the whole dataset. 
+	 *
+	 * @param numerator QxO weighted label sums (set by the algorithm).
+	 * @param denominator Qx1 weight sums (set by the algorithm).
+	 **/
+	void RBFSums(const cv::Mat &input, const cv::Mat &labels, const cv::Mat &weights, 
+				 const cv::Mat &xqueries, double tau, double eps, 
+				 cv::Mat &numerator, cv::Mat &denominator); 
+	
+	/**
+	 * \brief Finish an RBF computation from sums computed by RBFSums().
+	 *
+	 * @return QxO RBF values, Q query points, O output dimensions. 
+	 **/
+	cv::Mat RBFFromSums(const cv::Mat &numerator, const cv::Mat &denominator); 
+	
 }
 
 template<class mattype>	void NMPTUtils::map(cv::Mat &mat, mattype (*function)(mattype)) {
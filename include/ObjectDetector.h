@@ -47,6 +47,31 @@ public:
 	//virtual CvSeq* detectObjects(IplImage* image) = 0; 
 	virtual std::vector<cv::Rect> detectObjects(IplImage* image) = 0; 
 
+	/**
+	 * \brief Find objects in a region of a larger frame, given the region 
+	 * already scaled down to the size the detector should search. 
+	 *
+	 * This is how the ImagePatchPyramid searches each level of the foveated
+	 * representation. Detectors that can share work between many regions of 
+	 * the same frame (e.g. by building an image pyramid for the frame once) 
+	 * override this. By default, it is detectObjects(scaledRegion). 
+	 *
+	 * @param frame The full frame that region is taken from. 
+	 * @param region The region of frame being searched.
+	 * @param scaledRegion The region, scaled down. 
+	 * @param newFrame 1 if frame has changed since the last call, 0 if it is 
+	 * the same frame as before. 
+	 * @return Object locations, in the coordinates of scaledRegion. 
+	 **/
+	virtual std::vector<cv::Rect> detectObjectsInRegion(IplImage* frame, CvRect region, 
+														IplImage* scaledRegion, int newFrame); 
+	
+	/**
+	 * \brief Make a deep copy of the detector. Returns NULL if the detector
+	 * can't be copied. 
+	 **/
+	virtual ObjectDetector* clone(); 
+
 	virtual ~ObjectDetector(); 
 	
 	
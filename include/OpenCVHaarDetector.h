@@ -107,6 +107,11 @@ public:
 	 * warning will be printed, and the detector's source will need to be set.
 	 */
 	void setDetectorSource(std::string newFileName) ; 
+	
+	/**
+	 * \brief Make a deep copy of the detector. 
+	 **/
+	ObjectDetector* clone(); 
 protected:
 	void readFromStream(std::istream& in); 
 	void addToStream(std::ostream& out); 
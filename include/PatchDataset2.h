@@ -100,6 +100,11 @@ public:
 	 * wider than indicated in the dataset by a factor of [scale]. A scale 
 	 * less than 1 will crop the patches smaller around the center of the object,
 	 * will greater than 1 will include more of a border around the object. 
+	 * @param randomSeed Seed for choosing negative patch locations. Images are
+	 * read and their patches extracted in parallel (using cv::getNumThreads()
+	 * threads), and each image draws from its own generator seeded from 
+	 * randomSeed and the image's index, so the dataset only depends on the 
+	 * seed, and not on the number of threads. 
 	 */
 	PatchDataset2(cv::Size patchsize,
 				 const std::string &positiveImageListFilename = "", 
@@ -110,7 +115,8 @@ public:
 				 int numPosPatches = -1, 
 				 int numNegPatches = -1,
 				 int useFastPatchList = 1, 
-				  double scale = 1. ); 
+				  double scale = 1., 
+				  uint64 randomSeed = 0); 
 	
 	/**
 	 * \brief Destructor.
@@ -217,6 +223,56 @@ public:
 	 **/
 	int empty() const; 
 	
+	/**
+	 * \brief Save the dataset in a binary container that can be memory-mapped
+	 * with loadMapped. 
+	 *
+	 * The file holds a fixed header, the label array, the dataset's image
+	 * lists, and then one block per stored representation (patch pixels, and
+	 * optionally integral and square integral images). Each block is page
+	 * aligned, and each patch within a block starts on a 64 byte boundary. 
+	 * The file uses the byte order of the machine that wrote it. 
+	 *
+	 * @param filename File to write. It is written to filename.tmp first and 
+	 * then renamed, so an interrupted save never leaves a partial file. 
+	 * @param withIntegrals Store each patch's integral image, so that 
+	 * BoxFeature2 and HaarFeature2 can be applied to mapped patches without 
+	 * recomputing it. 
+	 * @param withSqIntegrals Store each patch's square integral image.
+	 *
+	 * @return 1 on success, 0 on failure.
+	 **/
+	int saveBinary(const std::string &filename, int withIntegrals=1, int withSqIntegrals=0) const; 
+	
+	/**
+	 * \brief Replace the contents of this dataset with a file written by
+	 * saveBinary, memory-mapping it instead of reading it. 
+	 *
+	 * The patches are zero-copy views into the mapping, so loading takes time
+	 * independent of the number of patches' pixels, and pages are only read
+	 * from disk when they are used. The mapping is private: modifying a 
+	 * patch in place never changes the file. 
+	 *
+	 * The mapping stays open while this dataset or any copy of it (such as
+	 * the one kept by GentleBoostClassifier2::setTrainingSet) exists. Patches
+	 * returned by getPatches() must not be used after that. 
+	 *
+	 * @return 1 on success, 0 on failure, in which case the dataset is
+	 * unchanged. 
+	 **/
+	int loadMapped(const std::string &filename); 
+	
+	/**
+	 * \brief Whether the patches of this dataset are views into a file 
+	 * loaded with loadMapped. 
+	 **/
+	int isMapped() const; 
+	
+	/**
+	 * \brief Check whether a file was written by saveBinary.
+	 **/
+	static int isBinaryFile(const std::string &filename); 
+	
 	
 	friend cv::FileStorage& operator << (cv::FileStorage &fs, const PatchDataset2 &data); 
 	friend void operator >> ( const cv::FileNode &fs, PatchDataset2 &data) ; 
@@ -227,12 +283,19 @@ protected:
 			  const std::string &negativeImageListFilename="" ,
 			  int posExamplePatchRadius=0, int posExampleScaleRadius=0,
 			  int numPosPatches=-1, int numNegPatches=-1, int useFastPatchList=1,
-			  double scale = 1.) ; 
+			  double scale = 1., uint64 randomSeed = 0) ; 
 	void copy(const PatchDataset2 &rhs); 
 	
 	ImagePatch2 getPatch(const cv::Mat &image, cv::Size patchSize, cv::Point objCenter, cv::Size objSize) const; 
-	ImagePatch2 getRandomPatch(const cv::Mat &image, cv::Size patchSize, const std::vector<cv::Rect> &blackoutList) const ; 
-	std::vector<ImagePatch2> getRandomPatches(int numPatches, const cv::Mat &image, cv::Size patchSize, const std::vector<cv::Rect> &blackoutList) const;
+	std::vector<ImagePatch2> getRandomPatches(int numPatches, const cv::Mat &image, cv::Size patchSize, const std::vector<cv::Rect> &blackoutList, 
+											  PatchList2* patchList, cv::RNG &rng) const;
+	PatchList2* createPatchList() const; 
+	enum { extractLabeledPatches, extractWholeImages, extractRandomPatches }; 
+	void extractPatches(int mode, const std::vector<std::string> &fileNames, 
+						const std::vector<std::vector<cv::Rect> > &objectLocations, 
+						int param1, int param2, uint64 seed, int maxPatches, 
+						std::vector<ImagePatch2> &dest) const; 
+	friend class PatchExtractionBody; 
 	void recreatePosNegPatches() ; 
 	
 	static int minPerNegIm; 
@@ -261,6 +324,19 @@ protected:
 	
 	PatchList2* list; 
 	
+	/**
+	 * \brief A private memory mapping of a binary patch file, unmapped when
+	 * the last dataset sharing it is destroyed.
+	 **/
+	struct MappedFile {
+		MappedFile(void* address, size_t length); 
+		~MappedFile(); 
+		void* address; 
+		size_t length; 
+	}; 
+	
+	cv::Ptr<MappedFile> mapping; 
+	
 };
 
 cv::FileStorage& operator << (cv::FileStorage &fs, const PatchDataset2 &data); 
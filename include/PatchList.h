@@ -186,6 +186,20 @@ public:
 	 */
 	void resetListToScale(int scale); 
 	
+	/**
+	 * \brief Prepare the data structure to search for objects at a certain
+	 * scale, but only in part of the image. Only patches that lie entirely 
+	 * inside region are kept. 
+	 *
+	 * This lets several regions of an image be searched, one after the other, 
+	 * after a single call to setImage(). 
+	 * 
+	 * @param scale Scale to search, as in resetListToScale(int). 
+	 * @param region Region of the image, in the coordinates of the image given
+	 * to setImage(). 
+	 */
+	void resetListToScale(int scale, cv::Rect region); 
+	
 	/**
 	 * \brief Adds the values in destInds to an accumulator. Any accumulator
 	 * values that are below threshold are removed from the list.
@@ -351,6 +351,24 @@ public:
 	void fillImageWithPixelsOfSearchPatch(cv::Mat &dest, 
 										  const SearchResult &r) const;
 	
+	/**
+	 * \brief Get the patch that the filtering process sees as a view of this
+	 * PatchList's integral (and image, if it was copied) at the patch's scale. 
+	 * Nothing is copied or integrated, so this takes constant time, and the
+	 * patch is ready for BoxFeature2 evaluation. 
+	 * 
+	 * The view is only valid until the next setImage(), which rewrites the 
+	 * scaled images in place, so call ImagePatch2::detach() on it (or copy it
+	 * with fillImageWithPixelsOfSearchPatch) if it is to be kept. 
+	 * 
+	 * @param dest Set to the view.
+	 * 
+	 * @param r A Patch SearchResult from getRemainingPatches() to query.
+	 * 
+	 * @return 1 on success, 0 if r is not a patch of the current image.
+	 */
+	int getSearchPatchView(ImagePatch2 &dest, const SearchResult &r) const; 
+	
 	/**
 	 * \brief Improve efficiency by only copying integral data (not image data). This
 	 * makes fillImageWithPixelsOfSearchPatch fail. 
@@ -367,6 +385,19 @@ public:
 	 */
 	void setDontScaleDownPatches(int flag=0); 
 	
+	/**
+	 * \brief Make getNearbyPatches() return views of the search pyramid (see
+	 * getSearchPatchView()) for patches that need no resampling, rather than 
+	 * copying their pixels and integrating them again. Patches that would be
+	 * resized to the base patch size are still copied. 
+	 * 
+	 * The views are only valid until the next setImage(), so call 
+	 * ImagePatch2::detach() on those that are to be kept. 
+	 * 
+	 * @param flag Set to non-zero to get views. 
+	 */
+	void setNearbyPatchViews(int flag=0); 
+	
 	/**
 	 * \brief Output of image filtering process as an image which can be 
 	 * visualized. 
@@ -426,7 +457,7 @@ protected:
 	//PatchList parameters
 	cv::Size minsize, maxsize, defaultSize; 
 	double stepwidth, scaleinc; 
-	int copyImageData, scaleDownPatches; 
+	int copyImageData, scaleDownPatches, nearbyPatchViews; 
 	
 	
     //Volatile data	
@@ -12,6 +12,7 @@
 
 
 #include <vector>
+#include <iostream>
 #include <opencv2/core/core.hpp>
 
 class Feature;
@@ -255,6 +256,144 @@ struct SearchResult {
 	int _scale; 
 }; 
 
+/**
+ *\ingroup AuxGroup
+ * \brief  <tt>Auxilliary Tool:</tt> A data structure that records where the
+ * time went in one round of cascaded classifier training, i.e. one call to 
+ * GentleBoostCascadedClassifier::trainOneRound. Write it with operator<< to 
+ * get one line of JSON per round. 
+ */
+struct TrainingRoundStats {
+	/**
+	 * \brief Number of the feature added in this round (1 for the first). 
+	 */
+	int round; 
+	
+	/**
+	 * \brief Number of new candidate features scored in the tournament. 
+	 */
+	int candidates_evaluated; 
+	
+	/**
+	 * \brief Wall-clock time for the whole round, in seconds. 
+	 */
+	double seconds_total; 
+	
+	/**
+	 * \brief Time spent replacing rejected negatives with hard negatives 
+	 * from background images, including re-scoring the new training set. 
+	 */
+	double seconds_mining; 
+	
+	/**
+	 * \brief Time spent in the feature tournament. The response, LUT and 
+	 * chi-square times below are part of this (and of adding the feature). 
+	 */
+	double seconds_tournament; 
+	
+	/**
+	 * \brief Time spent evaluating candidate features on training patches. 
+	 */
+	double seconds_response; 
+	
+	/**
+	 * \brief Time spent fitting candidate lookup tables to feature values. 
+	 */
+	double seconds_lut_fit; 
+	
+	/**
+	 * \brief Time spent computing rejection thresholds and chi-square error.
+	 */
+	double seconds_chisq; 
+	
+	/**
+	 * \brief Time spent adding the chosen feature to the classifier. 
+	 */
+	double seconds_add_feature; 
+	
+	/**
+	 * \brief Number of (feature, patch) evaluations done while scoring 
+	 * candidates. 
+	 */
+	long long patches_evaluated; 
+	
+	/**
+	 * \brief patches_evaluated divided by seconds_response. 
+	 */
+	double patches_per_second; 
+	
+	/**
+	 * \brief Background images searched for hard negatives. 
+	 */
+	int bg_images_searched; 
+	
+	/**
+	 * \brief Windows scanned in background images. 
+	 */
+	long long bg_windows_searched; 
+	
+	/**
+	 * \brief Windows that passed the current cascade, and so were candidate
+	 * hard negatives. bg_windows_kept/bg_windows_searched is the mining hit 
+	 * rate.
+	 */
+	long long bg_windows_kept; 
+	
+	/**
+	 * \brief Negative training patches replaced with hard negatives. 
+	 */
+	int bg_patches_replaced; 
+	
+	/**
+	 * \brief Image reads during the round that were answered from 
+	 * ImageCache2::getSharedCache(), which hard negative mining reads 
+	 * background images through. 
+	 */
+	long long image_cache_hits; 
+	
+	/**
+	 * \brief Image reads during the round that missed the shared image 
+	 * cache and were decoded from disk. 
+	 * image_cache_hits/(image_cache_hits+image_cache_misses) is the cache hit
+	 * rate. 
+	 */
+	long long image_cache_misses; 
+	
+	/**
+	 * \brief Number of training patches.
+	 */
+	int num_training_patches; 
+	
+	/**
+	 * \brief Bytes held by training patch images and integral images. 
+	 */
+	size_t patch_bytes; 
+	
+	/**
+	 * \brief Bytes held by per-patch training state (feature outputs, sums, 
+	 * weights, etc.). 
+	 */
+	size_t training_state_bytes; 
+	
+	/**
+	 * \brief Estimated time for the chosen feature to evaluate one window, 
+	 * in seconds (PerformanceMetrics::time_per_patch). 
+	 */
+	double time_per_patch; 
+	
+	/**
+	 * \brief Training performance after the round. 
+	 */
+	PerformanceMetrics perf; 
+}; 
+
+/**
+ *\ingroup AuxGroup
+ * \brief  <tt>Auxilliary Tool:</tt> Write a TrainingRoundStats as a single 
+ * line of JSON (without a trailing newline). 
+ */
+std::ostream& operator<< (std::ostream& out, const TrainingRoundStats& stats); 
+
 bool operator<(const SearchResult& a, const SearchResult& b); 
 bool operator<(const PerformanceMetrics& a, const PerformanceMetrics& b); 
 bool operator<(const FeaturePerformance& a, const FeaturePerformance& b);
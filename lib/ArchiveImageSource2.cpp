@@ -0,0 +1,275 @@
+/*
+ *  ArchiveImageSource2.cpp
+ *  OpenCV
+ *
+ */
+
+#include "ArchiveImageSource2.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+using namespace cv;
+
+static const size_t tarBlockSize = 512;
+
+static string baseName(const string &path) {
+	size_t slash = path.find_last_of('/');
+	return slash == string::npos ? path : path.substr(slash+1);
+}
+
+/* One path is the other, or ends with it after a '/'. */
+static bool pathsMatch(const string &a, const string &b) {
+	const string &longer = a.size() >= b.size() ? a : b;
+	const string &shorter = a.size() >= b.size() ? b : a;
+	if (longer.compare(longer.size()-shorter.size(), shorter.size(), shorter) != 0) return false;
+	return longer.size() == shorter.size() || longer[longer.size()-shorter.size()-1] == '/';
+}
+
+/* Tar numeric fields are octal text, or big-endian base-256 if the high bit
+ * of the first byte is set. */
+static size_t parseTarNumber(const char *field, int length) {
+	size_t value = 0;
+	if (field[0] & 0x80) {
+		for (int i = 1; i < length; i++) value = (value << 8) | (unsigned char)field[i];
+		return value;
+	}
+	for (int i = 0; i < length && field[i]; i++) {
+		if (field[i] >= '0' && field[i] <= '7') value = value*8 + (field[i]-'0');
+	}
+	return value;
+}
+
+static string tarString(const char *field, int length) {
+	return string(field, strnlen(field, length));
+}
+
+/**
+ * Decodes one batch of archive members, one member per task.
+ */
+class ArchiveDecodeBody : public ParallelLoopBody {
+public:
+	ArchiveDecodeBody(const vector<vector<uchar> > &data, vector<Mat> &images) :
+	data(data), images(images) {}
+
+	void operator()(const Range &range) const {
+		for (int j = range.start; j < range.end; j++) {
+			images[j] = imdecode(data[j], 0); //0 means CV_LOAD_IMAGE_GRAYSCALE
+		}
+	}
+
+private:
+	const vector<vector<uchar> > &data;
+	vector<Mat> &images;
+};
+
+ArchiveImageSource2::ArchiveImageSource2(const string &archiveFile,
+										 const ImageDataSet2 &dataset,
+										 int batchSize) :
+gzFileHandle(NULL), fileHandle(NULL), atEnd(0), batchSize(batchSize), dataset(dataset), batchPosition(0) {
+	if (this->batchSize <= 0) this->batchSize = 4*getNumThreads();
+	if (this->batchSize <= 0) this->batchSize = 1;
+
+	for (int i = 0; i < dataset.getNumEntries(); i++) {
+		entriesByBaseName.insert(make_pair(baseName(dataset.getFileName(i)), i));
+	}
+	matched.assign(dataset.getNumEntries(), 0);
+
+#ifdef USE_ZLIB
+	//gzread reads uncompressed files unchanged, so it handles plain tars too.
+	gzFileHandle = gzopen(archiveFile.c_str(), "rb");
+	if (gzFileHandle == NULL) {
+		cout << "Warning: Couldn't open archive " << archiveFile << endl;
+		atEnd = 1;
+	}
+#else
+	fileHandle = fopen(archiveFile.c_str(), "rb");
+	if (fileHandle == NULL) {
+		cout << "Warning: Couldn't open archive " << archiveFile << endl;
+		atEnd = 1;
+	} else {
+		int c1 = fgetc(fileHandle), c2 = fgetc(fileHandle);
+		if (c1 == 0x1f && c2 == 0x8b) {
+			cout << "Warning: " << archiveFile << " is gzip compressed, but NMPT was built without zlib. "
+			<< "Decompress it first, or rebuild with zlib." << endl;
+			fclose(fileHandle);
+			fileHandle = NULL;
+			atEnd = 1;
+		} else {
+			rewind(fileHandle);
+		}
+	}
+#endif
+}
+
+ArchiveImageSource2::~ArchiveImageSource2() {
+#ifdef USE_ZLIB
+	if (gzFileHandle != NULL) gzclose((gzFile)gzFileHandle);
+#endif
+	if (fileHandle != NULL) fclose(fileHandle);
+}
+
+int ArchiveImageSource2::isOpened() const {
+	return gzFileHandle != NULL || fileHandle != NULL;
+}
+
+int ArchiveImageSource2::readBytes(char *dest, size_t numBytes) {
+	size_t numRead = 0;
+	while (numRead < numBytes) {
+		size_t chunk = numBytes - numRead;
+		chunk = chunk > (1<<30) ? (1<<30) : chunk;
+		int n = 0;
+#ifdef USE_ZLIB
+		if (gzFileHandle != NULL) n = gzread((gzFile)gzFileHandle, dest+numRead, (unsigned)chunk);
+#else
+		if (fileHandle != NULL) n = fread(dest+numRead, 1, chunk, fileHandle);
+#endif
+		if (n <= 0) return 0;
+		numRead += n;
+	}
+	return 1;
+}
+
+int ArchiveImageSource2::skipBytes(size_t numBytes) {
+	char buffer[64*tarBlockSize];
+	while (numBytes > 0) {
+		size_t chunk = numBytes > sizeof(buffer) ? sizeof(buffer) : numBytes;
+		if (!readBytes(buffer, chunk)) return 0;
+		numBytes -= chunk;
+	}
+	return 1;
+}
+
+int ArchiveImageSource2::nextMember(string &name, vector<uchar> &data) {
+	string longName;
+	char header[tarBlockSize];
+	while (!atEnd) {
+		if (!readBytes(header, tarBlockSize)) {
+			atEnd = 1;
+			break;
+		}
+		if (header[0] == 0) { //An empty block marks the end of the archive.
+			atEnd = 1;
+			break;
+		}
+
+		size_t size = parseTarNumber(header+124, 12);
+		size_t padded = (size + tarBlockSize - 1)/tarBlockSize*tarBlockSize;
+		char type = header[156];
+
+		if (type == 'L' || type == 'x') {
+			//GNU long name, or pax extended header: names the next member.
+			vector<char> extra(padded+1, 0);
+			if (padded > 0 && !readBytes(&extra[0], padded)) {
+				atEnd = 1;
+				break;
+			}
+			if (type == 'L') {
+				longName = string(&extra[0], strnlen(&extra[0], size));
+			} else {
+				//Records are "<length> <key>=<value>\n".
+				size_t pos = 0;
+				while (pos < size) {
+					size_t recordLength = strtoul(&extra[pos], NULL, 10);
+					if (recordLength == 0 || pos + recordLength > size) break;
+					string record(&extra[pos], recordLength);
+					size_t space = record.find(' ');
+					if (space != string::npos && record.compare(space+1, 5, "path=") == 0)
+						longName = record.substr(space+6, record.size()-space-7);
+					pos += recordLength;
+				}
+			}
+			continue;
+		}
+
+		if (type != '0' && type != '\0' && type != '7') {
+			//Directories, links, and other non-file members.
+			longName.clear();
+			if (!skipBytes(padded)) atEnd = 1;
+			continue;
+		}
+
+		if (!longName.empty()) {
+			name = longName;
+		} else {
+			name = tarString(header, 100);
+			if (!memcmp(header+257, "ustar", 5) && header[345] != 0)
+				name = tarString(header+345, 155) + "/" + name;
+		}
+		while (name.compare(0, 2, "./") == 0) name = name.substr(2);
+
+		data.resize(size);
+		if ((size > 0 && !readBytes((char*)&data[0], size)) || !skipBytes(padded-size)) {
+			cout << "Warning: Archive ended in the middle of member " << name << endl;
+			atEnd = 1;
+			return 0;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+void ArchiveImageSource2::findEntries(const string &memberName, vector<int> &entries) const {
+	entries.clear();
+	typedef multimap<string, int>::const_iterator Iter;
+	pair<Iter, Iter> range = entriesByBaseName.equal_range(baseName(memberName));
+	for (Iter it = range.first; it != range.second; ++it) {
+		if (pathsMatch(dataset.getFileName(it->second), memberName)) entries.push_back(it->second);
+	}
+}
+
+int ArchiveImageSource2::readBatch() {
+	batchNames.clear();
+	batchEntries.clear();
+	batchImages.clear();
+	batchPosition = 0;
+
+	vector<vector<uchar> > data;
+	string name;
+	vector<uchar> memberData;
+	vector<int> entries;
+	while ((int)batchNames.size() < batchSize && nextMember(name, memberData)) {
+		if (!dataset.empty()) {
+			findEntries(name, entries);
+			if (entries.empty()) continue;
+		}
+		batchNames.push_back(name);
+		batchEntries.push_back(entries);
+		data.push_back(vector<uchar>());
+		data.back().swap(memberData);
+	}
+
+	batchImages.resize(data.size());
+	parallel_for_(Range(0, data.size()), ArchiveDecodeBody(data, batchImages));
+	return !batchNames.empty();
+}
+
+int ArchiveImageSource2::nextImage(string &memberName, Mat &image, vector<int> &entries) {
+	while (1) {
+		if (batchPosition == batchNames.size() && !readBatch()) return 0;
+		size_t j = batchPosition++;
+		if (batchImages[j].empty()) {
+			if (!dataset.empty()) cout << "Warning: Couldn't decode archive member " << batchNames[j] << endl;
+			continue;
+		}
+		memberName = batchNames[j];
+		image = batchImages[j];
+		entries = batchEntries[j];
+		batchImages[j].release();
+		for (size_t i = 0; i < entries.size(); i++) matched[entries[i]] = 1;
+		return 1;
+	}
+}
+
+vector<int> ArchiveImageSource2::getUnmatchedEntries() const {
+	vector<int> unmatched;
+	for (size_t i = 0; i < matched.size(); i++) {
+		if (!matched[i]) unmatched.push_back(i);
+	}
+	return unmatched;
+}
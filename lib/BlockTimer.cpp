@@ -74,13 +74,7 @@ timertype BlockTimer::getCurrentTimeInMicroseconds() {
 	gettimeofday(&tp, &tzp); 
 	now += ((timertype) tp.tv_sec)*1000000+(timertype)tp.tv_usec; 
 	
-	time_t rawtime;
-	struct tm * timeinfo;	
-	time ( &rawtime );
-	timeinfo = localtime ( &rawtime );
-	timertype numdays = timeinfo->tm_yday + 365*timeinfo->tm_year + (timeinfo->tm_year)/4; 
-	timertype microsecondsPerDay = 1440*60*1000000; 
-	now += numdays*microsecondsPerDay; 	
-	
+	//tv_sec already counts whole days. Adding the local day of the year on top made the time jump at 
+	//midnight (by a wrong amount, since the microseconds per day overflowed an int). 
     return now; 
 }
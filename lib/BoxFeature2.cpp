@@ -357,7 +357,7 @@ double BoxFeature2::evaluateImagePatch(const ImagePatch2 &patch) const{
 	if (_BOXFEATURE_DEBUG) cout << "Ratio is " << ratio << endl;
 	
 	Size integralSize = intmat.size(); 
-	int maxind = integralSize.width*integralSize.height; 
+	int maxind = (integralSize.height-1)*integralWidthStep+integralSize.width; //rows may be padded, e.g. in views
 	
 	for (int n = 0; n < numBoxes; n++) {
 		double s = weights.at<double>(0, n); 		
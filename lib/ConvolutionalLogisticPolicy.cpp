@@ -10,8 +10,12 @@
 #include <math.h>
 #include <opencv2/imgproc/imgproc_c.h>
 #include "ConvolutionalLogisticPolicy.h"
+#include "MultinomialObservationModel.h"
+#include "NMPTUtils.h"
+#include <algorithm>
 
 using namespace std; 
+using namespace cv; 
 
 ConvolutionalLogisticPolicy::ConvolutionalLogisticPolicy(CvSize gridSize) {
 	this->gridSize.width = gridSize.width; 
@@ -20,15 +24,17 @@ ConvolutionalLogisticPolicy::ConvolutionalLogisticPolicy(CvSize gridSize) {
 	softmaxGain = 300; 
 	boxSize = 5; 
 	actProb = cvCreateImage(cvSize(gridSize.width, gridSize.height), IPL_DEPTH_32F, 1);			
+	obsmodel = NULL; 
 }
 
-ConvolutionalLogisticPolicy::ConvolutionalLogisticPolicy(ConvolutionalLogisticPolicy* clpToCopy) {
+ConvolutionalLogisticPolicy::ConvolutionalLogisticPolicy(const ConvolutionalLogisticPolicy* clpToCopy) {
 	this->gridSize.width = clpToCopy->gridSize.width; 
 	this->gridSize.height = clpToCopy->gridSize.height; 
 	polnum = clpToCopy->polnum; 
 	softmaxGain = clpToCopy->softmaxGain; 
 	boxSize = clpToCopy->boxSize; 
 	actProb = cvCloneImage(clpToCopy->actProb);			
+	obsmodel = clpToCopy->obsmodel; 
 }
 
 
@@ -42,10 +48,31 @@ void ConvolutionalLogisticPolicy::addToStream(ostream& out) {
 	out << polnum << " " << softmaxGain << " " << boxSize << endl; 
 }
 
+void ConvolutionalLogisticPolicy::addToStreamBinary(ostream& out) {
+	double params[3] = {(double)polnum, softmaxGain, boxSize}; 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, params, sizeof(params)); 
+}
+
+int ConvolutionalLogisticPolicy::readFromStreamBinary(istream& in) {
+	double params[3]; 
+	if (!NMPTUtils::readChecksummedBlockFromStreamBinary(in, params, sizeof(params))) {
+		cout << "Warning: Corrupt policy parameters in binary model." << endl; 
+		return 0; 
+	}
+	polnum = cvRound(params[0]); 
+	softmaxGain = params[1]; 
+	boxSize = params[2]; 
+	return 1; 
+}
+
 void ConvolutionalLogisticPolicy::setPolicy(int policyNumber) {
 	this->polnum = policyNumber; 
 }
 
+void ConvolutionalLogisticPolicy::setObservationModel(const MultinomialObservationModel* model) {
+	obsmodel = model; 
+}
+
 void ConvolutionalLogisticPolicy::setHeuristicPolicyParameters(double softmaxGain, double boxSize) {
 	this->softmaxGain = softmaxGain; 
 	this->boxSize = boxSize; 
@@ -56,78 +83,116 @@ ConvolutionalLogisticPolicy::~ConvolutionalLogisticPolicy() {
 }
 
 CvPoint ConvolutionalLogisticPolicy::getFixationPoint(IplImage* currentBelief) {
+	return chooseFromScores(computeFixationScores(currentBelief)); 
+}
 
-	float targProb; 
-	float cum; 
+CvPoint ConvolutionalLogisticPolicy::getFixationPoint(IplImage* currentBelief, int numLikely, vector<CvPoint> &likely) {
+	Mat score = computeFixationScores(currentBelief); 
+	//Rank before choosing: the softmax gain is applied to actProb in place. 
+	rankFixationScores(score, numLikely, likely); 
+	return chooseFromScores(score); 
+}
+
+void ConvolutionalLogisticPolicy::getLikelyFixationPoints(IplImage* currentBelief, int numPoints, vector<CvPoint> &points) {
+	rankFixationScores(computeFixationScores(currentBelief), numPoints, points); 
+}
+
+Mat ConvolutionalLogisticPolicy::computeFixationScores(IplImage* currentBelief) {
 	switch (polnum) {
 		case FULL:
 			cerr << "FULL Convolutional Logistic Policies not yet implemented. Using Gaussian." << endl; 
 			polnum = GAUSSIAN; 
-			return getFixationPoint(currentBelief); 
+			return computeFixationScores(currentBelief); 
 		case BOX:
 			cvCopy(currentBelief, actProb); 
 			cvSmooth(actProb, actProb, CV_BLUR, boxSize,boxSize); 
-			cvScale(actProb, actProb, softmaxGain); 
-			cvExp(actProb, actProb); 
-			cvNormalize(actProb, actProb, 1, 0, CV_L1, NULL); 
-			targProb = randomFloat();  
-			cum = 0; 
-			for (int y = 0; y < actProb->height; y++) {
-				for (int x = 0; x < actProb->width; x++) {				
-					
-					cum = cum+cvGetReal2D(actProb, y, x); 
-					if (cum >= targProb) {
-						return cvPoint(x, y); 
-					}
-				}
-			}			
-			break;
+			return cvarrToMat(actProb); 
 		case GAUSSIAN:
 			cvCopy(currentBelief, actProb); 
 			cvSmooth(actProb, actProb, CV_GAUSSIAN, boxSize,boxSize); 
-			cvScale(actProb, actProb, softmaxGain); 
-			cvExp(actProb, actProb); 
-			cvNormalize(actProb, actProb, 1, 0, CV_L1, NULL); 
-			targProb = randomFloat();  
-			cum = 0; 
-			for (int y = 0; y < actProb->height; y++) {
-				for (int x = 0; x < actProb->width; x++) {				
-					
-					cum = cum+cvGetReal2D(actProb, y, x); 
-					if (cum >= targProb) {
-						return cvPoint(x, y); 
-					}
-				}
-			}			
-			break;
+			return cvarrToMat(actProb); 
 		case IMPULSE:
 			cvCopy(currentBelief, actProb); 
-			cvScale(actProb, actProb, softmaxGain); 
-			cvExp(actProb, actProb); 
-			cvNormalize(actProb, actProb, 1, 0, CV_L1, NULL); 
-			targProb = randomFloat();  
-			cum = 0; 
-			for (int y = 0; y < actProb->height; y++) {
-				for (int x = 0; x < actProb->width; x++) {				
-					
-					cum = cum+cvGetReal2D(actProb, y, x); 
-					if (cum >= targProb) {
-						return cvPoint(x, y); 
-					}
-				}
-			}			
+			return cvarrToMat(actProb); 
+		case INFOMAX: 
+			if (obsmodel == NULL) {
+				//Fall back for this fixation only, so the policy becomes INFOMAX again once
+				//an observation model is set. 
+				cerr << "INFOMAX policy needs an observation model. Using MAX." << endl; 
+				break; 
+			}
+			obsmodel->getExpectedInformationGain(currentBelief, infoGain); 
+			return infoGain; 
+		default:
 			break;
+	}
+	return cvarrToMat(currentBelief); 
+}
+
+CvPoint ConvolutionalLogisticPolicy::chooseFromScores(Mat score) {
+	switch (polnum) {
+		case BOX:
+		case GAUSSIAN:
+		case IMPULSE:
+			cvScale(actProb, actProb, softmaxGain); 
+			return sampleFromActivations(); 
 		case MAX:
-			double min, max; 
-			CvPoint min_loc, max_loc; 
-			cvMinMaxLoc( currentBelief, &min, &max, &min_loc, &max_loc );
-			return max_loc; 
+		case INFOMAX: 
+			{
+				Point best; 
+				minMaxLoc(score, NULL, NULL, NULL, &best); 
+				return best; 
+			}
 		default:
 			break;
 	}
 	return cvPoint(-1, -1); 
 }
 
+CvPoint ConvolutionalLogisticPolicy::sampleFromActivations() {
+	//Subtracting the largest activation before exponentiating keeps the softmax finite, however
+	//large softmaxGain is. 
+	Mat act = cvarrToMat(actProb); 
+	double min, max; 
+	minMaxLoc(act, &min, &max); 
+	subtract(act, Scalar(max), act); 
+	exp(act, act); 
+	sampler.setWeights(act); 
+	return resampleFixationPoint(); 
+}
+
+/* Orders cell indices by decreasing score. */
+struct CellScoreGreater {
+	const double* scores; 
+	CellScoreGreater(const double* scores) : scores(scores) {}
+	bool operator()(int a, int b) const { return scores[a] > scores[b] || (scores[a] == scores[b] && a < b); }
+}; 
+
+void ConvolutionalLogisticPolicy::rankFixationScores(Mat score, int numPoints, vector<CvPoint> &points) {
+	points.clear(); 
+	//The softmax and the gain only rescale activations monotonically, so rank the activations.
+	Mat flat; 
+	score.convertTo(flat, CV_64F); 
+	int numCells = flat.total(); 
+	numPoints = numPoints < numCells ? numPoints : numCells; 
+	if (numPoints <= 0) return; 
+	vector<int> order(numCells); 
+	for (int i = 0; i < numCells; i++) order[i] = i; 
+	partial_sort(order.begin(), order.begin()+numPoints, order.end(), CellScoreGreater(flat.ptr<double>())); 
+	for (int i = 0; i < numPoints; i++) points.push_back(cvPoint(order[i]%flat.cols, order[i]/flat.cols)); 
+}
+
+CvPoint ConvolutionalLogisticPolicy::resampleFixationPoint() {
+	int index = sampler.sample(randomFloat()); 
+	if (index < 0) return cvPoint(-1, -1); 
+	return cvPoint(index%actProb->width, index/actProb->width); 
+}
+
+void ConvolutionalLogisticPolicy::setFixationWeight(CvPoint gridPoint, double weight) {
+	if (sampler.size() != actProb->width*actProb->height) return; 
+	sampler.setWeight(gridPoint.y*actProb->width+gridPoint.x, weight); 
+}
+
 double ConvolutionalLogisticPolicy::getReward(IplImage* currentBelief) {
 	double reward = 0;  
 	for (int i = 0; i < gridSize.height; i++) {
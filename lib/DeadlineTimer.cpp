@@ -0,0 +1,107 @@
+#include "DeadlineTimer.h"
+
+using namespace std;
+
+DeadlineTimer::DeadlineTimer(int historyLength) :
+BlockTimer(2), historyLength(historyLength < 1 ? 1 : historyLength), nextFirstStep(0), nextLaterStep(0),
+budget(0), stepsThisFrame(0), stepRunning(0) {
+	resetStatistics();
+}
+
+void DeadlineTimer::startFrame(double budget) {
+	this->budget = budget;
+	stepsThisFrame = 0;
+	stepRunning = 0;
+	blockRestart(FRAME_BLOCK);
+}
+
+void DeadlineTimer::endFrame(int budgetWasBinding) {
+	double elapsed = getElapsedTime();
+	blockStop(FRAME_BLOCK);
+	numFrames++;
+	if (budgetWasBinding) numBindingFrames++;
+	if (elapsed > budget) numOverrunFrames++;
+	totalSteps += stepsThisFrame;
+	totalFrameTime += elapsed;
+}
+
+void DeadlineTimer::startStep() {
+	blockRestart(STEP_BLOCK);
+	stepRunning = 1;
+}
+
+void DeadlineTimer::stopStep() {
+	if (!stepRunning) return;
+	double cost = getCurrTime(STEP_BLOCK);
+	blockStop(STEP_BLOCK);
+	stepRunning = 0;
+
+	vector<double> &costs = stepsThisFrame == 0 ? firstStepCosts : laterStepCosts;
+	int &next = stepsThisFrame == 0 ? nextFirstStep : nextLaterStep;
+	if ((int)costs.size() < historyLength) costs.push_back(cost);
+	else costs[next] = cost;
+	next = (next+1) % historyLength;
+	stepsThisFrame++;
+}
+
+double DeadlineTimer::getElapsedTime() {
+	return getCurrTime(FRAME_BLOCK);
+}
+
+double DeadlineTimer::getRemainingTime() {
+	return budget - getElapsedTime();
+}
+
+double DeadlineTimer::predictNextStepCost() const {
+	//Until a step of this kind has been seen, steps of the other kind are the best guess.
+	const vector<double> &costs = stepsThisFrame == 0 ?
+	(firstStepCosts.empty() ? laterStepCosts : firstStepCosts) :
+	(laterStepCosts.empty() ? firstStepCosts : laterStepCosts);
+	double maxCost = 0;
+	for (size_t i = 0; i < costs.size(); i++) if (costs[i] > maxCost) maxCost = costs[i];
+	return maxCost;
+}
+
+int DeadlineTimer::canAffordNextStep() {
+	return getElapsedTime() + predictNextStepCost() <= budget;
+}
+
+int DeadlineTimer::getNumStepsThisFrame() const {
+	return stepsThisFrame;
+}
+
+int DeadlineTimer::getNumFrames() const {
+	return numFrames;
+}
+
+int DeadlineTimer::getNumBindingFrames() const {
+	return numBindingFrames;
+}
+
+int DeadlineTimer::getNumOverrunFrames() const {
+	return numOverrunFrames;
+}
+
+double DeadlineTimer::getMeanStepsPerFrame() const {
+	return numFrames > 0 ? (double)totalSteps/numFrames : 0;
+}
+
+double DeadlineTimer::getMeanFrameTime() const {
+	return numFrames > 0 ? totalFrameTime/numFrames : 0;
+}
+
+void DeadlineTimer::resetStatistics() {
+	numFrames = 0;
+	numBindingFrames = 0;
+	numOverrunFrames = 0;
+	totalSteps = 0;
+	totalFrameTime = 0;
+}
+
+void DeadlineTimer::printStatistics(ostream &out) const {
+	out << "Frames: " << numFrames
+	<< ", budget binding: " << numBindingFrames
+	<< ", budget exceeded: " << numOverrunFrames
+	<< ", mean steps per frame: " << getMeanStepsPerFrame()
+	<< ", mean time per frame: " << getMeanFrameTime()*1000 << " ms" << endl;
+}
@@ -10,6 +10,7 @@
 #include "DetectionEvaluator2.h"
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 #include "NMPTUtils.h"
 
 using namespace std;
@@ -106,62 +107,80 @@ vector<vector<Rect> > DetectionEvaluator2::getTargetLocations() const {
 	return targets; 
 }
 
+/* A detection of one image, for sorting the detections of all images together. */
+struct RankedDetection {
+	double value; 
+	int image; 
+	int box; 
+}; 
+
+static bool higherValue(const RankedDetection &a, const RankedDetection &b) {
+	return a.value > b.value; 
+}
+
 vector<EvaluationMetrics> DetectionEvaluator2::evaluatePerformance(const vector<vector<SearchResult> >& imBoxes) const {
+	int numImages = imBoxes.size(); 
 	vector<EvaluationMetrics> retval; 
-	retval.clear(); 
-	vector<vector<EvaluationMetrics> > ms; //ms is the list of threshold/performance for each image
-	ms.clear(); 
-	for (unsigned int i = 0; i < imBoxes.size(); i++) {
-		ms.push_back(evaluateImagePerformance(i, imBoxes[i])); 
-		/*
-		 cout << "Evaluated performance of Image " << i << endl; 
-		 for (unsigned int j = 0; j < ms[i].size(); j++) {
-		 cout << "For threshold " << ms[i][j].threshold << " there were " 
-		 << (1-ms[i][j].hit_ratio)*100 << "% misses (" << ms[i][j].num_hits 
-		 << " hits & " << ms[i][j].num_misses << " misses) and " << ms[i][j].num_false_alarms
-		 << " false alarms." << endl; 
-		 }
+	if (numImages == 0) return retval; 
 		 
-		 cout << "=========================================" << endl; 
-		 */
+	vector<RankedDetection> detections; 
+	vector<vector<char> > found(numImages); 
+	double totalTargets = 0; 
+	for (int i = 0; i < numImages; i++) {
+		found[i].assign(targets[i].size(), 0); 
+		totalTargets += targets[i].size(); 
+		for (size_t j = 0; j < imBoxes[i].size(); j++) {
+			RankedDetection d = {imBoxes[i][j].value, i, (int)j}; 
+			detections.push_back(d); 
+		}
 	}
-	//cout << "Evaluated thresholds for " << ms.size() << " images." << endl; 
-	for (unsigned int i = 0; i < ms.size(); i++) { //for each image
-		//cout << "In image " << i << " there are " << ms[i].size() << " thresholds." << endl; 
-		for (unsigned int j = 0; j < ms[i].size(); j++) { //for each threshold
-			EvaluationMetrics m; 
-			m.threshold = ms[i][j].threshold; 
-			m.num_hits = 0; 
-			m.num_misses = 0; 
-			m.num_false_alarms = 0; 
-			m.hit_ratio = 0; 
-			m.hits.clear(); 
-			m.misses.clear();
-			m.false_alarms.clear(); 
-			//get average performance over all images at that threshold
-			for (unsigned int k = 0; k < ms.size();  k++) {
-				EvaluationMetrics n = getPerformanceAtThreshold(ms[k], m.threshold); 
-				/*cout << "For image " << k << " with threshold " << m.threshold
-				 << " there were " << n.num_hits << " hits, " << n.num_misses 
-				 << " misses, " << n.num_false_alarms << " false alarms, and hr " 
-				 << n.hit_ratio << endl; */
-				m.num_hits = m.num_hits+n.num_hits; 
-				m.num_misses = m.num_misses+n.num_misses; 
-				m.num_false_alarms=m.num_false_alarms+n.num_false_alarms; 
-				m.hit_ratio = m.hit_ratio+n.hit_ratio; 
+	stable_sort(detections.begin(), detections.end(), higherValue); 
+	
+	//Lower the threshold past one group of equal-valued detections at a time,
+	//updating the summed counts of the images they belong to. Every detection
+	//in the group gets an entry, as each was a threshold of its own image. 
+	EvaluationMetrics m; 
+	double sumHits = 0, sumMisses = totalTargets, sumFalseAlarms = 0, sumHitRatio = 0; 
+	retval.reserve(detections.size()); 
+	size_t i = 0; 
+	while (i < detections.size()) {
+		size_t groupEnd = i; 
+		while (groupEnd < detections.size() && detections[groupEnd].value == detections[i].value) {
+			const RankedDetection &d = detections[groupEnd]; 
+			if (matchDetection(d.image, imBoxes[d.image][d.box].imageLocation, found[d.image]) >= 0) {
+				sumHits++; 
+				sumMisses--; 
+				sumHitRatio += 1.0/targets[d.image].size(); 
+			} else {
+				sumFalseAlarms++; 
 			}
-			m.num_hits = m.num_hits/ms.size(); 
-			m.num_misses = m.num_misses/ms.size(); 
-			m.num_false_alarms = m.num_false_alarms/ms.size(); 
-			m.hit_ratio=m.hit_ratio/ms.size(); 
-			retval.push_back(m); 
+			groupEnd++; 
 		}
+		m.threshold = detections[i].value; 
+		m.num_hits = sumHits/numImages; 
+		m.num_misses = sumMisses/numImages; 
+		m.num_false_alarms = sumFalseAlarms/numImages; 
+		m.hit_ratio = sumHitRatio/numImages; 
+		retval.insert(retval.end(), groupEnd-i, m); 
+		i = groupEnd; 
 	}
-	//cout << "In all, " << retval.size() << "thresholds were evaluated." << endl; 
-	sort(retval.begin(), retval.end()); 
+	reverse(retval.begin(), retval.end()); 
 	return retval; 
 }
 
+int DetectionEvaluator2::matchDetection(int imNum, const Rect &box, vector<char> &found) const {
+	//As the threshold drops, each new box goes to the first target, in target
+	//order, that it overlaps and that no higher-valued box has found. This is
+	//the same assignment evaluateImagePerformanceWithThreshold makes. 
+	for (size_t t = 0; t < targets[imNum].size(); t++) {
+		if (!found[t] && rectAreaOverlapRatio(targets[imNum][t], box) >= acceptArea) {
+			found[t] = 1; 
+			return t; 
+		}
+	}
+	return -1; 
+}
+
 EvaluationMetrics DetectionEvaluator2::getPerformanceAtThreshold(const vector<EvaluationMetrics>& ms, 
 																double threshold) const {
 	//ms is list of performance/threshold on a given image, and we want to know
@@ -199,16 +218,49 @@ EvaluationMetrics DetectionEvaluator2::getPerformanceAtThreshold(const vector<Ev
 }
 
 vector<EvaluationMetrics> DetectionEvaluator2::evaluateImagePerformance(int imNum, 
-																	   const vector<SearchResult>& boxes) const {
+																	   const vector<SearchResult>& boxes, 
+																	   int withRectangles) const {
+	vector<RankedDetection> detections(boxes.size()); 
+	for (size_t i = 0; i < boxes.size(); i++) {
+		RankedDetection d = {boxes[i].value, imNum, (int)i}; 
+		detections[i] = d; 
+	}
+	stable_sort(detections.begin(), detections.end(), higherValue); 
+	
+	vector<char> found(targets[imNum].size(), 0); 
+	EvaluationMetrics m; 
+	m.num_hits = 0; 
+	m.num_misses = targets[imNum].size(); 
+	m.num_false_alarms = 0; 
+	
 	vector<EvaluationMetrics> retval; 
-	for (unsigned int i = 0; i < boxes.size(); i++) {
-		EvaluationMetrics m = evaluateImagePerformanceWithThreshold(imNum, boxes, boxes[i].value); 
-		m.hits.clear(); 
-		m.misses.clear(); 
-		m.false_alarms.clear(); 
-		retval.push_back(m); 
+	retval.reserve(boxes.size()); 
+	size_t i = 0; 
+	while (i < detections.size()) {
+		size_t groupEnd = i; 
+		while (groupEnd < detections.size() && detections[groupEnd].value == detections[i].value) {
+			const Rect &box = boxes[detections[groupEnd].box].imageLocation; 
+			if (matchDetection(imNum, box, found) >= 0) {
+				m.num_hits++; 
+				m.num_misses--; 
+				if (withRectangles) m.hits.push_back(box); 
+			} else {
+				m.num_false_alarms++; 
+				if (withRectangles) m.false_alarms.push_back(box); 
+			}
+			groupEnd++; 
+		}
+		m.threshold = detections[i].value; 
+		m.hit_ratio = m.num_hits*1.0/targets[imNum].size(); 
+		if (withRectangles) {
+			m.misses.clear(); 
+			for (size_t t = 0; t < found.size(); t++) 
+				if (!found[t]) m.misses.push_back(targets[imNum][t]); 
+		}
+		retval.insert(retval.end(), groupEnd-i, m); 
+		i = groupEnd; 
 	}
-	sort(retval.begin(), retval.end()); 
+	reverse(retval.begin(), retval.end()); 
 	return retval; 
 }
 
@@ -269,6 +321,41 @@ string DetectionEvaluator2::outputOpenCVDescriptionFormatForHaarTraining() const
 }
 
 
+void DetectionEvaluator2::addToStreamBinary(ostream &out) const {
+	int size = fileNames.size(); 
+	out.write((char*)&size, sizeof(int)); 
+	for (int i = 0; i < size; i++) {
+		writeStringToStreamBinary(out, fileNames[i]); 
+		int numTargets = i < (int)targets.size() ? targets[i].size() : 0; 
+		out.write((char*)&numTargets, sizeof(int)); 
+		for (int j = 0; j < numTargets; j++) {
+			int r[4] = {targets[i][j].x, targets[i][j].y, targets[i][j].width, targets[i][j].height}; 
+			out.write((char*)r, 4*sizeof(int)); 
+		}
+	}
+}
+
+void DetectionEvaluator2::readFromStreamBinary(istream &in) {
+	int size = 0; 
+	in.read((char*)&size, sizeof(int)); 
+	fileNames.clear(); 
+	targets.clear(); 
+	for (int i = 0; i < size && in; i++) {
+		string fname; 
+		int numTargets = 0; 
+		readStringFromStreamBinary(in, fname); 
+		in.read((char*)&numTargets, sizeof(int)); 
+		vector<Rect> imTargets; 
+		for (int j = 0; j < numTargets && in; j++) {
+			int r[4] = {0, 0, 0, 0}; 
+			in.read((char*)r, 4*sizeof(int)); 
+			imTargets.push_back(Rect(r[0], r[1], r[2], r[3])); 
+		}
+		fileNames.push_back(fname); 
+		targets.push_back(imTargets); 
+	}
+}
+
 FileStorage& operator << (cv::FileStorage &fs, const DetectionEvaluator2 &rhs) {
 	fs << "{" << "empty" << rhs.empty(); 
 	if (!rhs.empty()) {
@@ -0,0 +1,80 @@
+/*
+ *  DiscreteSampler.cpp
+ *  OpenCV
+ *
+ */
+
+#include "DiscreteSampler.h"
+#include <iostream>
+
+using namespace std;
+using namespace cv;
+
+DiscreteSampler::DiscreteSampler() : topStep(0) {
+}
+
+void DiscreteSampler::setWeights(const Mat &newWeights) {
+	int n = newWeights.total();
+	weights.resize(n);
+	if (newWeights.depth() == CV_64F && newWeights.isContinuous()) {
+		const double* w = newWeights.ptr<double>();
+		weights.assign(w, w+n);
+	} else {
+		Mat w(newWeights.size(), CV_64FC1, n > 0 ? &weights[0] : NULL);
+		newWeights.convertTo(w, CV_64F);
+	}
+
+	//Each node holds the sum of the weights below it, so the tree builds in one pass.
+	tree.assign(n+1, 0);
+	for (int i = 1; i <= n; i++) {
+		tree[i] += weights[i-1];
+		int parent = i + (i & -i);
+		if (parent <= n) tree[parent] += tree[i];
+	}
+	for (topStep = 1; topStep*2 <= n; topStep *= 2) {}
+	if (n == 0) topStep = 0;
+}
+
+void DiscreteSampler::setWeight(int index, double weight) {
+	if (index < 0 || index >= (int)weights.size()) {
+		cout << "Warning: DiscreteSampler index " << index << " is out of range." << endl;
+		return;
+	}
+	double delta = weight - weights[index];
+	weights[index] = weight;
+	for (int i = index+1; i < (int)tree.size(); i += i & -i) tree[i] += delta;
+}
+
+double DiscreteSampler::getWeight(int index) const {
+	return weights[index];
+}
+
+double DiscreteSampler::getTotal() const {
+	double total = 0;
+	for (int i = weights.size(); i > 0; i -= i & -i) total += tree[i];
+	return total;
+}
+
+int DiscreteSampler::size() const {
+	return weights.size();
+}
+
+int DiscreteSampler::sample(double u) const {
+	int n = weights.size();
+	double total = getTotal();
+	if (n == 0 || !(total > 0)) return -1;
+
+	//Descend the tree, skipping every block whose weight lies below the target.
+	double target = u*total;
+	int pos = 0;
+	for (int step = topStep; step > 0; step /= 2) {
+		if (pos+step <= n && tree[pos+step] <= target) {
+			pos += step;
+			target -= tree[pos];
+		}
+	}
+	//Rounding can carry the target past the end, or onto a cell with no weight.
+	if (pos >= n) pos = n-1;
+	while (pos > 0 && weights[pos] <= 0) pos--;
+	return pos;
+}
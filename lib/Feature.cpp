@@ -10,7 +10,6 @@
 #include "Feature.h"
 #include "BoxFeature.h"
 #include "HaarFeature.h"
-#include "BlockTimer.h"
 #include "DebugGlobals.h"
 #include "NMPTUtils.h"
 
@@ -45,7 +44,8 @@ Feature::Feature(Size expectedPatchSize) {
 	prefersIntegral = 0; 
 	featureName = (char*)malloc(128*sizeof(char)); 
 	snprintf(featureName, 128*sizeof(char), "Feature"); 
-	rng = cvRNG(BlockTimer::getCurrentTimeInMicroseconds());
+	//Random parameters are drawn from cv::theRNG(), as in Feature2, so that 
+	//training snapshots can save and restore the random state. 
 }
 
 Feature::~Feature() {
@@ -70,7 +70,7 @@ vector<Feature*> Feature::getSimilarFeatures(int numFeatures) {
 		cvSub(maxParamVals, minParamVals, scratch); //get range
 		do {
 			if (_FEATURE_DEBUG) cout<< "Getting random features." << endl; 
-			cvRandArr(&rng, change, CV_RAND_NORMAL, 
+			cvRandArr(&theRNG().state, change, CV_RAND_NORMAL, 
 					  cvRealScalar(0), cvRealScalar(1)); 
 			if (_FEATURE_DEBUG) cout<< "Scaling features." << endl; 
 			cvMul(change, scratch, change, 0.05); //scale each change
@@ -100,7 +100,7 @@ void Feature::setRandomParameterValues() {
 	if (_FEATURE_DEBUG) cout<< "Getting range." << endl; 
 	cvSub(maxParamVals, minParamVals, scratch); //get range
 	if (_FEATURE_DEBUG) cout<< "Getting Random Array." << endl; 
-	cvRandArr(&rng, change, CV_RAND_UNI, 
+	cvRandArr(&theRNG().state, change, CV_RAND_UNI, 
 			  cvRealScalar(0), cvRealScalar(1)); 
 	
 	if (_FEATURE_DEBUG) cout<< "Making random values suitable." << endl; 
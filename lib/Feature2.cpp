@@ -112,6 +112,14 @@ Size Feature2::getPatchSize() const {
 	return patchSize; 
 } 
 
+string Feature2::getFeatureName() const {
+	return featureName; 
+}
+
+const Mat Feature2::getFeatureParameters() const {
+	return parameters; 
+} 
+
 void Feature2::getFeatureVisualization(Mat &dest) const{
 	dest = kernel.clone(); 
 }
@@ -240,6 +248,28 @@ Feature2* Feature2::readFromFile(const cv::FileNode &fs) {
 }
 
 
+Feature2* Feature2::readFromStreamBinary(istream &in) {
+	string name; 
+	Size size; 
+	Mat params; 
+	readStringFromStreamBinary(in, name); 
+	in.read((char*)&size.width, sizeof(int)); 
+	in.read((char*)&size.height, sizeof(int)); 
+	readMatFromStreamBinary(in, params); 
+	if (!in) return NULL; 
+	
+	Feature2* rhs = Feature2::getFeatureOfType(name, size); 
+	if (rhs != NULL) rhs->setFeatureParameters(params); 
+	return rhs; 
+}
+
+void Feature2::addToStreamBinary(ostream &out) const {
+	writeStringToStreamBinary(out, featureName); 
+	out.write((char*)&patchSize.width, sizeof(int)); 
+	out.write((char*)&patchSize.height, sizeof(int)); 
+	writeMatToStreamBinary(out, parameters); 
+}
+
 void Feature2::writeToFile(cv::FileStorage & fs, const string &varname) const {
 	if (_FEATURE_DEBUG) std::cout << "Adding Feature to Storage" << std::endl; 
 	fs << varname << "{" << "name" << featureName << "size_w" << patchSize.width
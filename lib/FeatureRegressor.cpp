@@ -90,38 +90,7 @@ void FeatureRegressor::train(int numTableElements, const vector<ImagePatch> &dat
 	
 	Mat vals ; 
 	patchFeature->evaluateImagePatches(data, vals); 
-	
-	minMaxLoc(vals, &lookUpTableMin, &lookUpTableMax); 
-	
-	if (_REGRESSOR_DEBUG) cout << "Look Up Table Min: " << lookUpTableMin << " ; Max: " << lookUpTableMax << endl; 
-	
-	if (lookUpTableMax - lookUpTableMin <= 0) {
-		if (_REGRESSOR_DEBUG) cout << "Set LUT to NULL" << endl; 
-		lookUpTable = Mat(); 
-		return; 
-	}
-	
-	Mat bins(numTableElements, 1, CV_64F); 
-	
-	for (int i = 0; i < numTableElements; i++) {
-		bins.at<double>( i, 0) = i*1.0/(numTableElements-1)*(lookUpTableMax - lookUpTableMin)+lookUpTableMin; 
-	}
-	
-	if (_REGRESSOR_DEBUG) cout << "Filling lookup table with RBF values." << endl; 
-	
-	lookUpTable = NMPTUtils::RBF(vals, labels, dataWeights, bins, 
-					  (lookUpTableMax-lookUpTableMin)*TAU, EPS).clone();
-	
-	lookUpTable.setTo(-1.,lookUpTable < -1); 
-	lookUpTable.setTo(1.,lookUpTable > 1); 
-	
-	if (_REGRESSOR_DEBUG) {
-		cout << "Look Up Table vals: " << endl; 
-		NMPTUtils::printMat(lookUpTable.t()); 
-	}
-	if (_REGRESSOR_DEBUG) cout << "Finished FeatureRegressor train." << endl; 
-	
-	
+	trainOnFeatureValues(numTableElements, vals, labels, dataWeights); 
 }
 
 void FeatureRegressor::train(int numTableElements, const vector<ImagePatch*> &data, const cv::Mat &labels, const cv::Mat &dataWeights) {
@@ -132,7 +101,14 @@ void FeatureRegressor::train(int numTableElements, const vector<ImagePatch*> &da
 	
 	Mat vals ; 
 	patchFeature->evaluateImagePatches(data, vals); 
+	trainOnFeatureValues(numTableElements, vals, labels, dataWeights); 
+}
 	
+void FeatureRegressor::evaluateFeature(const vector<ImagePatch*> &data, Mat &vals) {
+	patchFeature->evaluateImagePatches(data, vals); 
+}
+
+void FeatureRegressor::trainOnFeatureValues(int numTableElements, const Mat &vals, const Mat &labels, const Mat &dataWeights) {
 	minMaxLoc(vals, &lookUpTableMin, &lookUpTableMax); 
 	
 	if (_REGRESSOR_DEBUG) cout << "Look Up Table Min: " << lookUpTableMin << " ; Max: " << lookUpTableMax << endl; 
@@ -162,8 +138,6 @@ void FeatureRegressor::train(int numTableElements, const vector<ImagePatch*> &da
 		NMPTUtils::printMat(lookUpTable.t()); 
 	}
 	if (_REGRESSOR_DEBUG) cout << "Finished FeatureRegressor train." << endl; 
-	
-	
 }
 
 void FeatureRegressor::combineLUTs(const FeatureRegressor *other) {
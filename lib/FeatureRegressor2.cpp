@@ -22,6 +22,8 @@ double FeatureRegressor2::EPS = .001;
 
 FeatureRegressor2::FeatureRegressor2() {
 	patchFeature = NULL; 
+	lookUpTableMin = 0; 
+	lookUpTableMax = 0; 
 }
 
 FeatureRegressor2::FeatureRegressor2(const Feature2* feature) {
@@ -50,9 +52,13 @@ FeatureRegressor2::FeatureRegressor2(const FeatureRegressor2 &rhs) {
 }
 
 void FeatureRegressor2::setFeature(const Feature2* feature) {
-	if (patchFeature != NULL) delete (patchFeature); 
-	patchFeature = feature->copy(); 
-	if (_REGRESSOR_DEBUG) {
+	adoptFeature(feature == NULL ? NULL : feature->copy()); 
+}
+
+void FeatureRegressor2::adoptFeature(Feature2* feature) {
+	if (patchFeature != NULL && patchFeature != feature) delete (patchFeature); 
+	patchFeature = feature; 
+	if (_REGRESSOR_DEBUG && feature != NULL) {
 		cout << feature->debugInfo(); 
 	}
 	lookUpTableMin = 0; 
@@ -77,6 +83,19 @@ double FeatureRegressor2::getLUTRange() const {
 	return lookUpTableMax-lookUpTableMin; 
 }
 
+void FeatureRegressor2::getLUT(double &minVal, double &maxVal, Mat &lut) const {
+	minVal = lookUpTableMin; 
+	maxVal = lookUpTableMax; 
+	lut = lookUpTable; 
+}
+
+void FeatureRegressor2::setLUT(double minVal, double maxVal, const Mat &lut) {
+	CV_Assert(lut.empty() || (lut.type() == CV_64FC1 && lut.cols == 1)); 
+	lookUpTableMin = minVal; 
+	lookUpTableMax = maxVal; 
+	lookUpTable = lut; 
+}
+
 void FeatureRegressor2::train(int numTableElements, const vector<ImagePatch2> &data, const cv::Mat &labels, const cv::Mat &dataWeights) {
 	
 	/* input: NxM, N data points, M Dims*/	 
@@ -96,16 +115,45 @@ void FeatureRegressor2::train(int numTableElements, const vector<ImagePatch2> &d
 		return; 
 	}
 	
+	Mat numerator, denominator; 
+	getLUTStatistics(numTableElements, vals, labels, dataWeights, 
+					 lookUpTableMin, lookUpTableMax, numerator, denominator); 
+	setLUTFromStatistics(lookUpTableMin, lookUpTableMax, numerator, denominator); 
+	
+	if (_REGRESSOR_DEBUG) cout << "Finished FeatureRegressor train." << endl; 
+	
+	
+}
+
+void FeatureRegressor2::getLUTStatistics(int numTableElements, const Mat &vals, const Mat &labels, 
+										 const Mat &dataWeights, double minVal, double maxVal, 
+										 Mat &numerator, Mat &denominator) {
 	Mat bins(numTableElements, 1, CV_64F); 
 	
 	for (int i = 0; i < numTableElements; i++) {
-		bins.at<double>( i, 0) = i*1.0/(numTableElements-1)*(lookUpTableMax - lookUpTableMin)+lookUpTableMin; 
+		bins.at<double>( i, 0) = i*1.0/(numTableElements-1)*(maxVal - minVal)+minVal; 
+	}
+	
+	if (_REGRESSOR_DEBUG) cout << "Accumulating RBF statistics for lookup table." << endl; 
+	
+	NMPTUtils::RBFSums(vals, labels, dataWeights, bins, (maxVal-minVal)*TAU, EPS, 
+					   numerator, denominator); 
+}
+
+void FeatureRegressor2::setLUTFromStatistics(double minVal, double maxVal, 
+											 const Mat &numerator, const Mat &denominator) {
+	lookUpTableMin = minVal; 
+	lookUpTableMax = maxVal; 
+	
+	if (lookUpTableMax - lookUpTableMin <= 0 || numerator.empty()) {
+		if (_REGRESSOR_DEBUG) cout << "Set LUT to NULL" << endl; 
+		lookUpTable = Mat(); 
+		return; 
 	}
 	
 	if (_REGRESSOR_DEBUG) cout << "Filling lookup table with RBF values." << endl; 
 	
-	lookUpTable = NMPTUtils::RBF(vals, labels, dataWeights, bins, 
-								 (lookUpTableMax-lookUpTableMin)*TAU, EPS).clone();
+	lookUpTable = NMPTUtils::RBFFromSums(numerator, denominator); 
 	
 	lookUpTable.setTo(-1.,lookUpTable < -1); 
 	lookUpTable.setTo(1.,lookUpTable > 1); 
@@ -114,9 +162,6 @@ void FeatureRegressor2::train(int numTableElements, const vector<ImagePatch2> &d
 		cout << "Look Up Table vals: " << endl; 
 		NMPTUtils::printMat(lookUpTable.t()); 
 	}
-	if (_REGRESSOR_DEBUG) cout << "Finished FeatureRegressor train." << endl; 
-	
-	
 }
 
 void FeatureRegressor2::combineLUTs(const FeatureRegressor2 &other) {
@@ -276,6 +321,22 @@ istream& operator>> (istream& ifs, FeatureRegressor2 &model) {
 }
 
 
+void FeatureRegressor2::addToStreamBinary(ostream &out) const {
+	out.write((char*)&lookUpTableMin, sizeof(double)); 
+	out.write((char*)&lookUpTableMax, sizeof(double)); 
+	NMPTUtils::writeMatToStreamBinary(out, lookUpTable); 
+	patchFeature->addToStreamBinary(out); 
+}
+
+int FeatureRegressor2::readFromStreamBinary(istream &in) {
+	in.read((char*)&lookUpTableMin, sizeof(double)); 
+	in.read((char*)&lookUpTableMax, sizeof(double)); 
+	NMPTUtils::readMatFromStreamBinary(in, lookUpTable); 
+	if (patchFeature != NULL) delete(patchFeature); 
+	patchFeature = Feature2::readFromStreamBinary(in); 
+	return patchFeature != NULL && !in.fail(); 
+}
+
 cv::FileStorage& operator << (cv::FileStorage &fs, const FeatureRegressor2 &rhs) {
 	if (_REGRESSOR_DEBUG) cout << "Writing regressor to storage" << endl; 
 	fs << "{" << "min" << rhs.lookUpTableMin << "max" << rhs.lookUpTableMax 
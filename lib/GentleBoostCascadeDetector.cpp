@@ -0,0 +1,112 @@
+/*
+ *  GentleBoostCascadeDetector.cpp
+ *  OpenCV
+ *
+ */
+
+#include "GentleBoostCascadeDetector.h"
+#include <fstream>
+
+using namespace std;
+using namespace cv;
+
+const char* GentleBoostCascadeDetector::streamTag = "GentleBoostCascadeDetector";
+
+GentleBoostCascadeDetector::GentleBoostCascadeDetector() : threshold(0), lastFrameData(NULL) {
+}
+
+GentleBoostCascadeDetector::GentleBoostCascadeDetector(const char* filename, double threshold) :
+threshold(threshold), lastFrameData(NULL) {
+	setDetectorSource(filename);
+}
+
+GentleBoostCascadeDetector::GentleBoostCascadeDetector(GentleBoostCascadeDetector* detectorToCopy) :
+filename(detectorToCopy->filename), threshold(detectorToCopy->threshold),
+classifier(detectorToCopy->classifier), lastFrameData(NULL) {
+	if (!classifier.empty()) {
+		frameList = classifier->createSearchPatchList();
+		imageList = classifier->createSearchPatchList();
+	}
+}
+
+GentleBoostCascadeDetector::~GentleBoostCascadeDetector() {
+}
+
+void GentleBoostCascadeDetector::setDetectorSource(string newFileName) {
+	filename = newFileName;
+	classifier.release();
+	frameList.release();
+	imageList.release();
+	lastFrameData = NULL;
+
+	ifstream in(filename.c_str());
+	if (!in.is_open()) {
+		cout << "WARNING: Could not find object detector file " << newFileName << ".\n--->Call setDetectorSource() with a new cascade." << endl;
+		return;
+	}
+	GentleBoostCascadedClassifier* loaded = new GentleBoostCascadedClassifier();
+	in >> loaded;
+	in.close();
+	classifier = loaded;
+	frameList = classifier->createSearchPatchList();
+	imageList = classifier->createSearchPatchList();
+}
+
+void GentleBoostCascadeDetector::setThreshold(double threshold) {
+	this->threshold = threshold;
+}
+
+ObjectDetector* GentleBoostCascadeDetector::clone() {
+	return new GentleBoostCascadeDetector(this);
+}
+
+vector<Rect> GentleBoostCascadeDetector::detectObjects(IplImage* image) {
+	vector<Rect> objects;
+	if (classifier.empty()) return objects;
+
+	vector<SearchResult> results;
+	classifier->searchImage(cvarrToMat(image), imageList, results, 0, threshold);
+	for (size_t i = 0; i < results.size(); i++) objects.push_back(results[i].imageLocation);
+	return objects;
+}
+
+vector<Rect> GentleBoostCascadeDetector::detectObjectsInRegion(IplImage* frame, CvRect region,
+															   IplImage* scaledRegion, int newFrame) {
+	vector<Rect> objects;
+	if (classifier.empty() || region.width <= 0 || region.height <= 0) return objects;
+
+	Size frameSize(frame->width, frame->height);
+	if (newFrame || lastFrameData != frame->imageData || lastFrameSize != frameSize) {
+		frameList->setImage(cvarrToMat(frame));
+		lastFrameData = frame->imageData;
+		lastFrameSize = frameSize;
+	}
+
+	//An object the size of the base patch in the scaled down region is this
+	//large in the frame.
+	double scaleX = (double)region.width/scaledRegion->width;
+	double scaleY = (double)region.height/scaledRegion->height;
+	Size basePatchSize = classifier->getBasePatchSize();
+	Size minSize(cvCeil(basePatchSize.width*scaleX), cvCeil(basePatchSize.height*scaleY));
+
+	vector<SearchResult> results;
+	classifier->searchRegionOfPatchList(frameList, region, results, minSize, Size(0,0), threshold);
+	for (size_t i = 0; i < results.size(); i++) {
+		Rect r = results[i].imageLocation;
+		objects.push_back(Rect(cvRound((r.x-region.x)/scaleX), cvRound((r.y-region.y)/scaleY),
+							   cvRound(r.width/scaleX), cvRound(r.height/scaleY)));
+	}
+	return objects;
+}
+
+void GentleBoostCascadeDetector::readFromStream(istream& in) {
+	string name;
+	in >> name;
+	if (name == streamTag) in >> name;
+	in >> threshold;
+	setDetectorSource(name);
+}
+
+void GentleBoostCascadeDetector::addToStream(ostream& out) {
+	out << streamTag << " " << filename << " " << threshold << endl;
+}
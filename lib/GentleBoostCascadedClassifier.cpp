@@ -9,11 +9,17 @@
 
 #include "GentleBoostCascadedClassifier.h"
 #include <list>
+#include <set>
 #include "BlockTimer.h"
 #include "DebugGlobals.h"
 #include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
 #include "HaarFeature.h"
 #include "NMPTUtils.h"
+#include "ImageCache2.h"
 #include <opencv2/highgui/highgui_c.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -29,31 +35,47 @@ void GentleBoostCascadedClassifier::searchCurrentImageAtScale(vector<SearchResul
 															  vector<Rect> blacklistPatches,
 															  int spatialRadius, 
 															  int scaleRadius)  {	
+	searchPatchListAtScale(patchlist, keptPatches, scale, NMSRadius, threshold, blacklistPatches, 
+						   spatialRadius, scaleRadius); 
+}
+
+void GentleBoostCascadedClassifier::applyFeaturesToPatchList(PatchList* list) {
+	if (_CASCADE_DEBUG) cout << list->getCurrentListLength() << " remaining patches." << endl; 
+	for (int i = 0; i < numFeatures; i++) {
+		if (_CASCADE_DEBUG) cout << "Applying feature " << i << endl; 
+		features[i]->predictPatchList(list); 
+		
+		if (_CASCADE_DEBUG) cout << "Removing Patches" << endl; 
+		list->accumulateAndRemovePatchesBelowThreshold(featureRejectThresholds[i]); 
+		if (_CASCADE_DEBUG) cout << list->getCurrentListLength() << " remaining patches." << endl; 
+	}
+}
+
+void GentleBoostCascadedClassifier::searchPatchListAtScale(PatchList* list, 
+														   vector<SearchResult>& keptPatches, 
+														   int scale, 
+														   int NMSRadius, 
+														   double threshold,
+														   const vector<Rect> &blacklistPatches,
+														   int spatialRadius, 
+														   int scaleRadius)  {	
 	keptPatches.clear(); 
 	
-	if (scale < 0 || scale >= patchlist->getNumScales()) return; 
+	if (scale < 0 || scale >= list->getNumScales()) return; 
 	
 	
 	//patchlist->setImage(gray_image); 	
 	
 	if (_CASCADE_DEBUG) cout << "Searching image at scale " << scale << endl;
-	patchlist->resetListToScale(scale);
+	list->resetListToScale(scale);
 	
-	if (_CASCADE_DEBUG) cout << patchlist->getCurrentListLength() << " remaining patches." << endl; 
-	for (int i = 0; i < numFeatures; i++) {
-		if (_CASCADE_DEBUG) cout << "Applying feature " << i << endl; 
-		features[i]->predictPatchList(patchlist); 
-		
-		if (_CASCADE_DEBUG) cout << "Removing Patches" << endl; 
-		patchlist->accumulateAndRemovePatchesBelowThreshold(featureRejectThresholds[i]); 
-		if (_CASCADE_DEBUG) cout << patchlist->getCurrentListLength() << " remaining patches." << endl; 
-	}
+	applyFeaturesToPatchList(list); 
 	
-	if (NMSRadius > 0)	patchlist->keepOnlyLocalMaxima(NMSRadius); 
+	if (NMSRadius > 0)	list->keepOnlyLocalMaxima(NMSRadius); 
 	
 	vector<SearchResult> scalePatches; 
 	if (_CASCADE_DEBUG) cout << "Getting remaining patches." << endl; 
-	patchlist->getRemainingPatches(scalePatches, blacklistPatches, spatialRadius, scaleRadius);
+	list->getRemainingPatches(scalePatches, blacklistPatches, spatialRadius, scaleRadius);
 	
 	for (unsigned int i = 0; i < scalePatches.size(); i++) {
 		if (scalePatches[i].value > threshold) {
@@ -65,8 +87,8 @@ void GentleBoostCascadedClassifier::searchCurrentImageAtScale(vector<SearchResul
 	reverse(keptPatches.begin(), keptPatches.end());	
 	
 	if (_CASCADE_DEBUG) cout << "Image search at scale " << scale << " kept " 
-		<< keptPatches.size() << "/" << patchlist->getTotalPatches() << "(" 
-		<< 100.0*keptPatches.size()/patchlist->getTotalPatches() << "%)"<< endl; 
+		<< keptPatches.size() << "/" << list->getTotalPatches() << "(" 
+		<< 100.0*keptPatches.size()/list->getTotalPatches() << "%)"<< endl; 
 }
 
 
@@ -156,15 +178,28 @@ void GentleBoostCascadedClassifier::searchImage(const Mat &gray_image,
 												vector<Rect> blacklistPatches,
 												int spatialRadius, 
 												int scaleRadius) {
+	setCurrentImage(gray_image); 
+	searchAllScalesOfPatchList(patchlist, keptPatches, NMSRadius, threshold, blacklistPatches, 
+							   !disableNMSAcrossScales); 
+	
+	cout << "Image search kept " << keptPatches.size() << "/" << patchlist->getTotalPatches() <<
+	"(" << 100.0*keptPatches.size()/patchlist->getTotalPatches() << "%)"<< endl; 
+}
+
+void GentleBoostCascadedClassifier::searchAllScalesOfPatchList(PatchList* list, 
+															   vector<SearchResult>& keptPatches, 
+															   int NMSRadius, 
+															   double threshold,
+															   const vector<Rect> &blacklistPatches,
+															   bool suppressAcrossScales) {
 	keptPatches.clear(); 
 	vector<SearchResult> scalePatches; 
 	vector<Point> centers; 
 	vector<unsigned int>nextScaleStart; 
 		
-	setCurrentImage(gray_image); 
 //#pragma omp parallel for
-	for (int j = 0; j < patchlist->getNumScales(); j++) {
-		searchCurrentImageAtScale(scalePatches, j, NMSRadius, threshold, blacklistPatches); 
+	for (int j = 0; j < list->getNumScales(); j++) {
+		searchPatchListAtScale(list, scalePatches, j, NMSRadius, threshold, blacklistPatches); 
 		
 		for (unsigned int i = 0; i < scalePatches.size(); i++) {
 			if (scalePatches[i].value > threshold) {
@@ -177,15 +212,12 @@ void GentleBoostCascadedClassifier::searchImage(const Mat &gray_image,
 	}
 	
 	
-	if (NMSRadius > 0 && !disableNMSAcrossScales) {
+	if (NMSRadius > 0 && suppressAcrossScales) {
 		suppressLocalNonMaximaAcrossScales(keptPatches, NMSRadius, centers, nextScaleStart); 
 	}
 	
 	sort(keptPatches.begin(), keptPatches.end()); 
 	reverse(keptPatches.begin(), keptPatches.end()); 
-	
-	cout << "Image search kept " << keptPatches.size() << "/" << patchlist->getTotalPatches() <<
-	"(" << 100.0*keptPatches.size()/patchlist->getTotalPatches() << "%)"<< endl; 
 }
 
 
@@ -207,6 +239,57 @@ void GentleBoostCascadedClassifier::searchImage(const cv::Mat &gray_image,
 	
 }
 
+void GentleBoostCascadedClassifier::searchImage(const Mat &gray_image, 
+												PatchList* list, 
+												vector<SearchResult>& keptPatches, 
+												int NMSRadius, 
+												double threshold) {
+	keptPatches.clear(); 
+	if (features.size() == 0) {
+		cout << "Warning: Must have at least one feature before supplying an image to search." << endl; 
+		return; 
+	}
+	vector<Rect> blacklistPatches; 
+	list->setImage(gray_image); 
+	searchAllScalesOfPatchList(list, keptPatches, NMSRadius, threshold, blacklistPatches, 
+							   !disableNMSAcrossScales); 
+}
+
+void GentleBoostCascadedClassifier::searchRegionOfPatchList(PatchList* list, 
+															Rect region, 
+															vector<SearchResult>& keptPatches, 
+															Size minSize, 
+															Size maxSize, 
+															double threshold) {
+	keptPatches.clear(); 
+	if (features.size() == 0) {
+		cout << "Warning: Must have at least one feature before supplying an image to search." << endl; 
+		return; 
+	}
+	if (maxSize.width <= 0 || maxSize.height <= 0) maxSize = region.size(); 
+	
+	vector<SearchResult> scalePatches; 
+	for (int j = 0; j < list->getNumScales(); j++) {
+		Size patchSize = list->getPatchSizeAtScale(j); 
+		if (patchSize.width < minSize.width || patchSize.height < minSize.height 
+			|| patchSize.width > maxSize.width || patchSize.height > maxSize.height) continue; 
+		
+		list->resetListToScale(j, region); 
+		if (list->getCurrentListLength() == 0) continue; 
+		applyFeaturesToPatchList(list); 
+		
+		list->getRemainingPatches(scalePatches); 
+		for (unsigned int i = 0; i < scalePatches.size(); i++) {
+			if (scalePatches[i].value > threshold) {
+				keptPatches.push_back(scalePatches[i]); 
+			}
+		}
+	}
+	
+	sort(keptPatches.begin(), keptPatches.end()); 
+	reverse(keptPatches.begin(), keptPatches.end()); 
+}
+
 void GentleBoostCascadedClassifier::setSearchParams(int useFast,
 													Size minSize, 
 													Size maxSize,	
@@ -214,13 +297,28 @@ void GentleBoostCascadedClassifier::setSearchParams(int useFast,
 													double stepWidth, 
 													int scaleStepWidth) {
 	if (patchlist != NULL) delete(patchlist); 
-	if (useFast) {
-		patchlist = new FastPatchList(minSize, maxSize, scaleInc, stepWidth, basePatchSize, scaleStepWidth); 
+	searchUseFast = useFast; 
+	searchMinSize = minSize; 
+	searchMaxSize = maxSize; 
+	searchScaleInc = scaleInc; 
+	searchStepWidth = stepWidth; 
+	searchScaleStepWidth = scaleStepWidth; 
+	patchlist = createSearchPatchList(); 
+}
+
+PatchList* GentleBoostCascadedClassifier::createSearchPatchList() const {
+	if (searchUseFast) {
+		return new FastPatchList(searchMinSize, searchMaxSize, searchScaleInc, searchStepWidth, 
+								 basePatchSize, searchScaleStepWidth); 
 	} else {
-		patchlist = new PatchList(minSize, maxSize, scaleInc, stepWidth, basePatchSize); 
+		return new PatchList(searchMinSize, searchMaxSize, searchScaleInc, searchStepWidth, basePatchSize); 
 	}
 }
 
+void GentleBoostCascadedClassifier::setBGMiningBatchSize(int numImages) {
+	bgMiningBatchSize = numImages < 0 ? 0 : numImages; 
+}
+
 void GentleBoostCascadedClassifier::setBGTrainingFromImageDataset(const string &datasetFileName){
 	if (negImageDataset != NULL) delete(negImageDataset); 
 	negImageDataset = ImageDataSet::loadFromFile(datasetFileName); 	
@@ -275,8 +373,45 @@ int GentleBoostCascadedClassifier::updateSurvivalStats() {
 }
 
 
+/**
+ * Reads and searches one batch of background images, one image per task. 
+ * Each task owns its PatchList, which keeps the image pyramid around so that
+ * the collector can copy out patch pixels afterwards. 
+ */
+class BGImageMiningBody : public ParallelLoopBody {
+public:
+	BGImageMiningBody(GentleBoostCascadedClassifier* booster, 
+					  const vector<string> &fileNames, 
+					  const vector<vector<Rect> > &blackoutLists, 
+					  const vector<PatchList*> &lists, 
+					  vector<vector<SearchResult> > &results, 
+					  int NMSRadius) : 
+	booster(booster), fileNames(fileNames), blackoutLists(blackoutLists), 
+	lists(lists), results(results), NMSRadius(NMSRadius) {}
+	
+	void operator()(const Range &range) const {
+		for (int j = range.start; j < range.end; j++) {
+			results[j].clear(); 
+			Mat im; 
+			if (!ImageCache2::getSharedCache().getImage(fileNames[j], im)) continue; 
+			lists[j]->setImage(im); 
+			booster->searchAllScalesOfPatchList(lists[j], results[j], NMSRadius, -INFINITY, 
+												blackoutLists[j], false); 
+		}
+	}
+	
+private:
+	GentleBoostCascadedClassifier* booster; 
+	const vector<string> &fileNames; 
+	const vector<vector<Rect> > &blackoutLists; 
+	const vector<PatchList*> &lists; 
+	vector<vector<SearchResult> > &results; 
+	int NMSRadius; 
+}; 
+
 void GentleBoostCascadedClassifier::setHardNegativeTrainingExamplesFromBGImages(){
-	if ((negImageDataset == NULL || negImageDataset->getNumEntries() == 0) && posPatchDataset == NULL) {
+	if ((negImageDataset == NULL || negImageDataset->getNumEntries() == 0) 
+		&& posPatchDataset == NULL && posPatchDatasetFileName.empty()) {
 		if (_CASCADE_DEBUG) cout << "Warning: Must set a bg image dataset before calling setHardNegativeExamples" << endl; 
 		return; 
 	} else if (numFeatures == 0) {
@@ -292,95 +427,137 @@ void GentleBoostCascadedClassifier::setHardNegativeTrainingExamplesFromBGImages(
 		return; 
 	}
 	
-	unsigned int currInd = 0; 
-	int imNum = 0; 
-	int patchNum = 0; 
 	int numReplaced = 0; 
 	int usePosImagesForNegPatches = negImageDataset == NULL; 
+	if (usePosImagesForNegPatches && posPatchDataset == NULL) {
+		//A resumed snapshot restores the patches but not the dataset, which is 
+		//only needed here, for the positive images. 
+		if (_CASCADE_DEBUG) cout << "Reading dataset " << posPatchDatasetFileName << " for its images" << endl; 
+		posPatchDataset = PatchDataset::readFromFile(posPatchDatasetFileName); 
+	}
 	int numFiles = usePosImagesForNegPatches ? posPatchDataset->getNumUniquePositiveImages() : negImageDataset->getNumEntries();
 	
-	while (currInd < negPatches.size()) {
-		while (currInd < negPatches.size() && negSurvived[currInd] && keepNonRejectedBGPatches) currInd++; //Skip survived patches in update		
-		if (currInd == negPatches.size()) break; //Accidentally moved off the edge of the world
+	int batchSize = bgMiningBatchSize > 0 ? bgMiningBatchSize : getNumThreads(); 
+	batchSize = batchSize < 1 ? 1 : batchSize; 
+	batchSize = batchSize > numFiles ? numFiles : batchSize; 
+	vector<PatchList*> lists(batchSize); 
+	for (int j = 0; j < batchSize; j++) lists[j] = createSearchPatchList(); 
 		
-		if (_CASCADE_DEBUG) cout << "Filling index " << currInd << " / " << negPatches.size() << endl; 
-		currentBGFileNum = (currentBGFileNum+(1<<19)-1)%numFiles; 
-		if (_CASCADE_DEBUG) cout << "Using Image Number " << currentBGFileNum << " of " << numFiles << endl; 
-		string fname = usePosImagesForNegPatches ? posPatchDataset->getUniquePosImageName(currentBGFileNum).c_str() : negImageDataset->getFileName(currentBGFileNum); 
-		cout << "Searching image " << fname << endl; 
-		Mat im = imread(fname, 0); //CV_LOAD_IMAGE_GRAYSCALE);
+	//If the images run out of patches before all dead slots are filled, we 
+	//start over with more patches per image. 
+	bool searchAgain = true; 
+	while (searchAgain) {
+		searchAgain = false; 
+		unsigned int currInd = 0; 
+		int imNum = 0; 
+		int patchNum = 0; 
+		bool outOfImages = false; 
 		
-		vector<Rect> blackoutList; 
-		blackoutList.clear(); 
-		if (usePosImagesForNegPatches)
-			blackoutList = posPatchDataset->getObjectLocationsInPosImage(currentBGFileNum); 
+		while (currInd < negPatches.size() && !outOfImages) {
+			while (currInd < negPatches.size() && negSurvived[currInd] && keepNonRejectedBGPatches) currInd++; //Skip survived patches in update		
+			if (currInd == negPatches.size()) break; //Accidentally moved off the edge of the world
 		
-		//IplImage* gray_image = cvCreateImage(cvSize(im->width, im->height), IPL_DEPTH_8U, 1); 
-		//cvCvtColor(im, gray_image, CV_RGB2GRAY); 
-		vector<SearchResult> keptPatches; 
-		disableNMSAcrossScales = 1; 
-		if (useNMSInTraining) 
-			searchImage(im, keptPatches, basePatchSize.width/2, -INFINITY, blackoutList, basePatchSize.width*.5,2 );
-		else
-			searchImage(im, keptPatches, 0, -INFINITY, blackoutList,basePatchSize.width*.5,2); 
-		disableNMSAcrossScales = 0; 
-		patchNum += keptPatches.size(); 
-		long long seed = 0; 
-		for (unsigned int i = 0; i < maxPatchesPerImage && i < keptPatches.size() && currInd < negPatches.size(); i++) {
-			if (useNMSInTraining )
-				seed = i; 
-			else
-				seed = (seed+1<<31-1)%keptPatches.size(); 
-			
-			Mat p(negPatches[currInd]->getImageSize(), CV_8U,1); 
+			//Decode and search the next batch of images concurrently. Images 
+			//in the batch that aren't needed are simply not collected, and
+			//currentBGFileNum is only advanced past images that were used. 
+			int numInBatch = numFiles - imNum; 
+			numInBatch = numInBatch > batchSize ? batchSize : numInBatch; 
+			vector<int> fileNums(numInBatch); 
+			vector<string> fileNames(numInBatch); 
+			vector<vector<Rect> > blackoutLists(numInBatch); 
+			vector<vector<SearchResult> > results(numInBatch); 
+			int fileNum = currentBGFileNum; 
+			for (int j = 0; j < numInBatch; j++) {
+				fileNum = (fileNum+(1<<19)-1)%numFiles; 
+				fileNums[j] = fileNum; 
+				fileNames[j] = usePosImagesForNegPatches ? posPatchDataset->getUniquePosImageName(fileNum).c_str() : negImageDataset->getFileName(fileNum); 
+				if (usePosImagesForNegPatches)
+					blackoutLists[j] = posPatchDataset->getObjectLocationsInPosImage(fileNum); 
+			}
 			
-			patchlist->fillImageWithPixelsOfSearchPatch(p, keptPatches[seed]); 
+			int NMSRadius = useNMSInTraining ? basePatchSize.width/2 : 0; 
+			parallel_for_(Range(0, numInBatch), 
+						  BGImageMiningBody(this, fileNames, blackoutLists, lists, results, NMSRadius)); 
 			
-			if (!(negSurvived[currInd] && keepNonRejectedBGPatches)) {
-				negPatches[currInd]->setImage(p);
-				numReplaced++; 
-				currInd++; 
+			//Collect patches in image order, exactly as a serial search would.
+			for (int j = 0; j < numInBatch && currInd < negPatches.size(); j++) {
 				while (currInd < negPatches.size() && negSurvived[currInd] && keepNonRejectedBGPatches) currInd++; 
+				if (currInd == negPatches.size()) break; 
 				
 				if (_CASCADE_DEBUG) cout << "Filling index " << currInd << " / " << negPatches.size() << endl; 
-				if (currInd == negPatches.size()) break; 
-			} else {
-				currInd++; 
+				currentBGFileNum = fileNums[j]; 
+				if (_CASCADE_DEBUG) cout << "Using Image Number " << currentBGFileNum << " of " << numFiles << endl; 
+				cout << "Searching image " << fileNames[j] << endl; 
+				
+				vector<SearchResult> &keptPatches = results[j]; 
+				cout << "Image search kept " << keptPatches.size() << "/" << lists[j]->getTotalPatches() <<
+				"(" << 100.0*keptPatches.size()/lists[j]->getTotalPatches() << "%)"<< endl; 
+				roundStats.bg_images_searched++; 
+				roundStats.bg_windows_searched += lists[j]->getTotalPatches(); 
+				roundStats.bg_windows_kept += keptPatches.size(); 
+				patchNum += keptPatches.size(); 
+				long long seed = 0; 
+				for (unsigned int i = 0; i < maxPatchesPerImage && i < keptPatches.size() && currInd < negPatches.size(); i++) {
+					if (useNMSInTraining )
+						seed = i; 
+					else
+						seed = (seed+1<<31-1)%keptPatches.size(); 
+					
+					Mat p(negPatches[currInd]->getImageSize(), CV_8U,1); 
+					
+					lists[j]->fillImageWithPixelsOfSearchPatch(p, keptPatches[seed]); 
+					
+					if (!(negSurvived[currInd] && keepNonRejectedBGPatches)) {
+						negPatches[currInd]->setImage(p);
+						numReplaced++; 
+						currInd++; 
+						while (currInd < negPatches.size() && negSurvived[currInd] && keepNonRejectedBGPatches) currInd++; 
+						
+						if (_CASCADE_DEBUG) cout << "Filling index " << currInd << " / " << negPatches.size() << endl; 
+						if (currInd == negPatches.size()) break; 
+					} else {
+						currInd++; 
+					}
+				}
+				imNum++; 
+				if (imNum >= numFiles) {
+					cout << "Warning: Couldn't find enough hard bg patches in image set." << endl; 
+					outOfImages = true; 
+					break; 
+				}
 			}
-			
-			//cvReleaseImage(&p); 
-			//cvResetImageROI(gray_image); 
 		}
-		//cvReleaseImage(&gray_image); 
-		//cvReleaseImage(&im); 
-		imNum++; 
-		if (imNum >= numFiles) {
-			cout << "Warning: Couldn't find enough hard bg patches in image set." << endl; 
-			break; 
+		if (currInd < negPatches.size()) {
+			cout << patchNum << " patches remain and " << negPatches.size() << " were needed." << endl; 
+			if (patchNum >= (int) negPatches.size()) {
+				maxPatchesPerImage = maxPatchesPerImage*2; 
+				useNMSInTraining = 0; 
+				cout << "Increasing patches per image to " << maxPatchesPerImage << " and searching again." << endl; 
+				searchAgain = true; 
+			} else {
+				runningOutOfNegPatches = 1; 
+				maxPatchesPerImage = negPatches.size(); 
+				if (patchNum == 0)	ranOutOfNegPatches = 1; 
+			}
 		}
 	}
-	if (currInd < negPatches.size()) {
-		cout << patchNum << " patches remain and " << negPatches.size() << " were needed." << endl; 
-		if (patchNum >= (int) negPatches.size()) {
-			maxPatchesPerImage = maxPatchesPerImage*2; 
-			useNMSInTraining = 0; 
-			cout << "Increasing patches per image to " << maxPatchesPerImage << " and searching again." << endl; 
-			setHardNegativeTrainingExamplesFromBGImages(); 
-		} else {
-			runningOutOfNegPatches = 1; 
-			maxPatchesPerImage = negPatches.size(); 
-			if (patchNum == 0)	ranOutOfNegPatches = 1; 
-		}
 		
-	}
+	for (int j = 0; j < batchSize; j++) delete(lists[j]); 
 	
 	//cout << "Computing new training weights" << endl; 
 	setTrainingSet(trainingPatches, trainingLabels); 
 	
 	cout << "Replaced a total of " << numReplaced << " bg patches." << endl; 
+	roundStats.bg_patches_replaced += numReplaced; 
 } 
 
 
+static void deletePatches(vector<ImagePatch*> &patches) {
+	for (size_t i = 0; i < patches.size(); i++) 
+		delete(patches[i]); 
+	patches.clear(); 
+}
+
 GentleBoostCascadedClassifier::GentleBoostCascadedClassifier() : GentleBoostClassifier() {
 	
 	
@@ -409,6 +586,8 @@ GentleBoostCascadedClassifier::GentleBoostCascadedClassifier() : GentleBoostClas
 	ranOutOfNegPatches = 0; 
 	useNMSInTraining = 1; 
 	disableNMSAcrossScales = 0; 
+	bgMiningBatchSize = 0; 
+	resetRoundStats(); 
 	
 	sharingPatchList = 0; 
 }
@@ -420,6 +599,7 @@ GentleBoostCascadedClassifier::~GentleBoostCascadedClassifier() {
 	if (posImageDataset != NULL) delete(posImageDataset); 
 	if (negImageDataset != NULL) delete(negImageDataset); 
 	if (!sharingPatchList) delete(patchlist); 
+	deletePatches(snapshotPatches); 
 }
 
 
@@ -732,6 +912,8 @@ void GentleBoostCascadedClassifier::setTrainingSet(string pathToPatchDatasetFile
 	posPatchDataset->getLabels(labels); 
 	
 	setTrainingSet(patches, labels); 
+	posPatchDatasetFileName = pathToPatchDatasetFile; 
+	deletePatches(snapshotPatches); 
 	
 	if (negImageDataset != NULL) delete(negImageDataset); 
 	negImageDataset = posPatchDataset->getNegImagesDataset(); 	
@@ -765,6 +947,14 @@ void GentleBoostCascadedClassifier::setTrainingSet(const vector<ImagePatch*>& tr
 		this->trainingPatches.resize(trainingPatches.size(), (ImagePatch*)NULL); 
 		for (unsigned int i = 0; i < trainingPatches.size(); i++)
 			this->trainingPatches[i] = trainingPatches[i]; 
+		posPatchDatasetFileName.clear(); 
+		if (!snapshotPatches.empty()) {
+			//Free the patches of a loaded snapshot, unless they are reused. 
+			set<ImagePatch*> kept(this->trainingPatches.begin(), this->trainingPatches.end()); 
+			for (size_t i = 0; i < snapshotPatches.size(); i++) 
+				if (!kept.count(snapshotPatches[i])) delete(snapshotPatches[i]); 
+			snapshotPatches.clear(); 
+		}
 		negPatches.clear(); 
 		posPatches.clear(); 
 		for (unsigned int i = 0; i < this->trainingPatches.size(); i++) {
@@ -852,6 +1042,285 @@ void GentleBoostCascadedClassifier::setTestingSet(const vector<ImagePatch*>& tes
 } 
 
 
+static const char snapshotMagic[8] = {'N','M','P','T','G','B','C','S'}; 
+static const int snapshotVersion = 1; 
+
+static void writeFlagBinary(ostream &out, bool flag) {
+	char c = flag; 
+	out.write(&c, sizeof(char)); 
+}
+
+static bool readFlagBinary(istream &in) {
+	char c = 0; 
+	in.read(&c, sizeof(char)); 
+	return c != 0; 
+}
+
+static void writeCvMatToStreamBinary(ostream &out, const CvMat* mat) {
+	Mat m; 
+	if (mat != NULL) m = Mat(mat); 
+	NMPTUtils::writeMatToStreamBinary(out, m); 
+}
+
+static void replaceCvMat(CvMat*& dst, const Mat &src) {
+	cvReleaseMat(&dst); 
+	if (src.empty()) return; 
+	CvMat tmp = src; 
+	dst = cvCloneMat(&tmp); 
+}
+
+int GentleBoostCascadedClassifier::saveTrainingSnapshot(const string &filename, int trainingTarget) {
+	string tmpname = filename + ".tmp"; 
+	ofstream out(tmpname.c_str(), ios::out | ios::binary); 
+	if (!out.is_open()) {
+		cout << "Warning: Couldn't open " << tmpname << " for writing a training snapshot." << endl; 
+		return 0; 
+	}
+	
+	out.write(snapshotMagic, sizeof(snapshotMagic)); 
+	out.write((char*)&snapshotVersion, sizeof(int)); 
+	out.write((char*)&trainingTarget, sizeof(int)); 
+	
+	// Model, in the text format at full precision
+	ostringstream model; 
+	model.precision(20); 
+	addToStream(model); 
+	NMPTUtils::writeStringToStreamBinary(out, model.str()); 
+	
+	// Training set and boosting state
+	NMPTUtils::writeStringToStreamBinary(out, posPatchDatasetFileName); 
+	int numPatches = trainingPatches.size(); 
+	out.write((char*)&numPatches, sizeof(int)); 
+	for (int i = 0; i < numPatches; i++) 
+		trainingPatches[i]->addToStreamBinary(out); 
+	writeCvMatToStreamBinary(out, trainingLabels); 
+	writeCvMatToStreamBinary(out, trainingFeatureSum); 
+	writeCvMatToStreamBinary(out, trainingPosteriors); 
+	writeCvMatToStreamBinary(out, trainingPredictions); 
+	writeCvMatToStreamBinary(out, trainingWeights); 
+	writeCvMatToStreamBinary(out, trainingSurvived); 
+	int numOutputs = trainingFeatureOutputs.size(); 
+	out.write((char*)&numOutputs, sizeof(int)); 
+	for (int i = 0; i < numOutputs; i++) 
+		writeCvMatToStreamBinary(out, trainingFeatureOutputs[i]); 
+	out.write((char*)&trainingPerformance, sizeof(double)); 
+	out.write((char*)&numTrain, sizeof(int)); 
+	
+	// Background mining
+	writeFlagBinary(out, negImageDataset != NULL); 
+	if (negImageDataset != NULL) {
+		int numImages = negImageDataset->getNumEntries(); 
+		int labelsPerImage = negImageDataset->numLabelsPerImage(); 
+		out.write((char*)&numImages, sizeof(int)); 
+		out.write((char*)&labelsPerImage, sizeof(int)); 
+		for (int i = 0; i < numImages; i++) {
+			NMPTUtils::writeStringToStreamBinary(out, negImageDataset->getFileName(i)); 
+			vector<double> labels = negImageDataset->getFileLabels(i); 
+			labels.resize(labelsPerImage, 0); 
+			for (int j = 0; j < labelsPerImage; j++) 
+				out.write((char*)&labels[j], sizeof(double)); 
+		}
+	}
+	out.write((char*)&currentBGFileNum, sizeof(int)); 
+	out.write((char*)&maxPatchesPerImage, sizeof(unsigned int)); 
+	writeFlagBinary(out, useNMSInTraining); 
+	writeFlagBinary(out, keepNonRejectedBGPatches); 
+	writeFlagBinary(out, dontTrainRejected); 
+	writeFlagBinary(out, runningOutOfNegPatches); 
+	writeFlagBinary(out, ranOutOfNegPatches); 
+	writeFlagBinary(out, disableNMSAcrossScales); 
+	
+	uint64 rngState = theRNG().state; 
+	out.write((char*)&rngState, sizeof(uint64)); 
+	
+	out.close(); 
+	if (out.fail()) {
+		cout << "Warning: Failed writing training snapshot " << tmpname << endl; 
+		remove(tmpname.c_str()); 
+		return 0; 
+	}
+	if (rename(tmpname.c_str(), filename.c_str()) != 0) {
+		cout << "Warning: Couldn't move " << tmpname << " to " << filename << endl; 
+		return 0; 
+	}
+	if (_TRAINING_DEBUG) cout << "Saved training snapshot with " << numFeatures 
+		<< " features and " << numPatches << " patches to " << filename << endl; 
+	return 1; 
+}
+
+int GentleBoostCascadedClassifier::loadTrainingSnapshot(const string &filename, int* trainingTarget) {
+	ifstream in(filename.c_str(), ios::in | ios::binary); 
+	if (!in.is_open()) {
+		cout << "Warning: Couldn't open training snapshot " << filename << endl; 
+		return 0; 
+	}
+	
+	char magic[sizeof(snapshotMagic)]; 
+	int version = 0; 
+	in.read(magic, sizeof(snapshotMagic)); 
+	in.read((char*)&version, sizeof(int)); 
+	if (!in || memcmp(magic, snapshotMagic, sizeof(snapshotMagic)) 
+		|| version != snapshotVersion) {
+		cout << "Warning: " << filename << " is not a version " << snapshotVersion 
+		<< " cascade training snapshot." << endl; 
+		return 0; 
+	}
+	
+	// Read everything into temporaries first, so that a truncated or corrupt
+	// file leaves this classifier untouched. 
+	int newTarget = 0; 
+	string modelText, datasetFileName; 
+	int numPatches = 0; 
+	in.read((char*)&newTarget, sizeof(int)); 
+	NMPTUtils::readStringFromStreamBinary(in, modelText); 
+	NMPTUtils::readStringFromStreamBinary(in, datasetFileName); 
+	in.read((char*)&numPatches, sizeof(int)); 
+	int modelNumFeatures = -1; 
+	istringstream(modelText) >> modelNumFeatures; 
+	if (!in || modelNumFeatures < 0) {
+		cout << "Warning: Corrupt model in training snapshot " << filename << endl; 
+		return 0; 
+	}
+	if (numPatches < 1) {
+		cout << "Warning: Corrupt patch count in training snapshot " << filename << endl; 
+		return 0; 
+	}
+	vector<ImagePatch*> newPatches; 
+	for (int i = 0; i < numPatches && in; i++) {
+		newPatches.push_back(new ImagePatch()); 
+		newPatches[i]->readFromStreamBinary(in); 
+	}
+	Mat newLabels, newFeatureSum, newPosteriors, newPredictions, newWeights, newSurvived; 
+	NMPTUtils::readMatFromStreamBinary(in, newLabels); 
+	NMPTUtils::readMatFromStreamBinary(in, newFeatureSum); 
+	NMPTUtils::readMatFromStreamBinary(in, newPosteriors); 
+	NMPTUtils::readMatFromStreamBinary(in, newPredictions); 
+	NMPTUtils::readMatFromStreamBinary(in, newWeights); 
+	NMPTUtils::readMatFromStreamBinary(in, newSurvived); 
+	int numOutputs = 0; 
+	in.read((char*)&numOutputs, sizeof(int)); 
+	if (!in || numOutputs < 0 || numOutputs > modelNumFeatures) {
+		cout << "Warning: Corrupt feature outputs in training snapshot " << filename << endl; 
+		deletePatches(newPatches); 
+		return 0; 
+	}
+	vector<Mat> newOutputs(numOutputs); 
+	for (int i = 0; i < numOutputs; i++) 
+		NMPTUtils::readMatFromStreamBinary(in, newOutputs[i]); 
+	double newPerformance = 0; 
+	int newNumTrain = 0; 
+	in.read((char*)&newPerformance, sizeof(double)); 
+	in.read((char*)&newNumTrain, sizeof(int)); 
+	
+	ImageDataSet* newNegImages = NULL; 
+	if (readFlagBinary(in)) {
+		int numImages = 0, labelsPerImage = 0; 
+		in.read((char*)&numImages, sizeof(int)); 
+		in.read((char*)&labelsPerImage, sizeof(int)); 
+		if (!in || numImages < 0 || labelsPerImage < 0) {
+			cout << "Warning: Corrupt background image list in training snapshot " << filename << endl; 
+			deletePatches(newPatches); 
+			return 0; 
+		}
+		newNegImages = new ImageDataSet(0, labelsPerImage); 
+		vector<double> labels(labelsPerImage); 
+		for (int i = 0; i < numImages && in; i++) {
+			string name; 
+			NMPTUtils::readStringFromStreamBinary(in, name); 
+			for (int j = 0; j < labelsPerImage; j++) 
+				in.read((char*)&labels[j], sizeof(double)); 
+			newNegImages->addEntry(name, labels); 
+		}
+	}
+	int newBGFileNum = 0; 
+	unsigned int newMaxPatchesPerImage = 0; 
+	in.read((char*)&newBGFileNum, sizeof(int)); 
+	in.read((char*)&newMaxPatchesPerImage, sizeof(unsigned int)); 
+	bool newUseNMS = readFlagBinary(in); 
+	bool newKeepNonRejected = readFlagBinary(in); 
+	bool newDontTrainRejected = readFlagBinary(in); 
+	bool newRunningOut = readFlagBinary(in); 
+	bool newRanOut = readFlagBinary(in); 
+	bool newDisableNMSAcrossScales = readFlagBinary(in); 
+	uint64 rngState = 0; 
+	in.read((char*)&rngState, sizeof(uint64)); 
+	
+	int ok = 1; 
+	if (!in) {
+		cout << "Warning: Training snapshot " << filename << " is truncated." << endl; 
+		ok = 0; 
+	} else if (newLabels.rows != numPatches || newWeights.rows != numPatches 
+			   || newSurvived.rows != numPatches || newFeatureSum.rows != numPatches) {
+		cout << "Warning: Training snapshot " << filename 
+		<< " has inconsistent training state." << endl; 
+		ok = 0; 
+	}
+	
+	if (!ok) {
+		deletePatches(newPatches); 
+		if (newNegImages != NULL) delete(newNegImages); 
+		return 0; 
+	}
+	
+	for (size_t i = 0; i < features.size(); i++) 
+		delete(features[i]); 
+	features.clear(); 
+	istringstream model(modelText); 
+	readFromStream(model); 
+	
+	//The saved patches already hold their integrals, so they are used as they
+	//are. The PatchDataset is only read again if mining needs its images. 
+	if (posPatchDataset != NULL) delete(posPatchDataset); 
+	posPatchDataset = NULL; 
+	posPatchDatasetFileName = datasetFileName; 
+	deletePatches(snapshotPatches); 
+	snapshotPatches = newPatches; 
+	trainingPatches = newPatches; 
+	if (features.empty()) 
+		basePatchSize = trainingPatches[0]->getImageSize(); 
+	replaceCvMat(trainingLabels, newLabels); 
+	replaceCvMat(trainingFeatureSum, newFeatureSum); 
+	replaceCvMat(trainingPosteriors, newPosteriors); 
+	replaceCvMat(trainingPredictions, newPredictions); 
+	replaceCvMat(trainingWeights, newWeights); 
+	replaceCvMat(trainingSurvived, newSurvived); 
+	for (size_t i = 0; i < trainingFeatureOutputs.size(); i++) 
+		cvReleaseMat(&trainingFeatureOutputs[i]); 
+	trainingFeatureOutputs.assign(numOutputs, (CvMat*)NULL); 
+	for (int i = 0; i < numOutputs; i++) 
+		replaceCvMat(trainingFeatureOutputs[i], newOutputs[i]); 
+	trainingPerformance = newPerformance; 
+	numTrain = newNumTrain; 
+	
+	negPatches.clear(); 
+	posPatches.clear(); 
+	for (int i = 0; i < numPatches; i++) {
+		if (cvGetReal2D(trainingLabels,i,0) == 1)
+			posPatches.push_back(trainingPatches[i]); 
+		else
+			negPatches.push_back(trainingPatches[i]); 
+	}
+	
+	if (negImageDataset != NULL) delete(negImageDataset); 
+	negImageDataset = newNegImages; 
+	currentBGFileNum = newBGFileNum; 
+	maxPatchesPerImage = newMaxPatchesPerImage; 
+	useNMSInTraining = newUseNMS; 
+	keepNonRejectedBGPatches = newKeepNonRejected; 
+	dontTrainRejected = newDontTrainRejected; 
+	runningOutOfNegPatches = newRunningOut; 
+	ranOutOfNegPatches = newRanOut; 
+	disableNMSAcrossScales = newDisableNMSAcrossScales; 
+	
+	theRNG().state = rngState; 
+	if (trainingTarget != NULL) *trainingTarget = newTarget; 
+	
+	if (_CASCADE_DEBUG) cout << "Resumed from " << filename << " with " << numFeatures 
+		<< " features, " << posPatches.size() << " pos patches and " 
+		<< negPatches.size() << " neg patches." << endl;  
+	return 1; 
+}
+
 void GentleBoostCascadedClassifier::pickRejectThreshold(const CvMat* values,
 														const CvMat* labels,
 														const CvMat* survived,
@@ -1453,6 +1922,14 @@ bool GentleBoostCascadedClassifier::exhaustedAllNegPatches() {
 	return ranOutOfNegPatches; 
 }
 
+const TrainingRoundStats& GentleBoostCascadedClassifier::getLastRoundStats() const {
+	return roundStats; 
+}
+
+void GentleBoostCascadedClassifier::resetRoundStats() {
+	memset(&roundStats, 0, sizeof(TrainingRoundStats)); 
+}
+
 
 void GentleBoostCascadedClassifier::setTrainingParams(double maxPosRejects, double desiredNegRejects) {
 	maxPosRejectsPerRound = maxPosRejects; 
@@ -1483,7 +1960,7 @@ void GentleBoostCascadedClassifier::getPerformanceMeasures(const Feature* candid
 		return; 
 	}
 	
-	BlockTimer bt(1); 
+	BlockTimer bt(1), stats(1); 
 	perf.time_per_patch = 0; 
 	perf.total_pos = posPatches.size();
 	perf.total_neg = negPatches.size(); 
@@ -1516,8 +1993,15 @@ void GentleBoostCascadedClassifier::getPerformanceMeasures(const Feature* candid
 			FeatureRegressor* reg = new FeatureRegressor(candidate); 
 			if (_CASCADE_DEBUG) cout << "Train" << endl; 
 			
-			Mat tl = trainingLabels, tw=trainingWeights; 
-			reg->train(numBins, trainingPatches, tl, tw); 
+			roundStats.candidates_evaluated++; 
+			Mat tl = trainingLabels, tw=trainingWeights, vals; 
+			stats.blockRestart(0); 
+			reg->evaluateFeature(trainingPatches, vals); 
+			roundStats.seconds_response += stats.getCurrTime(0); 
+			roundStats.patches_evaluated += trainingPatches.size(); 
+			stats.blockRestart(0); 
+			reg->trainOnFeatureValues(numBins, vals, tl, tw); 
+			roundStats.seconds_lut_fit += stats.getCurrTime(0); 
 			
 			if (reg->getLUTRange() <= 0) {
 				perf.chisq = INFINITY; 
@@ -1542,6 +2026,8 @@ void GentleBoostCascadedClassifier::getPerformanceMeasures(const Feature* candid
 			bt.blockStop(0); 
 			if (_CASCADE_DEBUG) cout << "Training patches has size " << trainingPatches.size() << "; output has size " << output->width << "x" << output->height << endl; 
 			perf.time_per_patch = bt.getTotTime(0); 
+			roundStats.seconds_response += bt.getTotTime(0); 
+			roundStats.patches_evaluated += trainingPatches.size(); 
 			if (_CASCADE_DEBUG) cout << "Add" << endl; 
 			cvAdd(trainingFeatureSum, output, output, trainingSurvived); 
 			
@@ -1557,6 +2043,7 @@ void GentleBoostCascadedClassifier::getPerformanceMeasures(const Feature* candid
 	
 	if (_CASCADE_DEBUG) cout << "Starting pickRejectThreshold" << endl; 
 	
+	stats.blockRestart(0); 
 	perf.prev_pos_rejects = 0; 
 	perf.prev_neg_rejects = 0; 
 	for (int i = 0; i < trainingLabels->height; i++) {
@@ -1610,6 +2097,7 @@ void GentleBoostCascadedClassifier::getPerformanceMeasures(const Feature* candid
 	if (_CASCADE_DEBUG) cout << "set perf.chisq" << endl; 
 	
 	if (isnan(perf.chisq)) perf.chisq = INFINITY; 
+	roundStats.seconds_chisq += stats.getCurrTime(0); 
 	
 	
 	if (_CASCADE_DEBUG) cout << "Checked NAN, perf.chisq is " << perf.chisq << endl; 
@@ -1766,24 +2254,52 @@ void GentleBoostCascadedClassifier::compareFeaturesAndDeleteWorse(Feature*& oldF
 
 PerformanceMetrics GentleBoostCascadedClassifier::trainOneRound(int patience, int boostRounds) {
 	
+	resetRoundStats(); 
+	roundStats.round = getNumFeaturesTotal()+1; 
+	long long cacheHitsBefore, cacheMissesBefore; 
+	ImageCache2::getSharedCache().getStats(cacheHitsBefore, cacheMissesBefore); 
+	BlockTimer bt(2); 
+	bt.blockRestart(0); 
+	
 	if (_TRAINING_DEBUG) cout << "Adding feature " << getNumFeaturesTotal()+1 << endl; 
 	if (_TRAINING_DEBUG) cout << "Replacing easy background examples with harder ones." << endl; 
 	
+	bt.blockRestart(1); 
 	setHardNegativeTrainingExamplesFromBGImages(); 
+	roundStats.seconds_mining = bt.getCurrTime(1); 
 	
+	bt.blockRestart(1); 
 	Feature* feat = getGoodFeature(patience); 
+	roundStats.seconds_tournament = bt.getCurrTime(1); 
 	if (_TRAINING_DEBUG) cout << "Done with Feature Tournament." << endl; 
 	
 	if (_TRAINING_DEBUG) cout<< "Adding feature to classifier." << endl; 
+	bt.blockRestart(1); 
 	if (boostRounds > 0)
 		addFeatureBoosted(feat, boostRounds );
 	else 
 		addFeature(feat); 
+	roundStats.seconds_add_feature = bt.getCurrTime(1); 
 	delete(feat); 
 	
 	PerformanceMetrics perf; 
 	//booster->getPerformanceMeasures(NULL, chisq, posRej, negRej); 
 	getPerformanceMeasures(NULL, perf); 
+	
+	roundStats.perf = perf; 
+	roundStats.num_training_patches = trainingPatches.size(); 
+	for (size_t i = 0; i < trainingPatches.size(); i++) 
+		roundStats.patch_bytes += trainingPatches[i]->getMemoryUsage(); 
+	//Labels, sum, posteriors, predictions and weights are doubles; 
+	//survived is one byte; plus one double per feature output. 
+	roundStats.training_state_bytes = trainingPatches.size()*
+		(5*sizeof(double) + 1 + trainingFeatureOutputs.size()*sizeof(double)); 
+	roundStats.patches_per_second = roundStats.seconds_response > 0 ? 
+		roundStats.patches_evaluated / roundStats.seconds_response : INFINITY; 
+	ImageCache2::getSharedCache().getStats(roundStats.image_cache_hits, roundStats.image_cache_misses); 
+	roundStats.image_cache_hits -= cacheHitsBefore; 
+	roundStats.image_cache_misses -= cacheMissesBefore; 
+	roundStats.seconds_total = bt.getCurrTime(0); 
 	if (_TRAINING_DEBUG) cout << "Chi-Sq: " << perf.chisq  << " ; Pos Rejects: " << perf.pos_rejects 
 	<< " ; Neg Rejects: " << perf.neg_rejects << endl; 	
 	return perf;  
@@ -1882,6 +2398,7 @@ Feature* GentleBoostCascadedClassifier::getGoodFeatureViaTournament(string featu
 		<< " \tTimePerPatch " << candidates.back().perf.time_per_patch 
 		<< " \tCost " << featureCost(candidates.back().perf) << endl; 
 	}
+	roundStats.time_per_patch = candidates[0].perf.time_per_patch; 
 	return candidates[0].feat; 
 }
 
@@ -0,0 +1,54 @@
+/*
+ *  GentleBoostCascadedSearchContext.cpp
+ *  OpenCV
+ *
+ */
+
+#include "GentleBoostCascadedSearchContext.h"
+
+using namespace std;
+using namespace cv;
+
+GentleBoostCascadedSearchContext::GentleBoostCascadedSearchContext() {
+}
+
+GentleBoostCascadedSearchContext::GentleBoostCascadedSearchContext(const Ptr<GentleBoostCascadedClassifier> &model) {
+	setModel(model);
+}
+
+GentleBoostCascadedSearchContext::~GentleBoostCascadedSearchContext() {
+}
+
+void GentleBoostCascadedSearchContext::setModel(const Ptr<GentleBoostCascadedClassifier> &model) {
+	this->model = model;
+	if (model.empty()) patchList.release();
+	else patchList = model->createSearchPatchList();
+}
+
+Ptr<GentleBoostCascadedClassifier> GentleBoostCascadedSearchContext::getModel() const {
+	return model;
+}
+
+void GentleBoostCascadedSearchContext::searchImage(const Mat &gray_image,
+											vector<SearchResult>& keptPatches,
+											int NMSRadius,
+											double threshold) {
+	keptPatches.clear();
+	if (model.empty()) {
+		cout << "Warning: Must set a model before searching with a GentleBoostCascadedSearchContext." << endl;
+		return;
+	}
+	model->searchImage(gray_image, patchList, keptPatches, NMSRadius, threshold);
+}
+
+int GentleBoostCascadedSearchContext::getNumScales() {
+	if (patchList.empty()) return -1;
+	return patchList->getNumScales();
+}
+
+Size GentleBoostCascadedSearchContext::getSizeOfScale(int scale) {
+	if (!patchList.empty() && scale >= 0 && scale < patchList->getNumScales()) {
+		return patchList->getPatchSizeAtScale(scale);
+	}
+	return Size(-1,-1);
+}
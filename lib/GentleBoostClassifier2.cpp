@@ -12,6 +12,11 @@
 #include "DebugGlobals.h" 
 #include "NMPTUtils.h"
 #include "BlockTimer.h"
+#include "GentleBoostShards2.h"
+#include <fstream>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 
 using namespace cv; 
 using namespace std; 
@@ -37,6 +42,12 @@ GentleBoostClassifier2::GentleBoostClassifier2() {
 	useNMSInTraining = 1; 
 	disableNMSAcrossScales = 0; 
 	
+	screeningSubsampleSize = 0; 
+	screeningRescoreFraction = .1; 
+	screeningRounds = 0; 
+	screeningChanges = 0; 
+	
+	shards = NULL; 
 }
 
 GentleBoostClassifier2 & GentleBoostClassifier2::operator=(const GentleBoostClassifier2 &rhs) {
@@ -99,6 +110,7 @@ void GentleBoostClassifier2::copy(const GentleBoostClassifier2 &rhs) {
 	posImagesDataset = rhs.posImagesDataset; 
 	negImagesDataset = rhs.negImagesDataset; 
 	patchDataset = rhs.patchDataset; 
+	testingDataset = rhs.testingDataset; 
 	
 	currentBGFileNum = rhs.currentBGFileNum; 
 	dontTrainRejected = rhs.dontTrainRejected; 
@@ -108,6 +120,13 @@ void GentleBoostClassifier2::copy(const GentleBoostClassifier2 &rhs) {
 	ranOutOfNegPatches = rhs.ranOutOfNegPatches; 
 	useNMSInTraining = rhs.useNMSInTraining; 
 	disableNMSAcrossScales = rhs.disableNMSAcrossScales; 
+	
+	screeningSubsampleSize = rhs.screeningSubsampleSize; 
+	screeningRescoreFraction = rhs.screeningRescoreFraction; 
+	screeningRounds = rhs.screeningRounds; 
+	screeningChanges = rhs.screeningChanges; 
+	
+	shards = NULL; 
 }
 
 Size GentleBoostClassifier2::getBasePatchSize() const {
@@ -194,28 +213,33 @@ void GentleBoostClassifier2::updateWeights(const Mat &output, const Mat &labels,
 	int numPatches = output.rows; 
 	int hasLabels = labels.rows > 0 && labels.cols > 0 && labels.rows == numPatches; 
 	if (hasLabels) {
-		Mat out =  output.mul(labels); 
-		out = -out; 
-		
-		//Here we are scaling the log weight so that its max is an arbitrary
-		//constant, e.g. 5, so that things should be numerically stable, 
-		//even for large datasets. The larger this constant is, the more 
-		//precise the very small weights, but the larger risk we run of
-		//numerical instability. 
 		double minval,maxval; 
 		minMaxLoc(weights,&minval,&maxval); 
-		weights = weights - (maxval-5); 
-		
-		exp(out, out); 
-		weights = weights.mul(out);
-		if (survived.cols > 0 && survived.rows > 0 && dontTrainRejected) {
-			Mat notsurvived; 
-			bitwise_not(survived, notsurvived); 
-			weights.setTo(0., notsurvived);
-		}
+		reweight(output, labels, weights, survived, maxval); 
 		normalize(weights, weights, 1, 0, NORM_L1); 
 	}
 }
+		
+void GentleBoostClassifier2::reweight(const Mat &output, const Mat &labels, Mat &weights, 
+									  const Mat &survived, double maxWeight) const {
+	Mat out =  output.mul(labels); 
+	out = -out; 
+	
+	//Here we are scaling the log weight so that its max is an arbitrary
+	//constant, e.g. 5, so that things should be numerically stable, 
+	//even for large datasets. The larger this constant is, the more 
+	//precise the very small weights, but the larger risk we run of
+	//numerical instability. 
+	weights = weights - (maxWeight-5); 
+	
+	exp(out, out); 
+	weights = weights.mul(out);
+	if (survived.cols > 0 && survived.rows > 0 && dontTrainRejected) {
+		Mat notsurvived; 
+		bitwise_not(survived, notsurvived); 
+		weights.setTo(0., notsurvived);
+	}
+}
 
 void GentleBoostClassifier2::calcPosterior(const Mat &featureSum, Mat &posterior) const {
 	if (_GENTLEBOOST_DEBUG) cout << "Getting posterior." << endl; 
@@ -374,6 +398,25 @@ void GentleBoostClassifier2::addFeatureBoosted(const Feature2* nextFeature, int
 	if (_GENTLEBOOST_DEBUG) cout << "Adding feature with " << boostRounds << " rounds of boosting." << endl; 
 	if (_GENTLEBOOST_DEBUG) printDebugState();
 	
+	if (shards != NULL) {
+		//Every boosting round trains on trainingWeights, so all rounds give
+		//the same table; train it once and combine copies. 
+		FeatureRegressor2 reg(nextFeature); 
+		trainRegressorOnShards(reg); 
+		features.push_back(reg); 
+		for (int i = 1; i < boostRounds; i++) 
+			features.back().combineLUTs(reg); 
+		
+		int posRejects, negRejects; 
+		double threshold; 
+		pickRejectThreshold(Mat(), Mat(), Mat(), threshold, posRejects, negRejects); 
+		featureRejectThresholds.push_back(threshold); 
+		numFeatures = features.size(); 
+		
+		shards->addFeature(features.back(), threshold); 
+		return; 
+	}
+	
 	vector<FeatureRegressor2> regs; 
 	
 	Mat wts = trainingWeights.clone(), newsum = trainingFeatureSum.clone(); 
@@ -519,6 +562,11 @@ void GentleBoostClassifier2::getPerformanceMeasures(const Feature2* candidate, P
 	//  we remove the feature
 	//--Otherwise, calculates the error if we were to add this feature.
 	
+	if (shards != NULL) {
+		getShardedPerformanceMeasures(candidate, perf); 
+		return; 
+	}
+	
 	perf.pos_rejects = 0; 
 	perf.neg_rejects = 0; 
 	perf.total_pos = posPatches.size();
@@ -633,9 +681,11 @@ void GentleBoostClassifier2::setTrainingSet(const PatchDataset2 &dataset) {
 }
 
 void GentleBoostClassifier2::setTestingSet(const PatchDataset2 &dataset) {	
-	vector<ImagePatch2> patches = dataset.getPatches();
+	//Keep the dataset, since the patches of a mapped dataset are views into it.
+	testingDataset = dataset; 
+	vector<ImagePatch2> patches = testingDataset.getPatches();
 	Mat labels; 
-	dataset.getLabels(labels); 
+	testingDataset.getLabels(labels); 
 	
 	setTestingSet(patches, labels); 	
 }
@@ -649,11 +699,707 @@ Feature2* GentleBoostClassifier2::getGoodFeature(int patience, const string &fea
 	return getGoodFeatureViaTournament(featureType, featurePoolSize, numSimilar, reduceFraction); 
 }
 
+void GentleBoostClassifier2::setCandidateScreening(int subsampleSize, double rescoreFraction) {
+	screeningSubsampleSize = subsampleSize < 0 ? 0 : subsampleSize; 
+	if (rescoreFraction <= 0 || rescoreFraction > 1) {
+		cout << "Warning: Screening rescore fraction must be in (0,1]; using .1" << endl; 
+		rescoreFraction = .1; 
+	}
+	screeningRescoreFraction = rescoreFraction; 
+}
+
+void GentleBoostClassifier2::getCandidateScreeningStats(int &roundsScreened, int &choicesChanged) const {
+	roundsScreened = screeningRounds; 
+	choicesChanged = screeningChanges; 
+}
+
+static const char snapshotMagic[8] = {'N','M','P','T','G','B','2','S'}; 
+static const int snapshotVersion = 2; //Version 1 snapshots have no training target
+
+static void writeFlagBinary(ostream &out, bool flag) {
+	char c = flag; 
+	out.write(&c, sizeof(char)); 
+}
+
+static bool readFlagBinary(istream &in) {
+	char c = 0; 
+	in.read(&c, sizeof(char)); 
+	return c != 0; 
+}
+
+int GentleBoostClassifier2::saveTrainingSnapshot(const string &filename, int trainingTarget) const {
+	string tmpname = filename + ".tmp"; 
+	ofstream out(tmpname.c_str(), ios::out | ios::binary); 
+	if (!out.is_open()) {
+		cout << "Warning: Couldn't open " << tmpname << " for writing a training snapshot." << endl; 
+		return 0; 
+	}
+	
+	out.write(snapshotMagic, sizeof(snapshotMagic)); 
+	out.write((char*)&snapshotVersion, sizeof(int)); 
+	out.write((char*)&trainingTarget, sizeof(int)); 
+	
+	// Model
+	int numTotal = features.size(); 
+	out.write((char*)&numFeatures, sizeof(int)); 
+	out.write((char*)&numTotal, sizeof(int)); 
+	for (int i = 0; i < numTotal; i++) 
+		features[i].addToStreamBinary(out); 
+	int numThresholds = featureRejectThresholds.size(); 
+	out.write((char*)&numThresholds, sizeof(int)); 
+	for (int i = 0; i < numThresholds; i++) 
+		out.write((char*)&featureRejectThresholds[i], sizeof(double)); 
+	out.write((char*)&basePatchSize.width, sizeof(int)); 
+	out.write((char*)&basePatchSize.height, sizeof(int)); 
+	NMPTUtils::writeStringToStreamBinary(out, featureName); 
+	out.write((char*)&useFast, sizeof(int)); 
+	
+	// Training set and boosting state
+	int numPatches = trainingPatches.size(); 
+	out.write((char*)&numPatches, sizeof(int)); 
+	for (int i = 0; i < numPatches; i++) 
+		trainingPatches[i].addToStreamBinary(out); 
+	NMPTUtils::writeMatToStreamBinary(out, trainingLabels); 
+	NMPTUtils::writeMatToStreamBinary(out, trainingFeatureSum); 
+	NMPTUtils::writeMatToStreamBinary(out, trainingPosteriors); 
+	NMPTUtils::writeMatToStreamBinary(out, trainingPredictions); 
+	NMPTUtils::writeMatToStreamBinary(out, trainingWeights); 
+	NMPTUtils::writeMatToStreamBinary(out, trainingSurvived); 
+	int numOutputs = trainingFeatureOutputs.size(); 
+	out.write((char*)&numOutputs, sizeof(int)); 
+	for (int i = 0; i < numOutputs; i++) 
+		NMPTUtils::writeMatToStreamBinary(out, trainingFeatureOutputs[i]); 
+	out.write((char*)&trainingPerformance, sizeof(double)); 
+	out.write((char*)&numTrain, sizeof(int)); 
+	
+	// Background mining
+	posImagesDataset.addToStreamBinary(out); 
+	negImagesDataset.addToStreamBinary(out); 
+	out.write((char*)&currentBGFileNum, sizeof(int)); 
+	out.write((char*)&maxPatchesPerImage, sizeof(unsigned int)); 
+	writeFlagBinary(out, useNMSInTraining); 
+	writeFlagBinary(out, keepNonRejectedBGPatches); 
+	writeFlagBinary(out, dontTrainRejected); 
+	writeFlagBinary(out, runningOutOfNegPatches); 
+	writeFlagBinary(out, ranOutOfNegPatches); 
+	writeFlagBinary(out, disableNMSAcrossScales); 
+	
+	uint64 rngState = theRNG().state; 
+	out.write((char*)&rngState, sizeof(uint64)); 
+	
+	out.close(); 
+	if (out.fail()) {
+		cout << "Warning: Failed writing training snapshot " << tmpname << endl; 
+		remove(tmpname.c_str()); 
+		return 0; 
+	}
+	if (rename(tmpname.c_str(), filename.c_str()) != 0) {
+		cout << "Warning: Couldn't move " << tmpname << " to " << filename << endl; 
+		return 0; 
+	}
+	if (_TRAINING_DEBUG) cout << "Saved training snapshot with " << numFeatures 
+		<< " features and " << numPatches << " patches to " << filename << endl; 
+	return 1; 
+}
+
+int GentleBoostClassifier2::loadTrainingSnapshot(const string &filename, int* trainingTarget) {
+	ifstream in(filename.c_str(), ios::in | ios::binary); 
+	if (!in.is_open()) {
+		cout << "Warning: Couldn't open training snapshot " << filename << endl; 
+		return 0; 
+	}
+	
+	char magic[sizeof(snapshotMagic)]; 
+	int version = 0; 
+	in.read(magic, sizeof(snapshotMagic)); 
+	in.read((char*)&version, sizeof(int)); 
+	if (!in || memcmp(magic, snapshotMagic, sizeof(snapshotMagic)) 
+		|| version < 1 || version > snapshotVersion) {
+		cout << "Warning: " << filename << " is not a version 1-" << snapshotVersion 
+		<< " training snapshot." << endl; 
+		return 0; 
+	}
+	int newTarget = 0; 
+	if (version >= 2) 
+		in.read((char*)&newTarget, sizeof(int)); 
+	
+	// Read everything into temporaries first, so that a truncated or corrupt
+	// file leaves this classifier untouched. 
+	int newNumFeatures = 0, numTotal = 0; 
+	in.read((char*)&newNumFeatures, sizeof(int)); 
+	in.read((char*)&numTotal, sizeof(int)); 
+	if (!in || numTotal < 0 || newNumFeatures < 0 || newNumFeatures > numTotal) {
+		cout << "Warning: Corrupt feature count in training snapshot " << filename << endl; 
+		return 0; 
+	}
+	vector<FeatureRegressor2> newFeatures; 
+	for (int i = 0; i < numTotal; i++) {
+		FeatureRegressor2 reg; 
+		if (!reg.readFromStreamBinary(in)) {
+			cout << "Warning: Couldn't read feature " << i << " of training snapshot " << filename << endl; 
+			return 0; 
+		}
+		newFeatures.push_back(reg); 
+	}
+	int numThresholds = 0; 
+	in.read((char*)&numThresholds, sizeof(int)); 
+	if (!in || numThresholds < 0 || numThresholds > numTotal) {
+		cout << "Warning: Corrupt reject thresholds in training snapshot " << filename << endl; 
+		return 0; 
+	}
+	vector<double> newThresholds(numThresholds); 
+	for (int i = 0; i < numThresholds; i++) 
+		in.read((char*)&newThresholds[i], sizeof(double)); 
+	Size newPatchSize; 
+	string newFeatureName; 
+	int newUseFast = 0; 
+	in.read((char*)&newPatchSize.width, sizeof(int)); 
+	in.read((char*)&newPatchSize.height, sizeof(int)); 
+	NMPTUtils::readStringFromStreamBinary(in, newFeatureName); 
+	in.read((char*)&newUseFast, sizeof(int)); 
+	
+	int numPatches = 0; 
+	in.read((char*)&numPatches, sizeof(int)); 
+	if (!in || numPatches < 0) {
+		cout << "Warning: Corrupt patch count in training snapshot " << filename << endl; 
+		return 0; 
+	}
+	vector<ImagePatch2> newPatches(numPatches); 
+	for (int i = 0; i < numPatches && in; i++) 
+		newPatches[i].readFromStreamBinary(in); 
+	Mat newLabels, newFeatureSum, newPosteriors, newPredictions, newWeights, newSurvived; 
+	NMPTUtils::readMatFromStreamBinary(in, newLabels); 
+	NMPTUtils::readMatFromStreamBinary(in, newFeatureSum); 
+	NMPTUtils::readMatFromStreamBinary(in, newPosteriors); 
+	NMPTUtils::readMatFromStreamBinary(in, newPredictions); 
+	NMPTUtils::readMatFromStreamBinary(in, newWeights); 
+	NMPTUtils::readMatFromStreamBinary(in, newSurvived); 
+	int numOutputs = 0; 
+	in.read((char*)&numOutputs, sizeof(int)); 
+	if (!in || numOutputs < 0 || numOutputs > numTotal) {
+		cout << "Warning: Corrupt feature outputs in training snapshot " << filename << endl; 
+		return 0; 
+	}
+	vector<Mat> newOutputs(numOutputs); 
+	for (int i = 0; i < numOutputs; i++) 
+		NMPTUtils::readMatFromStreamBinary(in, newOutputs[i]); 
+	double newPerformance = 0; 
+	int newNumTrain = 0; 
+	in.read((char*)&newPerformance, sizeof(double)); 
+	in.read((char*)&newNumTrain, sizeof(int)); 
+	
+	ImageDataSet2 newPosImages, newNegImages; 
+	newPosImages.readFromStreamBinary(in); 
+	newNegImages.readFromStreamBinary(in); 
+	int newBGFileNum = 0; 
+	unsigned int newMaxPatchesPerImage = 0; 
+	in.read((char*)&newBGFileNum, sizeof(int)); 
+	in.read((char*)&newMaxPatchesPerImage, sizeof(unsigned int)); 
+	bool newUseNMS = readFlagBinary(in); 
+	bool newKeepNonRejected = readFlagBinary(in); 
+	bool newDontTrainRejected = readFlagBinary(in); 
+	bool newRunningOut = readFlagBinary(in); 
+	bool newRanOut = readFlagBinary(in); 
+	bool newDisableNMSAcrossScales = readFlagBinary(in); 
+	uint64 rngState = 0; 
+	in.read((char*)&rngState, sizeof(uint64)); 
+	
+	if (!in) {
+		cout << "Warning: Training snapshot " << filename << " is truncated." << endl; 
+		return 0; 
+	}
+	if (newLabels.rows != numPatches || newWeights.rows != numPatches 
+		|| newSurvived.rows != numPatches || newFeatureSum.rows != numPatches) {
+		cout << "Warning: Training snapshot " << filename 
+		<< " has inconsistent training state." << endl; 
+		return 0; 
+	}
+	
+	features = newFeatures; 
+	numFeatures = newNumFeatures; 
+	featureRejectThresholds = newThresholds; 
+	featureName = newFeatureName; 
+	useFast = newUseFast; 
+	setBasePatchSize(newPatchSize); 
+	
+	trainingPatches = newPatches; 
+	trainingLabels = newLabels; 
+	trainingFeatureSum = newFeatureSum; 
+	trainingPosteriors = newPosteriors; 
+	trainingPredictions = newPredictions; 
+	trainingWeights = newWeights; 
+	trainingSurvived = newSurvived; 
+	trainingFeatureOutputs = newOutputs; 
+	trainingPerformance = newPerformance; 
+	numTrain = newNumTrain; 
+	
+	negPatches.clear(); 
+	posPatches.clear(); 
+	for (size_t i = 0; i < trainingPatches.size(); i++) {
+		if (trainingLabels.at<double>(i,0) > 0)
+			posPatches.push_back(&trainingPatches[i]); 
+		else 
+			negPatches.push_back(&trainingPatches[i]); 
+	}
+	
+	posImagesDataset = newPosImages; 
+	negImagesDataset = newNegImages; 
+	currentBGFileNum = newBGFileNum; 
+	maxPatchesPerImage = newMaxPatchesPerImage; 
+	useNMSInTraining = newUseNMS; 
+	keepNonRejectedBGPatches = newKeepNonRejected; 
+	dontTrainRejected = newDontTrainRejected; 
+	runningOutOfNegPatches = newRunningOut; 
+	ranOutOfNegPatches = newRanOut; 
+	disableNMSAcrossScales = newDisableNMSAcrossScales; 
+	
+	theRNG().state = rngState; 
+	if (trainingTarget != NULL) *trainingTarget = newTarget; 
+	
+	if (_TRAINING_DEBUG) printDebugState(); 
+	if (_CASCADE_DEBUG) cout << "Resumed from " << filename << " with " << numFeatures 
+		<< " features, " << posPatches.size() << " pos patches and " 
+		<< negPatches.size() << " neg patches." << endl;  
+	return 1; 
+}
+
+static const char binaryModelMagic[8] = {'N','M','P','T','G','B','2','M'}; 
+static const int binaryModelVersion = 1; 
+static const int binaryModelByteOrder = 0x01020304; 
+
+int GentleBoostClassifier2::isBinaryModelFile(const string &filename) {
+	char magic[sizeof(binaryModelMagic)]; 
+	ifstream in(filename.c_str(), ios::in | ios::binary); 
+	if (!in.read(magic, sizeof(magic))) return 0; 
+	return !memcmp(magic, binaryModelMagic, sizeof(magic)); 
+}
+
+int GentleBoostClassifier2::saveBinaryModel(const string &filename, int lutDepth) const {
+	if (lutDepth != CV_32F && lutDepth != CV_64F) {
+		cout << "Warning: Binary model lookup tables must be CV_32F or CV_64F; using CV_64F." << endl; 
+		lutDepth = CV_64F; 
+	}
+	
+	int numRegs = features.size(); 
+	vector<string> typeNames; 
+	vector<int> typeIndex(numRegs), patchW(numRegs), patchH(numRegs), 
+	paramCount(numRegs), lutCount(numRegs); 
+	vector<double> lutMin(numRegs), lutMax(numRegs), allParams, allLUTs; 
+	for (int i = 0; i < numRegs; i++) {
+		const Feature2* feat = features[i].getFeature(); 
+		string name = feat->getFeatureName(); 
+		typeIndex[i] = find(typeNames.begin(), typeNames.end(), name) - typeNames.begin(); 
+		if (typeIndex[i] == (int)typeNames.size()) typeNames.push_back(name); 
+		patchW[i] = feat->getPatchSize().width; 
+		patchH[i] = feat->getPatchSize().height; 
+		Mat params = feat->getFeatureParameters(); 
+		paramCount[i] = params.total(); 
+		for (int j = 0; j < paramCount[i]; j++) 
+			allParams.push_back(params.at<double>(0, j)); 
+		Mat lut; 
+		features[i].getLUT(lutMin[i], lutMax[i], lut); 
+		lutCount[i] = lut.total(); 
+		for (int j = 0; j < lutCount[i]; j++) 
+			allLUTs.push_back(lut.at<double>(j, 0)); 
+	}
+	Mat storedLUTs; 
+	Mat(allLUTs).convertTo(storedLUTs, lutDepth); 
+	
+	int numTypes = typeNames.size(); 
+	int numThresholds = featureRejectThresholds.size(); 
+	int totalParams = allParams.size(); 
+	int totalLUT = allLUTs.size(); 
+	
+	string tmpname = filename + ".tmp"; 
+	ofstream out(tmpname.c_str(), ios::out | ios::binary | ios::trunc); 
+	if (!out.is_open()) {
+		cout << "Warning: Couldn't open " << tmpname << " for writing." << endl; 
+		return 0; 
+	}
+	
+	out.write(binaryModelMagic, sizeof(binaryModelMagic)); 
+	out.write((char*)&binaryModelVersion, sizeof(int)); 
+	out.write((char*)&binaryModelByteOrder, sizeof(int)); 
+	out.write((char*)&lutDepth, sizeof(int)); 
+	out.write((char*)&numFeatures, sizeof(int)); 
+	out.write((char*)&numRegs, sizeof(int)); 
+	out.write((char*)&numThresholds, sizeof(int)); 
+	out.write((char*)&numTypes, sizeof(int)); 
+	out.write((char*)&totalParams, sizeof(int)); 
+	out.write((char*)&totalLUT, sizeof(int)); 
+	out.write((char*)&useFast, sizeof(int)); 
+	out.write((char*)&basePatchSize.width, sizeof(int)); 
+	out.write((char*)&basePatchSize.height, sizeof(int)); 
+	NMPTUtils::writeStringToStreamBinary(out, featureName); 
+	for (int i = 0; i < numTypes; i++) 
+		NMPTUtils::writeStringToStreamBinary(out, typeNames[i]); 
+	
+	if (numRegs > 0) {
+		out.write((char*)&typeIndex[0], numRegs*sizeof(int)); 
+		out.write((char*)&patchW[0], numRegs*sizeof(int)); 
+		out.write((char*)&patchH[0], numRegs*sizeof(int)); 
+		out.write((char*)&paramCount[0], numRegs*sizeof(int)); 
+		out.write((char*)&lutCount[0], numRegs*sizeof(int)); 
+		out.write((char*)&lutMin[0], numRegs*sizeof(double)); 
+		out.write((char*)&lutMax[0], numRegs*sizeof(double)); 
+	}
+	if (numThresholds > 0) 
+		out.write((char*)&featureRejectThresholds[0], numThresholds*sizeof(double)); 
+	if (totalParams > 0) 
+		out.write((char*)&allParams[0], totalParams*sizeof(double)); 
+	if (totalLUT > 0) 
+		out.write((char*)storedLUTs.data, totalLUT*storedLUTs.elemSize()); 
+	
+	out.close(); 
+	if (out.fail() || rename(tmpname.c_str(), filename.c_str()) != 0) {
+		cout << "Warning: Failed to write binary model " << filename << endl; 
+		remove(tmpname.c_str()); 
+		return 0; 
+	}
+	return 1; 
+}
+
+int GentleBoostClassifier2::loadBinaryModel(const string &filename) {
+	ifstream in(filename.c_str(), ios::in | ios::binary); 
+	if (!in.is_open()) {
+		cout << "Warning: Couldn't open binary model " << filename << endl; 
+		return 0; 
+	}
+	
+	char magic[sizeof(binaryModelMagic)]; 
+	int version = 0, byteOrder = 0; 
+	in.read(magic, sizeof(magic)); 
+	in.read((char*)&version, sizeof(int)); 
+	in.read((char*)&byteOrder, sizeof(int)); 
+	if (!in || memcmp(magic, binaryModelMagic, sizeof(magic)) 
+		|| version != binaryModelVersion || byteOrder != binaryModelByteOrder) {
+		cout << "Warning: " << filename << " is not a version " << binaryModelVersion 
+		<< " binary model for this machine." << endl; 
+		return 0; 
+	}
+	
+	int lutDepth = 0, newNumFeatures = 0, numRegs = 0, numThresholds = 0, numTypes = 0, 
+	totalParams = 0, totalLUT = 0, newUseFast = 0; 
+	Size newPatchSize; 
+	string newFeatureName; 
+	in.read((char*)&lutDepth, sizeof(int)); 
+	in.read((char*)&newNumFeatures, sizeof(int)); 
+	in.read((char*)&numRegs, sizeof(int)); 
+	in.read((char*)&numThresholds, sizeof(int)); 
+	in.read((char*)&numTypes, sizeof(int)); 
+	in.read((char*)&totalParams, sizeof(int)); 
+	in.read((char*)&totalLUT, sizeof(int)); 
+	in.read((char*)&newUseFast, sizeof(int)); 
+	in.read((char*)&newPatchSize.width, sizeof(int)); 
+	in.read((char*)&newPatchSize.height, sizeof(int)); 
+	NMPTUtils::readStringFromStreamBinary(in, newFeatureName); 
+	if (!in || (lutDepth != CV_32F && lutDepth != CV_64F) || numRegs < 0 
+		|| newNumFeatures < 0 || newNumFeatures > numRegs || numThresholds < 0 
+		|| numThresholds > numRegs || numTypes < 0 || totalParams < 0 || totalLUT < 0) {
+		cout << "Warning: Corrupt header in binary model " << filename << endl; 
+		return 0; 
+	}
+	vector<string> typeNames(numTypes); 
+	for (int i = 0; i < numTypes; i++) 
+		NMPTUtils::readStringFromStreamBinary(in, typeNames[i]); 
+	
+	vector<int> typeIndex(numRegs), patchW(numRegs), patchH(numRegs), 
+	paramCount(numRegs), lutCount(numRegs); 
+	vector<double> lutMin(numRegs), lutMax(numRegs), newThresholds(numThresholds); 
+	Mat allParams(1, totalParams, CV_64F), storedLUTs(totalLUT, 1, CV_MAKETYPE(lutDepth, 1)); 
+	if (numRegs > 0) {
+		in.read((char*)&typeIndex[0], numRegs*sizeof(int)); 
+		in.read((char*)&patchW[0], numRegs*sizeof(int)); 
+		in.read((char*)&patchH[0], numRegs*sizeof(int)); 
+		in.read((char*)&paramCount[0], numRegs*sizeof(int)); 
+		in.read((char*)&lutCount[0], numRegs*sizeof(int)); 
+		in.read((char*)&lutMin[0], numRegs*sizeof(double)); 
+		in.read((char*)&lutMax[0], numRegs*sizeof(double)); 
+	}
+	if (numThresholds > 0) 
+		in.read((char*)&newThresholds[0], numThresholds*sizeof(double)); 
+	if (totalParams > 0) 
+		in.read((char*)allParams.data, totalParams*sizeof(double)); 
+	if (totalLUT > 0) 
+		in.read((char*)storedLUTs.data, totalLUT*storedLUTs.elemSize()); 
+	if (!in) {
+		cout << "Warning: Binary model " << filename << " is truncated." << endl; 
+		return 0; 
+	}
+	
+	long long paramSum = 0, lutSum = 0; 
+	for (int i = 0; i < numRegs; i++) {
+		if (typeIndex[i] < 0 || typeIndex[i] >= numTypes || paramCount[i] < 0 || lutCount[i] < 0) {
+			cout << "Warning: Corrupt feature " << i << " in binary model " << filename << endl; 
+			return 0; 
+		}
+		paramSum += paramCount[i]; 
+		lutSum += lutCount[i]; 
+	}
+	if (paramSum != totalParams || lutSum != totalLUT) {
+		cout << "Warning: Inconsistent array sizes in binary model " << filename << endl; 
+		return 0; 
+	}
+	
+	Mat allLUTs; 
+	storedLUTs.convertTo(allLUTs, CV_64F); 
+	
+	// Regressors are built in place, adopting their features and viewing their
+	// lookup tables in allLUTs, so nothing is copied per feature. 
+	vector<FeatureRegressor2> newFeatures(numRegs); 
+	int paramOffset = 0, lutOffset = 0; 
+	for (int i = 0; i < numRegs; i++) {
+		Feature2* feat = Feature2::getFeatureOfType(typeNames[typeIndex[i]], 
+													 Size(patchW[i], patchH[i])); 
+		if (feat == NULL) {
+			cout << "Warning: Unknown feature type " << typeNames[typeIndex[i]] 
+			<< " in binary model " << filename << endl; 
+			return 0; 
+		}
+		if (paramCount[i] > 0) 
+			feat->setFeatureParameters(allParams.colRange(paramOffset, paramOffset+paramCount[i])); 
+		newFeatures[i].adoptFeature(feat); 
+		Mat lut; 
+		if (lutCount[i] > 0) 
+			lut = allLUTs.rowRange(lutOffset, lutOffset+lutCount[i]); 
+		newFeatures[i].setLUT(lutMin[i], lutMax[i], lut); 
+		paramOffset += paramCount[i]; 
+		lutOffset += lutCount[i]; 
+	}
+	
+	features.swap(newFeatures); 
+	numFeatures = newNumFeatures; 
+	featureRejectThresholds = newThresholds; 
+	featureName = newFeatureName; 
+	basePatchSize = newPatchSize; 
+	useFast = newUseFast; 
+	setUseFastPatchList(useFast); 
+	return 1; 
+}
+
+void GentleBoostClassifier2::setTrainingShards(GentleBoostShardCoordinator2 *shards) {
+	this->shards = shards; 
+	if (shards == NULL) return; 
+	
+	if (screeningSubsampleSize > 0) 
+		cout << "Warning: Candidate screening is not used when training on shards." << endl; 
+	
+	//The workers hold the training set; keep none locally. 
+	trainingPatches.clear(); 
+	posPatches.clear(); 
+	negPatches.clear(); 
+	trainingLabels = Mat(); 
+	trainingFeatureOutputs.clear(); 
+	trainingFeatureSum = Mat(); 
+	trainingPosteriors = Mat(); 
+	trainingPredictions = Mat(); 
+	trainingWeights = Mat(); 
+	trainingSurvived = Mat(); 
+	
+	if (basePatchSize.width <= 0 || basePatchSize.height <= 0) 
+		setBasePatchSize(shards->getPatchSize()); 
+	
+	shards->reset(); 
+	for (int i = 0; i < numFeatures; i++) 
+		shards->addFeature(features[i], featureRejectThresholds[i]); 
+	
+	if (_CASCADE_DEBUG) cout << "Training on " << shards->getNumShards() << " shards with " 
+		<< shards->getNumPos() << " pos patches and " << shards->getNumNeg() 
+		<< " neg patches." << endl;  
+}
+
+void GentleBoostClassifier2::trainRegressorOnShards(FeatureRegressor2 &reg) const {
+	//Same steps as FeatureRegressor2::train, with the range and the table 
+	//statistics summed over all shards. 
+	double minVal, maxVal; 
+	shards->getFeatureRange(reg.getFeature(), minVal, maxVal); 
+	Mat numerator, denominator; 
+	if (maxVal - minVal > 0) 
+		shards->getLUTStatistics(reg.getFeature(), numBins, minVal, maxVal, numerator, denominator); 
+	reg.setLUTFromStatistics(minVal, maxVal, numerator, denominator); 
+}
+
+void GentleBoostClassifier2::getShardedPerformanceMeasures(const Feature2* candidate, PerformanceMetrics& perf) const {
+	perf.pos_rejects = 0; 
+	perf.neg_rejects = 0; 
+	perf.total_pos = shards->getNumPos();
+	perf.total_neg = shards->getNumNeg(); 
+	perf.prev_pos_rejects = 0; 
+	perf.prev_neg_rejects = 0; 
+	perf.threshold = -INFINITY; 
+	perf.time_per_patch = 0; 
+	
+	GentleBoostShardCoordinator2::Evaluation eval; 
+	if (candidate == NULL) { 
+		shards->evaluateCurrent(eval); 
+	} else {
+		int ind = -1; 
+		for (int i = 0; i < numFeatures; i++) {
+			if (candidate == features[i].getFeature()) {
+				ind = i; 
+				break; 
+			}
+		}
+		
+		if (ind > -1) {
+			shards->evaluateWithout(ind, eval); 
+		} else {
+			FeatureRegressor2 reg(candidate); 
+			trainRegressorOnShards(reg); 
+			
+			if (reg.getLUTRange() <= 0) {
+				perf.chisq = INFINITY; 
+				perf.pos_rejects = perf.total_pos; 
+				perf.neg_rejects = 0; 
+				perf.time_per_patch = INFINITY; 
+				perf.threshold = -INFINITY; 
+				return; 
+			}
+			
+			shards->evaluateWith(reg, eval); 
+			perf.time_per_patch = eval.seconds / (perf.total_pos + perf.total_neg); 
+		}
+	}
+	
+	perf.prev_pos_rejects = eval.prevPosRejects; 
+	perf.prev_neg_rejects = eval.prevNegRejects; 
+	perf.pos_rejects = perf.prev_pos_rejects; 
+	perf.neg_rejects = perf.prev_neg_rejects; 	
+	perf.time_per_patch = perf.time_per_patch*1.0/(perf.total_pos-perf.prev_pos_rejects+perf.total_neg-perf.prev_neg_rejects); 
+	
+	if (candidate != NULL)  {
+		pickRejectThreshold(Mat(), Mat(), Mat(), 
+							perf.threshold, perf.pos_rejects, perf.neg_rejects); 
+	} else {
+		if (numFeatures > 0)
+			perf.threshold = featureRejectThresholds[numFeatures-1]; 
+	}
+	
+	perf.chisq = eval.chisq; 
+	if (isnan(perf.chisq)) perf.chisq = INFINITY; 
+}
+
+bool GentleBoostClassifier2::getTrainingSubsample(int numDraws, TrainingSubsample &subsample) const {
+	int numPatches = trainingPatches.size(); 
+	if (numDraws <= 0 || numDraws >= numPatches) return false; 
+	
+	double totalWeight = sum(trainingWeights)[0]; 
+	if (!(totalWeight > 0)) return false; 
+	
+	//Systematic resampling: one evenly spaced pass over the cumulative
+	//weights, so the subsample is deterministic and has low variance. 
+	double step = totalWeight / numDraws; 
+	double next = .5*step; 
+	double cumulative = 0; 
+	vector<int> inds; 
+	vector<int> counts; 
+	int drawn = 0; 
+	for (int i = 0; i < numPatches; i++) {
+		cumulative += trainingWeights.at<double>(i,0); 
+		int count = 0; 
+		while (next < cumulative && drawn < numDraws) {
+			count++; 
+			drawn++; 
+			next += step; 
+		}
+		if (count > 0) {
+			inds.push_back(i); 
+			counts.push_back(count); 
+		}
+	}
+	
+	int numKept = inds.size(); 
+	if (numKept == 0) return false; 
+	
+	subsample.patches.resize(numKept); 
+	subsample.labels.create(numKept, 1, CV_64F); 
+	subsample.weights.create(numKept, 1, CV_64F); 
+	subsample.featureSum.create(numKept, 1, CV_64F); 
+	subsample.survived.create(numKept, 1, trainingSurvived.type()); 
+	subsample.numPos = 0; 
+	subsample.numNeg = 0; 
+	for (int i = 0; i < numKept; i++) {
+		int ind = inds[i]; 
+		subsample.patches[i] = trainingPatches[ind]; 
+		subsample.labels.at<double>(i,0) = trainingLabels.at<double>(ind,0); 
+		subsample.weights.at<double>(i,0) = counts[i]; 
+		subsample.featureSum.at<double>(i,0) = trainingFeatureSum.at<double>(ind,0); 
+		subsample.survived.at<uint8_t>(i,0) = trainingSurvived.at<uint8_t>(ind,0); 
+		if (subsample.labels.at<double>(i,0) > 0) subsample.numPos++; 
+		else subsample.numNeg++; 
+	}
+	
+	if (_TRAINING_DEBUG) cout << "Screening subsample has " << numKept << " distinct patches from "
+		<< numDraws << " draws (" << subsample.numPos << " pos, " << subsample.numNeg << " neg)." << endl; 
+	return true; 
+}
+
+void GentleBoostClassifier2::getScreeningPerformance(const Feature2* candidate, PerformanceMetrics& perf,
+													 const TrainingSubsample &subsample) const {
+	//Same as the "add this feature" mode of getPerformanceMeasures, but 
+	//restricted to the screening subsample. 
+	perf.pos_rejects = 0; 
+	perf.neg_rejects = 0; 
+	perf.total_pos = subsample.numPos; 
+	perf.total_neg = subsample.numNeg; 
+	perf.prev_pos_rejects = 0; 
+	perf.prev_neg_rejects = 0; 
+	perf.threshold = -INFINITY; 
+	perf.time_per_patch = 0; 
+	
+	FeatureRegressor2 reg(candidate); 
+	reg.train(numBins, subsample.patches, subsample.labels, subsample.weights); 
+	
+	if (reg.getLUTRange() <= 0) {
+		perf.chisq = INFINITY; 
+		perf.pos_rejects = subsample.numPos; 
+		perf.time_per_patch = INFINITY; 
+		return; 
+	}
+	
+	Mat newSum; 
+	BlockTimer bt; 
+	bt.blockRestart(0); 
+	reg.predict(subsample.patches, newSum); 
+	perf.time_per_patch = bt.getCurrTime(0) / subsample.patches.size(); 
+	
+	accumulateEvidence(subsample.featureSum, newSum, subsample.survived); 
+	
+	for (int i = 0; i < subsample.labels.rows; i++) {
+		if (subsample.survived.at<uint8_t>(i,0)) continue; 
+		if (subsample.labels.at<double>(i,0) > 0) perf.prev_pos_rejects++; 
+		else perf.prev_neg_rejects++; 
+	}
+	perf.pos_rejects = perf.prev_pos_rejects; 
+	perf.neg_rejects = perf.prev_neg_rejects; 
+	
+	pickRejectThreshold(newSum, subsample.labels, subsample.survived, 
+						perf.threshold, perf.pos_rejects, perf.neg_rejects); 
+	
+	Mat prob; 
+	calcPosterior(newSum, prob); 
+	perf.chisq = getChiSq(subsample.labels, prob); 
+}
+
 Feature2* GentleBoostClassifier2::getGoodFeatureViaTournament(const string &featureType,
 															 int startPoolSize, 
 															 int similarFeatures,
 															 double keepPortion) const {	
 	
+	TrainingSubsample subsampleData; 
+	const TrainingSubsample* subsample = NULL; 
+	if (screeningSubsampleSize > 0 && getTrainingSubsample(screeningSubsampleSize, subsampleData)) 
+		subsample = &subsampleData; 
+	
+	//Without screening, the tournament runs down to a single winner. With 
+	//screening, it stops at a few finalists, which are re-scored on the 
+	//full training set. 
+	unsigned int numFinalists = 1; 
+	if (subsample != NULL) {
+		numFinalists = ceil(screeningRescoreFraction*startPoolSize); 
+		numFinalists = numFinalists<1?1:numFinalists; 
+	}
+	
 	vector<FeaturePerformance2> candidates; 
 	if (_TRAINING_DEBUG) cout << "Getting Initial Pool & performance." << endl; 
 	for (int i = 0; i < startPoolSize; i++) {
@@ -662,7 +1408,8 @@ Feature2* GentleBoostClassifier2::getGoodFeatureViaTournament(const string &feat
 		f.feat = Feature2::getFeatureOfType(featureType, basePatchSize); //new HaarFeature(basePatchSize);
 		
 		if (_TRAINING_DEBUG) cout << "Checking Performance of feature " << i << endl; 
-		getPerformanceMeasures(f.feat,f.perf);
+		if (subsample != NULL) getScreeningPerformance(f.feat, f.perf, *subsample); 
+		else getPerformanceMeasures(f.feat,f.perf);
 		candidates.push_back(f); 
 	}
 	
@@ -670,7 +1417,7 @@ Feature2* GentleBoostClassifier2::getGoodFeatureViaTournament(const string &feat
 	if (_TRAINING_DEBUG) cout << "Size is " << candidates.size() << endl; 
 	
 	int roundSimilarFeatures = similarFeatures; 
-	while(candidates.size() > 1) {
+	while(candidates.size() > numFinalists) {
 		vector<double> test; 
 		if (_TRAINING_DEBUG) cout << "Sorting" << endl; 
 		sort(candidates.begin(), candidates.end()); 
@@ -687,8 +1434,8 @@ Feature2* GentleBoostClassifier2::getGoodFeatureViaTournament(const string &feat
 			<< " \tNegRejects " << candidates.back().perf.neg_rejects 
 			<< " \tTimePerPatch " << candidates.back().perf.time_per_patch 
 			<< " \tCost " << featureCost(candidates.back().perf) << endl; 
-		int newsize = keepPortion*candidates.size(); 
-		newsize = newsize<1?1:newsize; 
+		unsigned int newsize = keepPortion*candidates.size(); 
+		newsize = newsize<numFinalists?numFinalists:newsize; 
 		for (unsigned int i = newsize; i < candidates.size(); i++) {
 			delete(candidates[i].feat); 
 		}
@@ -702,7 +1449,8 @@ Feature2* GentleBoostClassifier2::getGoodFeatureViaTournament(const string &feat
 				if (_TRAINING_DEBUG) cout << "Got a Similar Feature" << endl; 
 				compareFeaturesAndDeleteWorse(candidates[i].feat, 
 											  similar[0],
-											  candidates[i].perf); 
+											  candidates[i].perf, 
+											  subsample); 
 				if (similar[0] != (Feature2*)NULL) {
 					cout << "Warning -- compareFeaturesAndDeleteWorse didn't set NULL to worse." << endl; 
 				}
@@ -721,6 +1469,29 @@ Feature2* GentleBoostClassifier2::getGoodFeatureViaTournament(const string &feat
 			<< " \tTimePerPatch " << candidates.back().perf.time_per_patch 
 			<< " \tCost " << featureCost(candidates.back().perf) << endl; 
 	}
+	
+	if (subsample != NULL) {
+		sort(candidates.begin(), candidates.end()); 
+		reverse(candidates.begin(), candidates.end()); 
+		Feature2* screenedBest = candidates.front().feat; 
+		
+		if (_TRAINING_DEBUG) cout << "Re-scoring " << candidates.size() << " finalists on the full training set." << endl; 
+		for (unsigned int i = 0; i < candidates.size(); i++) {
+			getPerformanceMeasures(candidates[i].feat, candidates[i].perf); 
+		}
+		sort(candidates.begin(), candidates.end()); 
+		reverse(candidates.begin(), candidates.end()); 
+		for (unsigned int i = 1; i < candidates.size(); i++) {
+			delete(candidates[i].feat); 
+		}
+		candidates.resize(1); 
+		
+		screeningRounds++; 
+		if (candidates.front().feat != screenedBest) screeningChanges++; 
+		cout << "Screening: " << subsample->patches.size() << " of " << trainingPatches.size()
+		<< " patches, " << numFinalists << " finalists re-scored; full-set re-scoring changed the chosen feature in "
+		<< screeningChanges << " of " << screeningRounds << " rounds." << endl; 
+	}
 	return candidates[0].feat; 
 }
 
@@ -738,17 +1509,24 @@ double GentleBoostClassifier2::featureCost(const PerformanceMetrics& a) {
 
 void GentleBoostClassifier2::compareFeaturesAndDeleteWorse(Feature2*& oldFeat1NewBetterFeat, 
 																  Feature2*& oldFeat2NewDeletedFeat,
-																  PerformanceMetrics& oldPerf1NewBetterPerf) const {
+																  PerformanceMetrics& oldPerf1NewBetterPerf,
+																  const TrainingSubsample* subsample) const {
 	if (_TRAINING_DEBUG) cout << "Comparing Features." << endl; 
 	PerformanceMetrics perf2; 
 	if (oldPerf1NewBetterPerf.chisq < 0 || oldPerf1NewBetterPerf.pos_rejects <0
 		|| oldPerf1NewBetterPerf.neg_rejects < 0) {
 		if (_TRAINING_DEBUG) cout << "Getting feature 1 Performance." << endl; 
-		getPerformanceMeasures(oldFeat1NewBetterFeat,
-							   oldPerf1NewBetterPerf); 
+		if (subsample != NULL) 
+			getScreeningPerformance(oldFeat1NewBetterFeat, oldPerf1NewBetterPerf, *subsample); 
+		else 
+			getPerformanceMeasures(oldFeat1NewBetterFeat,
+								   oldPerf1NewBetterPerf); 
 	}
 	if (_TRAINING_DEBUG) cout << "Getting feature 2 Performance." << endl; 
-	getPerformanceMeasures(oldFeat2NewDeletedFeat, perf2); 
+	if (subsample != NULL) 
+		getScreeningPerformance(oldFeat2NewDeletedFeat, perf2, *subsample); 
+	else 
+		getPerformanceMeasures(oldFeat2NewDeletedFeat, perf2); 
 	if (perf2 < oldPerf1NewBetterPerf) {
 		if (_TRAINING_DEBUG) cout << "Feature 2 was worse -- deleting"<< endl; 
 		delete(oldFeat2NewDeletedFeat); 
@@ -833,31 +1611,43 @@ void GentleBoostClassifier2::searchCurrentImageAtScale(vector<SearchResult>& kep
 													   vector<Rect> blacklistPatches,
 													   int spatialRadius, 
 													   int scaleRadius)  {	
+	searchPatchListAtScale(patchList, keptPatches, scale, NMSRadius, threshold, blacklistPatches, 
+						   spatialRadius, scaleRadius); 
+}
+
+void GentleBoostClassifier2::searchPatchListAtScale(PatchList2* list, 
+													vector<SearchResult>& keptPatches, 
+													int scale, 
+													int NMSRadius, 
+													double threshold,
+													const vector<Rect> &blacklistPatches,
+													int spatialRadius, 
+													int scaleRadius) const {	
 	keptPatches.clear(); 
 	
-	if (scale < 0 || scale >= patchList->getNumScales()) return; 
+	if (scale < 0 || scale >= list->getNumScales()) return; 
 	
 	
 	//patchlist->setImage(gray_image); 	
 	
 	if (_CASCADE_DEBUG) cout << "Searching image at scale " << scale << endl;
-	patchList->resetListToScale(scale);
+	list->resetListToScale(scale);
 	
-	if (_CASCADE_DEBUG) cout << patchList->getCurrentListLength() << " remaining patches." << endl; 
+	if (_CASCADE_DEBUG) cout << list->getCurrentListLength() << " remaining patches." << endl; 
 	for (int i = 0; i < numFeatures; i++) {
 		if (_CASCADE_DEBUG) cout << "Applying feature " << i << endl; 
-		features[i].predictPatchList(patchList); 
+		features[i].predictPatchList(list); 
 		
 		if (_CASCADE_DEBUG) cout << "Removing Patches" << endl; 
-		patchList->accumulateAndRemovePatchesBelowThreshold(featureRejectThresholds[i]); 
-		if (_CASCADE_DEBUG) cout << patchList->getCurrentListLength() << " remaining patches." << endl; 
+		list->accumulateAndRemovePatchesBelowThreshold(featureRejectThresholds[i]); 
+		if (_CASCADE_DEBUG) cout << list->getCurrentListLength() << " remaining patches." << endl; 
 	}
 	
-	if (NMSRadius > 0)	patchList->keepOnlyLocalMaxima(NMSRadius); 
+	if (NMSRadius > 0)	list->keepOnlyLocalMaxima(NMSRadius); 
 	
 	vector<SearchResult> scalePatches; 
 	if (_CASCADE_DEBUG) cout << "Getting remaining patches." << endl; 
-	patchList->getRemainingPatches(scalePatches, blacklistPatches, spatialRadius, scaleRadius);
+	list->getRemainingPatches(scalePatches, blacklistPatches, spatialRadius, scaleRadius);
 	
 	for (unsigned int i = 0; i < scalePatches.size(); i++) {
 		if (scalePatches[i].value > threshold) {
@@ -869,8 +1659,8 @@ void GentleBoostClassifier2::searchCurrentImageAtScale(vector<SearchResult>& kep
 	reverse(keptPatches.begin(), keptPatches.end());	
 	
 	if (_CASCADE_DEBUG) cout << "Image search at scale " << scale << " kept " 
-		<< keptPatches.size() << "/" << patchList->getTotalPatches() << "(" 
-		<< 100.0*keptPatches.size()/patchList->getTotalPatches() << "%)"<< endl; 
+		<< keptPatches.size() << "/" << list->getTotalPatches() << "(" 
+		<< 100.0*keptPatches.size()/list->getTotalPatches() << "%)"<< endl; 
 }
 
 void GentleBoostClassifier2::searchImage(const cv::Mat &gray_image, 
@@ -920,13 +1710,45 @@ void GentleBoostClassifier2::searchImage(const Mat &gray_image,
 												 int spatialRadius, 
 												 int scaleRadius) {
 	keptPatches.clear(); 
+	setCurrentImage(gray_image); 
+	searchAllScalesOfPatchList(patchList, keptPatches, NMSRadius, threshold, blacklistPatches); 
+	
+	if (_BLACKOUT_DEBUG) cout << "Image search kept " << keptPatches.size() << "/" << patchList->getTotalPatches() <<
+	"(" << 100.0*keptPatches.size()/patchList->getTotalPatches() << "%)"<< endl; 
+}
+
+void GentleBoostClassifier2::searchImage(const Mat &gray_image, 
+										 PatchList2* list, 
+										 vector<SearchResult>& keptPatches, 
+										 int NMSRadius, 
+										 double threshold) const {
+	keptPatches.clear(); 
+	if (features.size() == 0) {
+		cout << "Warning: Must have at least one feature before supplying an image to search." << endl; 
+		return; 
+	}
+	vector<Rect> blacklistPatches; 
+	list->setImage(gray_image); 
+	searchAllScalesOfPatchList(list, keptPatches, NMSRadius, threshold, blacklistPatches); 
+}
+
+PatchList2* GentleBoostClassifier2::createSearchPatchList() const {
+	if (useFast) return new FastPatchList2(fpl); 
+	return new PatchList2(pl); 
+}
+
+void GentleBoostClassifier2::searchAllScalesOfPatchList(PatchList2* list, 
+														vector<SearchResult>& keptPatches, 
+														int NMSRadius, 
+														double threshold,
+														const vector<Rect> &blacklistPatches) const {
+	keptPatches.clear(); 
 	vector<SearchResult> scalePatches; 
 	vector<Point> centers; 
 	vector<size_t>nextScaleStart; 
 	
-	setCurrentImage(gray_image); 
-	for (int j = 0; j < patchList->getNumScales(); j++) {
-		searchCurrentImageAtScale(scalePatches, j, NMSRadius, threshold, blacklistPatches); 
+	for (int j = 0; j < list->getNumScales(); j++) {
+		searchPatchListAtScale(list, scalePatches, j, NMSRadius, threshold, blacklistPatches); 
 		
 		for (unsigned int i = 0; i < scalePatches.size(); i++) {
 			if (scalePatches[i].value > threshold) {
@@ -945,9 +1767,6 @@ void GentleBoostClassifier2::searchImage(const Mat &gray_image,
 	
 	sort(keptPatches.begin(), keptPatches.end()); 
 	reverse(keptPatches.begin(), keptPatches.end()); 
-	
-	if (_BLACKOUT_DEBUG) cout << "Image search kept " << keptPatches.size() << "/" << patchList->getTotalPatches() <<
-	"(" << 100.0*keptPatches.size()/patchList->getTotalPatches() << "%)"<< endl; 
 }
 
 void GentleBoostClassifier2::sharePatchListWithClassifier(const GentleBoostClassifier2 &otherClassifier){
@@ -0,0 +1,54 @@
+/*
+ *  GentleBoostSearchContext2.cpp
+ *  OpenCV
+ *
+ */
+
+#include "GentleBoostSearchContext2.h"
+
+using namespace std;
+using namespace cv;
+
+GentleBoostSearchContext2::GentleBoostSearchContext2() {
+}
+
+GentleBoostSearchContext2::GentleBoostSearchContext2(const Ptr<GentleBoostClassifier2> &model) {
+	setModel(model);
+}
+
+GentleBoostSearchContext2::~GentleBoostSearchContext2() {
+}
+
+void GentleBoostSearchContext2::setModel(const Ptr<GentleBoostClassifier2> &model) {
+	this->model = model;
+	if (model.empty()) patchList.release();
+	else patchList = model->createSearchPatchList();
+}
+
+Ptr<GentleBoostClassifier2> GentleBoostSearchContext2::getModel() const {
+	return model;
+}
+
+void GentleBoostSearchContext2::searchImage(const Mat &gray_image,
+											vector<SearchResult>& keptPatches,
+											int NMSRadius,
+											double threshold) {
+	keptPatches.clear();
+	if (model.empty()) {
+		cout << "Warning: Must set a model before searching with a GentleBoostSearchContext2." << endl;
+		return;
+	}
+	model->searchImage(gray_image, patchList, keptPatches, NMSRadius, threshold);
+}
+
+int GentleBoostSearchContext2::getNumScales() const {
+	if (patchList.empty()) return -1;
+	return patchList->getNumScales();
+}
+
+Size GentleBoostSearchContext2::getSizeOfScale(int scale) const {
+	if (!patchList.empty() && scale >= 0 && scale < patchList->getNumScales()) {
+		return patchList->getPatchSizeAtScale(scale);
+	}
+	return Size(-1,-1);
+}
@@ -0,0 +1,704 @@
+/*
+ *  GentleBoostShards2.cpp
+ *  OpenCV
+ *
+ */
+
+#include "GentleBoostShards2.h"
+#include "Feature2.h"
+#include "NMPTUtils.h"
+#include "BlockTimer.h"
+#include "DebugGlobals.h"
+#include <sstream>
+#include <iostream>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+using namespace cv;
+using namespace std;
+
+//Requests sent from the coordinator to the workers.
+enum {
+	SHARD_INFO = 1,
+	SHARD_RESET,
+	SHARD_RANGE,
+	SHARD_LUT_STATS,
+	SHARD_EVALUATE,
+	SHARD_ADD_FEATURE,
+	SHARD_REWEIGHT,
+	SHARD_NORMALIZE,
+	SHARD_QUIT
+};
+
+enum {
+	EVALUATE_CURRENT = 0,
+	EVALUATE_WITHOUT,
+	EVALUATE_WITH
+};
+
+//Sent by the coordinator as the first message on every connection, and
+//echoed back by the worker, so that neither side talks to a peer running
+//something else (or another version of this protocol). 
+static const char handshakeMagic[8] = {'N','M','P','T','S','H','D','2'};
+static const int protocolVersion = 1;
+static const int handshakeBytes = sizeof(handshakeMagic) + sizeof(int);
+
+//Largest message either side accepts. Real messages are a few kilobytes; 
+//the cap keeps a bad peer from making us allocate the length it claims. 
+static const int maxMessageBytes = 64 << 20;
+
+//Messages are a 4-byte length followed by a binary payload.
+static int sendAll(int socket, const char* buf, size_t len) {
+	while (len > 0) {
+		ssize_t sent = send(socket, buf, len, MSG_NOSIGNAL);
+		if (sent <= 0) return 0;
+		buf += sent;
+		len -= sent;
+	}
+	return 1;
+}
+
+static int recvAll(int socket, char* buf, size_t len) {
+	while (len > 0) {
+		ssize_t got = recv(socket, buf, len, 0);
+		if (got <= 0) return 0;
+		buf += got;
+		len -= got;
+	}
+	return 1;
+}
+
+static int sendMessage(int socket, const string &message) {
+	int len = message.size();
+	return sendAll(socket, (const char*)&len, sizeof(int))
+		&& sendAll(socket, message.data(), len);
+}
+
+static int recvMessage(int socket, string &message, int maxLen = maxMessageBytes) {
+	int len = 0;
+	if (!recvAll(socket, (char*)&len, sizeof(int))) return 0;
+	if (len < 0 || len > maxLen) {
+		cout << "Warning: Training peer sent a message of " << len 
+		<< " bytes; the limit is " << maxLen << "." << endl;
+		return 0;
+	}
+	message.resize(len);
+	return len == 0 || recvAll(socket, &message[0], len);
+}
+
+static string handshakeMessage() {
+	ostringstream out(ios::out | ios::binary);
+	out.write(handshakeMagic, sizeof(handshakeMagic));
+	out.write((char*)&protocolVersion, sizeof(int));
+	return out.str();
+}
+
+static int isHandshake(const string &message) {
+	return message == handshakeMessage();
+}
+
+static void setNoDelay(int socket) {
+	int one = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(int));
+}
+
+static string beginRequest(int request) {
+	ostringstream out(ios::out | ios::binary);
+	out.write((char*)&request, sizeof(int));
+	return out.str();
+}
+
+GentleBoostShardCoordinator2::GentleBoostShardCoordinator2() {
+	numPos = 0;
+	numNeg = 0;
+	patchSize = Size(-1,-1);
+}
+
+GentleBoostShardCoordinator2::~GentleBoostShardCoordinator2() {
+	shutdown();
+}
+
+void GentleBoostShardCoordinator2::shutdown() {
+	string quit = beginRequest(SHARD_QUIT);
+	for (size_t i = 0; i < sockets.size(); i++) {
+		sendMessage(sockets[i], quit);
+		close(sockets[i]);
+	}
+	sockets.clear();
+	for (size_t i = 0; i < localPids.size(); i++) {
+		int status;
+		waitpid(localPids[i], &status, 0);
+	}
+	localPids.clear();
+	numPos = 0;
+	numNeg = 0;
+}
+
+int GentleBoostShardCoordinator2::spawnLocalWorkers(const PatchDataset2 &dataset, int numWorkers) {
+	shutdown();
+	int numPatches = dataset.getPatches().size();
+	if (numWorkers < 1 || numWorkers > numPatches) {
+		cout << "Warning: Can't split " << numPatches << " patches among "
+		<< numWorkers << " workers." << endl;
+		return 0;
+	}
+
+	cout.flush();
+	for (int k = 0; k < numWorkers; k++) {
+		int fds[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+			cout << "Warning: Couldn't create a socket pair for training worker " << k << endl;
+			shutdown();
+			return 0;
+		}
+		pid_t pid = fork();
+		if (pid < 0) {
+			cout << "Warning: Couldn't fork training worker " << k << endl;
+			close(fds[0]);
+			close(fds[1]);
+			shutdown();
+			return 0;
+		}
+		if (pid == 0) {
+			close(fds[0]);
+			for (size_t i = 0; i < sockets.size(); i++)
+				close(sockets[i]);
+			GentleBoostShardWorker2 worker(dataset, k, numWorkers);
+			worker.serve(fds[1]);
+			close(fds[1]);
+			cout.flush();
+			_exit(0);
+		}
+		close(fds[1]);
+		sockets.push_back(fds[0]);
+		localPids.push_back(pid);
+	}
+	return queryShardInfo();
+}
+
+int GentleBoostShardCoordinator2::connectToWorkers(const vector<string> &addresses) {
+	shutdown();
+	for (size_t i = 0; i < addresses.size(); i++) {
+		size_t colon = addresses[i].rfind(':');
+		if (colon == string::npos) {
+			cout << "Warning: Worker address " << addresses[i] << " is not host:port." << endl;
+			shutdown();
+			return 0;
+		}
+		string host = addresses[i].substr(0, colon);
+		string port = addresses[i].substr(colon+1);
+
+		struct addrinfo hints, *result, *rp;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) {
+			cout << "Warning: Couldn't resolve worker address " << addresses[i] << endl;
+			shutdown();
+			return 0;
+		}
+		int fd = -1;
+		for (rp = result; rp != NULL; rp = rp->ai_next) {
+			fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+			if (fd < 0) continue;
+			if (connect(fd, rp->ai_addr, rp->ai_addrlen) == 0) break;
+			close(fd);
+			fd = -1;
+		}
+		freeaddrinfo(result);
+		if (fd < 0) {
+			cout << "Warning: Couldn't connect to worker " << addresses[i] << endl;
+			shutdown();
+			return 0;
+		}
+		setNoDelay(fd);
+		sockets.push_back(fd);
+	}
+	return queryShardInfo();
+}
+
+int GentleBoostShardCoordinator2::queryShardInfo() {
+	string hello = handshakeMessage();
+	for (size_t i = 0; i < sockets.size(); i++) {
+		string reply;
+		if (!sendMessage(sockets[i], hello) || !recvMessage(sockets[i], reply, handshakeBytes)
+			|| !isHandshake(reply)) {
+			cout << "Warning: Training worker " << i << " isn't a version " << protocolVersion
+			<< " GentleBoostShardWorker2." << endl;
+			shutdown();
+			return 0;
+		}
+	}
+	
+	broadcast(beginRequest(SHARD_INFO));
+	vector<string> replies;
+	gather(replies);
+	numPos = 0;
+	numNeg = 0;
+	for (size_t i = 0; i < replies.size(); i++) {
+		istringstream in(replies[i], ios::in | ios::binary);
+		int shardPos, shardNeg;
+		Size shardSize;
+		in.read((char*)&shardPos, sizeof(int));
+		in.read((char*)&shardNeg, sizeof(int));
+		in.read((char*)&shardSize.width, sizeof(int));
+		in.read((char*)&shardSize.height, sizeof(int));
+		if (i == 0) patchSize = shardSize;
+		if (shardSize != patchSize) {
+			cout << "Warning: Training workers have different patch sizes." << endl;
+			shutdown();
+			return 0;
+		}
+		numPos += shardPos;
+		numNeg += shardNeg;
+	}
+	if (_CASCADE_DEBUG) cout << "Connected to " << sockets.size() << " training workers with "
+		<< numPos << " pos patches and " << numNeg << " neg patches." << endl;
+	return !sockets.empty();
+}
+
+void GentleBoostShardCoordinator2::broadcast(const string &request) {
+	for (size_t i = 0; i < sockets.size(); i++) {
+		if (!sendMessage(sockets[i], request))
+			CV_Error(CV_StsError, "Lost connection to a training worker.");
+	}
+}
+
+void GentleBoostShardCoordinator2::gather(vector<string> &replies) {
+	replies.resize(sockets.size());
+	for (size_t i = 0; i < sockets.size(); i++) {
+		if (!recvMessage(sockets[i], replies[i]))
+			CV_Error(CV_StsError, "Lost connection to a training worker.");
+	}
+}
+
+int GentleBoostShardCoordinator2::getNumShards() const {
+	return sockets.size();
+}
+
+int GentleBoostShardCoordinator2::getNumPos() const {
+	return numPos;
+}
+
+int GentleBoostShardCoordinator2::getNumNeg() const {
+	return numNeg;
+}
+
+Size GentleBoostShardCoordinator2::getPatchSize() const {
+	return patchSize;
+}
+
+void GentleBoostShardCoordinator2::reset() {
+	ostringstream out(ios::out | ios::binary);
+	out << beginRequest(SHARD_RESET);
+	int totalPatches = numPos + numNeg;
+	out.write((char*)&totalPatches, sizeof(int));
+	broadcast(out.str());
+	vector<string> replies;
+	gather(replies);
+}
+
+void GentleBoostShardCoordinator2::getFeatureRange(const Feature2* feature, double &minVal, double &maxVal) {
+	ostringstream out(ios::out | ios::binary);
+	out << beginRequest(SHARD_RANGE);
+	feature->addToStreamBinary(out);
+	broadcast(out.str());
+	vector<string> replies;
+	gather(replies);
+
+	minVal = INFINITY;
+	maxVal = -INFINITY;
+	for (size_t i = 0; i < replies.size(); i++) {
+		istringstream in(replies[i], ios::in | ios::binary);
+		double shardMin, shardMax;
+		in.read((char*)&shardMin, sizeof(double));
+		in.read((char*)&shardMax, sizeof(double));
+		minVal = shardMin < minVal ? shardMin : minVal;
+		maxVal = shardMax > maxVal ? shardMax : maxVal;
+	}
+}
+
+void GentleBoostShardCoordinator2::getLUTStatistics(const Feature2* feature, int numTableElements,
+													double minVal, double maxVal,
+													Mat &numerator, Mat &denominator) {
+	ostringstream out(ios::out | ios::binary);
+	out << beginRequest(SHARD_LUT_STATS);
+	feature->addToStreamBinary(out);
+	out.write((char*)&numTableElements, sizeof(int));
+	out.write((char*)&minVal, sizeof(double));
+	out.write((char*)&maxVal, sizeof(double));
+	broadcast(out.str());
+	vector<string> replies;
+	gather(replies);
+
+	numerator = Mat();
+	denominator = Mat();
+	for (size_t i = 0; i < replies.size(); i++) {
+		istringstream in(replies[i], ios::in | ios::binary);
+		Mat shardNum, shardDen;
+		NMPTUtils::readMatFromStreamBinary(in, shardNum);
+		NMPTUtils::readMatFromStreamBinary(in, shardDen);
+		if (i == 0) {
+			numerator = shardNum;
+			denominator = shardDen;
+		} else {
+			numerator += shardNum;
+			denominator += shardDen;
+		}
+	}
+}
+
+static void sumEvaluations(const vector<string> &replies, GentleBoostShardCoordinator2::Evaluation &eval) {
+	eval.chisq = 0;
+	eval.prevPosRejects = 0;
+	eval.prevNegRejects = 0;
+	eval.seconds = 0;
+	for (size_t i = 0; i < replies.size(); i++) {
+		istringstream in(replies[i], ios::in | ios::binary);
+		double chisq, seconds;
+		int posRejects, negRejects;
+		in.read((char*)&chisq, sizeof(double));
+		in.read((char*)&posRejects, sizeof(int));
+		in.read((char*)&negRejects, sizeof(int));
+		in.read((char*)&seconds, sizeof(double));
+		eval.chisq += chisq;
+		eval.prevPosRejects += posRejects;
+		eval.prevNegRejects += negRejects;
+		eval.seconds += seconds;
+	}
+}
+
+void GentleBoostShardCoordinator2::evaluateCurrent(Evaluation &eval) {
+	ostringstream out(ios::out | ios::binary);
+	out << beginRequest(SHARD_EVALUATE);
+	int mode = EVALUATE_CURRENT;
+	out.write((char*)&mode, sizeof(int));
+	broadcast(out.str());
+	vector<string> replies;
+	gather(replies);
+	sumEvaluations(replies, eval);
+}
+
+void GentleBoostShardCoordinator2::evaluateWithout(int index, Evaluation &eval) {
+	ostringstream out(ios::out | ios::binary);
+	out << beginRequest(SHARD_EVALUATE);
+	int mode = EVALUATE_WITHOUT;
+	out.write((char*)&mode, sizeof(int));
+	out.write((char*)&index, sizeof(int));
+	broadcast(out.str());
+	vector<string> replies;
+	gather(replies);
+	sumEvaluations(replies, eval);
+}
+
+void GentleBoostShardCoordinator2::evaluateWith(const FeatureRegressor2 &reg, Evaluation &eval) {
+	ostringstream out(ios::out | ios::binary);
+	out << beginRequest(SHARD_EVALUATE);
+	int mode = EVALUATE_WITH;
+	out.write((char*)&mode, sizeof(int));
+	reg.addToStreamBinary(out);
+	broadcast(out.str());
+	vector<string> replies;
+	gather(replies);
+	sumEvaluations(replies, eval);
+}
+
+void GentleBoostShardCoordinator2::addFeature(const FeatureRegressor2 &reg, double threshold) {
+	//Adding a feature takes three steps, because the weight update rescales
+	//by the largest weight and normalizes by the weight sum, both of which
+	//are taken over all shards.
+	vector<string> replies;
+
+	ostringstream out(ios::out | ios::binary);
+	out << beginRequest(SHARD_ADD_FEATURE);
+	reg.addToStreamBinary(out);
+	out.write((char*)&threshold, sizeof(double));
+	broadcast(out.str());
+	gather(replies);
+	double maxWeight = -INFINITY;
+	for (size_t i = 0; i < replies.size(); i++) {
+		istringstream in(replies[i], ios::in | ios::binary);
+		double shardMax;
+		in.read((char*)&shardMax, sizeof(double));
+		maxWeight = shardMax > maxWeight ? shardMax : maxWeight;
+	}
+
+	ostringstream reweight(ios::out | ios::binary);
+	reweight << beginRequest(SHARD_REWEIGHT);
+	reweight.write((char*)&maxWeight, sizeof(double));
+	broadcast(reweight.str());
+	gather(replies);
+	double weightSum = 0;
+	for (size_t i = 0; i < replies.size(); i++) {
+		istringstream in(replies[i], ios::in | ios::binary);
+		double shardSum;
+		in.read((char*)&shardSum, sizeof(double));
+		weightSum += shardSum;
+	}
+
+	ostringstream normalize(ios::out | ios::binary);
+	normalize << beginRequest(SHARD_NORMALIZE);
+	normalize.write((char*)&weightSum, sizeof(double));
+	broadcast(normalize.str());
+	gather(replies);
+}
+
+
+GentleBoostShardWorker2::GentleBoostShardWorker2(const PatchDataset2 &dataset, int shardIndex, int numShards) {
+	vector<ImagePatch2> allPatches = dataset.getPatches();
+	Mat allLabels;
+	dataset.getLabels(allLabels);
+
+	vector<ImagePatch2> patches;
+	Mat labels;
+	for (size_t i = shardIndex; i < allPatches.size(); i += numShards) {
+		patches.push_back(allPatches[i]);
+		labels.push_back(allLabels.row(i));
+	}
+
+	if (patches.empty()) {
+		cout << "Warning: Training worker " << shardIndex << " of " << numShards
+		<< " has no patches." << endl;
+		return;
+	}
+	shard.setTrainingSet(patches, labels);
+}
+
+int GentleBoostShardWorker2::waitForCoordinator(int port, const string &interfaceAddress) {
+	ostringstream portName;
+	portName << port;
+	struct addrinfo hints, *result, *rp;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(interfaceAddress.c_str(), portName.str().c_str(), &hints, &result) != 0) {
+		cout << "Warning: Couldn't resolve interface address " << interfaceAddress << endl;
+		return -1;
+	}
+	int listener = -1;
+	for (rp = result; rp != NULL; rp = rp->ai_next) {
+		listener = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (listener < 0) continue;
+		int one = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (char*)&one, sizeof(int));
+		if (bind(listener, rp->ai_addr, rp->ai_addrlen) == 0 && listen(listener, 1) == 0) break;
+		close(listener);
+		listener = -1;
+	}
+	freeaddrinfo(result);
+	if (listener < 0) {
+		cout << "Warning: Couldn't listen on " << interfaceAddress << " port " << port << endl;
+		return -1;
+	}
+
+	int fd = accept(listener, NULL, NULL);
+	close(listener);
+	if (fd < 0) {
+		cout << "Warning: Couldn't accept a coordinator connection." << endl;
+		return -1;
+	}
+	setNoDelay(fd);
+	return fd;
+}
+
+int GentleBoostShardWorker2::serve(int socket) {
+	string message;
+	if (!recvMessage(socket, message, handshakeBytes) || !isHandshake(message)) {
+		cout << "Warning: Training worker was contacted by something other than a version "
+		<< protocolVersion << " GentleBoostShardCoordinator2." << endl;
+		return 0;
+	}
+	if (!sendMessage(socket, message)) {
+		cout << "Warning: Training worker lost its connection to the coordinator." << endl;
+		return 0;
+	}
+	
+	while (recvMessage(socket, message)) {
+		istringstream in(message, ios::in | ios::binary);
+		int request = 0;
+		in.read((char*)&request, sizeof(int));
+		if (request == SHARD_QUIT) return 1;
+
+		ostringstream out(ios::out | ios::binary);
+		handleRequest(request, in, out);
+		if (!sendMessage(socket, out.str())) break;
+	}
+	cout << "Warning: Training worker lost its connection to the coordinator." << endl;
+	return 0;
+}
+
+void GentleBoostShardWorker2::handleRequest(int request, istream &in, ostream &out) {
+	const vector<ImagePatch2> &patches = shard.trainingPatches;
+	int numPatches = patches.size();
+
+	switch (request) {
+		case SHARD_INFO: {
+			int numPos = shard.posPatches.size(), numNeg = shard.negPatches.size();
+			Size size = numPatches > 0 ? patches[0].getImageSize() : Size(0,0);
+			out.write((char*)&numPos, sizeof(int));
+			out.write((char*)&numNeg, sizeof(int));
+			out.write((char*)&size.width, sizeof(int));
+			out.write((char*)&size.height, sizeof(int));
+			break;
+		}
+		case SHARD_RESET: {
+			//Same initial state as GentleBoostClassifier2::searchPatches, but
+			//with weights uniform over the patches of all shards.
+			int totalPatches = 1;
+			in.read((char*)&totalPatches, sizeof(int));
+			shard.features.clear();
+			shard.featureRejectThresholds.clear();
+			shard.numFeatures = 0;
+			shard.trainingFeatureOutputs.clear();
+			shard.trainingFeatureSum = Mat::zeros(numPatches, 1, CV_64F);
+			shard.trainingWeights = Mat::zeros(numPatches, 1, CV_64F) + 1.0/totalPatches;
+			shard.trainingPosteriors = Mat::zeros(numPatches, 1, CV_64F) + 0.5;
+			shard.trainingPredictions = Mat::zeros(numPatches, 1, CV_64F) - 1.;
+			shard.trainingSurvived.create(numPatches, 1, CV_8U);
+			shard.trainingSurvived.setTo(255);
+			int ack = 1;
+			out.write((char*)&ack, sizeof(int));
+			break;
+		}
+		case SHARD_RANGE: {
+			Feature2* feature = Feature2::readFromStreamBinary(in);
+			double minVal = INFINITY, maxVal = -INFINITY;
+			if (feature != NULL && numPatches > 0) {
+				Mat vals;
+				feature->evaluateImagePatches(patches, vals);
+				minMaxLoc(vals, &minVal, &maxVal);
+			}
+			delete(feature);
+			out.write((char*)&minVal, sizeof(double));
+			out.write((char*)&maxVal, sizeof(double));
+			break;
+		}
+		case SHARD_LUT_STATS: {
+			Feature2* feature = Feature2::readFromStreamBinary(in);
+			int numTableElements = 0;
+			double minVal = 0, maxVal = 0;
+			in.read((char*)&numTableElements, sizeof(int));
+			in.read((char*)&minVal, sizeof(double));
+			in.read((char*)&maxVal, sizeof(double));
+			Mat vals, numerator, denominator;
+			if (feature != NULL && numPatches > 0)
+				feature->evaluateImagePatches(patches, vals);
+			else
+				vals.create(0, 1, CV_64F);
+			delete(feature);
+			FeatureRegressor2::getLUTStatistics(numTableElements, vals, shard.trainingLabels,
+												shard.trainingWeights, minVal, maxVal,
+												numerator, denominator);
+			NMPTUtils::writeMatToStreamBinary(out, numerator);
+			NMPTUtils::writeMatToStreamBinary(out, denominator);
+			break;
+		}
+		case SHARD_EVALUATE: {
+			//Mirrors GentleBoostClassifier2::getPerformanceMeasures on this shard.
+			int mode = EVALUATE_CURRENT;
+			in.read((char*)&mode, sizeof(int));
+			Mat newSum;
+			double seconds = 0;
+			if (mode == EVALUATE_WITHOUT) {
+				int index = 0;
+				in.read((char*)&index, sizeof(int));
+				newSum = shard.trainingFeatureSum - shard.trainingFeatureOutputs[index];
+			} else if (mode == EVALUATE_WITH) {
+				FeatureRegressor2 reg;
+				reg.readFromStreamBinary(in);
+				BlockTimer bt;
+				bt.blockRestart(0);
+				reg.predict(patches, newSum);
+				seconds = bt.getCurrTime(0);
+				shard.accumulateEvidence(shard.trainingFeatureSum, newSum, shard.trainingSurvived);
+			} else {
+				newSum = shard.trainingFeatureSum.clone();
+			}
+
+			int posRejects = 0, negRejects = 0;
+			for (int i = 0; i < numPatches; i++) {
+				if (shard.trainingSurvived.at<uint8_t>(i,0)) continue;
+				if (shard.trainingLabels.at<double>(i,0) > 0) posRejects++;
+				else negRejects++;
+			}
+
+			double chisq = 0;
+			if (numPatches > 0) {
+				Mat prob;
+				shard.calcPosterior(newSum, prob);
+				chisq = shard.getChiSq(shard.trainingLabels, prob);
+			}
+			out.write((char*)&chisq, sizeof(double));
+			out.write((char*)&posRejects, sizeof(int));
+			out.write((char*)&negRejects, sizeof(int));
+			out.write((char*)&seconds, sizeof(double));
+			break;
+		}
+		case SHARD_ADD_FEATURE: {
+			//First third of GentleBoostClassifier2::updateValuesForFeature.
+			FeatureRegressor2 reg;
+			double threshold = -INFINITY;
+			reg.readFromStreamBinary(in);
+			in.read((char*)&threshold, sizeof(double));
+			shard.features.push_back(reg);
+			shard.featureRejectThresholds.push_back(threshold);
+			shard.numFeatures = shard.features.size();
+
+			double minWeight = 0, maxWeight = -INFINITY;
+			if (numPatches > 0) {
+				reg.predict(patches, pendingOutput);
+				shard.accumulateEvidence(pendingOutput, shard.trainingFeatureSum, shard.trainingSurvived);
+				shard.updateSurvivedList(shard.trainingFeatureSum, threshold, shard.trainingSurvived);
+				minMaxLoc(shard.trainingWeights, &minWeight, &maxWeight);
+			} else {
+				pendingOutput = Mat();
+			}
+			out.write((char*)&maxWeight, sizeof(double));
+			break;
+		}
+		case SHARD_REWEIGHT: {
+			double maxWeight = 0;
+			in.read((char*)&maxWeight, sizeof(double));
+			double weightSum = 0;
+			if (numPatches > 0) {
+				shard.reweight(pendingOutput, shard.trainingLabels, shard.trainingWeights,
+							   shard.trainingSurvived, maxWeight);
+				weightSum = norm(shard.trainingWeights, NORM_L1);
+			}
+			out.write((char*)&weightSum, sizeof(double));
+			break;
+		}
+		case SHARD_NORMALIZE: {
+			double weightSum = 0;
+			in.read((char*)&weightSum, sizeof(double));
+			if (numPatches > 0) {
+				//Same scale as normalize(..., NORM_L1) over the whole set.
+				double scale = weightSum > DBL_EPSILON ? 1./weightSum : 0.;
+				shard.trainingWeights.convertTo(shard.trainingWeights, -1, scale);
+				shard.calcPosterior(shard.trainingFeatureSum, shard.trainingPosteriors);
+				shard.makePredictions(shard.trainingFeatureSum, shard.trainingPredictions,
+									  shard.trainingSurvived);
+			}
+			shard.trainingFeatureOutputs.push_back(pendingOutput.clone());
+			int ack = 1;
+			out.write((char*)&ack, sizeof(int));
+			break;
+		}
+		default:
+			cout << "Warning: Training worker got unknown request " << request << endl;
+			break;
+	}
+}
@@ -0,0 +1,123 @@
+/*
+ *  ImageCache2.cpp
+ *  OpenCV
+ *
+ */
+
+#include "ImageCache2.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+using namespace std;
+using namespace cv;
+
+static ImageCache2 sharedImageCache;
+
+ImageCache2& ImageCache2::getSharedCache() {
+	return sharedImageCache;
+}
+
+ImageCache2::ImageCache2(size_t byteBudget) : budget(byteBudget), used(0), hits(0), misses(0) {
+}
+
+int ImageCache2::getImage(const string &filename, Mat &image, Mat *integralImage) {
+	Mat newImage, newIntegral;
+	bool found = false;
+	{
+		AutoLock l(lock);
+		map<string, Entry>::iterator it = entries.find(filename);
+		if (it != entries.end()) {
+			lru.splice(lru.begin(), lru, it->second.lruPosition);
+			found = true;
+			newImage = it->second.image;
+			newIntegral = it->second.integralImage;
+			if (integralImage == NULL || !newIntegral.empty()) {
+				hits++;
+				image = newImage;
+				if (integralImage != NULL) *integralImage = newIntegral;
+				return 1;
+			}
+		}
+	}
+
+	// Decode, and integrate if asked to, without holding the lock.
+	if (!found) newImage = imread(filename, 0); //0 means CV_LOAD_IMAGE_GRAYSCALE
+	if (newImage.empty()) {
+		AutoLock l(lock);
+		misses++;
+		return 0;
+	}
+	if (integralImage != NULL) integral(newImage, newIntegral, CV_32S);
+
+	{
+		AutoLock l(lock);
+		if (found) hits++;
+		else misses++;
+
+		map<string, Entry>::iterator it = entries.find(filename);
+		if (it == entries.end()) {
+			size_t bytes = newImage.total()*newImage.elemSize() + newIntegral.total()*newIntegral.elemSize();
+			if (budget > 0 && bytes <= budget) {
+				lru.push_front(filename);
+				Entry &e = entries[filename];
+				e.image = newImage;
+				e.integralImage = newIntegral;
+				e.bytes = bytes;
+				e.lruPosition = lru.begin();
+				used += bytes;
+			}
+		} else if (!newIntegral.empty() && it->second.integralImage.empty()) {
+			size_t bytes = newIntegral.total()*newIntegral.elemSize();
+			it->second.integralImage = newIntegral;
+			it->second.bytes += bytes;
+			used += bytes;
+		} else if (!it->second.integralImage.empty()) {
+			// Another thread cached this image meanwhile; share its data.
+			newImage = it->second.image;
+			newIntegral = it->second.integralImage;
+		}
+		evictToBudget();
+	}
+
+	image = newImage;
+	if (integralImage != NULL) *integralImage = newIntegral;
+	return 1;
+}
+
+void ImageCache2::evictToBudget() {
+	while (used > budget && !lru.empty()) {
+		map<string, Entry>::iterator it = entries.find(lru.back());
+		used -= it->second.bytes;
+		entries.erase(it);
+		lru.pop_back();
+	}
+}
+
+void ImageCache2::setByteBudget(size_t byteBudget) {
+	AutoLock l(lock);
+	budget = byteBudget;
+	evictToBudget();
+}
+
+size_t ImageCache2::getByteBudget() const {
+	AutoLock l(lock);
+	return budget;
+}
+
+size_t ImageCache2::getBytesUsed() const {
+	AutoLock l(lock);
+	return used;
+}
+
+void ImageCache2::getStats(long long &hits, long long &misses) const {
+	AutoLock l(lock);
+	hits = this->hits;
+	misses = this->misses;
+}
+
+void ImageCache2::clear() {
+	AutoLock l(lock);
+	entries.clear();
+	lru.clear();
+	used = 0;
+}
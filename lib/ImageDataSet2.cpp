@@ -8,6 +8,8 @@
  */
 
 #include "ImageDataSet2.h"
+#include "ImageCache2.h"
+#include "NMPTUtils.h"
 #include <fstream>
 #include <stdlib.h>
 #include <string.h>
@@ -140,6 +142,10 @@ std::string ImageDataSet2::getFileName(int fileNumber) const{
 	return filenames[fileNumber]; 
 } 	
 
+int ImageDataSet2::getImage(int fileNumber, Mat &image, Mat *integralImage) const {
+	return ImageCache2::getSharedCache().getImage(filenames[fileNumber], image, integralImage); 
+}
+
 vector<double> ImageDataSet2::getFileLabels(int fileNumber) const{
 	vector<double> retval; 
 	return labels.empty()? retval: labels[fileNumber]; 
@@ -157,6 +163,34 @@ int ImageDataSet2::empty() const {
 	return filenames.empty(); 
 }
 
+void ImageDataSet2::addToStreamBinary(ostream &out) const {
+	int size = filenames.size(); 
+	int numLabels = numLabelsPerImage(); 
+	out.write((char*)&size, sizeof(int)); 
+	out.write((char*)&numLabels, sizeof(int)); 
+	for (int i = 0; i < size; i++) {
+		NMPTUtils::writeStringToStreamBinary(out, filenames[i]); 
+		if (numLabels > 0) 
+			out.write((char*)&labels[i][0], numLabels*sizeof(double)); 
+	}
+}
+
+void ImageDataSet2::readFromStreamBinary(istream &in) {
+	int size = 0, numLabels = 0; 
+	in.read((char*)&size, sizeof(int)); 
+	in.read((char*)&numLabels, sizeof(int)); 
+	filenames.clear(); 
+	labels.clear(); 
+	for (int i = 0; i < size && in; i++) {
+		string fname; 
+		NMPTUtils::readStringFromStreamBinary(in, fname); 
+		vector<double> entryLabels(numLabels); 
+		if (numLabels > 0) 
+			in.read((char*)&entryLabels[0], numLabels*sizeof(double)); 
+		addEntry(fname, entryLabels); 
+	}
+}
+
 FileStorage& operator << (cv::FileStorage &fs, const ImageDataSet2 &rhs) {
 	fs << "{" << "empty" << rhs.empty(); 
 	if (!rhs.empty()) {
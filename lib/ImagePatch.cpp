@@ -220,6 +220,10 @@ Size ImagePatch::getIntegralSize() const {
 	return intData.size(); 
 }
 
+size_t ImagePatch::getMemoryUsage() const {
+	return imgData.total()*imgData.elemSize() + intData.total()*intData.elemSize(); 
+}
+
 IplImage* ImagePatch::getImageHeader() const {
 	if (imgData.data == NULL) return NULL; 
 	IplImage* retval = cvCreateImageHeader( getImageSize(), IPL_DEPTH_8U, 1 ); 
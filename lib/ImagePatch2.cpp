@@ -18,6 +18,27 @@
 using namespace std; 
 using namespace cv; 
 
+/* Copy an integral view into compact storage, subtracting the sums above and
+ * to the left of the viewed region so that the copy starts from zero. */
+template <typename T> 
+static void rebaseIntegral(const Mat &view, Mat &dest) {
+	Mat rebased(view.size(), view.type()); 
+	const T* top = view.ptr<T>(0); 
+	for (int y = 0; y < view.rows; y++) {
+		const T* src = view.ptr<T>(y); 
+		T* dst = rebased.ptr<T>(y); 
+		T left = src[0] - top[0]; 
+		for (int x = 0; x < view.cols; x++) {
+			dst[x] = src[x] - top[x] - left; 
+		}
+	}
+	dest = rebased; 
+}
+
+static int isSharedOrView(const Mat &m) {
+	return m.data != NULL && (m.isSubmatrix() || (m.refcount != NULL && *m.refcount > 1)); 
+}
+
 ImagePatch2::ImagePatch2() {
 }
 
@@ -85,6 +106,81 @@ void ImagePatch2::setImage(const Mat &image, Rect ROI, int setData, int setInteg
 	if (!setSqInt) sqIntData = Mat(); //clear sq integral if it wasn't wanted
 }
 
+int ImagePatch2::setRepresentations(const Mat &image, const Mat &integral, 
+									const Mat &sqIntegral, const Mat &tIntegral) {
+	Size imSize(-1, -1); 
+	if (!image.empty()) imSize = image.size(); 
+	const Mat* ints[3] = {&integral, &sqIntegral, &tIntegral}; 
+	int types[3] = {CV_32SC1, CV_64FC1, CV_32SC1}; 
+	for (int i = 0; i < 3; i++) {
+		if (ints[i]->empty()) continue; 
+		if (ints[i]->type() != types[i]) {
+			cout << "Warning: ImagePatch2 integral representation has the wrong type." << endl; 
+			return 0; 
+		}
+		Size s(ints[i]->cols-1, ints[i]->rows-1); 
+		if (imSize.width < 0) imSize = s; 
+		if (s != imSize) {
+			cout << "Warning: ImagePatch2 representations have inconsistent sizes." << endl; 
+			return 0; 
+		}
+	}
+	if (!image.empty() && image.type() != CV_8UC1) {
+		cout << "Warning: ImagePatch2 image representation must be 8-bit single channel." << endl; 
+		return 0; 
+	}
+	imgData = image; 
+	intData = integral; 
+	sqIntData = sqIntegral; 
+	tIntData = tIntegral; 
+	return 1; 
+}
+
+int ImagePatch2::setRepresentationsView(const Mat &image, const Mat &integral, Rect ROI, 
+										const Mat &sqIntegral, const Mat &tIntegral) {
+	Size imSize(-1, -1); 
+	if (!image.empty()) imSize = image.size(); 
+	const Mat* ints[3] = {&integral, &sqIntegral, &tIntegral}; 
+	for (int i = 0; i < 3 && imSize.width < 0; i++) {
+		if (!ints[i]->empty()) imSize = Size(ints[i]->cols-1, ints[i]->rows-1); 
+	}
+	if (ROI.x < 0 || ROI.y < 0 || ROI.width <= 0 || ROI.height <= 0 
+		|| ROI.x+ROI.width > imSize.width || ROI.y+ROI.height > imSize.height) {
+		cout << "Warning: ImagePatch2 view region is outside the image." << endl; 
+		return 0; 
+	}
+	Rect intROI(ROI.x, ROI.y, ROI.width+1, ROI.height+1); 
+	Mat views[3]; 
+	for (int i = 0; i < 3; i++) {
+		if (ints[i]->empty()) continue; 
+		if (ints[i]->cols-1 != imSize.width || ints[i]->rows-1 != imSize.height) {
+			cout << "Warning: ImagePatch2 representations have inconsistent sizes." << endl; 
+			return 0; 
+		}
+		views[i] = (*ints[i])(intROI); 
+	}
+	return setRepresentations(image.empty() ? Mat() : image(ROI), views[0], views[1], views[2]); 
+}
+
+void ImagePatch2::detach() {
+	if (!(isSharedOrView(imgData) || isSharedOrView(intData) 
+		  || isSharedOrView(sqIntData) || isSharedOrView(tIntData))) return; 
+	
+	imgData = imgData.clone(); 
+	if (!intData.empty()) rebaseIntegral<int>(intData, intData); 
+	if (!sqIntData.empty()) rebaseIntegral<double>(sqIntData, sqIntData); 
+	if (!tIntData.empty()) {
+		//Tilted sums reach outside the region, so they can't be rebased from it. 
+		if (hasImageRep()) {
+			Mat sum, sqsum; 
+			integral(imgData, sum, sqsum, tIntData, CV_32S); 
+		} else {
+			cout << "Warning: Can't detach a tilted integral without image data; dropping it." << endl; 
+			tIntData = Mat(); 
+		}
+	}
+}
+
 Size ImagePatch2::getImageSize() const {
 	if (hasImageRep() )
 		return imgData.size();
@@ -159,6 +255,29 @@ void ImagePatch2::createRepIfNeeded(int setData, int setIntegral, int setSqInt,
 	}
 }
 
+void ImagePatch2::addToStreamBinary(ostream &out) const {
+	char reps[4] = {(char)hasImageRep(), (char)hasIntegralRep(), 
+		(char)hasSqIntegralRep(), (char)hasTIntegralRep()}; 
+	out.write(reps, 4*sizeof(char)); 
+	if (reps[0]) NMPTUtils::writeMatToStreamBinary(out, imgData); 
+	if (reps[1]) NMPTUtils::writeMatToStreamBinary(out, intData); 
+	if (reps[2]) NMPTUtils::writeMatToStreamBinary(out, sqIntData); 
+	if (reps[3]) NMPTUtils::writeMatToStreamBinary(out, tIntData); 
+}
+
+void ImagePatch2::readFromStreamBinary(istream &in) {
+	char reps[4] = {0, 0, 0, 0}; 
+	in.read(reps, 4*sizeof(char)); 
+	imgData = Mat(); 
+	intData = Mat(); 
+	sqIntData = Mat(); 
+	tIntData = Mat(); 
+	if (reps[0]) NMPTUtils::readMatFromStreamBinary(in, imgData); 
+	if (reps[1]) NMPTUtils::readMatFromStreamBinary(in, intData); 
+	if (reps[2]) NMPTUtils::readMatFromStreamBinary(in, sqIntData); 
+	if (reps[3]) NMPTUtils::readMatFromStreamBinary(in, tIntData); 
+}
+
 FileStorage& operator << (cv::FileStorage &fs, const ImagePatch2 &rhs) {
 	Mat im; 
 	rhs.getImageRep(im); 
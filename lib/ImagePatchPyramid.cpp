@@ -9,7 +9,9 @@
 
 #include "ImagePatchPyramid.h"
 #include "DebugGlobals.h"
+#include "NMPTUtils.h"
 #include <fstream>
+#include <sstream>
 #include <stdio.h>
 #include <opencv2/imgproc/imgproc_c.h>
 #include <opencv2/highgui/highgui_c.h>
@@ -31,6 +33,8 @@ ImagePatchPyramid::ImagePatchPyramid() {
 	foveaRepresentation=NULL;
 	currentScaledImage=NULL;
 	detector = NULL; 
+	cacheDetections = 0; 
+	detectorHasFrame = 0; 
 }
 
 
@@ -38,7 +42,7 @@ ImagePatchPyramid::ImagePatchPyramid() {
  * \brief Deep Copy Constructor: Create an IPP that is identical to 
  * the one copied.
  **/
-ImagePatchPyramid::ImagePatchPyramid(ImagePatchPyramid* ippToCopy) {
+ImagePatchPyramid::ImagePatchPyramid(const ImagePatchPyramid* ippToCopy, int copyDetector) {
 	
 	minw = 60; 
 	minh = 45; 
@@ -60,14 +64,17 @@ ImagePatchPyramid::ImagePatchPyramid(ImagePatchPyramid* ippToCopy) {
 	this->gridSize = ippToCopy->gridSize; 
 	
 	this->repeatFirstScale = ippToCopy->repeatFirstScale; 
+	this->cacheDetections = ippToCopy->cacheDetections; 
 	this->observeOff = ippToCopy->observeOff; 
 	
 	this->minw = ippToCopy->minw; 
 	this->minh = ippToCopy->minh; 
 	this->numSubImages = ippToCopy->numSubImages; 
 	
-	if (ippToCopy->detector)
-		this->detector = new OpenCVHaarDetector(ippToCopy->detector); 
+	this->detectorHasFrame = 0; 
+	
+	if (ippToCopy->detector && copyDetector)
+		this->detector = ippToCopy->detector->clone(); 
 	
 	if (ippToCopy->objectCount)
 		this->objectCount = cvCloneImage(ippToCopy->objectCount); 
@@ -100,7 +107,7 @@ ImagePatchPyramid::ImagePatchPyramid(ImagePatchPyramid* ippToCopy) {
 }
 
 ImagePatchPyramid::ImagePatchPyramid(CvSize inputImageSize, CvSize subImageSize, CvSize gridSize, 
-									 int numSubImages, CvMat* subImageGridPoints, OpenCVHaarDetector* detector){
+									 int numSubImages, CvMat* subImageGridPoints, ObjectDetector* detector){
 	
 	minw = 60;
 	minh = 45; 
@@ -122,6 +129,8 @@ ImagePatchPyramid::ImagePatchPyramid(CvSize inputImageSize, CvSize subImageSize,
 	this->numSubImages = numSubImages; 
 	this->subImageGridPoints = cvCloneMat(subImageGridPoints); 
 	this->detector = detector; 
+	this->cacheDetections = 0; 
+	this->detectorHasFrame = 0; 
 	
 	reInitialize(); 
 	
@@ -200,6 +209,7 @@ ImagePatchPyramid::~ImagePatchPyramid() {
 	cvReleaseImage(&(this->objectCountFirstScale));
 	cvReleaseImage(&(this->foveaRepresentation));
 	cvReleaseImage(&(this->currentScaledImage));  
+	if (detector != NULL) delete(detector); 
 }
 
 void ImagePatchPyramid::readFromStream(istream& in) {
@@ -222,14 +232,92 @@ void ImagePatchPyramid::readFromStream(istream& in) {
 		}
 	}
 	
-	detector = new OpenCVHaarDetector(); 
-	
-	//cout << "Read in Haar detector IPP" << endl; 
-	in >> detector; 
+	readDetectorFromStream(in); 
 	//cout << "ReInitialize IPP" << endl; 
 	reInitialize();
 }
 
+void ImagePatchPyramid::readDetectorFromStream(istream& in) {
+	//A Haar detector is saved as its file name; other detectors start with a tag. 
+	string detectorName; 
+	in >> detectorName; 
+	if (detector != NULL) delete(detector); 
+	if (detectorName == GentleBoostCascadeDetector::streamTag) {
+		detector = new GentleBoostCascadeDetector(); 
+		in >> detector; 
+	} else {
+		//cout << "Read in Haar detector IPP" << endl; 
+		detector = new OpenCVHaarDetector(detectorName.c_str()); 
+	}
+	detectorHasFrame = 0; 
+}
+
+//Layout of the header block written by addToStreamBinary(). 
+enum {binInputW, binInputH, binSubW, binSubH, binGridW, binGridH, binNumScales, 
+	binPointsRows, binPointsCols, binDetectorLength, binHeaderSize}; 
+
+void ImagePatchPyramid::addToStreamBinary(ostream& out) {
+	ostringstream detectorText; 
+	detectorText << detector; 
+	string detectorString = detectorText.str(); 
+	
+	int header[binHeaderSize]; 
+	header[binInputW] = inputImageSize.width; 
+	header[binInputH] = inputImageSize.height; 
+	header[binSubW] = subImageSize.width; 
+	header[binSubH] = subImageSize.height; 
+	header[binGridW] = gridSize.width; 
+	header[binGridH] = gridSize.height; 
+	header[binNumScales] = getNumScales(); 
+	header[binPointsRows] = subImageGridPoints->rows; 
+	header[binPointsCols] = subImageGridPoints->cols; 
+	header[binDetectorLength] = detectorString.size(); 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, header, sizeof(header)); 
+	
+	vector<int> points(subImageGridPoints->rows*subImageGridPoints->cols); 
+	for (int y = 0; y < subImageGridPoints->rows; y++) {
+		for (int x = 0; x < subImageGridPoints->cols; x++) {
+			points[y*subImageGridPoints->cols+x] = cvRound(cvGetReal2D(subImageGridPoints, y, x)); 
+		}
+	}
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, points.empty() ? NULL : &points[0], points.size()*sizeof(int)); 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, detectorString.data(), detectorString.size()); 
+}
+
+int ImagePatchPyramid::readFromStreamBinary(istream& in) {
+	int header[binHeaderSize]; 
+	if (!NMPTUtils::readChecksummedBlockFromStreamBinary(in, header, sizeof(header)) 
+		|| header[binNumScales] < 1 || header[binPointsRows] != header[binNumScales] 
+		|| header[binPointsCols] != 2 || header[binGridW] < 1 || header[binGridH] < 1 
+		|| header[binDetectorLength] < 0) {
+		cout << "Warning: Corrupt ImagePatchPyramid header in binary model." << endl; 
+		return 0; 
+	}
+	
+	CvMat* newGridPoints = cvCreateMat(header[binPointsRows], header[binPointsCols], CV_32SC1); 
+	string detectorString(header[binDetectorLength], ' '); 
+	if (!NMPTUtils::readChecksummedBlockFromStreamBinary(in, newGridPoints->data.i, 
+														  newGridPoints->rows*newGridPoints->cols*sizeof(int)) 
+		|| !NMPTUtils::readChecksummedBlockFromStreamBinary(in, detectorString.empty() ? NULL : &detectorString[0], 
+															 detectorString.size())) {
+		cout << "Warning: Corrupt ImagePatchPyramid data in binary model." << endl; 
+		cvReleaseMat(&newGridPoints); 
+		return 0; 
+	}
+	
+	inputImageSize = cvSize(header[binInputW], header[binInputH]); 
+	subImageSize = cvSize(header[binSubW], header[binSubH]); 
+	gridSize = cvSize(header[binGridW], header[binGridH]); 
+	numSubImages = header[binNumScales]; 
+	if (subImageGridPoints) cvReleaseMat(&subImageGridPoints); 
+	subImageGridPoints = newGridPoints; 
+	
+	istringstream detectorText(detectorString); 
+	readDetectorFromStream(detectorText); 
+	reInitialize();
+	return 1; 
+}
+
 void ImagePatchPyramid::addToStream(ostream& out) {
 	out << inputImageSize.width << " " << inputImageSize.height << endl; 
 	out << subImageSize.width << " " << subImageSize.height << endl; 
@@ -343,6 +431,7 @@ void ImagePatchPyramid::changeInputImageSize(CvSize newInputSize, CvSize newSubI
 	cvSetZero(objectCountFirstScale); 
 	
 	newImage = 1; 
+	detectorHasFrame = 0; 
 }
 
 CvPoint ImagePatchPyramid::searchHighResImage(IplImage* grayFrame){
@@ -445,6 +534,12 @@ void ImagePatchPyramid::countObjects(vector<Rect> objects, CvPoint searchPoint,
 }
 
 
+void ImagePatchPyramid::setObjectDetector(ObjectDetector* newDetector) {
+	if (detector != NULL && detector != newDetector) delete(detector); 
+	detector = newDetector; 
+	detectorHasFrame = 0; 
+}
+
 void ImagePatchPyramid::setObjectDetectorSource(string newFileName) {
 	detector->setDetectorSource(newFileName); 
 }
@@ -465,6 +560,7 @@ CvRect ImagePatchPyramid::getFullImageROIForPointAtScale(CvPoint searchPoint, in
 
 void ImagePatchPyramid::setNewImage() {
 	newImage = 1; 
+	detectorHasFrame = 0; 
 	//cvSetZero(objectCountFirstScale); 
 }
 
@@ -473,7 +569,14 @@ void ImagePatchPyramid::searchFrameAtGridPoint(IplImage* grayFrame, CvPoint sear
 	if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: Beginning search of frame at grid point " << searchPoint.x << ", " << searchPoint.y << endl; 
 	//If we are searching the same frame as before...
 	int start = 0; 
-	if (!newImage && repeatFirstScale) {
+	if (cacheDetections) {
+		if (newImage) {
+			if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: clearing detection cache for new frame." << endl; 
+			clearDetectionCache(); 
+		}
+		cvSetZero(objectCount); 
+	}
+	else if (!newImage && repeatFirstScale) {
 		if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: copying first scale from previous search." << endl; 
 		
 		cvCopy(objectCountFirstScale, objectCount); 
@@ -497,12 +600,14 @@ void ImagePatchPyramid::searchFrameAtGridPoint(IplImage* grayFrame, CvPoint sear
 		if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: getting roi for search point at scale " << scale << "." << endl;
 		CvRect fullImageROI = getFullImageROIForPointAtScale(searchPoint, scale); 
 		
-		cvSetImageROI( grayFrame,  fullImageROI ); 
+		if (!cacheDetections || !observeOff) {
+			cvSetImageROI( grayFrame,  fullImageROI ); 
 		
 		
-		if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: Scaling down image." << endl;
-		cvResize (grayFrame, currentScaledImage, CV_INTER_NN);  //scale foveated region of image down to this scale		
-		cvResetImageROI(grayFrame); 
+			if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: Scaling down image." << endl;
+			cvResize (grayFrame, currentScaledImage, CV_INTER_NN);  //scale foveated region of image down to this scale		
+			cvResetImageROI(grayFrame); 
+		}
 		if (!observeOff) {
 			
 			if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: scaling image back up for fovea representation." << endl;
@@ -518,9 +623,17 @@ void ImagePatchPyramid::searchFrameAtGridPoint(IplImage* grayFrame, CvPoint sear
 		}
 		
 		
+		if (cacheDetections) {
+			if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: looking up cached detector outputs in each grid cell." << endl;
+			countCachedObjects(grayFrame, searchPoint, scale); 
+			continue; 
+		}
+		
 		if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: applying object detector to the current image." << endl;
 		//CvSeq* objects = detector->detectObjects( currentScaledImage);
-		vector<Rect> objects = detector->detectObjects( currentScaledImage);
+		vector<Rect> objects = detector->detectObjectsInRegion(grayFrame, fullImageROI, currentScaledImage, 
+															   !detectorHasFrame);
+		detectorHasFrame = 1; 
 		
 		if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: counting detector outputs in each grid cell." << endl;
 		countObjects(objects, searchPoint, scale); 	//Fill "objectCount", the basic I-POMDP observation vector.
@@ -539,6 +652,8 @@ void ImagePatchPyramid::searchFrameAtGridPoint(IplImage* grayFrame, CvPoint sear
 		
 	}
 	
+	if (cacheDetections) newImage = 0; 
+	
 	if (!observeOff) {
 		
 		if (_IPP_DEBUG) cout << "searchFrameAtGridPoint: drawing grid over fovea representation." << endl;
@@ -567,6 +682,77 @@ void ImagePatchPyramid::searchFrameAtGridPoint(IplImage* grayFrame, CvPoint sear
 }
 
 
+void ImagePatchPyramid::clearDetectionCache() {
+	scaledFrames.assign(numSubImages, Mat()); 
+	tileSearched.resize(numSubImages); 
+	cachedCounts.resize(numSubImages); 
+	for (int scale = 0; scale < numSubImages; scale++) {
+		int tileWidth = cvGetReal2D(subImageGridPoints, scale, 0); 
+		int tileHeight = cvGetReal2D(subImageGridPoints, scale, 1); 
+		tileSearched[scale] = Mat::zeros((gridSize.height+tileHeight-1)/tileHeight, 
+										 (gridSize.width+tileWidth-1)/tileWidth, CV_8U); 
+		cachedCounts[scale] = Mat::zeros(gridSize.height, gridSize.width, CV_8U); 
+	}
+}
+
+void ImagePatchPyramid::searchTile(IplImage* grayFrame, int scale, int tileX, int tileY) {
+	int tileWidth = cvGetReal2D(subImageGridPoints, scale, 0); 
+	int tileHeight = cvGetReal2D(subImageGridPoints, scale, 1); 
+	Rect grid(0, 0, gridSize.width, gridSize.height); 
+	
+	//A patch of tileWidth x tileHeight grid cells is scaled to subImageSize, so the whole frame
+	//is scaled by the same factor.
+	Mat &scaledFrame = scaledFrames[scale]; 
+	if (scaledFrame.empty()) {
+		Size scaledSize(subImageSize.width*gridSize.width/tileWidth, 
+						subImageSize.height*gridSize.height/tileHeight); 
+		resize(cvarrToMat(grayFrame), scaledFrame, scaledSize, 0, 0, INTER_NEAREST); 
+	}
+	
+	Rect tile = Rect(tileX*tileWidth, tileY*tileHeight, tileWidth, tileHeight) & grid; 
+	Rect cells = Rect(tile.x-tileWidth/2, tile.y-tileHeight/2, 
+					  tile.width+tileWidth/2*2, tile.height+tileHeight/2*2) & grid; 
+	int x0 = cells.x*scaledFrame.cols/gridSize.width; 
+	int y0 = cells.y*scaledFrame.rows/gridSize.height; 
+	int x1 = (cells.x+cells.width)*scaledFrame.cols/gridSize.width; 
+	int y1 = (cells.y+cells.height)*scaledFrame.rows/gridSize.height; 
+	
+	IplImage region = scaledFrame(Rect(x0, y0, x1-x0, y1-y0)); 
+	if (_IPP_DEBUG) cout << "searchTile: applying object detector to tile " << tileX << ", " << tileY << " of scale " << scale << "." << endl;
+	vector<Rect> objects = detector->detectObjects(&region); 
+	
+	for(vector<Rect>::const_iterator r = objects.begin(); r != objects.end(); r++) {
+		int x = (x0 + r->x + r->width/2) * gridSize.width / scaledFrame.cols; 
+		int y = (y0 + r->y + r->height/2) * gridSize.height / scaledFrame.rows; 
+		if (!tile.contains(Point(x, y))) continue; //Found in the margin; belongs to another tile. 
+		uchar &count = cachedCounts[scale].at<uchar>(y, x); 
+		if (count < 255) count++; 
+	}
+	tileSearched[scale].at<uchar>(tileY, tileX) = 1; 
+}
+
+void ImagePatchPyramid::countCachedObjects(IplImage* grayFrame, CvPoint searchPoint, int scale) {
+	
+	if (searchPoint.x < 0 || searchPoint.y < 0) 
+		cout << "Bad Search Point: " << searchPoint.x << ", " <<searchPoint.y << endl; 
+	
+	int gridStartX = cvGetReal2D( actXtoGridCornerX, searchPoint.x, scale); 
+	int gridStartY = cvGetReal2D( actYtoGridCornerY, searchPoint.y, scale); 
+	int tileWidth = cvGetReal2D(subImageGridPoints, scale, 0); 
+	int tileHeight = cvGetReal2D(subImageGridPoints, scale, 1); 
+	Rect gridImageROI(gridStartX, gridStartY, tileWidth, tileHeight); 
+	
+	for (int tileY = gridImageROI.y/tileHeight; tileY <= (gridImageROI.br().y-1)/tileHeight; tileY++) {
+		for (int tileX = gridImageROI.x/tileWidth; tileX <= (gridImageROI.br().x-1)/tileWidth; tileX++) {
+			if (!tileSearched[scale].at<uchar>(tileY, tileX)) 
+				searchTile(grayFrame, scale, tileX, tileY); 
+		}
+	}
+	
+	Mat counts = cvarrToMat(objectCount)(gridImageROI); 
+	add(counts, cachedCounts[scale](gridImageROI), counts); 
+}
+
 
 void ImagePatchPyramid::saveVisualization(IplImage* grayFrame, CvPoint searchPoint, const char* base_filename) { 	
 		
@@ -717,6 +903,8 @@ void ImagePatchPyramid::setMinSize(CvSize minsize) {
 }
 void ImagePatchPyramid::useSameFrameOptimizations(int flag) {repeatFirstScale = flag; }
 int ImagePatchPyramid::getSameFrameOptimizations() {return repeatFirstScale;}
+void ImagePatchPyramid::useDetectionCache(int flag) {cacheDetections = flag; newImage = 1; }
+int ImagePatchPyramid::getDetectionCache() {return cacheDetections;}
 
 
 CvSize ImagePatchPyramid::getInputImageSize() {return inputImageSize;}
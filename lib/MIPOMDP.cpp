@@ -9,16 +9,21 @@
 
 #include "MIPOMDP.h"
 #include "DebugGlobals.h"
+#include "NMPTUtils.h"
 #include <math.h>
+#include <float.h>
 #include <stdlib.h>
 #include <cassert>
 #include <fstream>
 #include <opencv2/imgproc/imgproc_c.h>
 #include <opencv2/highgui/highgui_c.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <map>
 
 using namespace std; 
+using namespace cv; 
 
 
 MIPOMDP::MIPOMDP(CvSize inputImageSize, CvSize subImageSize, CvSize gridSize, int numSubImages, CvMat* subImageGridPoints, const char* haarDetectorXMLFile){
@@ -35,11 +40,15 @@ MIPOMDP::MIPOMDP(CvSize inputImageSize, CvSize subImageSize, CvSize gridSize, in
 	//Allocate image size, type, memory
 	currentBelief = cvCreateImage(cvSize(gridSize.width, gridSize.height), IPL_DEPTH_32F, 1);	
 	fixationCount = cvCreateImage(cvSize(gridSize.width, gridSize.height), IPL_DEPTH_8U, 1);	
+	deferBeliefNormalization = 0; 
+	numTrainingThreads = 0; 
+	numSpeculativeFixations = 0; 
 	
 	//This takes care of a lot of initialization. 
 	changeInputImageSize(inputImageSize, subImageSize); 
 	
 	obsmodel = new MultinomialObservationModel(gridSize); 
+	policy->setObservationModel(obsmodel); 
 	
 	dynamicsoff = 0; 
 	repeatOff = 0; 
@@ -80,11 +89,15 @@ MIPOMDP::MIPOMDP() {
 	//Allocate image size, type, memory
 	currentBelief = cvCreateImage(cvSize(gridSize.width, gridSize.height), IPL_DEPTH_32F, 1);	
 	fixationCount = cvCreateImage(cvSize(gridSize.width, gridSize.height), IPL_DEPTH_8U, 1);	
+	deferBeliefNormalization = 0; 
+	numTrainingThreads = 0; 
+	numSpeculativeFixations = 0; 
 	
 	//This takes care of a lot of initialization. 
 	changeInputImageSize(inputImageSize, subImageSize); 
 	
 	obsmodel = new MultinomialObservationModel(gridSize); 
+	policy->setObservationModel(obsmodel); 
 	
 	dynamicsoff = 0; 
 	repeatOff = 0; 
@@ -94,11 +107,15 @@ MIPOMDP::MIPOMDP(CvSize gridSize) {
 	this->gridSize = gridSize; 
 	currentBelief = cvCreateImage(cvSize(gridSize.width, gridSize.height), IPL_DEPTH_32F, 1);	
 	fixationCount = cvCreateImage(cvSize(gridSize.width, gridSize.height), IPL_DEPTH_8U, 1);		
+	deferBeliefNormalization = 0; 
+	numTrainingThreads = 0; 
+	numSpeculativeFixations = 0; 
 	dynamicsoff = 0; 
 	repeatOff = 0; 
 	ipp = new ImagePatchPyramid(); 
 	obsmodel = new MultinomialObservationModel(gridSize); 
 	policy = new ConvolutionalLogisticPolicy(gridSize); 
+	policy->setObservationModel(obsmodel); 
 	//Set others to zero just to be clean
 	resetPrior(); 
 	cvSetZero(fixationCount);  
@@ -106,6 +123,51 @@ MIPOMDP::MIPOMDP(CvSize gridSize) {
 
 void MIPOMDP::resetPrior() {
 	cvSet(currentBelief, cvRealScalar(1.0/(gridSize.width*gridSize.height))); 
+	logBelief.create(gridSize.height, gridSize.width, CV_64F); 
+	logBelief.setTo(Scalar(-log((double)gridSize.width*gridSize.height))); 
+	logBeliefIsCurrent = 1; 
+	beliefIsCurrent = 1; 
+}
+
+void MIPOMDP::setLogBeliefFromBelief() {
+	Mat belief = cvarrToMat(currentBelief); 
+	belief.convertTo(logBelief, CV_64F); 
+	max(logBelief, DBL_MIN, logBelief); //Cells that underflowed to 0 stay finite.
+	log(logBelief, logBelief); 
+	logBeliefIsCurrent = 1; 
+}
+
+void MIPOMDP::setBeliefFromLogBelief() {
+	//The grid as one row; a 32-bit float IplImage has no row padding. 
+	Mat logBeliefRow = logBelief.reshape(1, 1); 
+	Mat beliefRow = cvarrToMat(currentBelief).reshape(1, 1); 
+	normalizeLogBeliefs(logBeliefRow, beliefRow); 
+	beliefIsCurrent = 1; 
+}
+
+void MIPOMDP::normalizeLogBeliefs(Mat &logBeliefs, Mat &beliefs) {
+	//log-sum-exp: shift so the largest log probability of each row is 0 before exponentiating. 
+	//All rows are done together, in a few passes over contiguous memory. 
+	Mat rowMax, rowSum, expBeliefs; 
+	reduce(logBeliefs, rowMax, 1, CV_REDUCE_MAX); 
+	for (int r = 0; r < logBeliefs.rows; r++) {
+		Mat row = logBeliefs.row(r); 
+		subtract(row, Scalar(rowMax.at<double>(r)), row); 
+	}
+	exp(logBeliefs, expBeliefs); 
+	reduce(expBeliefs, rowSum, 1, CV_REDUCE_SUM); 
+	beliefs.create(logBeliefs.size(), CV_32F); 
+	for (int r = 0; r < logBeliefs.rows; r++) {
+		double total = rowSum.at<double>(r); 
+		Mat row = logBeliefs.row(r); 
+		subtract(row, Scalar(log(total)), row); 
+		Mat dest = beliefs.row(r); 
+		expBeliefs.row(r).convertTo(dest, CV_32F, 1.0/total); 
+	}
+}
+
+void MIPOMDP::updateBeliefIfNeeded() {
+	if (!beliefIsCurrent) setBeliefFromLogBelief(); 
 }
 
 void MIPOMDP::saveToFile(const char* filename) {
@@ -120,6 +182,8 @@ void MIPOMDP::saveToFile(const char* filename) {
 }
 
 MIPOMDP* MIPOMDP::loadFromFile(const char* filename){
+	if (isBinaryModelFile(filename)) return loadFromBinaryFile(filename); 
+	
 	ifstream in; 
 	in.open(filename); 
 	int width, height; 
@@ -135,10 +199,86 @@ MIPOMDP* MIPOMDP::loadFromFile(const char* filename){
 	return retval; 
 }
 
+static const char binaryModelMagic[8] = {'N','M','P','T','M','I','P','O'}; 
+static const int binaryModelVersion = 1; 
+static const int binaryModelByteOrder = 0x01020304; 
+
+int MIPOMDP::isBinaryModelFile(const char* filename) {
+	char magic[sizeof(binaryModelMagic)]; 
+	ifstream in(filename, ios::in | ios::binary); 
+	if (!in.read(magic, sizeof(magic))) return 0; 
+	return !memcmp(magic, binaryModelMagic, sizeof(magic)); 
+}
+
+int MIPOMDP::saveToBinaryFile(const char* filename) {
+	string tmpname = string(filename) + ".tmp"; 
+	ofstream out(tmpname.c_str(), ios::out | ios::binary | ios::trunc); 
+	if (!out.is_open()) {
+		cout << "Warning: Couldn't open " << tmpname << " for writing." << endl; 
+		return 0; 
+	}
+	
+	out.write(binaryModelMagic, sizeof(binaryModelMagic)); 
+	out.write((char*)&binaryModelVersion, sizeof(int)); 
+	out.write((char*)&binaryModelByteOrder, sizeof(int)); 
+	int grid[2] = {gridSize.width, gridSize.height}; 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, grid, sizeof(grid)); 
+	ipp->addToStreamBinary(out); 
+	obsmodel->addToStreamBinary(out); 
+	policy->addToStreamBinary(out); 
+	
+	out.close(); 
+	if (out.fail() || rename(tmpname.c_str(), filename) != 0) {
+		cout << "Warning: Failed to write binary model " << filename << endl; 
+		remove(tmpname.c_str()); 
+		return 0; 
+	}
+	return 1; 
+}
+
+MIPOMDP* MIPOMDP::loadFromBinaryFile(const char* filename) {
+	ifstream in(filename, ios::in | ios::binary); 
+	if (!in.is_open()) {
+		cout << "Warning: Couldn't open binary model " << filename << endl; 
+		return NULL; 
+	}
+	
+	char magic[sizeof(binaryModelMagic)]; 
+	int version = 0, byteOrder = 0; 
+	in.read(magic, sizeof(magic)); 
+	in.read((char*)&version, sizeof(int)); 
+	in.read((char*)&byteOrder, sizeof(int)); 
+	if (!in || memcmp(magic, binaryModelMagic, sizeof(magic)) 
+		|| version != binaryModelVersion || byteOrder != binaryModelByteOrder) {
+		cout << "Warning: " << filename << " is not a version " << binaryModelVersion 
+		<< " binary model for this machine." << endl; 
+		return NULL; 
+	}
+	
+	int grid[2]; 
+	if (!NMPTUtils::readChecksummedBlockFromStreamBinary(in, grid, sizeof(grid)) 
+		|| grid[0] < 1 || grid[1] < 1) {
+		cout << "Warning: Corrupt header in binary model " << filename << endl; 
+		return NULL; 
+	}
+	
+	MIPOMDP* retval = new MIPOMDP(cvSize(grid[0], grid[1])); 
+	if (!retval->ipp->readFromStreamBinary(in) 
+		|| !retval->obsmodel->readFromStreamBinary(in) 
+		|| !retval->policy->readFromStreamBinary(in)) {
+		cout << "Warning: Failed to load binary model " << filename << endl; 
+		delete(retval); 
+		return NULL; 
+	}
+	retval->foveaRepresentation = retval->ipp->foveaRepresentation; 
+	return retval; 
+}
+
 
 MIPOMDP::~MIPOMDP() {
 	cvReleaseImage(&(this->currentBelief)); 
 	cvReleaseImage(&(this->fixationCount)); 
+	clearSpeculativeIpps(); 
 	delete(ipp); 
 	delete(obsmodel); 
 	delete(policy); 
@@ -171,6 +311,7 @@ void MIPOMDP::changeInputImageSize(CvSize newInputSize, CvSize newSubImageSize){
 }
 
 double MIPOMDP::getProb() {	
+	updateBeliefIfNeeded(); 
 	double min, max; 
 	CvPoint min_loc, max_loc; 
 	cvMinMaxLoc( currentBelief, &min, &max, &min_loc, &max_loc );
@@ -178,6 +319,7 @@ double MIPOMDP::getProb() {
 }
 
 double MIPOMDP::getReward() {
+	updateBeliefIfNeeded(); 
 	return policy->getReward(currentBelief); 
 }
 
@@ -185,7 +327,14 @@ CvPoint MIPOMDP::getMostLikelyTargetLocation() {
 	if (_MIPOMDP_DEBUG) cout << "getMostLikelyTargetLocation: Finding max of belief distribution." << endl; 
 	double min, max; 
 	CvPoint min_loc, max_loc; 
-	cvMinMaxLoc( currentBelief, &min, &max, &min_loc, &max_loc );
+	if (!beliefIsCurrent) {
+		//The log belief has the same maximum, and doesn't need normalizing.
+		Point maxPoint; 
+		minMaxLoc(logBelief, &min, &max, NULL, &maxPoint); 
+		max_loc = maxPoint; 
+	} else {
+		cvMinMaxLoc( currentBelief, &min, &max, &min_loc, &max_loc );
+	}
 	if (_MIPOMDP_DEBUG) cout << "getMostLikelyTargetLocation: Finding pixel at center of grid cell." << endl; 
 	return pixelForGridPoint(max_loc); 
 }
@@ -203,6 +352,9 @@ CvPoint MIPOMDP::searchNewFrame(IplImage* grayFrame) {
 }
 
 CvPoint MIPOMDP::searchFrameUntilConfident(IplImage* grayFrame, double confidenceThresh){
+	if (numSpeculativeFixations > 0 && prepareSpeculativeIpps()) 
+		return searchFrameUntilConfidentSpeculatively(grayFrame, confidenceThresh); 
+	
 	int olddynamics = dynamicsoff; 
 	dynamicsoff = 1; 	
 	double min, max; 
@@ -223,6 +375,166 @@ CvPoint MIPOMDP::searchFrameUntilConfident(IplImage* grayFrame, double confidenc
 	return pixelForGridPoint(max_loc); 
 }
 
+/**
+ * Runs the detector at one grid point per task, each with its own IPP.
+ */
+class MIPOMDPSpeculationBody : public ParallelLoopBody {
+public:
+	MIPOMDPSpeculationBody(IplImage* grayFrame, const vector<ImagePatchPyramid*> &ipps, 
+						   const vector<CvPoint> &points) : 
+	grayFrame(grayFrame), ipps(ipps), points(points) {}
+	
+	void operator()(const Range &range) const {
+		for (int i = range.start; i < range.end; i++) {
+			//The IPP sets an ROI on the frame it searches, so each task gets its own header.
+			IplImage* frame = cvCreateImageHeader(cvSize(grayFrame->width, grayFrame->height), 
+												  grayFrame->depth, grayFrame->nChannels); 
+			cvSetData(frame, grayFrame->imageData, grayFrame->widthStep); 
+			ipps[i]->searchFrameAtGridPoint(frame, points[i]); 
+			cvReleaseImageHeader(&frame); 
+		}
+	}
+	
+private:
+	IplImage* grayFrame; 
+	const vector<ImagePatchPyramid*> &ipps; 
+	const vector<CvPoint> &points; 
+}; 
+
+CvPoint MIPOMDP::searchFrameUntilConfidentSpeculatively(IplImage* grayFrame, double confidenceThresh){
+	int olddynamics = dynamicsoff; 
+	dynamicsoff = 1; 	
+	double min, max; 
+	CvPoint min_loc, max_loc; 
+	max = 0; 
+	cvSetZero(fixationCount); 
+	ipp->setNewImage(); 
+	
+	//Detector outputs at points searched ahead of the policy in this frame, by grid index.
+	map<int, Mat> speculated; 
+	vector<CvPoint> candidates; 
+	vector<CvPoint> points; 
+	vector<ImagePatchPyramid*> taskIpps; 
+	while (max < confidenceThresh) {
+		//Candidates are ranked before the policy draws, and without random numbers, so the policy
+		//makes the same choices as in searchFrameUntilConfident(). 
+		updateBeliefIfNeeded(); 
+		CvPoint searchPoint = policy->getFixationPoint(currentBelief, numSpeculativeFixations+1, candidates); 
+		if (cvGetReal2D(fixationCount, searchPoint.y, searchPoint.x) > 0) {
+			break; 
+		}
+		cvSetReal2D(fixationCount, searchPoint.y, searchPoint.x, 
+					cvGetReal2D(fixationCount, searchPoint.y, searchPoint.x)+1); 
+		
+		int index = searchPoint.y*gridSize.width+searchPoint.x; 
+		map<int, Mat>::iterator found = speculated.find(index); 
+		if (found != speculated.end()) {
+			if (_MIPOMDP_DEBUG) cout << "searchFrameUntilConfidentSpeculatively: Using detector output from a speculative search." << endl; 
+			Mat counts = cvarrToMat(ipp->objectCount); 
+			found->second.copyTo(counts); 
+			speculated.erase(found); 
+		} else {
+			//The chosen point runs on the main IPP, which keeps the preview up to date.
+			points.assign(1, searchPoint); 
+			taskIpps.assign(1, ipp); 
+			for (size_t i = 0; i < candidates.size() && points.size() <= speculativeIpps.size(); i++) {
+				CvPoint candidate = candidates[i]; 
+				int candidateIndex = candidate.y*gridSize.width+candidate.x; 
+				if (candidateIndex == index || speculated.count(candidateIndex) 
+					|| cvGetReal2D(fixationCount, candidate.y, candidate.x) > 0) continue; 
+				taskIpps.push_back(speculativeIpps[points.size()-1]); 
+				points.push_back(candidate); 
+			}
+			parallel_for_(Range(0, points.size()), MIPOMDPSpeculationBody(grayFrame, taskIpps, points)); 
+			for (size_t i = 1; i < points.size(); i++) {
+				speculated[points[i].y*gridSize.width+points[i].x] = cvarrToMat(taskIpps[i]->objectCount, true); 
+			}
+		}
+		updateBeliefFromCounts(searchPoint, ipp->objectCount); 
+		cvMinMaxLoc( currentBelief, &min, &max, &min_loc, &max_loc );
+	}
+	
+	dynamicsoff = olddynamics; 
+	return pixelForGridPoint(max_loc); 
+}
+
+CvPoint MIPOMDP::searchFrameUntilDeadline(IplImage* grayFrame, double timeBudget, 
+										  double confidenceThresh, double* confidence){
+	deadlineTimer.startFrame(timeBudget); 
+	int olddynamics = dynamicsoff; 
+	dynamicsoff = 1; 	
+	double min, max; 
+	CvPoint min_loc, max_loc; 
+	updateBeliefIfNeeded(); 
+	cvMinMaxLoc( currentBelief, &min, &max, &min_loc, &max_loc );
+	max = 0; 
+	cvSetZero(fixationCount); 
+	ipp->setNewImage(); 
+	int budgetWasBinding = 0; 
+	while (max < confidenceThresh) {
+		if (!deadlineTimer.canAffordNextStep()) {
+			budgetWasBinding = 1; 
+			break; 
+		}
+		deadlineTimer.startStep(); 
+		CvPoint searchPoint = recommendSearchPointForCurrentBelief(); 
+		if (cvGetReal2D(fixationCount, searchPoint.y, searchPoint.x) > 0) {
+			break; 
+		}
+		searchFrameAtGridPoint(grayFrame, searchPoint); 
+		deadlineTimer.stopStep(); 
+		cvMinMaxLoc( currentBelief, &min, &max, &min_loc, &max_loc );
+	}
+	if (_MIPOMDP_DEBUG) cout << "searchFrameUntilDeadline: Made " << deadlineTimer.getNumStepsThisFrame() 
+		<< " fixations in " << deadlineTimer.getElapsedTime() << " seconds." << endl; 
+	deadlineTimer.endFrame(budgetWasBinding); 
+	
+	dynamicsoff = olddynamics; 
+	if (confidence != NULL) *confidence = getProb(); 
+	return pixelForGridPoint(max_loc); 
+}
+
+DeadlineTimer* MIPOMDP::getDeadlineTimer() {return &deadlineTimer;} 
+
+void MIPOMDP::setSpeculativeFixations(int numFixations) {
+	numSpeculativeFixations = numFixations < 0 ? 0 : numFixations; 
+	clearSpeculativeIpps(); 
+}
+
+int MIPOMDP::prepareSpeculativeIpps() {
+	//Copies made before the main IPP was resized are stale. 
+	CvSize inputSize = ipp->getInputImageSize(); 
+	CvSize subImageSize = ipp->getSubImageSize(); 
+	for (size_t i = 0; i < speculativeIpps.size(); i++) {
+		CvSize copyInputSize = speculativeIpps[i]->getInputImageSize(); 
+		CvSize copySubImageSize = speculativeIpps[i]->getSubImageSize(); 
+		if (copyInputSize.width != inputSize.width || copyInputSize.height != inputSize.height 
+			|| copySubImageSize.width != subImageSize.width || copySubImageSize.height != subImageSize.height) {
+			clearSpeculativeIpps(); 
+			break; 
+		}
+	}
+	
+	while ((int)speculativeIpps.size() < numSpeculativeFixations) {
+		ImagePatchPyramid* copy = new ImagePatchPyramid(ipp); 
+		if (copy->detector == NULL) {
+			cout << "Warning: The object detector can't be cloned, so searchFrameUntilConfident() can't search ahead." << endl; 
+			delete(copy); 
+			numSpeculativeFixations = 0; 
+			clearSpeculativeIpps(); 
+			return 0; 
+		}
+		copy->setGeneratePreview(0); 
+		speculativeIpps.push_back(copy); 
+	}
+	for (size_t i = 0; i < speculativeIpps.size(); i++) speculativeIpps[i]->setNewImage(); 
+	return 1; 
+}
+
+void MIPOMDP::clearSpeculativeIpps() {
+	for (size_t i = 0; i < speculativeIpps.size(); i++) delete(speculativeIpps[i]); 
+	speculativeIpps.clear(); 
+}
 
 CvPoint MIPOMDP::searchFrameRandomlyUntilConfident(IplImage* grayFrame, double confidenceThresh){
 	int olddynamics = dynamicsoff; 
@@ -255,10 +567,14 @@ CvPoint MIPOMDP::searchFrameForNFixationsOpenLoop(IplImage* grayFrame, int numfi
 	cvSetZero(fixationCount); 
 	CvSize gridSize = cvSize(ipp->objectCount->width, ipp->objectCount->height); 
 	ipp->setNewImage(); 
+	//Open loop policies don't look at the belief, so normalize it once at the end.
+	deferBeliefNormalization = 1; 
 	for (int count = 0; count < numfixations; count++) {
 		CvPoint searchPoint = OpenLoopPolicies::getFixationPoint(count, OLPolicyType, gridSize);  
 		searchFrameAtGridPoint(grayFrame, searchPoint); 
 	}
+	deferBeliefNormalization = 0; 
+	updateBeliefIfNeeded(); 
 	cvMinMaxLoc( currentBelief, &min, &max, &min_loc, &max_loc );
 	dynamicsoff = olddynamics; 
 	return pixelForGridPoint(max_loc); 
@@ -316,6 +632,8 @@ CvPoint MIPOMDP::searchHighResImage(IplImage* grayFrame){
 	cvSubS(currentBelief, cvRealScalar(max_val), currentBelief); 
 	cvExp(currentBelief, currentBelief); 
 	cvNormalize(currentBelief, currentBelief, 1, 0, CV_L1); 
+	beliefIsCurrent = 1; 
+	logBeliefIsCurrent = 0; 
 	return retval; 
 } 
 
@@ -345,16 +663,23 @@ CvPoint MIPOMDP::searchFrameAtGridPoint(IplImage* grayFrame, CvPoint searchPoint
 	
 	if (!dynamicsoff) {
 		if (_MIPOMDP_DEBUG) cout << "searchFrameAtGridPoint: Running forward belief dynamics." << endl; 
+		updateBeliefIfNeeded(); 
 		runForwardBeliefDynamics(); 
+		logBeliefIsCurrent = 0; 
 	}
 	
 	if (_MIPOMDP_DEBUG) cout << "searchFrameAtGridPoint: Building ipp representation and searching for face." << endl; 
 	ipp->searchFrameAtGridPoint(grayFrame, searchPoint); 
+	return updateBeliefFromCounts(searchPoint, ipp->objectCount); 
+}
+
+CvPoint MIPOMDP::updateBeliefFromCounts(CvPoint searchPoint, IplImage* counts) {
 	if (_MIPOMDP_DEBUG) cout << "searchFrameAtGridPoint: Consulting observation model about ipp output." << endl; 
-	obsmodel->setObservationProbability(searchPoint, ipp->objectCount); 
+	if (!logBeliefIsCurrent) setLogBeliefFromBelief(); 
+	obsmodel->addLogLikelihoodRatio(searchPoint, counts, logBelief); 
+	beliefIsCurrent = 0; 
 	if (_MIPOMDP_DEBUG) cout << "searchFrameAtGridPoint: Updating belief distribution." << endl; 
-	cvMul(obsmodel->observationProbability, currentBelief, currentBelief); 
-	cvNormalize(currentBelief, currentBelief, 1, 0, CV_L1 ); //Normalize probability map to 1. 
+	if (!deferBeliefNormalization) setBeliefFromLogBelief(); //Normalize probability map to 1. 
 	if (_MIPOMDP_DEBUG) cout << "searchFrameAtGridPoint: Finding most likely target location." << endl; 
 	return getMostLikelyTargetLocation(); 
 }
@@ -378,6 +703,7 @@ void MIPOMDP::combineModels(MIPOMDP* otherPomdp) {
 
 CvPoint MIPOMDP::recommendSearchPointForCurrentBelief() {
 	if (_MIPOMDP_DEBUG) cout << "recommendSearchPointForCurrentBelief: Consulting policy." << endl; 
+	updateBeliefIfNeeded(); 
 	return policy->getFixationPoint(currentBelief); 
 }
 
@@ -398,6 +724,7 @@ void MIPOMDP::saveVisualization(IplImage* grayFrame, CvPoint searchPoint, const
 	cvSetReal2D(fixationCount, searchPoint.y, searchPoint.x, 
 				cvGetReal2D(fixationCount, searchPoint.y, searchPoint.x)+1); 
 	
+	updateBeliefIfNeeded(); 
 	if (!dynamicsoff) {
 		runForwardBeliefDynamics(); 
 	}
@@ -426,6 +753,7 @@ void MIPOMDP::saveVisualization(IplImage* grayFrame, CvPoint searchPoint, const
 	cvMul(obsmodel->observationProbability, currentBelief, currentBelief); 
 	
 	cvNormalize(currentBelief, currentBelief, 1, 0, CV_L1 ); //Normalize probability map to 1. 
+	logBeliefIsCurrent = 0; 
 
 }
 
@@ -435,17 +763,43 @@ void MIPOMDP::setHeuristicPolicyParameters(double softmaxGain, double boxSize) {
 
 void MIPOMDP::setGeneratePreview(int flag) {ipp->setGeneratePreview(flag);} 
 
-void MIPOMDP::setMinSize(CvSize minsize) { ipp->setMinSize(minsize);}
+void MIPOMDP::setMinSize(CvSize minsize) { ipp->setMinSize(minsize); clearSpeculativeIpps();}
+
+void MIPOMDP::useSameFrameOptimizations(int flag) {ipp->useSameFrameOptimizations(flag); clearSpeculativeIpps();}
+
+void MIPOMDP::useDetectionCache(int flag) {ipp->useDetectionCache(flag); clearSpeculativeIpps();}
 
-void MIPOMDP::useSameFrameOptimizations(int flag) {ipp->useSameFrameOptimizations(flag);}
+CvSize MIPOMDP::getGridSize() const {return gridSize;} 
 
-CvSize MIPOMDP::getGridSize(){return gridSize;} 
+const MultinomialObservationModel* MIPOMDP::getObservationModel() const {return obsmodel;} 
+
+const ConvolutionalLogisticPolicy* MIPOMDP::getPolicy() const {return policy;} 
+
+const ImagePatchPyramid* MIPOMDP::getImagePatchPyramid() const {return ipp;} 
 
 int MIPOMDP::getNumScales(){return ipp->getNumScales(); } 
 
-void MIPOMDP::setHaarCascadeScaleFactor(double factor) { ((OpenCVHaarDetector*)ipp->detector)->setHaarCascadeScaleFactor(factor);}
+void MIPOMDP::setHaarCascadeScaleFactor(double factor) { 
+	OpenCVHaarDetector* haar = dynamic_cast<OpenCVHaarDetector*>(ipp->detector); 
+	if (haar == NULL) {
+		cout << "Warning: setHaarCascadeScaleFactor() only applies to an OpenCVHaarDetector." << endl; 
+		return; 
+	}
+	haar->setHaarCascadeScaleFactor(factor);
+	clearSpeculativeIpps(); 
+}
+
+void MIPOMDP::setHaarCascadeMinSize(int size) {	
+	OpenCVHaarDetector* haar = dynamic_cast<OpenCVHaarDetector*>(ipp->detector); 
+	if (haar == NULL) {
+		cout << "Warning: setHaarCascadeMinSize() only applies to an OpenCVHaarDetector." << endl; 
+		return; 
+	}
+	haar->setHaarCascadeMinSize(size); 
+	clearSpeculativeIpps(); 
+}
 
-void MIPOMDP::setHaarCascadeMinSize(int size) {	((OpenCVHaarDetector*)ipp->detector)->setHaarCascadeMinSize(size); }
+void MIPOMDP::setObjectDetector(ObjectDetector* detector) {ipp->setObjectDetector(detector); clearSpeculativeIpps();}
 
 void MIPOMDP::setTargetCanMove(int flag) {dynamicsoff = !flag;}
 
@@ -458,6 +812,38 @@ void MIPOMDP::trainObservationModel(ImageDataSet* trainingSet){
 	addDataToObservationModel(trainingSet); 
 }
 
+/**
+ * Tabulates observations for one shard of a training set per task.
+ */
+class MIPOMDPTrainingBody : public ParallelLoopBody {
+public:
+	MIPOMDPTrainingBody(MIPOMDP* pomdp, ImageDataSet* trainingSet, 
+						const vector<ImagePatchPyramid*> &ipps, 
+						const vector<MultinomialObservationModel*> &models) : 
+	pomdp(pomdp), trainingSet(trainingSet), ipps(ipps), models(models) {}
+	
+	void operator()(const Range &range) const {
+		int numImages = trainingSet->getNumEntries(); 
+		int numShards = ipps.size(); 
+		for (int w = range.start; w < range.end; w++) {
+			//Shards are contiguous blocks of the dataset, fixed by the number of workers.
+			for (int j = w*numImages/numShards; j < (w+1)*numImages/numShards; j++) {
+				pomdp->addImageToObservationModel(ipps[w], models[w], trainingSet, j); 
+			}
+		}
+	}
+	
+private:
+	MIPOMDP* pomdp; 
+	ImageDataSet* trainingSet; 
+	const vector<ImagePatchPyramid*> &ipps; 
+	const vector<MultinomialObservationModel*> &models; 
+}; 
+
+void MIPOMDP::setNumTrainingThreads(int numThreads) {
+	numTrainingThreads = numThreads < 0 ? 0 : numThreads; 
+}
+
 void MIPOMDP::addDataToObservationModel(ImageDataSet* trainingSet){	
 	int oldPreviewFlag = ipp->getGeneratePreview();
 	int oldOptFlag = ipp->getSameFrameOptimizations(); 
@@ -466,39 +852,28 @@ void MIPOMDP::addDataToObservationModel(ImageDataSet* trainingSet){
 	CvSize oldImageSize = ipp->getInputImageSize(); 
 	CvSize oldSubImageSize = ipp->getSubImageSize(); 
 	
-	for (int j = 0; j < trainingSet->getNumEntries(); j++) { 
-		CvRect objectLocation; 
-		string filename = trainingSet->getFileName(j);
-		vector<double> labels = trainingSet->getFileLabels(j); 
-		objectLocation.x = labels[0]; 
-		objectLocation.y = labels[1]; 
-		objectLocation.width = labels[2]; 
-		objectLocation.height = labels[2]; 
-		cout << "Image " << filename << " has Face at " << objectLocation.x << ", " << objectLocation.y << endl; 
-		IplImage* current_frame = cvLoadImage( filename.c_str(), CV_LOAD_IMAGE_GRAYSCALE ); 
-		
-		int w1 = current_frame->width; 
-		int h1 = current_frame->height; 
-		
-		changeInputImageSize(cvSize(w1, h1));//, cvSize(w2,h2)); 
-		
-		//This calculation makes it so that the smallest scale has 1:1 mapping of pixels. 
-		int numScales = ipp->getUsedScales(); 
-		int smallWidth = ipp->getGridCellWidthOfScale(numScales-1);
-		int smallHeight = ipp->getGridCellHeightOfScale(numScales-1); 
-		int w2 = w1 * smallWidth / gridSize.width; //e.g. w1*3/21
-		int h2 = h1 * smallHeight / gridSize.height; //e.g. h1*3/21			
-		
-		
-		cout << "Image Size: " << w1 << "x" << h1 << "; Smallest Grid Cells: " << smallWidth << "x" << smallHeight << 
-		"; Smallest Patch Pixels: " << w2 << "x" << h2 << endl; 
-		
-		updateProbTableCounts(current_frame, objectLocation); 
-		
-		cvReleaseImage(&current_frame); 
+	int numWorkers = numTrainingThreads > 0 ? numTrainingThreads : getNumThreads(); 
+	numWorkers = numWorkers > trainingSet->getNumEntries() ? trainingSet->getNumEntries() : numWorkers; 
+	numWorkers = numWorkers < 1 ? 1 : numWorkers; 
 		
+	//Each worker fixates with its own IPP, and counts into its own copy of the model, starting 
+	//from the prior. Detectors are copied here, since loading them isn't known to be reentrant.
+	vector<ImagePatchPyramid*> ipps(numWorkers); 
+	vector<MultinomialObservationModel*> models(numWorkers); 
+	for (int w = 0; w < numWorkers; w++) {
+		ipps[w] = new ImagePatchPyramid(ipp); 
+		models[w] = new MultinomialObservationModel(obsmodel); 
+		models[w]->resetCounts(); 
 	}
 	
+	parallel_for_(Range(0, numWorkers), MIPOMDPTrainingBody(this, trainingSet, ipps, models)); 
+	
+	//The counts are whole numbers, so merging them gives the same model for any number of workers.
+	for (int w = 0; w < numWorkers; w++) {
+		obsmodel->combineEvidence(models[w]); 
+		delete(models[w]); 
+		delete(ipps[w]); 
+	}
 	
 	obsmodel->normalizeProbTables(); 
 	changeInputImageSize(oldImageSize,oldSubImageSize); 
@@ -507,30 +882,79 @@ void MIPOMDP::addDataToObservationModel(ImageDataSet* trainingSet){
 	ipp->useSameFrameOptimizations(oldOptFlag);
 }
 
+void MIPOMDP::addImageToObservationModel(ImagePatchPyramid* trainIpp, MultinomialObservationModel* trainModel, 
+										 ImageDataSet* trainingSet, int j) {
+	CvRect objectLocation; 
+	string filename = trainingSet->getFileName(j);
+	vector<double> labels = trainingSet->getFileLabels(j); 
+	objectLocation.x = labels[0]; 
+	objectLocation.y = labels[1]; 
+	objectLocation.width = labels[2]; 
+	objectLocation.height = labels[2]; 
+	IplImage* current_frame = cvLoadImage( filename.c_str(), CV_LOAD_IMAGE_GRAYSCALE ); 
+	if (current_frame == NULL) {
+		AutoLock l(trainingOutputLock); 
+		cout << "Warning: Couldn't read image " << filename << endl; 
+		return; 
+	}
+	
+	int w1 = current_frame->width; 
+	int h1 = current_frame->height; 
+	
+	trainIpp->changeInputImageSize(cvSize(w1, h1));//, cvSize(w2,h2)); 
+	
+	//This calculation makes it so that the smallest scale has 1:1 mapping of pixels. 
+	int numScales = trainIpp->getUsedScales(); 
+	int smallWidth = trainIpp->getGridCellWidthOfScale(numScales-1);
+	int smallHeight = trainIpp->getGridCellHeightOfScale(numScales-1); 
+	int w2 = w1 * smallWidth / gridSize.width; //e.g. w1*3/21
+	int h2 = h1 * smallHeight / gridSize.height; //e.g. h1*3/21			
+	
+	{
+		AutoLock l(trainingOutputLock); 
+		cout << "Image " << filename << " has Face at " << objectLocation.x << ", " << objectLocation.y << endl; 
+		cout << "Image Size: " << w1 << "x" << h1 << "; Smallest Grid Cells: " << smallWidth << "x" << smallHeight << 
+		"; Smallest Patch Pixels: " << w2 << "x" << h2 << endl; 
+	}
+	
+	updateProbTableCounts(trainIpp, trainModel, current_frame, objectLocation); 
+	
+	cvReleaseImage(&current_frame); 
+}
+
 void MIPOMDP::updateProbTableCounts(IplImage* grayFrame, CvRect objectLocation) {
+	updateProbTableCounts(ipp, obsmodel, grayFrame, objectLocation); 
+}
+
+void MIPOMDP::updateProbTableCounts(ImagePatchPyramid* trainIpp, MultinomialObservationModel* trainModel, 
+									IplImage* grayFrame, CvRect objectLocation) {
 	int x = objectLocation.x ;//- objectLocation.width/2; 
 	int y = objectLocation.y ;//- objectLocation.height/2; 
 	objectLocation.x = x;
 	objectLocation.y = y; 
 	objectLocation.width = 1; 
 	objectLocation.height = 1; 
-	ipp->setNewImage(); 
+	trainIpp->setNewImage(); 
 	CvPoint ol = cvPoint(x,y); 
-	CvPoint gl = ipp->gridPointForPixel(ol); 
+	CvPoint gl = trainIpp->gridPointForPixel(ol); 
 	objectLocation.x = gl.x; 
 	objectLocation.y = gl.y; 
-	cout << "Face is at grid cell (" << objectLocation.x << "," << objectLocation.y << "), Width is " << objectLocation.width << "; Height is " << objectLocation.height << endl; 
+	{
+		AutoLock l(trainingOutputLock); 
+		cout << "Face is at grid cell (" << objectLocation.x << "," << objectLocation.y << "), Width is " << objectLocation.width << "; Height is " << objectLocation.height << endl; 
+	}
 	
 	//x1,y1 is where we're looking now
-	for (int y1 = 0; y1 < ipp->objectCount->height; y1++) {
-		for (int x1 = 0; x1 < ipp->objectCount->width; x1++) {						
+	for (int y1 = 0; y1 < trainIpp->objectCount->height; y1++) {
+		for (int x1 = 0; x1 < trainIpp->objectCount->width; x1++) {						
 			CvPoint searchPoint = cvPoint(x1,y1); 
-			ipp->searchFrameAtGridPoint(grayFrame, searchPoint); 
-			obsmodel->updateProbTableCounts(searchPoint, ipp->objectCount, objectLocation); 
+			trainIpp->searchFrameAtGridPoint(grayFrame, searchPoint); 
+			trainModel->updateProbTableCounts(searchPoint, trainIpp->objectCount, objectLocation); 
 		}
 	}
 }
 
 void MIPOMDP::setObjectDetectorSource(string newFileName) {
 	ipp->setObjectDetectorSource(newFileName); 
+	clearSpeculativeIpps(); 
 }
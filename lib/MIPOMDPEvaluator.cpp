@@ -0,0 +1,259 @@
+/*
+ *  MIPOMDPEvaluator.cpp
+ *  OpenCV
+ *
+ */
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
+
+#include "MIPOMDPEvaluator.h"
+#include "MIPOMDP.h"
+#include "ImageDataSet.h"
+#include "BlockTimer.h"
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Runs one evaluation worker per task. Per-worker state (the MIPOMDP, the 
+ * timer, and in pinned mode the core) is indexed by the task, not by the 
+ * thread, so it stays correct if the backend runs several tasks on one 
+ * thread; each pinned task restores its thread's affinity when it finishes.
+ */
+class MIPOMDPEvaluationBody : public ParallelLoopBody {
+public:
+	MIPOMDPEvaluationBody(MIPOMDPEvaluator* evaluator) : evaluator(evaluator) {}
+
+	void operator()(const Range &range) const {
+		for (int w = range.start; w < range.end; w++) evaluator->evaluateJobs(w);
+	}
+
+private:
+	MIPOMDPEvaluator* evaluator;
+};
+
+static double gridDistance(CvPoint a, CvPoint b) {
+	return sqrt((double)(a.x-b.x)*(a.x-b.x)+(double)(a.y-b.y)*(a.y-b.y));
+}
+
+static double percentile(const vector<double> &sorted, double p) {
+	if (sorted.empty()) return 0;
+	return sorted[(size_t)(p*(sorted.size()-1)+.5)];
+}
+
+MIPOMDPEvaluator::MIPOMDPEvaluator() : nextJobIndex(0), stopConfidence(0.125), numWorkers(0),
+pinThreads(0), progress(NULL) {
+}
+
+MIPOMDPEvaluator::~MIPOMDPEvaluator() {
+}
+
+void MIPOMDPEvaluator::addFold(const string &pomdpFile, ImageDataSet* testSet) {
+	Fold fold;
+	fold.pomdpFile = pomdpFile;
+	for (int i = 0; i < testSet->getNumEntries(); i++) {
+		vector<double> labels = testSet->getFileLabels(i);
+		if (labels.size() < 2) {
+			cout << "Warning: Skipping " << testSet->getFileName(i) << ", which has no target location." << endl;
+			continue;
+		}
+		fold.fileNames.push_back(testSet->getFileName(i));
+		fold.targets.push_back(cvPoint(labels[0], labels[1]));
+	}
+	folds.push_back(fold);
+}
+
+void MIPOMDPEvaluator::setStopConfidence(double confidence) {
+	stopConfidence = confidence;
+}
+
+void MIPOMDPEvaluator::setNumWorkers(int numWorkers) {
+	this->numWorkers = numWorkers < 0 ? 0 : numWorkers;
+}
+
+void MIPOMDPEvaluator::setPinThreads(int flag) {
+	pinThreads = flag;
+}
+
+void MIPOMDPEvaluator::setProgressStream(ostream *out) {
+	progress = out;
+}
+
+const vector<MIPOMDPEvaluationResult>& MIPOMDPEvaluator::getResults() const {
+	return results;
+}
+
+int MIPOMDPEvaluator::run() {
+	jobs.clear();
+	for (size_t f = 0; f < folds.size(); f++) {
+		for (size_t i = 0; i < folds[f].fileNames.size(); i++) jobs.push_back(make_pair((int)f, (int)i));
+	}
+	results.assign(jobs.size(), MIPOMDPEvaluationResult());
+	nextJobIndex = 0;
+
+	int oldNumThreads = getNumThreads();
+	int workers = numWorkers > 0 ? numWorkers : oldNumThreads;
+	if (pinThreads) {
+		workers = getNumberOfCPUs();
+		setNumThreads(workers);
+	}
+	workers = workers < 1 ? 1 : workers;
+	workers = workers > (int)jobs.size() ? (int)jobs.size() : workers;
+
+	//One stripe per worker, so that no worker's stripe also holds another 
+	//worker (which would find the job queue already drained). 
+	parallel_for_(Range(0, workers), MIPOMDPEvaluationBody(this), workers);
+
+	if (pinThreads) setNumThreads(oldNumThreads);
+
+	int numOK = 0;
+	for (size_t i = 0; i < results.size(); i++) numOK += results[i].ok;
+	return numOK;
+}
+
+int MIPOMDPEvaluator::nextJob() {
+	AutoLock l(lock);
+	if (nextJobIndex >= (int)jobs.size()) return -1;
+	return nextJobIndex++;
+}
+
+void MIPOMDPEvaluator::pinToCore(int core) {
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		AutoLock l(lock);
+		cout << "Warning: Couldn't pin evaluation worker to core " << core << endl;
+	}
+#endif
+}
+
+void MIPOMDPEvaluator::evaluateJobs(int worker) {
+#ifdef __linux__
+	cpu_set_t oldSet;
+	int restoreAffinity = pinThreads && sched_getaffinity(0, sizeof(oldSet), &oldSet) == 0;
+	if (pinThreads) pinToCore(worker % getNumberOfCPUs());
+#endif
+
+	BlockTimer timer;
+	MIPOMDP* pomdp = NULL;
+	int pomdpFold = -1;
+
+	for (int job = nextJob(); job >= 0; job = nextJob()) {
+		int f = jobs[job].first;
+		int i = jobs[job].second;
+		MIPOMDPEvaluationResult &r = results[job];
+		r.fold = f;
+		r.image = i;
+		r.worker = worker;
+		r.ok = 0;
+
+		if (pomdpFold != f) {
+			if (pomdp != NULL) delete(pomdp);
+			{
+				//The Haar cascade loader isn't known to be reentrant.
+				AutoLock l(lock);
+				pomdp = MIPOMDP::loadFromFile(folds[f].pomdpFile.c_str());
+			}
+			pomdpFold = f;
+			if (pomdp == NULL) {
+				AutoLock l(lock);
+				cout << "Warning: Couldn't load " << folds[f].pomdpFile << endl;
+			} else {
+				pomdp->setGeneratePreview(0);
+			}
+		}
+		if (pomdp == NULL) continue;
+
+		IplImage* current_frame = cvLoadImage(folds[f].fileNames[i].c_str(), CV_LOAD_IMAGE_GRAYSCALE);
+		if (current_frame == NULL) {
+			AutoLock l(lock);
+			cout << "Warning: Couldn't read image " << folds[f].fileNames[i] << endl;
+			continue;
+		}
+		r.width = current_frame->width;
+		r.height = current_frame->height;
+		pomdp->changeInputImageSize(cvSize(current_frame->width, current_frame->height));
+		CvPoint targetGridPoint = pomdp->gridPointForPixel(folds[f].targets[i]);
+
+		timer.blockReset(1);
+		timer.blockStart(1);
+		CvPoint searchPoint = pomdp->searchFrameUntilConfident(current_frame, stopConfidence);
+		timer.blockStop(1);
+		r.searchProb = pomdp->getProb();
+		r.searchReward = pomdp->getReward();
+		r.searchGridError = gridDistance(pomdp->gridPointForPixel(searchPoint), targetGridPoint);
+		pomdp->resetPrior();
+
+		timer.blockReset(2);
+		timer.blockStart(2);
+		CvPoint hiresPoint = pomdp->searchHighResImage(current_frame);
+		timer.blockStop(2);
+		r.hiresGridError = gridDistance(pomdp->gridPointForPixel(hiresPoint), targetGridPoint);
+		pomdp->resetPrior();
+
+		r.searchTime = timer.getTotTime(1);
+		r.hiresTime = timer.getTotTime(2);
+		r.ok = 1;
+		cvReleaseImage(&current_frame);
+
+		if (progress != NULL) {
+			AutoLock l(lock);
+			*progress << r.searchTime << ", " << r.hiresTime << ", " << r.searchGridError
+			<< ", " << r.hiresGridError << ", " << r.width << ", " << r.height << ", "
+			<< r.searchProb << ", " << r.searchReward << endl;
+		}
+	}
+
+	if (pomdp != NULL) delete(pomdp);
+
+#ifdef __linux__
+	if (restoreAffinity) sched_setaffinity(0, sizeof(oldSet), &oldSet);
+#endif
+}
+
+void MIPOMDPEvaluator::printSummary(ostream &out) const {
+	double totalSearchTime=0, totalSearchGridErr=0, totalHiResTime=0, totalHiResGridErr=0;
+	long long numPixels = 0;
+	vector<double> searchTimes, hiresTimes;
+	for (size_t i = 0; i < results.size(); i++) {
+		const MIPOMDPEvaluationResult &r = results[i];
+		if (!r.ok) continue;
+		totalSearchTime += r.searchTime;
+		totalHiResTime += r.hiresTime;
+		totalSearchGridErr += r.searchGridError;
+		totalHiResGridErr += r.hiresGridError;
+		numPixels += r.width*r.height;
+		searchTimes.push_back(r.searchTime);
+		hiresTimes.push_back(r.hiresTime);
+	}
+	int numImages = searchTimes.size();
+	if (numImages == 0) {
+		out << "No images were evaluated." << endl;
+		return;
+	}
+	sort(searchTimes.begin(), searchTimes.end());
+	sort(hiresTimes.begin(), hiresTimes.end());
+
+	out << "Evaluated " << numImages << " of " << results.size() << " images." << endl;
+	out << "Mean MIPOMDP Search Time: " << totalSearchTime / numImages << " Seconds" << endl;
+	out << "Mean VJ Search Time     : " << totalHiResTime / numImages << " Seconds" << endl;
+	out << "Mean MIPOMDP Search Rate: " << totalSearchTime*1000000/numPixels <<" ms / 1000 px" << endl;
+	out << "Mean VJ Search Rate     : " << totalHiResTime*1000000/numPixels << " ms / 1000 px" << endl;
+	out << "Mean MIPOMDP Grid Error : " << totalSearchGridErr / numImages << endl;
+	out << "Mean VJ Grid Error      : " << totalHiResGridErr / numImages << endl;
+	out << "MIPOMDP Search Time (s) : p50 " << percentile(searchTimes, .5) << ", p90 "
+	<< percentile(searchTimes, .9) << ", p99 " << percentile(searchTimes, .99) << ", max "
+	<< searchTimes.back() << endl;
+	out << "VJ Search Time (s)      : p50 " << percentile(hiresTimes, .5) << ", p90 "
+	<< percentile(hiresTimes, .9) << ", p99 " << percentile(hiresTimes, .99) << ", max "
+	<< hiresTimes.back() << endl;
+}
@@ -0,0 +1,175 @@
+/*
+ *  MIPOMDPStreamBatch.cpp
+ *  OpenCV
+ *
+ */
+
+#include "MIPOMDPStreamBatch.h"
+#include "MIPOMDP.h"
+#include <math.h>
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Runs the detectors of one step and adds their evidence to the beliefs, one 
+ * worker (and so one detector) per task.
+ */
+class MIPOMDPStreamSearchBody : public ParallelLoopBody {
+public:
+	MIPOMDPStreamSearchBody(MIPOMDPStreamBatch* batch) : batch(batch) {}
+
+	void operator()(const Range &range) const {
+		for (int w = range.start; w < range.end; w++) batch->searchStreams(w);
+	}
+
+private:
+	MIPOMDPStreamBatch* batch;
+};
+
+MIPOMDPStreamBatch::MIPOMDPStreamBatch(const MIPOMDP* model, int numStreams) : model(model) {
+	numStreams = numStreams < 0 ? 0 : numStreams;
+	gridSize = model->getGridSize();
+	int numCells = gridSize.width*gridSize.height;
+
+	policy = new ConvolutionalLogisticPolicy(model->getPolicy());
+	const ImagePatchPyramid* modelIPP = model->getImagePatchPyramid();
+	int numWorkers = getNumThreads();
+	numWorkers = numWorkers > numStreams ? numStreams : numWorkers;
+	numWorkers = numWorkers < 1 ? 1 : numWorkers;
+	detectors.assign(numWorkers, (ObjectDetector*)NULL);
+	for (int w = 0; w < numWorkers && modelIPP->detector != NULL; w++) detectors[w] = modelIPP->detector->clone();
+	ipps.resize(numStreams);
+	for (int s = 0; s < numStreams; s++) ipps[s] = new ImagePatchPyramid(modelIPP, 0);
+	frames.assign(numStreams, (IplImage*)NULL);
+	searching.assign(numStreams, 0);
+	numFixations.assign(numStreams, 0);
+	fixations.assign(numStreams, cvPoint(0, 0));
+
+	logBeliefs.create(numStreams, numCells, CV_64F);
+	beliefs.create(numStreams, numCells, CV_32F);
+	fixationCounts = Mat::zeros(numStreams, numCells, CV_8U);
+	for (int s = 0; s < numStreams; s++) resetPrior(s);
+}
+
+MIPOMDPStreamBatch::~MIPOMDPStreamBatch() {
+	for (size_t s = 0; s < ipps.size(); s++) delete(ipps[s]);
+	for (size_t w = 0; w < detectors.size(); w++) delete(detectors[w]);
+	delete(policy);
+}
+
+int MIPOMDPStreamBatch::getNumStreams() const {
+	return ipps.size();
+}
+
+void MIPOMDPStreamBatch::resetPrior(int stream) {
+	int numCells = gridSize.width*gridSize.height;
+	logBeliefs.row(stream).setTo(Scalar(-log((double)numCells)));
+	beliefs.row(stream).setTo(Scalar(1.0/numCells));
+}
+
+void MIPOMDPStreamBatch::setFrame(int stream, IplImage* grayFrame) {
+	ImagePatchPyramid* ipp = ipps[stream];
+	CvSize size = ipp->getInputImageSize();
+	if (size.width != grayFrame->width || size.height != grayFrame->height) {
+		ipp->changeInputImageSize(cvSize(grayFrame->width, grayFrame->height));
+		resetPrior(stream);
+	}
+	ipp->setNewImage();
+	frames[stream] = grayFrame;
+	fixationCounts.row(stream).setTo(Scalar(0));
+	numFixations[stream] = 0;
+	searching[stream] = 1;
+}
+
+void MIPOMDPStreamBatch::stopSearching(int stream) {
+	searching[stream] = 0;
+	frames[stream] = NULL;
+}
+
+int MIPOMDPStreamBatch::step(double confidenceThresh) {
+	//The policy keeps scratch buffers, so fixations are chosen one stream at a time.
+	steppedStreams.clear();
+	for (size_t s = 0; s < ipps.size(); s++) {
+		if (!searching[s]) continue;
+		IplImage belief = getBelief(s);
+		CvPoint searchPoint = policy->getFixationPoint(&belief);
+		uchar &count = fixationCounts.at<uchar>(s, searchPoint.y*gridSize.width+searchPoint.x);
+		if (count > 0) {
+			stopSearching(s);
+			continue;
+		}
+		count++;
+		numFixations[s]++;
+		fixations[s] = searchPoint;
+		steppedStreams.push_back(s);
+	}
+	if (steppedStreams.empty()) return 0;
+
+	int numWorkers = detectors.size();
+	parallel_for_(Range(0, numWorkers), MIPOMDPStreamSearchBody(this), numWorkers);
+	MIPOMDP::normalizeLogBeliefs(logBeliefs, beliefs);
+
+	int numSearching = 0;
+	for (size_t i = 0; i < steppedStreams.size(); i++) {
+		int s = steppedStreams[i];
+		if (getProb(s) >= confidenceThresh) stopSearching(s);
+		else numSearching++;
+	}
+	return numSearching;
+}
+
+void MIPOMDPStreamBatch::searchStreams(int worker) {
+	//Each stream keeps to one worker's detector, and only writes its own row of logBeliefs.
+	int numWorkers = detectors.size();
+	const MultinomialObservationModel* obsmodel = model->getObservationModel();
+	for (size_t i = 0; i < steppedStreams.size(); i++) {
+		int s = steppedStreams[i];
+		if (s % numWorkers != worker) continue;
+		ImagePatchPyramid* ipp = ipps[s];
+		ipp->detector = detectors[worker];
+		ipp->searchFrameAtGridPoint(frames[s], fixations[s]);
+		ipp->detector = NULL;
+		Mat logBelief = logBeliefs.row(s).reshape(1, gridSize.height);
+		obsmodel->addLogLikelihoodRatio(fixations[s], ipp->objectCount, logBelief);
+	}
+}
+
+void MIPOMDPStreamBatch::searchFramesUntilConfident(const vector<IplImage*> &grayFrames,
+													double confidenceThresh,
+													vector<CvPoint> &locations) {
+	int numStreams = grayFrames.size() < ipps.size() ? grayFrames.size() : ipps.size();
+	for (int s = 0; s < numStreams; s++) setFrame(s, grayFrames[s]);
+	while (step(confidenceThresh) > 0) {}
+
+	locations.resize(numStreams);
+	for (int s = 0; s < numStreams; s++) locations[s] = getMostLikelyTargetLocation(s);
+}
+
+int MIPOMDPStreamBatch::isSearching(int stream) const {
+	return searching[stream];
+}
+
+int MIPOMDPStreamBatch::getNumFixations(int stream) const {
+	return numFixations[stream];
+}
+
+CvPoint MIPOMDPStreamBatch::getLastFixation(int stream) const {
+	return fixations[stream];
+}
+
+CvPoint MIPOMDPStreamBatch::getMostLikelyTargetLocation(int stream) const {
+	Point maxPoint;
+	minMaxLoc(getBelief(stream), NULL, NULL, NULL, &maxPoint);
+	return ipps[stream]->pixelForGridPoint(maxPoint);
+}
+
+double MIPOMDPStreamBatch::getProb(int stream) const {
+	double max;
+	minMaxLoc(beliefs.row(stream), NULL, &max);
+	return max;
+}
+
+Mat MIPOMDPStreamBatch::getBelief(int stream) const {
+	return beliefs.row(stream).reshape(1, gridSize.height);
+}
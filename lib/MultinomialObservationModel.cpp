@@ -8,8 +8,11 @@
  */
 
 #include "MultinomialObservationModel.h"
+#include "NMPTUtils.h"
+#include <math.h>
 
 using namespace std; 
+using namespace cv; 
 
 MultinomialObservationModel::MultinomialObservationModel(CvSize gridSize) {
 	observationProbability = cvCreateImage(cvSize(gridSize.width, gridSize.height), IPL_DEPTH_32F, 1);	
@@ -30,6 +33,10 @@ MultinomialObservationModel::MultinomialObservationModel(MultinomialObservationM
 	countsObsGivenNoFace = cvCloneMatND(modelToCopy->countsObsGivenNoFace); 
 	probObsGivenFace = cvCloneMatND(modelToCopy->probObsGivenFace); 
 	probObsGivenNoFace = cvCloneMatND(modelToCopy->probObsGivenNoFace); 
+	logRatioTables.resize(modelToCopy->logRatioTables.size()); 
+	for (size_t i = 0; i < logRatioTables.size(); i++) logRatioTables[i] = modelToCopy->logRatioTables[i].clone(); 
+	infoGainTables.resize(modelToCopy->infoGainTables.size()); 
+	for (size_t i = 0; i < infoGainTables.size(); i++) infoGainTables[i] = modelToCopy->infoGainTables[i].clone(); 
 }
 
 MultinomialObservationModel::~MultinomialObservationModel() {
@@ -78,6 +85,7 @@ void MultinomialObservationModel::readFromStream(istream& in) {
 			}
 		}		
 	}
+	updateLogRatioTables(); 
 	//cout << "Read From File." << endl; 
 }
 
@@ -121,6 +129,44 @@ void MultinomialObservationModel::addToStream(ostream& out) {
 	}
 }
 
+void MultinomialObservationModel::addToStreamBinary(ostream& out) {
+	int dims[CV_MAX_DIM]; 
+	int numDims = cvGetDims(probObsGivenFace, dims); 
+	int header[3] = {dims[0], dims[1], dims[2]}; 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, header, sizeof(header)); 
+	
+	size_t bytes = sizeof(double); 
+	for (int d = 0; d < numDims; d++) bytes *= dims[d]; 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, probObsGivenFace->data.db, bytes); 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, probObsGivenNoFace->data.db, bytes); 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, countsObsGivenFace->data.db, bytes); 
+	NMPTUtils::writeChecksummedBlockToStreamBinary(out, countsObsGivenNoFace->data.db, bytes); 
+}
+
+int MultinomialObservationModel::readFromStreamBinary(istream& in) {
+	int dims[CV_MAX_DIM]; 
+	int numDims = cvGetDims(probObsGivenFace, dims); 
+	int header[3]; 
+	if (!NMPTUtils::readChecksummedBlockFromStreamBinary(in, header, sizeof(header)) 
+		|| header[0] != dims[0] || header[1] != dims[1] || header[2] != dims[2]) {
+		cout << "Warning: Binary observation model doesn't match the size of the grid." << endl; 
+		return 0; 
+	}
+	
+	//The tables are stored exactly as they are laid out in memory, so they're read in place.
+	size_t bytes = sizeof(double); 
+	for (int d = 0; d < numDims; d++) bytes *= dims[d]; 
+	if (!NMPTUtils::readChecksummedBlockFromStreamBinary(in, probObsGivenFace->data.db, bytes) 
+		|| !NMPTUtils::readChecksummedBlockFromStreamBinary(in, probObsGivenNoFace->data.db, bytes) 
+		|| !NMPTUtils::readChecksummedBlockFromStreamBinary(in, countsObsGivenFace->data.db, bytes) 
+		|| !NMPTUtils::readChecksummedBlockFromStreamBinary(in, countsObsGivenNoFace->data.db, bytes)) {
+		cout << "Warning: Corrupt observation model tables in binary model." << endl; 
+		return 0; 
+	}
+	updateLogRatioTables(); 
+	return 1; 
+}
+
 void MultinomialObservationModel::fillProbTablesHeuristic() {
 	int maxcount = cvGetDimSize(probObsGivenFace, 2); 	
 	
@@ -132,6 +178,7 @@ void MultinomialObservationModel::fillProbTablesHeuristic() {
 			}
 		}		
 	}
+	updateLogRatioTables(); 
 }
 
 void MultinomialObservationModel::resetCounts() {	
@@ -181,6 +228,109 @@ void MultinomialObservationModel::normalizeProbTables() {
 			}
 		}		
 	}
+	updateLogRatioTables(); 
+}
+
+void MultinomialObservationModel::updateLogRatioTables() {
+	int maxcount = cvGetDimSize(probObsGivenFace, 2); 
+	int width = observationProbability->width; 
+	int height = observationProbability->height; 
+	logRatioTables.resize(maxcount); 
+	for (int c = 0; c < maxcount; c++) {
+		logRatioTables[c].create(2*height-1, 2*width-1, CV_64F); 
+	}
+	for (int offsety = 0; offsety < height; offsety++) {
+		for (int offsetx = 0; offsetx < width; offsetx++) {
+			double zeroRatio = 0; 
+			for (int c = 0; c < maxcount; c++) {
+				double pface = cvGetReal3D(probObsGivenFace, offsety, offsetx, c);
+				double pnoface = cvGetReal3D(probObsGivenNoFace, offsety, offsetx, c); 
+				double ratio = log(pface/pnoface); 
+				if (c == 0) zeroRatio = ratio; 
+				else ratio = ratio - zeroRatio; 
+				//The ratio only depends on the distance from fixation, so fill all four quadrants.
+				logRatioTables[c].at<double>(height-1-offsety, width-1-offsetx) = ratio; 
+				logRatioTables[c].at<double>(height-1-offsety, width-1+offsetx) = ratio; 
+				logRatioTables[c].at<double>(height-1+offsety, width-1-offsetx) = ratio; 
+				logRatioTables[c].at<double>(height-1+offsety, width-1+offsetx) = ratio; 
+			}
+		}
+	}
+	updateInfoGainTables(); 
+}
+
+const double MultinomialObservationModel::infoGainMinBelief = 1e-8; 
+
+void MultinomialObservationModel::updateInfoGainTables() {
+	int maxcount = cvGetDimSize(probObsGivenFace, 2); 
+	int width = observationProbability->width; 
+	int height = observationProbability->height; 
+	double logStep = -log(infoGainMinBelief)/(numInfoGainLevels-1); 
+	infoGainTables.resize(numInfoGainLevels); 
+	for (int k = 0; k < numInfoGainLevels; k++) {
+		infoGainTables[k].create(2*height-1, 2*width-1, CV_64F); 
+	}
+	vector<double> pface(maxcount), ratio(maxcount); 
+	for (int offsety = 0; offsety < height; offsety++) {
+		for (int offsetx = 0; offsetx < width; offsetx++) {
+			for (int c = 0; c < maxcount; c++) {
+				pface[c] = cvGetReal3D(probObsGivenFace, offsety, offsetx, c);
+				ratio[c] = pface[c]/cvGetReal3D(probObsGivenNoFace, offsety, offsetx, c); 
+			}
+			for (int k = 0; k < numInfoGainLevels; k++) {
+				double b = k == numInfoGainLevels-1 ? 1 : infoGainMinBelief*exp(k*logStep); 
+				double g = 0; 
+				for (int c = 0; c < maxcount; c++) {
+					g += pface[c]*log(ratio[c]/(b*ratio[c]+1-b)); 
+				}
+				infoGainTables[k].at<double>(height-1-offsety, width-1-offsetx) = g; 
+				infoGainTables[k].at<double>(height-1-offsety, width-1+offsetx) = g; 
+				infoGainTables[k].at<double>(height-1+offsety, width-1-offsetx) = g; 
+				infoGainTables[k].at<double>(height-1+offsety, width-1+offsetx) = g; 
+			}
+		}
+	}
+}
+
+void MultinomialObservationModel::getExpectedInformationGain(IplImage* belief, Mat &gain) const {
+	int width = observationProbability->width; 
+	int height = observationProbability->height; 
+	gain.create(height, width, CV_64F); 
+	
+	//Each cell's belief is split between the two tabulated levels it falls between, giving one
+	//weight image per level. The gain at every fixation is then a sum over levels of the weight
+	//image correlated with that level's table, which filter2D computes (through the DFT for
+	//tables of any size) without visiting every pair of fixation and cell. 
+	double logStep = -log(infoGainMinBelief)/(numInfoGainLevels-1); 
+	vector<Mat> weights(numInfoGainLevels); 
+	for (int k = 0; k < numInfoGainLevels; k++) {
+		weights[k] = Mat::zeros(height, width, CV_64F); 
+	}
+	vector<int> levelUsed(numInfoGainLevels, 0); 
+	for (int y = 0; y < height; y++) {
+		const float* beliefRow = (const float*)(belief->imageData + y*belief->widthStep); 
+		for (int x = 0; x < width; x++) {
+			double b = beliefRow[x]; 
+			if (b < 1e-12) continue; 
+			double t = log(b/infoGainMinBelief)/logStep; 
+			t = t < 0 ? 0 : (t > numInfoGainLevels-1.001 ? numInfoGainLevels-1.001 : t); 
+			int k = (int)t; 
+			weights[k].at<double>(y, x) += b*(k+1-t); 
+			weights[k+1].at<double>(y, x) += b*(t-k); 
+			levelUsed[k] = levelUsed[k+1] = 1; 
+		}
+	}
+	
+	//With the anchor at the table's center, filter2D gives 
+	//sum over cells of weights(cell)*table(height-1-fix.y+cell.y, width-1-fix.x+cell.x). 
+	gain = Scalar(0); 
+	Mat levelGain; 
+	Point anchor(width-1, height-1); 
+	for (int k = 0; k < numInfoGainLevels; k++) {
+		if (!levelUsed[k]) continue; 
+		filter2D(weights[k], levelGain, CV_64F, infoGainTables[k], anchor, 0, BORDER_CONSTANT); 
+		gain += levelGain; 
+	}
 }
 
 void MultinomialObservationModel::setObservationProbability(CvPoint searchPoint, IplImage* faceCount) {
@@ -203,6 +353,34 @@ void MultinomialObservationModel::setObservationProbability(CvPoint searchPoint,
 }
 
 
+void MultinomialObservationModel::addLogLikelihoodRatio(CvPoint searchPoint, IplImage* faceCount, Mat &logBelief) const {
+	int width = observationProbability->width; 
+	int height = observationProbability->height; 
+	if (searchPoint.x < 0 || searchPoint.y < 0 || searchPoint.x >= width || searchPoint.y >= height) {
+		cout << "Bad Search Point: " << searchPoint.x << ", " <<searchPoint.y << endl; 
+		return; 
+	}
+	
+	//Most cells see no detections, so add the ratios for a count of 0 everywhere, and then
+	//correct the cells that had detections. 
+	Rect window(width-1-searchPoint.x, height-1-searchPoint.y, width, height); 
+	logBelief += logRatioTables[0](window); 
+	
+	//With a single count bin, every count is clamped to 0, which was added already. 
+	int maxcount = logRatioTables.size(); 
+	if (maxcount < 2) return; 
+	for (int gridlocy = 0; gridlocy < height; gridlocy++) {
+		const uchar* counts = (const uchar*)(faceCount->imageData + gridlocy*faceCount->widthStep); 
+		double* beliefRow = logBelief.ptr<double>(gridlocy); 
+		for (int gridlocx = 0; gridlocx < width; gridlocx++) {
+			int c = counts[gridlocx]; 
+			if (c == 0) continue; 
+			c = c<maxcount?c:maxcount-1; 
+			beliefRow[gridlocx] += logRatioTables[c].at<double>(window.y+gridlocy, window.x+gridlocx); 
+		}
+	}
+}
+
 void MultinomialObservationModel::updateProbTableCounts(CvPoint searchPoint, IplImage* faceCount, CvRect faceLocation) {
 	
 	int maxcount = cvGetDimSize(probObsGivenFace, 2);
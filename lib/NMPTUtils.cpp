@@ -284,6 +284,102 @@ void NMPTUtils::readMatBinary(const FileNode &tm, Mat &mat) {
 }
 
 
+void NMPTUtils::writeMatToStreamBinary(std::ostream &out, const Mat &mat) {
+	int header[3] = {mat.rows, mat.cols, mat.type()}; 
+	out.write((char*)header, 3*sizeof(int)); 
+	size_t rowBytes = mat.cols*mat.elemSize(); 
+	for (int i = 0; i < mat.rows; i++) {
+		out.write((const char*)mat.ptr(i), rowBytes); 
+	}
+}
+
+/* Whether a stream can still supply the given number of bytes, so that a 
+ * corrupt length is rejected before anything is allocated for it. Streams that
+ * can't seek are only held to a fixed limit. */
+static int streamHasBytes(std::istream &in, double bytes) {
+	const double maxBytes = 2147483647.0; 
+	if (bytes > maxBytes) return 0; 
+	std::istream::pos_type here = in.tellg(); 
+	if (here == std::istream::pos_type(-1)) return 1; 
+	in.seekg(0, std::ios::end); 
+	std::istream::pos_type end = in.tellg(); 
+	in.seekg(here); 
+	if (end == std::istream::pos_type(-1) || !in) {
+		in.clear(); 
+		in.seekg(here); 
+		return 1; 
+	}
+	return bytes <= (double)(end - here); 
+}
+
+int NMPTUtils::readMatFromStreamBinary(std::istream &in, Mat &mat) {
+	int header[3]; 
+	in.read((char*)header, 3*sizeof(int)); 
+	if (!in || header[0] < 0 || header[1] < 0 
+		|| header[2] != CV_MAT_TYPE(header[2]) || CV_MAT_DEPTH(header[2]) > CV_64F) {
+		mat = Mat(); 
+		return 0; 
+	}
+	if (header[0] == 0 || header[1] == 0) {
+		mat = Mat(); 
+		return 1; 
+	}
+	if (!streamHasBytes(in, (double)header[0]*header[1]*CV_ELEM_SIZE(header[2]))) {
+		mat = Mat(); 
+		return 0; 
+	}
+	mat.create(header[0], header[1], header[2]); 
+	in.read((char*)mat.data, mat.rows*mat.step); 
+	return !in.fail(); 
+}
+
+void NMPTUtils::writeStringToStreamBinary(std::ostream &out, const std::string &str) {
+	int size = str.size(); 
+	out.write((char*)&size, sizeof(int)); 
+	out.write(str.data(), size); 
+}
+
+int NMPTUtils::readStringFromStreamBinary(std::istream &in, std::string &str) {
+	int size = 0; 
+	in.read((char*)&size, sizeof(int)); 
+	if (!in || size < 0 || !streamHasBytes(in, size)) return 0; 
+	str.resize(size); 
+	if (size > 0) in.read(&str[0], size); 
+	return !in.fail(); 
+}
+
+//Filled in during static initialization, so that checksums can be computed from any thread.
+static struct CRC32Table {
+	unsigned int entries[256]; 
+	CRC32Table() {
+		for (unsigned int n = 0; n < 256; n++) {
+			unsigned int c = n; 
+			for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1; 
+			entries[n] = c; 
+		}
+	}
+} crc32Table; 
+
+unsigned int NMPTUtils::crc32(const void* data, size_t bytes, unsigned int crc) {
+	const uchar* p = (const uchar*)data; 
+	crc = ~crc; 
+	for (size_t i = 0; i < bytes; i++) crc = crc32Table.entries[(crc ^ p[i]) & 0xFF] ^ (crc >> 8); 
+	return ~crc; 
+}
+
+void NMPTUtils::writeChecksummedBlockToStreamBinary(std::ostream &out, const void* data, size_t bytes) {
+	unsigned int crc = crc32(data, bytes); 
+	if (bytes > 0) out.write((const char*)data, bytes); 
+	out.write((char*)&crc, sizeof(unsigned int)); 
+}
+
+int NMPTUtils::readChecksummedBlockFromStreamBinary(std::istream &in, void* data, size_t bytes) {
+	unsigned int crc = 0; 
+	if (bytes > 0) in.read((char*)data, bytes); 
+	in.read((char*)&crc, sizeof(unsigned int)); 
+	return !in.fail() && crc == crc32(data, bytes); 
+}
+
 /*
  void NMPTUtils::writeMatBinaryCompressed(FileStorage &fs, const string &name, const Mat &m) {
  Mat mat(m.rows,m.cols,m.type());
@@ -564,6 +660,20 @@ void NMPTUtils::rectangleRotated(Mat & image, Point center, Size size, double an
  * predictions: QxO, Q query points, O output dimensions. 
  */
 Mat NMPTUtils::RBF(const Mat &input, const Mat &labels, const Mat &weights, const Mat &xqueries, double tau, double eps) {
+	Mat numerator, denominator; 
+	RBFSums(input, labels, weights, xqueries, tau, eps, numerator, denominator); 
+	return RBFFromSums(numerator, denominator); 
+}
+
+/* Unnormalized RBF statistics: for each query i, 
+ * numerator(i,:) = sum_j k(x_i, input_j) * weights_j * labels(j,:) and
+ * denominator(i) = sum_j k(x_i, input_j) * weights_j. 
+ * 
+ * These are additive over disjoint sets of data points, so the RBF of a 
+ * partitioned dataset can be computed by summing the statistics of each part. 
+ */
+void NMPTUtils::RBFSums(const Mat &input, const Mat &labels, const Mat &weights, const Mat &xqueries, 
+						double tau, double eps, Mat &numerator, Mat &denominator) {
 	int N = input.rows; 
 	//int M = input.cols; 
 	int O = labels.cols; 
@@ -571,21 +681,20 @@ Mat NMPTUtils::RBF(const Mat &input, const Mat &labels, const Mat &weights, cons
 	
     if (_RBF_DEBUG) std::cout << "Computing RBF on " << N << " data points, " << Q << " queries." << std::endl;
 	
-	Mat predictions, xdiff, wtrow;
+	Mat xdiff, wtrow;
 	double negt2inv = -1.0/(2.0*tau*tau);
 	wtrow.create(1,N,CV_64F); 
-	predictions.create(Q,O,CV_64F); 
-
+	numerator.create(Q,O,CV_64F); 
+	denominator.create(Q,1,CV_64F); 
 	
 	for (int i = 0; i < Q; i++) {
 		const Mat currx1 = xqueries.row(i); 
-		Mat curry = predictions.row(i); 
+		Mat curry = numerator.row(i); 
 		
 		if (_RBF_DEBUG) {
             std::cout << "Computing RBF Val for query " ;
 			printMat(currx1); 
 		}
-			
 		
 		for (int j = 0; j < N; j++) {
 			Mat currx2 = input.row(j); 
@@ -595,28 +704,31 @@ Mat NMPTUtils::RBF(const Mat &input, const Mat &labels, const Mat &weights, cons
 			wtrow.at<double>(0,j) = wt; 
 		}
 		
-		if (_RBF_DEBUG) {
-            //std::cout << "Unnormalized Weights: " ;
-			//printMat(wtrow); 
-		}
-		
+		denominator.at<double>(i,0) = N > 0 ? sum(wtrow)[0] : 0; 
+		if (N > 0) 
+			curry = wtrow * labels; 
+		else 
+			curry = 0.; 
+	}
+}
+
+Mat NMPTUtils::RBFFromSums(const Mat &numerator, const Mat &denominator) {
+	Mat predictions = numerator.clone(); 
+	
+	for (int i = 0; i < predictions.rows; i++) {
+		Mat curry = predictions.row(i); 
 		
-		double norm = sum(wtrow)[0]; 
+		double norm = denominator.at<double>(i,0); 
 		
-        //std::cout << "Norm is " << norm.val[0] << std::endl;
+        //std::cout << "Norm is " << norm << std::endl;
 		if (norm > 0)  {
-			wtrow *= 1.0/norm;
+			curry *= 1.0/norm;
 		}
 		else {
-			wtrow = 0.; 
+			curry = 0.; 
 		}
 		
-		curry = wtrow * labels; 
-		
-		
 		if (_RBF_DEBUG) {
-            //std::cout << "Normalized Weights: " ;
-			//printMat(wtrow); 
             std::cout << "Values " ;
 			printMat(curry); 
 		}
@@ -9,8 +9,19 @@
 
 #include "ObjectDetector.h"
 using namespace std; 
+using namespace cv; 
 
 ObjectDetector::~ObjectDetector(){}
+
+vector<Rect> ObjectDetector::detectObjectsInRegion(IplImage* frame, CvRect region, 
+												   IplImage* scaledRegion, int newFrame) {
+	return detectObjects(scaledRegion); 
+}
+
+ObjectDetector* ObjectDetector::clone() {
+	return NULL; 
+}
+
 ostream& operator<< (ostream& ofs, ObjectDetector* model) {
 	model->addToStream(ofs); 
 	return ofs; 
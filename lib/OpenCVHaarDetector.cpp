@@ -81,6 +81,10 @@ vector<Rect> OpenCVHaarDetector::detectObjects(IplImage* image) {
 	return objects; 
 }
 
+ObjectDetector* OpenCVHaarDetector::clone() {
+	return new OpenCVHaarDetector(this); 
+}
+
 void OpenCVHaarDetector::setHaarCascadeScaleFactor(double factor) {
 	vjScale = factor; 
 }
@@ -17,12 +17,68 @@
 #include "OpenLoopPolicies.h"
 #include "FastPatchList.h"
 #include "NMPTUtils.h"
+#include "ImageCache2.h"
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std; 
 using namespace cv;
 
 int PatchDataset2::minPerNegIm = 100; 
 
+static const char binaryPatchMagic[8] = {'N','M','P','T','P','D','S','2'}; 
+static const int binaryPatchVersion = 1; 
+static const int binaryPatchByteOrder = 0x01020304; 
+static const size_t binaryPatchBlockAlign = 4096; 
+static const size_t binaryPatchStrideAlign = 64; 
+
+/* Fixed header at the start of a binary patch file. All offsets are in bytes
+ * from the start of the file. Representation blocks are ordered image, 
+ * integral, square integral; a block with zero stride is absent. */
+struct BinaryPatchHeader {
+	char magic[8]; 
+	int version; 
+	int byteOrder; 
+	int patchWidth; 
+	int patchHeight; 
+	int numPatches; 
+	int numReps; 
+	long long labelsOffset; 
+	long long metaOffset; 
+	long long metaBytes; 
+	long long repOffset[3]; 
+	long long repStride[3]; 
+	long long fileBytes; 
+}; 
+
+static size_t alignUp(size_t val, size_t alignment) {
+	return (val + alignment - 1) / alignment * alignment; 
+}
+
+static void padStreamTo(ostream &out, size_t offset) {
+	static const char zeros[binaryPatchBlockAlign] = {0}; 
+	size_t pos = out.tellp(); 
+	while (pos < offset) {
+		size_t n = std::min(offset - pos, binaryPatchBlockAlign); 
+		out.write(zeros, n); 
+		pos += n; 
+	}
+}
+
+PatchDataset2::MappedFile::MappedFile(void* address, size_t length) 
+: address(address), length(length) {
+}
+
+PatchDataset2::MappedFile::~MappedFile() {
+	if (address != NULL && address != MAP_FAILED) 
+		munmap(address, length); 
+}
+
 PatchDataset2::PatchDataset2() {
 	init(); 
 }
@@ -48,10 +104,11 @@ PatchDataset2::PatchDataset2(Size patchsize,
 							 int numPosPatches, 
 							 int numNegPatches,
 							 int useFastPatchList, 
-							 double scale) {
+							 double scale, 
+							 uint64 randomSeed) {
 	init(patchsize, positiveImageListFilename, positiveImageLabelsFilename, 
 		 negativeImageListFilename, posExamplePatchRadius, posExampleScaleRadius, 
-		 numPosPatches, numNegPatches, useFastPatchList, scale); 
+		 numPosPatches, numNegPatches, useFastPatchList, scale, randomSeed); 
 }
 
 void PatchDataset2::setUseFastPatchList(int yesorno) {
@@ -72,7 +129,8 @@ void PatchDataset2::init(Size patchsize,
 						 int numPosPatches, 
 						 int numNegPatches,
 						 int useFastPatchList, 
-						 double scale) {
+						 double scale, 
+						 uint64 randomSeed) {
 	
 	setUseFastPatchList(useFastPatchList); 
 	
@@ -117,52 +175,26 @@ void PatchDataset2::init(Size patchsize,
 		negImageDataset = posImageDataset; 
 	}
 	
-	Mat image; 
+	vector<ImagePatch2> newPatches; 
 	
 	if (posImagesHaveLabels) { // Extract labeled regions from images. 
-		vector<string> names = evaluator.getFileNames(); 
-		vector<vector<Rect> > locs = evaluator.getTargetLocations(); 
-		for (size_t imNum = 0; imNum < names.size(); imNum++) {
-			if (_DATASET_DEBUG) cout << "Getting patches from positive example " << imNum << endl; 
-			
-			image = imread(names[imNum], 0);
-			list->setImage(image);  
-			for (size_t patchNum = 0; patchNum < locs[imNum].size(); patchNum++) {
-				Rect ROI = locs[imNum][patchNum]; 
-				if (ROI.x < 0) ROI.x = 0; 
-				if (ROI.y < 0) ROI.y = 0; 
-				if (ROI.x+ROI.width > image.cols) ROI.width=image.cols-ROI.x; 
-				if (ROI.y+ROI.height > image.rows) ROI.height=image.rows-ROI.y; 
-				vector<ImagePatch2> objPatches = list->getNearbyPatches(ROI,
-																	   posExamplePatchRadius,
-																	   posExampleScaleRadius); 
-				
-				for (size_t z = 0; z < objPatches.size(); z++) {
-					patches.push_back(objPatches[z]); 
-					labels.push_back(1); 
-					posPatches.push_back(patches.back()); 
-				}
-			}
-		}
+		extractPatches(extractLabeledPatches, evaluator.getFileNames(), evaluator.getTargetLocations(), 
+					   posExamplePatchRadius, posExampleScaleRadius, randomSeed, -1, newPatches); 
 	} else if (numPosImages > 0) { //Treat the whole image as a positive patch.
-		for (int i = 0; i < posImageDataset.getNumEntries(); i++) {
-			Mat im = imread(posImageDataset.getFileName(i), 0); 
-			Mat patch; 
-			resize(im, patch, patchSize, 0, 0, INTER_NEAREST); 
-			ImagePatch2 impatch; 
-			patches.push_back(impatch); 
-			patches.back().setImage(patch, 0, 1, 0, 0); 
-			posPatches.push_back(patches.back());
-			labels.push_back(1); 
-		}								 
+		vector<string> names(posImageDataset.getNumEntries()); 
+		for (size_t i = 0; i < names.size(); i++) 
+			names[i] = posImageDataset.getFileName(i); 
+		extractPatches(extractWholeImages, names, vector<vector<Rect> >(names.size()), 
+					   0, 0, randomSeed, -1, newPatches); 
 	}
 	
-	if (numPosPatches > -1 && numPosPatches < (int)patches.size()) {
-		patches.resize(numPosPatches); 
-		posPatches.resize(numPosPatches); 
-	}
+	if (numPosPatches > -1 && numPosPatches < (int)newPatches.size()) 
+		newPatches.resize(numPosPatches); 
 	
+	patches = newPatches; 
+	labels.assign(patches.size(), 1); 
 	numPosPatches = patches.size(); 
+	newPatches.clear(); 
 	
 	if (numNegImages < 1) { //Take negative patches from positive images
 		
@@ -177,7 +209,6 @@ void PatchDataset2::init(Size patchsize,
 		
 		int numTotal = numPosPatches+numNegPatches; 
 		
-		int ind = numPosPatches; 
 		int patchesPerNegIm = ceil( (numTotal-numPosPatches)*1.0 / numNegImages); 
 		
 		patchesPerNegIm = patchesPerNegIm > minPerNegIm ? patchesPerNegIm : minPerNegIm; 
@@ -186,23 +217,8 @@ void PatchDataset2::init(Size patchsize,
 		<< " negative patches from " << numNegImages << " images with " 
 		<< patchesPerNegIm << " patches per image." << endl; 
 		
-		for (size_t i = 0; i < names.size(); i++) {
-			if (_DATASET_DEBUG) cout << "Getting patches from negative example " << i << endl; 
-			if (_DATASET_DEBUG) cout << "Loading neg image " << names[i] << endl; 
-			if (ind >= numTotal) break; 
-			
-			image = imread(names[i], 0); //0 means CV_LOAD_IMAGE_GRAYSCALE
-			
-			vector<ImagePatch2> impatches = getRandomPatches(patchesPerNegIm,image,patchSize, locs[i]);
-			
-			for (size_t j = 0; j < impatches.size(); j++) {
-				if (ind >= numTotal) break; 
-				patches.push_back(impatches[j]); 
-				negPatches.push_back(impatches[j]); 
-				labels.push_back(-1); 
-				ind++; 
-			}
-		}	
+		extractPatches(extractRandomPatches, names, locs, patchesPerNegIm, 0, 
+					   randomSeed, numTotal-numPosPatches, newPatches); 
 	} else { // Take negative patches from background images
 		if (numNegPatches < 0 && numNegImages > 0) numNegPatches = numPosPatches; 
 		
@@ -211,7 +227,6 @@ void PatchDataset2::init(Size patchsize,
 		
 		int numTotal = numPosPatches+numNegPatches; 
 		
-		int ind = numPosPatches; 
 		int patchesPerNegIm = ceil( (numTotal-numPosPatches)*1.0 / numNegImages); 
 		patchesPerNegIm = patchesPerNegIm > minPerNegIm ? patchesPerNegIm : minPerNegIm; 
 		
@@ -219,20 +234,125 @@ void PatchDataset2::init(Size patchsize,
 		<< " negative patches from " << numNegImages << " images with " 
 		<< patchesPerNegIm << " patches per image." << endl; 
 		
-		for (int i = 0; i < negImageDataset.getNumEntries(); i++) {
-			if (_DATASET_DEBUG) cout << "Getting patches from negative example " << i << endl; 
-			image = imread( negImageDataset.getFileName(i), 0); //CV_LOAD_IMAGE_GRAYSCALE);
-
-			for (int j = 0; j < patchesPerNegIm; j++) {
-				vector<Rect> r; 
-				patches.push_back(getRandomPatch(image,patchSize,r)); 
-				negPatches.push_back(patches.back()); 
-				labels.push_back(-1); 
-				ind++; 
+		vector<string> names(negImageDataset.getNumEntries()); 
+		for (size_t i = 0; i < names.size(); i++) 
+			names[i] = negImageDataset.getFileName(i); 
+		extractPatches(extractRandomPatches, names, vector<vector<Rect> >(names.size()), 
+					   patchesPerNegIm, 0, randomSeed, -1, newPatches); 
+	}
+
+	patches.insert(patches.end(), newPatches.begin(), newPatches.end()); 
+	labels.resize(patches.size(), -1); 
+	recreatePosNegPatches(); 
+}
+
+
+/**
+ * Reads images and extracts their patches, one image per task. Each call 
+ * owns a PatchList2, and each image draws random locations from its own 
+ * generator, so the patches of an image don't depend on which thread, or
+ * in which order, it was processed. 
+ */
+class PatchExtractionBody : public ParallelLoopBody {
+public:
+	PatchExtractionBody(const PatchDataset2* dataset, int mode, 
+						const vector<string> &fileNames, 
+						const vector<vector<Rect> > &objectLocations, 
+						int param1, int param2, uint64 seed, int firstImage, 
+						vector<vector<ImagePatch2> > &results) : 
+	dataset(dataset), mode(mode), fileNames(fileNames), objectLocations(objectLocations), 
+	param1(param1), param2(param2), seed(seed), firstImage(firstImage), results(results) {}
+	
+	void operator()(const Range &range) const {
+		Ptr<PatchList2> list = dataset->createPatchList(); 
+		for (int j = range.start; j < range.end; j++) {
+			int imNum = firstImage + j; 
+			results[j].clear(); 
+			if (_DATASET_DEBUG) cout << "Getting patches from image " << fileNames[imNum] << endl; 
+			Mat image; 
+			if (!ImageCache2::getSharedCache().getImage(fileNames[imNum], image)) {
+				cout << "Warning: Couldn't read image " << fileNames[imNum] << endl; 
+				continue; 
+			}
+			
+			if (mode == PatchDataset2::extractLabeledPatches) {
+				//Patches that need no resampling are viewed in the pyramid the 
+				//search already integrated, and detached (rebased) out of it 
+				//before the next image, rather than being integrated again. 
+				list->setNearbyPatchViews(1); 
+				list->setImage(image);  
+				for (size_t patchNum = 0; patchNum < objectLocations[imNum].size(); patchNum++) {
+					Rect ROI = objectLocations[imNum][patchNum]; 
+					if (ROI.x < 0) ROI.x = 0; 
+					if (ROI.y < 0) ROI.y = 0; 
+					if (ROI.x+ROI.width > image.cols) ROI.width=image.cols-ROI.x; 
+					if (ROI.y+ROI.height > image.rows) ROI.height=image.rows-ROI.y; 
+					vector<ImagePatch2> objPatches = list->getNearbyPatches(ROI, param1, param2); 
+					for (size_t k = 0; k < objPatches.size(); k++) {
+						objPatches[k].detach(); 
+						results[j].push_back(objPatches[k]); 
+					}
+				}
+			} else if (mode == PatchDataset2::extractWholeImages) {
+				Mat patch; 
+				resize(image, patch, dataset->patchSize, 0, 0, INTER_NEAREST); 
+				results[j].push_back(ImagePatch2()); 
+				results[j].back().setImage(patch, 0, 1, 0, 0); 
+			} else {
+				RNG rng(seed ^ (CV_BIG_UINT(0x9E3779B97F4A7C15) * (uint64)(imNum+1))); 
+				results[j] = dataset->getRandomPatches(param1, image, dataset->patchSize, 
+													   objectLocations[imNum], list, rng); 
 			}
 		}	
 	}
 	
+private:
+	const PatchDataset2* dataset; 
+	int mode; 
+	const vector<string> &fileNames; 
+	const vector<vector<Rect> > &objectLocations; 
+	int param1, param2; 
+	uint64 seed; 
+	int firstImage; 
+	vector<vector<ImagePatch2> > &results; 
+}; 
+
+void PatchDataset2::extractPatches(int mode, const vector<string> &fileNames, 
+								   const vector<vector<Rect> > &objectLocations, 
+								   int param1, int param2, uint64 seed, int maxPatches, 
+								   vector<ImagePatch2> &dest) const {
+	int numImages = fileNames.size(); 
+	
+	// Without a patch limit every image is needed, so all are processed at 
+	// once. With a limit, images are processed a few per thread at a time, 
+	// so that images past the limit are never read. 
+	int batchSize = numImages; 
+	if (maxPatches >= 0) {
+		int numThreads = getNumThreads(); 
+		batchSize = 4*(numThreads > 1 ? numThreads : 1); 
+	}
+	
+	for (int first = 0; first < numImages; first += batchSize) {
+		if (maxPatches >= 0 && (int)dest.size() >= maxPatches) break; 
+		int numInBatch = min(batchSize, numImages - first); 
+		vector<vector<ImagePatch2> > results(numInBatch); 
+		parallel_for_(Range(0, numInBatch), 
+					  PatchExtractionBody(this, mode, fileNames, objectLocations, 
+										  param1, param2, seed, first, results)); 
+		
+		// Append in image order, exactly as a serial build would. 
+		for (int j = 0; j < numInBatch; j++) {
+			for (size_t k = 0; k < results[j].size(); k++) {
+				if (maxPatches >= 0 && (int)dest.size() >= maxPatches) break; 
+				dest.push_back(results[j][k]); 
+			}
+		}
+	}
+}
+
+PatchList2* PatchDataset2::createPatchList() const {
+	if (useFast) return new FastPatchList2(); 
+	return new PatchList2(); 
 }
 
 
@@ -333,34 +453,31 @@ ImagePatch2 PatchDataset2::getPatch(const Mat &image, Size patchSize, Point objC
 }
 
 
-ImagePatch2 PatchDataset2::getRandomPatch(const Mat &image, Size patchSize, 
-										  const vector<Rect> &blackoutList) const{	
-	return getRandomPatches(1, image, patchSize, blackoutList)[0]; 
-}
-
 vector<ImagePatch2> PatchDataset2::getRandomPatches(int numPatches, const Mat & image, 
-													Size patchSize, const vector<Rect> &blackoutList) const{
+													Size patchSize, const vector<Rect> &blackoutList, 
+													PatchList2* patchList, RNG &rng) const{
 	
 	Mat patch_image; 
 	
-	list->setImage(image);  
+	patchList->setImage(image);  
 	vector<SearchResult> scaleResults; 
 	vector<SearchResult> allResults; 
 	allResults.clear(); 
-	for (int s = 0; s < list->getNumScales(); s++) {
-		list->resetListToScale(s);
+	for (int s = 0; s < patchList->getNumScales(); s++) {
+		patchList->resetListToScale(s);
 		scaleResults.clear(); 
-		list->getRemainingPatches(scaleResults, blackoutList, patchSize.width*.5, 2);
+		patchList->getRemainingPatches(scaleResults, blackoutList, patchSize.width*.5, 2);
 		allResults.insert(allResults.end(), scaleResults.begin(), scaleResults.end()); 
 	}
 	
 	vector<ImagePatch2> retvec; 
+	if (allResults.empty()) return retvec; 
 	
 	for (int i = 0; i < numPatches; i++) {
 		
-		int locnum = (int)(NMPTUtils::randomFloat()*allResults.size());
+		int locnum = (int)(rng.uniform(0., 1.)*allResults.size());
 		 
-		list->fillImageWithPixelsOfSearchPatch(patch_image, allResults[locnum]); 
+		patchList->fillImageWithPixelsOfSearchPatch(patch_image, allResults[locnum]); 
 		
 		ImagePatch2 retval; 
 		retval.setImage(patch_image, 0, 1, 0, 0); 
@@ -400,6 +517,7 @@ void PatchDataset2::copy(const PatchDataset2 &rhs) {
 	negImageDataset = rhs.negImageDataset; 
 	
 	evaluator = rhs.evaluator;
+	mapping = rhs.mapping; 
 }
 
 int PatchDataset2::empty() const {
@@ -407,6 +525,219 @@ int PatchDataset2::empty() const {
 }
 
 
+int PatchDataset2::isMapped() const {
+	return !mapping.empty(); 
+}
+
+int PatchDataset2::isBinaryFile(const string &filename) {
+	char magic[8]; 
+	ifstream in(filename.c_str(), ios::in | ios::binary); 
+	if (!in.read(magic, sizeof(magic))) return 0; 
+	return !memcmp(magic, binaryPatchMagic, sizeof(magic)); 
+}
+
+int PatchDataset2::saveBinary(const string &filename, int withIntegrals, int withSqIntegrals) const {
+	int numPatches = patches.size(); 
+	int w = patchSize.width, h = patchSize.height; 
+	for (int i = 0; i < numPatches; i++) {
+		if (patches[i].getImageSize() != patchSize) {
+			cout << "Warning: Patch " << i << " does not match the dataset patch size; not saving " 
+			<< filename << endl; 
+			return 0; 
+		}
+	}
+	
+	ostringstream meta(ios::out | ios::binary); 
+	meta.write((char*)&useFast, sizeof(int)); 
+	meta.write((char*)&scale, sizeof(double)); 
+	NMPTUtils::writeStringToStreamBinary(meta, posImagesFileList); 
+	NMPTUtils::writeStringToStreamBinary(meta, posImagesLabelsList); 
+	NMPTUtils::writeStringToStreamBinary(meta, negImagesFileList); 
+	posImageDataset.addToStreamBinary(meta); 
+	negImageDataset.addToStreamBinary(meta); 
+	evaluator.addToStreamBinary(meta); 
+	string metaData = meta.str(); 
+	
+	BinaryPatchHeader header; 
+	memset(&header, 0, sizeof(header)); 
+	memcpy(header.magic, binaryPatchMagic, sizeof(header.magic)); 
+	header.version = binaryPatchVersion; 
+	header.byteOrder = binaryPatchByteOrder; 
+	header.patchWidth = w; 
+	header.patchHeight = h; 
+	header.numPatches = numPatches; 
+	header.numReps = 3; 
+	header.labelsOffset = alignUp(sizeof(header), binaryPatchStrideAlign); 
+	header.metaOffset = alignUp(header.labelsOffset + numPatches*sizeof(int), binaryPatchStrideAlign); 
+	header.metaBytes = metaData.size(); 
+	
+	size_t repBytes[3] = {w*h*sizeof(uchar), 
+		withIntegrals ? (w+1)*(h+1)*sizeof(int) : 0,
+		withSqIntegrals ? (w+1)*(h+1)*sizeof(double) : 0}; 
+	size_t offset = header.metaOffset + header.metaBytes; 
+	for (int r = 0; r < 3; r++) {
+		header.repStride[r] = alignUp(repBytes[r], binaryPatchStrideAlign); 
+		if (header.repStride[r] == 0) continue; 
+		header.repOffset[r] = alignUp(offset, binaryPatchBlockAlign); 
+		offset = header.repOffset[r] + header.repStride[r]*numPatches; 
+	}
+	header.fileBytes = offset; 
+	
+	string tmpname = filename + ".tmp"; 
+	ofstream out(tmpname.c_str(), ios::out | ios::binary | ios::trunc); 
+	if (!out.is_open()) {
+		cout << "Warning: Couldn't open " << tmpname << " for writing." << endl; 
+		return 0; 
+	}
+	
+	out.write((char*)&header, sizeof(header)); 
+	padStreamTo(out, header.labelsOffset); 
+	if (numPatches > 0) 
+		out.write((char*)&labels[0], numPatches*sizeof(int)); 
+	padStreamTo(out, header.metaOffset); 
+	out.write(metaData.data(), metaData.size()); 
+	
+	for (int r = 0; r < 3; r++) {
+		if (header.repStride[r] == 0) continue; 
+		padStreamTo(out, header.repOffset[r]); 
+		for (int i = 0; i < numPatches; i++) {
+			ImagePatch2 p = patches[i]; 
+			Mat rep; 
+			if (r == 1) {
+				p.createRepIfNeeded(0, 1); 
+				rep = p.getIntegralHeader(); 
+			} else if (r == 2) {
+				p.createRepIfNeeded(1, 0); 
+				Mat sum, sqsum; 
+				integral(p.getImageHeader(), sum, sqsum, CV_32S); 
+				rep = sqsum; 
+			} else {
+				p.createRepIfNeeded(1, 0); 
+				rep = p.getImageHeader(); 
+			}
+			for (int y = 0; y < rep.rows; y++) 
+				out.write((char*)rep.ptr(y), rep.cols*rep.elemSize()); 
+			padStreamTo(out, header.repOffset[r] + (i+1)*header.repStride[r]); 
+		}
+	}
+	
+	out.close(); 
+	if (out.fail() || rename(tmpname.c_str(), filename.c_str()) != 0) {
+		cout << "Warning: Failed to write " << filename << endl; 
+		remove(tmpname.c_str()); 
+		return 0; 
+	}
+	return 1; 
+}
+
+int PatchDataset2::loadMapped(const string &filename) {
+	int fd = open(filename.c_str(), O_RDONLY); 
+	if (fd < 0) {
+		cout << "Warning: Couldn't open " << filename << endl; 
+		return 0; 
+	}
+	struct stat st; 
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BinaryPatchHeader)) {
+		cout << "Warning: " << filename << " is not a binary patch dataset." << endl; 
+		close(fd); 
+		return 0; 
+	}
+	size_t length = st.st_size; 
+	void* address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0); 
+	close(fd); 
+	if (address == MAP_FAILED) {
+		cout << "Warning: Couldn't map " << filename << endl; 
+		return 0; 
+	}
+	Ptr<MappedFile> file = new MappedFile(address, length); 
+	uchar* base = (uchar*)address; 
+	
+	BinaryPatchHeader header; 
+	memcpy(&header, base, sizeof(header)); 
+	if (memcmp(header.magic, binaryPatchMagic, sizeof(header.magic))) {
+		cout << "Warning: " << filename << " is not a binary patch dataset." << endl; 
+		return 0; 
+	}
+	if (header.version != binaryPatchVersion || header.byteOrder != binaryPatchByteOrder) {
+		cout << "Warning: " << filename << " has an unsupported version or byte order." << endl; 
+		return 0; 
+	}
+	
+	int w = header.patchWidth, h = header.patchHeight, numPatches = header.numPatches; 
+	size_t repBytes[3] = {w*h*sizeof(uchar), (w+1)*(h+1)*sizeof(int), (w+1)*(h+1)*sizeof(double)}; 
+	int valid = (w > 0 && h > 0 && numPatches >= 0 && header.numReps == 3 
+				 && header.fileBytes == (long long)length 
+				 && header.labelsOffset >= (long long)sizeof(header)
+				 && header.labelsOffset + numPatches*(long long)sizeof(int) <= header.fileBytes
+				 && header.metaOffset >= 0 && header.metaBytes >= 0
+				 && header.metaOffset + header.metaBytes <= header.fileBytes
+				 && header.repStride[0] > 0); 
+	for (int r = 0; r < 3 && valid; r++) {
+		if (header.repStride[r] == 0) continue; 
+		valid = (header.repStride[r] >= (long long)repBytes[r] 
+				 && header.repOffset[r] % binaryPatchStrideAlign == 0
+				 && header.repStride[r] % binaryPatchStrideAlign == 0
+				 && header.repOffset[r] >= 0 
+				 && header.repOffset[r] + header.repStride[r]*numPatches <= header.fileBytes); 
+	}
+	if (!valid) {
+		cout << "Warning: " << filename << " is truncated or corrupt." << endl; 
+		return 0; 
+	}
+	
+	int newUseFast = 1; 
+	double newScale = 1; 
+	string newPosList, newPosLabels, newNegList; 
+	ImageDataSet2 newPosDataset, newNegDataset; 
+	DetectionEvaluator2 newEvaluator; 
+	istringstream meta(string((char*)base + header.metaOffset, header.metaBytes), 
+					   ios::in | ios::binary); 
+	meta.read((char*)&newUseFast, sizeof(int)); 
+	meta.read((char*)&newScale, sizeof(double)); 
+	NMPTUtils::readStringFromStreamBinary(meta, newPosList); 
+	NMPTUtils::readStringFromStreamBinary(meta, newPosLabels); 
+	NMPTUtils::readStringFromStreamBinary(meta, newNegList); 
+	newPosDataset.readFromStreamBinary(meta); 
+	newNegDataset.readFromStreamBinary(meta); 
+	newEvaluator.readFromStreamBinary(meta); 
+	if (!meta) {
+		cout << "Warning: " << filename << " has corrupt dataset information." << endl; 
+		return 0; 
+	}
+	
+	vector<int> newLabels(numPatches); 
+	if (numPatches > 0) 
+		memcpy(&newLabels[0], base + header.labelsOffset, numPatches*sizeof(int)); 
+	
+	vector<ImagePatch2> newPatches(numPatches); 
+	for (int i = 0; i < numPatches; i++) {
+		Mat reps[3]; 
+		for (int r = 0; r < 3; r++) {
+			if (header.repStride[r] == 0) continue; 
+			uchar* data = base + header.repOffset[r] + header.repStride[r]*i; 
+			if (r == 0) reps[r] = Mat(h, w, CV_8UC1, data); 
+			else if (r == 1) reps[r] = Mat(h+1, w+1, CV_32SC1, data); 
+			else reps[r] = Mat(h+1, w+1, CV_64FC1, data); 
+		}
+		newPatches[i].setRepresentations(reps[0], reps[1], reps[2]); 
+	}
+	
+	setUseFastPatchList(newUseFast); 
+	scale = newScale; 
+	posImagesFileList = newPosList; 
+	posImagesLabelsList = newPosLabels; 
+	negImagesFileList = newNegList; 
+	patchSize = Size(w, h); 
+	posImageDataset = newPosDataset; 
+	negImageDataset = newNegDataset; 
+	evaluator = newEvaluator; 
+	labels = newLabels; 
+	patches = newPatches; 
+	mapping = file; 
+	recreatePosNegPatches(); 
+	return 1; 
+}
+
 FileStorage& operator << (cv::FileStorage &fs, const PatchDataset2 &rhs) {
 	fs << "{" << "useFast" << rhs.useFast << "scale" << rhs.scale 
 	<< "posImagesFileList" << rhs.posImagesFileList
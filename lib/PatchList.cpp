@@ -73,6 +73,26 @@ void PatchList::resetListToScale(int scale){
 	currentScale = scale;
 }
 
+void PatchList::resetListToScale(int scale, Rect region){
+	resetListToScale(scale); 
+	if (currentScale != scale) return; 
+	
+	Size patchSize = scalePatchSizes[scale]; 
+	int currLast = 0; 
+	for (int i = 0; i < currentListLength; i++) {
+		int x = imLoc[i]%origImageSize.width; 
+		int y = imLoc[i]/origImageSize.width; 
+		if (x < region.x || y < region.y || x+patchSize.width > region.x+region.width
+			|| y+patchSize.height > region.y+region.height) continue; 
+		accInds[currLast] = accInds[i]; 
+		destInds[currLast] = destInds[i]; 
+		srcInds[currLast] = srcInds[i]; 
+		imLoc[currLast] = imLoc[i]; 
+		currLast++; 
+	}
+	currentListLength = currLast; 
+}
+
 Size PatchList::getBasePatchSize(){
 	return Size (default_width, default_height); 
 }
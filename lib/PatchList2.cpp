@@ -66,6 +66,7 @@ void PatchList2::init(Size baseObjectSize, Size minSize, Size maxSize,
 	shouldResetAccumulator = 1; 
 	origImageSize = Size(0,0); 
 	scaleDownPatches = 1; 
+	nearbyPatchViews = 0; 
 }
 
 PatchList2::~PatchList2() {
@@ -370,16 +371,17 @@ vector<ImagePatch2> PatchList2::getNearbyPatches(cv::Rect roi,
 	for (int i = 0; i < (int)s.size(); i++) {		
 		//!!!!! TODO : Check this out. -- Decide if we want this to be size of base patch or size of patch in image
 		// As it is, we are grabbing every available pixel.
-		Mat patchIm; 
-		if (scaleDownPatches) {
-			patchIm.create(getBasePatchSize(), CV_8U); 
-		}
-		else {
-			patchIm.create(getFilterSizeAtScale(s[i]._scale), CV_8U); 
+		Size filterSize = getFilterSizeAtScale(s[i]._scale); 
+		Size patchSize = scaleDownPatches ? getBasePatchSize() : filterSize; 
+		
+		ImagePatch2 patch;  
+		if (nearbyPatchViews && patchSize == filterSize && getSearchPatchView(patch, s[i])) {
+			retval.push_back(patch); 
+			continue; 
 		}
 		
+		Mat patchIm(patchSize, CV_8U); 
 		fillImageWithPixelsOfSearchPatch(patchIm, s[i]); 
-		ImagePatch2 patch;  
 		patch.setImage(patchIm); 
 		retval.push_back(patch); 
 	}
@@ -404,6 +406,16 @@ void PatchList2::fillImageWithPixelsOfSearchPatch(cv::Mat &image,
 	resize(subImage, image, dstsize, 0, 0, INTER_AREA); 
 }
 
+int PatchList2::getSearchPatchView(ImagePatch2 &dest, const SearchResult &r) const {
+	if (r._scale < 0 || r._scale >= numScales) {
+		cout << "WARNING: Trying to view search patch at scale " << r._scale << ", but there are only " << numScales << " scales." << endl; 
+		return 0; 
+	}
+	const ImagePatch2 &im = images[r._scale]; 
+	return dest.setRepresentationsView(im.getImageHeader(), im.getIntegralHeader(), 
+									   Rect(Point(r._x, r._y), getFilterSizeAtScale(r._scale))); 
+}
+
 Size PatchList2::getMaxEffectivePatchSize() const {
 	int maxw = maxsize.width; 
 	if (maxsize.width == 0 || maxsize.width > origImageSize.width)
@@ -826,3 +838,7 @@ void PatchList2::setDontScaleDownPatches(int flag) {
 	scaleDownPatches = !flag; 
 }
 
+void PatchList2::setNearbyPatchViews(int flag) {
+	nearbyPatchViews = flag; 
+}
+
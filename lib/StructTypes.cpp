@@ -1,5 +1,6 @@
 #include "StructTypes.h"
 #include "GentleBoostClassifier2.h"
+#include <math.h>
 
 double (*_featureCost)(const PerformanceMetrics& ) = &(GentleBoostClassifier2::featureCost);
 
@@ -24,4 +25,43 @@ bool operator<(const FeaturePerformance2& a, const FeaturePerformance2& b){
 
 void setFeatureCostFunction(double (*costFun)(const PerformanceMetrics&  )) {
 	_featureCost = costFun; 
-}
\ No newline at end of file
+}
+
+//JSON has no representation for inf or nan. 
+static void writeJSONNumber(std::ostream& out, double val) {
+	if (isnan(val) || isinf(val)) out << "null"; 
+	else out << val; 
+}
+
+std::ostream& operator<< (std::ostream& out, const TrainingRoundStats& stats) {
+	out << "{\"round\": " << stats.round 
+	<< ", \"candidates_evaluated\": " << stats.candidates_evaluated 
+	<< ", \"seconds_total\": " << stats.seconds_total 
+	<< ", \"seconds_mining\": " << stats.seconds_mining 
+	<< ", \"seconds_tournament\": " << stats.seconds_tournament 
+	<< ", \"seconds_response\": " << stats.seconds_response 
+	<< ", \"seconds_lut_fit\": " << stats.seconds_lut_fit 
+	<< ", \"seconds_chisq\": " << stats.seconds_chisq 
+	<< ", \"seconds_add_feature\": " << stats.seconds_add_feature 
+	<< ", \"patches_evaluated\": " << stats.patches_evaluated 
+	<< ", \"patches_per_second\": " ; 
+	writeJSONNumber(out, stats.patches_per_second); 
+	out << ", \"bg_images_searched\": " << stats.bg_images_searched 
+	<< ", \"bg_windows_searched\": " << stats.bg_windows_searched 
+	<< ", \"bg_windows_kept\": " << stats.bg_windows_kept 
+	<< ", \"bg_patches_replaced\": " << stats.bg_patches_replaced 
+	<< ", \"image_cache_hits\": " << stats.image_cache_hits 
+	<< ", \"image_cache_misses\": " << stats.image_cache_misses 
+	<< ", \"num_training_patches\": " << stats.num_training_patches 
+	<< ", \"patch_bytes\": " << stats.patch_bytes 
+	<< ", \"training_state_bytes\": " << stats.training_state_bytes 
+	<< ", \"time_per_patch\": " ; 
+	writeJSONNumber(out, stats.time_per_patch); 
+	out << ", \"chisq\": " ; 
+	writeJSONNumber(out, stats.perf.chisq); 
+	out << ", \"pos_rejects\": " << stats.perf.pos_rejects 
+	<< ", \"neg_rejects\": " << stats.perf.neg_rejects 
+	<< ", \"total_pos\": " << stats.perf.total_pos 
+	<< ", \"total_neg\": " << stats.perf.total_neg << "}"; 
+	return out; 
+}
@@ -0,0 +1,325 @@
+/*
+ *  BatchDetectImages.cpp
+ *  OpenCV
+ *
+ */
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GentleBoostCascadedClassifier.h"
+#include "GentleBoostCascadedSearchContext.h"
+#include "ImageDataSet2.h"
+#include "ImageCache2.h"
+#include "DetectionEvaluator2.h"
+#include "ArchiveImageSource2.h"
+
+using namespace std;
+using namespace cv;
+
+/**
+ * Searches one batch of images, one image per task, reading the images that
+ * weren't already read from an archive through the shared ImageCache2. Each
+ * task has its own search context, and all contexts share one classifier.
+ */
+class BatchDetectionBody : public ParallelLoopBody {
+public:
+	BatchDetectionBody(const vector<string> &fileNames,
+					   const vector<Mat> &images,
+					   vector<GentleBoostCascadedSearchContext*> &contexts,
+					   vector<vector<SearchResult> > &results,
+					   vector<double> &seconds,
+					   vector<int> &readOK,
+					   int NMSRadius, double threshold) :
+	fileNames(fileNames), images(images), contexts(contexts), results(results),
+	seconds(seconds), readOK(readOK), NMSRadius(NMSRadius), threshold(threshold) {}
+
+	void operator()(const Range &range) const {
+		for (int j = range.start; j < range.end; j++) {
+			int64 start = getTickCount();
+			results[j].clear();
+			Mat im = images[j];
+			readOK[j] = !im.empty() || ImageCache2::getSharedCache().getImage(fileNames[j], im);
+			if (readOK[j]) contexts[j]->searchImage(im, results[j], NMSRadius, threshold);
+			seconds[j] = (getTickCount()-start)/getTickFrequency();
+		}
+	}
+
+private:
+	const vector<string> &fileNames;
+	const vector<Mat> &images;
+	vector<GentleBoostCascadedSearchContext*> &contexts;
+	vector<vector<SearchResult> > &results;
+	vector<double> &seconds;
+	vector<int> &readOK;
+	int NMSRadius;
+	double threshold;
+};
+
+static string csvField(const string &s) {
+	if (s.find_first_of(",\"\n") == string::npos) return s;
+	string out = "\"";
+	for (size_t i = 0; i < s.size(); i++) {
+		if (s[i] == '"') out += '"';
+		out += s[i];
+	}
+	return out + "\"";
+}
+
+static string jsonString(const string &s) {
+	string out = "\"";
+	for (size_t i = 0; i < s.size(); i++) {
+		unsigned char c = s[i];
+		if (c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+		} else {
+			if (c == '"' || c == '\\') out += '\\';
+			out += s[i];
+		}
+	}
+	return out + "\"";
+}
+
+static double percentile(const vector<double> &sorted, double p) {
+	if (sorted.empty()) return 0;
+	size_t ind = (size_t)(p*(sorted.size()-1)+.5);
+	return sorted[ind];
+}
+
+int main (int argc, char * const argv[])
+{
+	int useJSON = 0;
+	int useFast = 0;
+	int numThreads = 0;
+	int NMSRadius = 0;
+	int maxResults = 0;
+	int numFeaturesToUse = -1;
+	int cacheMegabytes = 0; //Each image is searched once, so by default nothing is kept
+	double threshold = -INFINITY;
+	string outputFile, rocFile, archiveFile;
+	vector<string> files;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--json")) useJSON = 1;
+		else if (!strcmp(argv[i], "--csv")) useJSON = 0;
+		else if (!strcmp(argv[i], "--fast")) useFast = 1;
+		else if (!strcmp(argv[i], "--threads") && i+1 < argc) numThreads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--nms") && i+1 < argc) NMSRadius = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--max-results") && i+1 < argc) maxResults = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--features") && i+1 < argc) numFeaturesToUse = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--cache-mb") && i+1 < argc) cacheMegabytes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--thresh") && i+1 < argc) threshold = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--output") && i+1 < argc) outputFile = argv[++i];
+		else if (!strcmp(argv[i], "--roc") && i+1 < argc) rocFile = argv[++i];
+		else if (!strcmp(argv[i], "--archive") && i+1 < argc) archiveFile = argv[++i];
+		else files.push_back(argv[i]);
+	}
+
+	if (files.size() < 2 || files.size() > 3 || files[0][0] == '-' || (!rocFile.empty() && files.size() != 3)) {
+		cout << argv[0] << ": Search every image in a list with a GentleBoostCascadedClassifier, using" << endl
+		<< "all cores, and write the detections of each image as it finishes." << endl << endl;
+		cout << "Usage:" << endl ;
+		cout << "\t" << argv[0] << " [options] cascadeFile imageListFile [imageLabelsFile]" << endl;
+		cout << "\t\timageListFile and imageLabelsFile are in the format read by ImageDataSet2." << endl;
+		cout << "\t\tEach image is searched once, even if it is listed several times." << endl;
+		cout << "\t--csv\t\t: Write one line per detection: file,x,y,width,height,scale,value (default)." << endl;
+		cout << "\t--json\t\t: Write one JSON object per image, with its detections and search time." << endl;
+		cout << "\t--output file\t: Write detections to file rather than to standard output." << endl;
+		cout << "\t--threads n\t: Number of worker threads (default: all cores)." << endl;
+		cout << "\t--nms r\t\t: Non-maximum suppression radius in pixels (default 0, off)." << endl;
+		cout << "\t--thresh t\t: Only report detections with value above t (default: all)." << endl;
+		cout << "\t--max-results n\t: Report at most n detections per image (default: all)." << endl;
+		cout << "\t--features n\t: Use only the first n features of the cascade (default: all)." << endl;
+		cout << "\t--fast\t\t: Search with a FastPatchList." << endl;
+		cout << "\t--cache-mb n\t: Keep up to n MB of decoded images in the shared ImageCache2 (default 0)." << endl;
+		cout << "\t--archive file\t: Read the listed images out of a tar (or gzip tar) archive in one" << endl;
+		cout << "\t\t\t  pass, rather than opening each file. Images are matched to archive" << endl;
+		cout << "\t\t\t  members by name, and results are written in archive order." << endl;
+		cout << "\t--roc file\t: Evaluate the detections against imageLabelsFile with DetectionEvaluator2," << endl;
+		cout << "\t\t\t  and write threshold,hits,misses,false_alarms,hit_ratio lines to file." << endl;
+		cout << "\t" << argv[0] << " --help\t: Print this message and quit." << endl;
+		return 0;
+	}
+
+	ifstream in(files[0].c_str());
+	if (!in.is_open()) {
+		cout << "Warning: Couldn't open " << files[0] << endl;
+		return 1;
+	}
+	Ptr<GentleBoostCascadedClassifier> booster = new GentleBoostCascadedClassifier();
+	GentleBoostCascadedClassifier* loaded = booster;
+	in >> loaded;
+	int cascadeOK = !in.fail();
+	in.close();
+	if (!cascadeOK || booster->getNumFeaturesTotal() < 1) {
+		cout << "Warning: Couldn't read a cascade with any features from " << files[0] << endl;
+		return 1;
+	}
+	booster->setSearchParams(useFast);
+	booster->setNumFeaturesUsed(numFeaturesToUse);
+
+	DetectionEvaluator2 evaluator;
+	vector<string> fileNames;
+	if (files.size() == 3) {
+		evaluator.setDataSet(files[1], files[2]);
+		fileNames = evaluator.getFileNames();
+	} else {
+		ImageDataSet2 images(files[1]);
+		set<string> seen;
+		for (int i = 0; i < images.getNumEntries(); i++) {
+			string name = images.getFileName(i);
+			if (seen.insert(name).second) fileNames.push_back(name);
+		}
+	}
+	int numFiles = fileNames.size();
+
+	ofstream outFile;
+	if (!outputFile.empty()) {
+		outFile.open(outputFile.c_str());
+		if (!outFile.is_open()) {
+			cout << "Warning: Couldn't open " << outputFile << " for writing." << endl;
+			return 1;
+		}
+	}
+	ostream &out = outputFile.empty() ? cout : outFile;
+	//Progress and timing go to stderr when detections go to stdout.
+	ostream &log = outputFile.empty() ? cerr : cout;
+
+	if (numThreads > 0) setNumThreads(numThreads);
+	ImageCache2::getSharedCache().setByteBudget((size_t)(cacheMegabytes < 0 ? 0 : cacheMegabytes) << 20);
+	int batchSize = 2*getNumThreads();
+	batchSize = batchSize < 1 ? 1 : batchSize;
+	batchSize = batchSize > numFiles ? numFiles : batchSize;
+
+	Ptr<ArchiveImageSource2> archive;
+	if (!archiveFile.empty()) {
+		ImageDataSet2 wanted;
+		for (int i = 0; i < numFiles; i++) wanted.addEntry(fileNames[i]);
+		archive = new ArchiveImageSource2(archiveFile, wanted);
+		if (!archive->isOpened()) return 1;
+	}
+
+	//Created after every early return, and deleted as soon as the search is done.
+	vector<GentleBoostCascadedSearchContext*> contexts(batchSize);
+	for (int j = 0; j < batchSize; j++) contexts[j] = new GentleBoostCascadedSearchContext(booster);
+
+	if (!useJSON) out << "file,x,y,width,height,scale,value" << endl;
+
+	vector<double> latencies;
+	latencies.reserve(numFiles);
+	vector<vector<SearchResult> > allBoxes;
+	if (!rocFile.empty()) allBoxes.resize(numFiles);
+	int numFailed = 0;
+	int64 start = getTickCount();
+
+	int nextFile = 0;
+	while (1) {
+		//Gather the next batch, either in list order, or in archive order.
+		vector<int> batchFiles;
+		vector<Mat> batchImages;
+		if (archive.empty()) {
+			for (; nextFile < numFiles && (int)batchFiles.size() < batchSize; nextFile++) {
+				batchFiles.push_back(nextFile);
+				batchImages.push_back(Mat());
+			}
+		} else {
+			string memberName;
+			Mat image;
+			vector<int> entries;
+			while ((int)batchFiles.size() < batchSize && archive->nextImage(memberName, image, entries)) {
+				batchFiles.push_back(entries[0]);
+				batchImages.push_back(image);
+			}
+		}
+		int numInBatch = batchFiles.size();
+		if (numInBatch == 0) break;
+
+		vector<string> batchNames(numInBatch);
+		for (int j = 0; j < numInBatch; j++) batchNames[j] = fileNames[batchFiles[j]];
+		vector<vector<SearchResult> > results(numInBatch);
+		vector<double> seconds(numInBatch);
+		vector<int> readOK(numInBatch);
+		parallel_for_(Range(0, numInBatch),
+					  BatchDetectionBody(batchNames, batchImages, contexts, results, seconds, readOK,
+										 NMSRadius, threshold));
+
+		//Write results in batch order, so output is the same for any number of threads.
+		for (int j = 0; j < numInBatch; j++) {
+			if (!readOK[j]) {
+				log << "Warning: Couldn't read image " << batchNames[j] << endl;
+				numFailed++;
+			} else {
+				latencies.push_back(seconds[j]);
+			}
+			vector<SearchResult> &boxes = results[j];
+			if (maxResults > 0 && boxes.size() > (size_t)maxResults) boxes.resize(maxResults);
+
+			if (useJSON) {
+				out << "{\"file\": " << jsonString(batchNames[j]) << ", \"ok\": " << readOK[j]
+				<< ", \"seconds\": " << seconds[j] << ", \"detections\": [";
+				for (size_t k = 0; k < boxes.size(); k++) {
+					Rect r = boxes[k].imageLocation;
+					out << (k ? ", " : "") << "{\"x\": " << r.x << ", \"y\": " << r.y
+					<< ", \"width\": " << r.width << ", \"height\": " << r.height
+					<< ", \"scale\": " << boxes[k]._scale << ", \"value\": " << boxes[k].value << "}";
+				}
+				out << "]}" << endl;
+			} else {
+				string name = csvField(batchNames[j]);
+				for (size_t k = 0; k < boxes.size(); k++) {
+					Rect r = boxes[k].imageLocation;
+					out << name << "," << r.x << "," << r.y << "," << r.width << "," << r.height
+					<< "," << boxes[k]._scale << "," << boxes[k].value << endl;
+				}
+			}
+			if (!rocFile.empty()) allBoxes[batchFiles[j]].swap(boxes);
+		}
+		out.flush();
+	}
+	for (int j = 0; j < batchSize; j++) delete contexts[j];
+
+	if (!archive.empty()) {
+		vector<int> missing = archive->getUnmatchedEntries();
+		for (size_t i = 0; i < missing.size(); i++) {
+			log << "Warning: Couldn't read image " << fileNames[missing[i]] << " from " << archiveFile << endl;
+		}
+		numFailed += missing.size();
+	}
+
+	double totalSeconds = (getTickCount()-start)/getTickFrequency();
+	sort(latencies.begin(), latencies.end());
+	log << "Searched " << numFiles << " images (" << numFailed << " unreadable) in " << totalSeconds
+	<< " s with " << getNumThreads() << " threads: " << (totalSeconds > 0 ? numFiles/totalSeconds : 0)
+	<< " images/s." << endl;
+	log << "Per-image latency (s): p50 " << percentile(latencies, .5) << ", p90 " << percentile(latencies, .9)
+	<< ", p99 " << percentile(latencies, .99) << ", max " << (latencies.empty() ? 0 : latencies.back()) << endl;
+
+	if (!rocFile.empty()) {
+		vector<EvaluationMetrics> roc = evaluator.evaluatePerformance(allBoxes);
+		ofstream rocOut(rocFile.c_str());
+		if (!rocOut.is_open()) {
+			cout << "Warning: Couldn't open " << rocFile << " for writing." << endl;
+			return 1;
+		}
+		rocOut << "threshold,hits,misses,false_alarms,hit_ratio" << endl;
+		for (size_t i = 0; i < roc.size(); i++) {
+			rocOut << roc[i].threshold << "," << roc[i].num_hits << "," << roc[i].num_misses << ","
+			<< roc[i].num_false_alarms << "," << roc[i].hit_ratio << endl;
+		}
+		rocOut.close();
+		log << "Wrote " << roc.size() << " ROC points to " << rocFile << endl;
+	}
+
+	return 0;
+}
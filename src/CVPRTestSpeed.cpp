@@ -38,7 +38,13 @@
  * \li Estimated Probability that Face is really at Face Location
  * \li Posterior Belief Distribution Negative Entropy.
  *
- * Then, statistics of average performance are printed. 
+ * Then, statistics of average performance are printed, along with the 
+ * distribution of per-image search times. 
+ *
+ * By default, images are searched one at a time, as in the paper. Run with 
+ * "--threads n" to evaluate n images at once, each worker with its own copy 
+ * of the MIPOMDP (see MIPOMDPEvaluator). Add "--pin" to run one worker per 
+ * core, pinned to that core, which keeps timings comparable between runs. 
  *
  * MIPOMDP is an extension of the IPOMDP Infomax Model of Eye-movment in Butko 
  * and Movellan, 2008; Najemnik and Geisler, 2005 (see \ref bib_sec).
@@ -49,8 +55,10 @@
 using namespace std; 
 #include "ImageDataSet.h"
 #include "MIPOMDP.h"
-#include "BlockTimer.h"
+#include "MIPOMDPEvaluator.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <iostream> 
 #include <string>
 
@@ -65,103 +73,32 @@ int main(int argc, char** argv) {
 	CvSize gridSize = cvSize(21,21); 
 	int numScales =4; 
 	
+	MIPOMDPEvaluator evaluator; 
+	evaluator.setStopConfidence(0.125); 
+	evaluator.setNumWorkers(1); 
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--threads") && i+1 < argc) evaluator.setNumWorkers(atoi(argv[++i])); 
+		else if (!strcmp(argv[i], "--pin")) evaluator.setPinThreads(1); 
+	}
+	
 	ImageDataSet* train = ImageDataSet::loadFromFile(files, labels); 
 	cout << "Loaded dataset of  " << train->getNumEntries() << " files, with ";  
 	cout << train->numLabelsPerImage() << " labels. " << endl; 
 	
-	
-	BlockTimer timer; 
-
-	
-	double totalSearchTime=0, totalSearchGridErr=0, totalHiResTime=0; 
-	double totalHiResGridErr=0; 
-	int numImages = 0; 
-	long long numPixels = 0; 
-	
 	for (int i = 0; i < 7; i++) {
 		ImageDataSet* test = train->split(0, 499); 
 		char pomdpfile[5000]; 
 		snprintf(pomdpfile, 5000, 
 				 "data/MIPOMDPData-%dx%d-%dScales-HoldoutSet%d.txt", 
 				 gridSize.width, gridSize.height, numScales, i); 
-		MIPOMDP* pomdp = MIPOMDP::loadFromFile(pomdpfile);
-		pomdp->setGeneratePreview(0); 
-		cout << "Holdout Set " << i << "; Loaded File " << pomdpfile << endl; 
-		for (int j = 0; j < test->getNumEntries(); j++) {
-			double stopconf = 0.125; 			
-			string imageFile = test->getFileName(j); 
-			vector<double> imageLabels = test->getFileLabels(j); 
-			CvPoint faceLocation = cvPoint(imageLabels[0], imageLabels[1]); 
-			
-			IplImage* current_frame = cvLoadImage(imageFile.c_str(), 
-												  CV_LOAD_IMAGE_GRAYSCALE ); 
-			pomdp->changeInputImageSize(cvSize(current_frame->width, 
-											   current_frame->height)); 
-			CvPoint faceGridLocation = pomdp->gridPointForPixel(faceLocation); 			
-			
-			timer.blockStart(1); 
-			CvPoint searchPoint = pomdp->searchFrameUntilConfident(current_frame
-																   , stopconf);		
-			timer.blockStop(1); 
-			double searchProb = pomdp->getProb(); 
-			double searchRew = pomdp->getReward(); 
-			CvPoint searchGridPoint = pomdp->gridPointForPixel(searchPoint);
-			pomdp->resetPrior(); 
-			
-			timer.blockStart(2); 
-			CvPoint hiresPoint = pomdp->searchHighResImage(current_frame);			
-			timer.blockStop(2); 
-			CvPoint hiresGridPoint = pomdp->gridPointForPixel(hiresPoint);
-			pomdp->resetPrior(); 
-			
-			
-			double distGridSearch = sqrt((searchGridPoint.x-faceGridLocation.x)*
-										 (searchGridPoint.x-faceGridLocation.x)+
-										 (searchGridPoint.y-faceGridLocation.y)*
-										 (searchGridPoint.y-faceGridLocation.y)
-			); 
-			double distGridHires = sqrt((hiresGridPoint.x-faceGridLocation.x)*
-										(hiresGridPoint.x-faceGridLocation.x)+
-										(hiresGridPoint.y-faceGridLocation.y)*
-										(hiresGridPoint.y-faceGridLocation.y)); 
-			
-			double searchTime = timer.getTotTime(1); 
-			double hiresTime = timer.getTotTime(2); 
-			
-			totalSearchTime = totalSearchTime+searchTime; 
-			totalSearchGridErr = totalSearchGridErr+distGridSearch; 
-			totalHiResTime = totalHiResTime+hiresTime; 
-			totalHiResGridErr = totalHiResGridErr+distGridHires; 
-			numImages++; 
-			numPixels = numPixels + current_frame->width*current_frame->height; 
-			
-						
-			cout << searchTime << ", " << hiresTime << ", " << distGridSearch ;
-			cout << ", " << distGridHires  << ", " << current_frame->width ; 
-			cout << ", " << current_frame->height << ", " << searchProb << ", ";
-			cout << searchRew <<  endl; 
-			
-			cout << "Mean MIPOMDP Search Time: " ;
-			cout << totalSearchTime / numImages << " Seconds" << endl; 
-			cout << "Mean VJ Search Time     : " ; 
-			cout << totalHiResTime / numImages << " Seconds" << endl; 
-			cout << "Mean MIPOMDP Search Rate: " ; 
-			cout << totalSearchTime*1000000/numPixels <<" ms / 1000 px" << endl; 
-			cout << "Mean VJ Search Rate     : " ; 
-			cout << totalHiResTime*1000000/numPixels << " ms / 1000 px" << endl; 
-			cout << "Mean MIPOMDP Grid Error : " ; 
-			cout << totalSearchGridErr / numImages << endl; 
-			cout << "Mean VJ Grid Error      : " ; 
-			cout << totalHiResGridErr / numImages << endl; 
-			
-			cvReleaseImage(&current_frame); 
-			
-			timer.blockReset(1); 
-			timer.blockReset(2); 	
-			
-			
-		}		
+		evaluator.addFold(pomdpfile, test); 
+		cout << "Holdout Set " << i << "; Using File " << pomdpfile << endl; 
 		delete(test); 
-		delete(pomdp); 
 	}
-}
\ No newline at end of file
+	delete(train); 
+			
+	evaluator.setProgressStream(&cout); 
+	evaluator.run(); 
+	evaluator.printSummary(cout); 
+	return 0; 
+}
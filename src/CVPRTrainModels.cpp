@@ -16,6 +16,12 @@
  * (2) Run the program.<br>
  * <tt> \>\> bin/CVPRTrainModels.</tt>
  *
+ * To train models for a face detector trained with NMPT (e.g. by 
+ * TrainCascadedDetector) rather than OpenCV's Haar cascade, give its file: <br>
+ * <tt> \>\> bin/CVPRTrainModels data/face.cascade</tt><br>
+ * The models then search with a GentleBoostCascadeDetector, which builds one
+ * image pyramid per frame and reuses it for every scale and fixation.
+ *
  * \b Description: 
  *
  * This example program is contained in "CVPRTrainModels.cpp". Following the 
@@ -58,6 +64,10 @@ int main(int argc, char** argv) {
 	
 
 	MIPOMDP* pomdp = new MIPOMDP(); 
+	if (argc > 1) {
+		cout << "Using NMPT cascade " << argv[1] << " as the object detector." << endl; 
+		pomdp->setObjectDetector(new GentleBoostCascadeDetector(argv[1])); 
+	}
 	CvSize gridSize = pomdp->getGridSize(); 
 	int numScales = pomdp->getNumScales(); 
 	
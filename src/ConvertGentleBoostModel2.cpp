@@ -0,0 +1,61 @@
+/*
+ *  ConvertGentleBoostModel2.cpp
+ *  OpenCV
+ *
+ */
+
+#include <opencv2/core/core.hpp>
+#include <iostream>
+#include <string>
+#include <string.h>
+#include "GentleBoostClassifier2.h"
+
+using namespace std;
+using namespace cv;
+
+int main (int argc, char * const argv[])
+{
+	int lutDepth = CV_64F;
+	vector<string> files;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--float-luts")) lutDepth = CV_32F;
+		else files.push_back(argv[i]);
+	}
+
+	if (files.size() != 2 || files[0][0] == '-') {
+		cout << argv[0] << ": Convert a GentleBoostClassifier2 model between the OpenCV FileStorage" << endl
+		<< "format and the compact binary format." << endl << endl;
+		cout << "Usage:" << endl ;
+		cout << "\t" << argv[0] << " [--float-luts] input output" << endl;
+		cout << "\t\tIf input is a FileStorage model, write it to output in the binary format," << endl;
+		cout << "\t\tstoring lookup tables as single precision if --float-luts is given." << endl;
+		cout << "\t\tIf input is a binary model, write it to output as FileStorage." << endl;
+		cout << "\t" << argv[0] << " --help\t: Print this message and quit." << endl;
+		return 0;
+	}
+
+	GentleBoostClassifier2 booster;
+	if (GentleBoostClassifier2::isBinaryModelFile(files[0])) {
+		if (!booster.loadBinaryModel(files[0])) return 1;
+		FileStorage file(files[1], FileStorage::WRITE);
+		if (!file.isOpened()) {
+			cout << "Warning: Couldn't open " << files[1] << " for writing." << endl;
+			return 1;
+		}
+		file << "GentleBoostClassifier" << booster;
+		file.release();
+	} else {
+		FileStorage file(files[0], FileStorage::READ);
+		if (!file.isOpened()) {
+			cout << "Warning: Couldn't open " << files[0] << endl;
+			return 1;
+		}
+		file["GentleBoostClassifier"] >> booster;
+		file.release();
+		if (!booster.saveBinaryModel(files[1], lutDepth)) return 1;
+	}
+	cout << "Wrote a GentleBoostClassifier with " << booster.getNumFeaturesTotal()
+	<< " features to " << files[1] << endl;
+	return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ *  ConvertMIPOMDPModel.cpp
+ *  OpenCV
+ *
+ */
+
+#include <iostream>
+#include <string>
+#include <string.h>
+#include "MIPOMDP.h"
+
+using namespace std;
+
+int main (int argc, char * const argv[])
+{
+	if (argc != 3 || !strcmp(argv[1], "--help")) {
+		cout << argv[0] << ": Convert a MIPOMDP model between the text format and the" << endl
+		<< "checksummed binary format." << endl << endl;
+		cout << "Usage:" << endl ;
+		cout << "\t" << argv[0] << " input output" << endl;
+		cout << "\t\tIf input is a text model (from MIPOMDP::saveToFile), write it to output in" << endl;
+		cout << "\t\tthe binary format. If input is a binary model, write it to output as text." << endl;
+		cout << "\t" << argv[0] << " --help\t: Print this message and quit." << endl;
+		return 0;
+	}
+
+	int toBinary = !MIPOMDP::isBinaryModelFile(argv[1]);
+	MIPOMDP* pomdp = MIPOMDP::loadFromFile(argv[1]);
+	if (pomdp == NULL) return 1;
+
+	if (toBinary) {
+		if (!pomdp->saveToBinaryFile(argv[2])) {
+			delete(pomdp);
+			return 1;
+		}
+	} else {
+		pomdp->saveToFile(argv[2]);
+	}
+	cout << "Wrote a " << pomdp->getGridSize().width << "x" << pomdp->getGridSize().height
+	<< " MIPOMDP with " << pomdp->getNumScales() << " scales to " << argv[2]
+	<< (toBinary ? " in the binary format." : " as text.") << endl;
+	delete(pomdp);
+	return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ *  ConvertPatchDataset2.cpp
+ *  OpenCV
+ *
+ */
+
+#include <opencv2/core/core.hpp>
+#include <iostream>
+#include <string>
+#include <string.h>
+#include "PatchDataset2.h"
+
+using namespace std;
+using namespace cv;
+
+int main (int argc, char * const argv[])
+{
+	int withIntegrals = 1;
+	int withSqIntegrals = 0;
+	vector<string> files;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--no-integrals")) withIntegrals = 0;
+		else if (!strcmp(argv[i], "--sq-integrals")) withSqIntegrals = 1;
+		else files.push_back(argv[i]);
+	}
+
+	if (files.size() != 2 || files[0][0] == '-') {
+		cout << argv[0] << ": Convert a PatchDataset2 between the OpenCV FileStorage format and" << endl
+		<< "the memory-mappable binary format." << endl << endl;
+		cout << "Usage:" << endl ;
+		cout << "\t" << argv[0] << " [--no-integrals] [--sq-integrals] input output" << endl;
+		cout << "\t\tIf input is a FileStorage dataset, write it to output in the binary format," << endl;
+		cout << "\t\tstoring integral images unless --no-integrals is given, and square" << endl;
+		cout << "\t\tintegral images if --sq-integrals is given." << endl;
+		cout << "\t\tIf input is a binary dataset, write it to output as FileStorage." << endl;
+		cout << "\t" << argv[0] << " --help\t: Print this message and quit." << endl;
+		return 0;
+	}
+
+	PatchDataset2 data;
+	if (PatchDataset2::isBinaryFile(files[0])) {
+		if (!data.loadMapped(files[0])) return 1;
+		cout << "Writing " << data.getPatches().size() << " patches to " << files[1] << endl;
+		FileStorage file(files[1], FileStorage::WRITE);
+		if (!file.isOpened()) {
+			cout << "Warning: Couldn't open " << files[1] << " for writing." << endl;
+			return 1;
+		}
+		file << "dataset" << data;
+		file.release();
+	} else {
+		FileStorage file(files[0], FileStorage::READ);
+		if (!file.isOpened()) {
+			cout << "Warning: Couldn't open " << files[0] << endl;
+			return 1;
+		}
+		file["dataset"] >> data;
+		file.release();
+		cout << "Writing " << data.getPatches().size() << " patches to " << files[1] << endl;
+		if (!data.saveBinary(files[1], withIntegrals, withSqIntegrals)) return 1;
+	}
+	return 0;
+}
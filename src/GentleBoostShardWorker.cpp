@@ -0,0 +1,67 @@
+/*
+ *  GentleBoostShardWorker.cpp
+ *  OpenCV
+ *
+ */
+
+#include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
+#include "GentleBoostShards2.h"
+#include "PatchDataset2.h"
+
+using namespace std;
+using namespace cv;
+
+int main (int argc, char * const argv[])
+{
+	string datasetname = "data/GenkiSZSLFacePatches";
+	string interfaceAddress = "127.0.0.1";
+
+	if (argc < 4 || argc > 6 || argv[1][0] == '-') {
+		cout << argv[0] << ": Serve one shard of a GentleBoost training set to a coordinator" << endl
+		<< "running TrainGentleBoost2 with shardAddresses set." << endl << endl;
+		cout << "Usage:" << endl ;
+		cout << "\t" << argv[0] << " port shard_index num_shards [dataset [interface]]" << endl;
+		cout << "\t\tKeep the patches whose index is shard_index modulo num_shards, and" << endl;
+		cout << "\t\twait for the coordinator on port. dataset defaults to " << datasetname << endl;
+		cout << "\t\tinterface defaults to " << interfaceAddress << ", which only accepts a coordinator" << endl;
+		cout << "\t\ton this host; use 0.0.0.0 to listen on all interfaces. There is no" << endl;
+		cout << "\t\tauthentication, so only listen on a trusted network." << endl;
+		cout << "\t" << argv[0] << " --help\t: Print this message and quit." << endl;
+		return 0;
+	}
+
+	int port = atoi(argv[1]);
+	int shardIndex = atoi(argv[2]);
+	int numShards = atoi(argv[3]);
+	if (argc > 4)
+		datasetname = argv[4];
+	if (argc > 5)
+		interfaceAddress = argv[5];
+
+	if (numShards < 1 || shardIndex < 0 || shardIndex >= numShards) {
+		cout << "Warning: shard_index must be in [0, num_shards)." << endl;
+		return 1;
+	}
+
+	PatchDataset2 data;
+	if (PatchDataset2::isBinaryFile(datasetname)) {
+		if (!data.loadMapped(datasetname)) return 1;
+	} else {
+		FileStorage datafile(datasetname, FileStorage::READ);
+		datafile["dataset"] >> data;
+		datafile.release();
+	}
+
+	GentleBoostShardWorker2 worker(data, shardIndex, numShards);
+
+	cout << "Shard " << shardIndex << " of " << numShards << " waiting for a coordinator on "
+	<< interfaceAddress << " port " << port << endl;
+	int socket = GentleBoostShardWorker2::waitForCoordinator(port, interfaceAddress);
+	if (socket < 0) return 1;
+
+	worker.serve(socket);
+	close(socket);
+	return 0;
+}
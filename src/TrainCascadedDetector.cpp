@@ -10,6 +10,7 @@
 #include <iostream>
 #include <fstream>
 #include "GentleBoostCascadedClassifier.h"
+#include "ImageCache2.h"
 
 using namespace std;
 
@@ -28,45 +29,82 @@ int main (int argc, char * const argv[])
 	//double eps = 0; //.001; 
 	int boostRounds = 2;
 	int patience = 10; 
+	int imageCacheMegabytes = 1024; //Decoded background images kept between mining rounds
+	int startOver = 0; 
+	int snapshotEvery = 10; //Save a resumable training snapshot every N features; 0 disables
 	
 	
 	string datasetname = "data/GenkiSZSLFacePatches"; 
 	string oldFileName = "";
 	string newFileName = "data/GenkiSZSLCascade.txt" ; 
+	string statsLogName = "data/GenkiSZSLCascadeStats.jsonl"; //One line of JSON per round; empty disables
+	string snapshotName = "data/GenkiSZSLCascade.snapshot"; 
 	
 	setFeatureCostFunction(&costFun); 
+	ImageCache2::getSharedCache().setByteBudget((size_t)imageCacheMegabytes << 20); 
 	
 	
 	GentleBoostCascadedClassifier* booster = new GentleBoostCascadedClassifier(); 
 	booster->setSearchParams(useFast);
 	
-	if (!oldFileName.empty()) {
-		ifstream in; 
-		in.open(oldFileName.c_str()); 
-		in >> booster; 
-		in.close(); 
-		booster->setTrainingSet(datasetname); 
-		cout << "Loaded existing GentleBoost cascaded with " << booster->getNumFeaturesTotal() << " features." << endl; 
-		cout << "Its patch size is " << booster->getBasePatchSize().width << "x" << booster->getBasePatchSize().height << endl; 
-	} else {
-		booster->setTrainingSet(datasetname); 
-		booster->setTrainingParams(maxPosRejectsPerRound, desiredNegRejectsPerRound); 
+	int resumed = 0; 
+	int targetNumFeatures = 0; //Total features to train to; kept in the snapshot so a resumed run stops in the same place
+	if (!startOver && snapshotEvery > 0) {
+		ifstream snapshot(snapshotName.c_str()); 
+		if (snapshot.good()) {
+			snapshot.close(); 
+			resumed = booster->loadTrainingSnapshot(snapshotName, &targetNumFeatures); 
+			if (resumed) 
+				cout << "Resuming training of a GentleBoost cascade with " 
+				<< booster->getNumFeaturesTotal() << " features." << endl; 
+		}
+	}
+	
+	if (!resumed) {
+		if (!oldFileName.empty()) {
+			ifstream in; 
+			in.open(oldFileName.c_str()); 
+			in >> booster; 
+			in.close(); 
+			booster->setTrainingSet(datasetname); 
+			cout << "Loaded existing GentleBoost cascaded with " << booster->getNumFeaturesTotal() << " features." << endl; 
+			cout << "Its patch size is " << booster->getBasePatchSize().width << "x" << booster->getBasePatchSize().height << endl; 
+		} else {
+			booster->setTrainingSet(datasetname); 
+			booster->setTrainingParams(maxPosRejectsPerRound, desiredNegRejectsPerRound); 
+		}
 	}
 	
 	//FeatureRegressor::TAU = tau; 
 	//FeatureRegressor::EPS = eps; 
 	
-	for (int iteration  = 0; iteration < numFeaturesToAddToModel; iteration++){
-		cout << "Iteration Number " << iteration << endl; 
+	ofstream statsLog; 
+	if (!statsLogName.empty()) 
+		statsLog.open(statsLogName.c_str(), ios::out | ios::app); 
+	
+	if (targetNumFeatures <= 0) 
+		targetNumFeatures = booster->getNumFeaturesTotal() + numFeaturesToAddToModel; 
+	
+	while (booster->getNumFeaturesTotal() < targetNumFeatures) {
+		int numBefore = booster->getNumFeaturesTotal(); 
+		cout << "Iteration Number " << numBefore << " of " << targetNumFeatures << endl; 
 		
 		PerformanceMetrics perf = booster->trainOneRound(patience, boostRounds); 
+		if (booster->getNumFeaturesTotal() <= numBefore) {
+			cout << "Warning: No feature was added in this round; stopping." << endl; 
+			break; 
+		}
 		cout << "Saving" << endl; 
 		ofstream out; 
 		out.open(newFileName.c_str()); 
 		out << booster; 
 		out.close(); 	
+		if (snapshotEvery > 0 && booster->getNumFeaturesTotal() % snapshotEvery == 0) 
+			booster->saveTrainingSnapshot(snapshotName, targetNumFeatures); 
 		cout << "Data Chi-Sq: " << perf.chisq  << " ; Pos Rejects: " << perf.pos_rejects 
 		<< " ; Neg Rejects: " << perf.neg_rejects << endl; 
+		if (statsLog.is_open()) 
+			statsLog << booster->getLastRoundStats() << endl; 
 		cout << "======================================" << endl; 
 		
 		if (booster->exhaustedAllNegPatches()) break; 
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <fstream>
 #include "GentleBoostClassifier2.h"
+#include "GentleBoostShards2.h"
 #include "ImagePatch2.h"
 #include "PatchDataset2.h"
 
@@ -23,37 +24,85 @@ int main (int argc, char * const argv[])
 	int boostRounds = 2;
 	int patience = 1; 
 	int startOver = 0; 
+	int screeningSubsampleSize = 0; //e.g. 5000 for 100k-patch datasets; 0 scores every candidate on all patches
+	double screeningRescoreFraction = .1; 
+	int snapshotEvery = 10; //Save a resumable training snapshot every N features; 0 disables
+	int numLocalShards = 0; //Split the patches among this many forked worker processes; 0 trains in this process
+	vector<string> shardAddresses; //host:port of GentleBoostShardWorker processes, e.g. "node2:7300"; overrides numLocalShards
 	
 	
 	string datasetname = "data/GenkiSZSLFacePatches"; 
 	string fileName = "data/GenkiSZSLBoost.txt" ; 
+	string snapshotName = "data/GenkiSZSLBoost.snapshot" ; 
+	
+	GentleBoostShardCoordinator2 shards; 
+	int sharded = numLocalShards > 0 || !shardAddresses.empty(); 
 	
 	GentleBoostClassifier2 booster; 
 	
-	if (!startOver) {
-		FileStorage file(fileName, FileStorage::READ); 
-		if (file.isOpened()) {
-			file["GentleBoostClassifier"] >> booster; 
-			cout << "Adding to a GentleBoostClassifier with " 
-			<< booster.getNumFeaturesTotal() << " features." << endl; 
+	int resumed = 0; 
+	int targetNumFeatures = 0; //Total features to train to; kept in the snapshot so a resumed run stops in the same place
+	if (!startOver && snapshotEvery > 0 && !sharded) {
+		ifstream snapshot(snapshotName.c_str()); 
+		if (snapshot.good()) {
+			snapshot.close(); 
+			resumed = booster.loadTrainingSnapshot(snapshotName, &targetNumFeatures); 
+			if (resumed) 
+				cout << "Resuming training of a GentleBoostClassifier with " 
+				<< booster.getNumFeaturesTotal() << " features." << endl; 
 		}
-		file.release(); 
 	}
 	
-	PatchDataset2 data; 
-	FileStorage datafile(datasetname, FileStorage::READ); 
-	datafile["dataset"] >> data; 
-	datafile.release(); 
+	if (!resumed) {
+		if (!startOver) {
+			FileStorage file(fileName, FileStorage::READ); 
+			if (file.isOpened()) {
+				file["GentleBoostClassifier"] >> booster; 
+				cout << "Adding to a GentleBoostClassifier with " 
+				<< booster.getNumFeaturesTotal() << " features." << endl; 
+			}
+			file.release(); 
+		}
 	
-	booster.setTrainingSet(data); 
+		if (!shardAddresses.empty()) {
+			if (!shards.connectToWorkers(shardAddresses)) return 1; 
+			booster.setTrainingShards(&shards); 
+		} else {
+			PatchDataset2 data; 
+			if (PatchDataset2::isBinaryFile(datasetname)) {
+				if (!data.loadMapped(datasetname)) return 1; 
+			} else {
+				FileStorage datafile(datasetname, FileStorage::READ); 
+				datafile["dataset"] >> data; 
+				datafile.release(); 
+			}
+		
+			if (numLocalShards > 0) {
+				if (!shards.spawnLocalWorkers(data, numLocalShards)) return 1; 
+				booster.setTrainingShards(&shards); 
+			} else {
+				booster.setTrainingSet(data); 
+			}
+		}
+	}
+	booster.setCandidateScreening(screeningSubsampleSize, screeningRescoreFraction); 
+	if (targetNumFeatures <= 0) 
+		targetNumFeatures = booster.getNumFeaturesTotal() + numFeaturesToAddToModel; 
 
-	for (int iteration  = 0; iteration < numFeaturesToAddToModel; iteration++){
-		cout << "Training Iteration Number " << (iteration+1) << endl; 
+	while (booster.getNumFeaturesTotal() < targetNumFeatures) {
+		int numBefore = booster.getNumFeaturesTotal(); 
+		cout << "Training Iteration Number " << (numBefore+1) << " of " << targetNumFeatures << endl; 
 		
 		PerformanceMetrics perf = booster.trainOneRound(patience, boostRounds); 
+		if (booster.getNumFeaturesTotal() <= numBefore) {
+			cout << "Warning: No feature was added in this round; stopping." << endl; 
+			break; 
+		}
 		FileStorage file(fileName, FileStorage::WRITE);
 		file << "GentleBoostClassifier" << booster; 
 		file.release(); 
+		if (!sharded && snapshotEvery > 0 && booster.getNumFeaturesTotal() % snapshotEvery == 0) 
+			booster.saveTrainingSnapshot(snapshotName, targetNumFeatures); 
 		cout << "Training Data Chi-Sq: " << perf.chisq  <<  endl; 
 		cout << "======================================" << endl; 
 		